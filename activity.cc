@@ -14,13 +14,128 @@
 
 #include "activity.h"
 
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <numeric>
+
+#include "absl/synchronization/blocking_counter.h"
 #include "benchmark/benchmark.h"
 #include "boost/preprocessor/repetition/repeat.hpp"
+#include "distbench_thread_support.h"
 #include "distbench_utils.h"
 #include "glog/logging.h"
 
 namespace distbench {
 
+namespace {
+
+// Iterations of an activity may run in parallel, so each thread gets its own
+// random number generator:
+std::mt19937& ThreadMersenneTwister() {
+  thread_local std::mt19937 prng{std::random_device()()};
+  return prng;
+}
+
+int64_t ThreadCpuTimeNs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec * 1'000'000'000LL + ts.tv_nsec;
+}
+
+int64_t NsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+absl::Status ValidateMemoryConfig(ActivityConfig& ac) {
+  auto footprint_bytes = GetNamedSettingInt64(ac.activity_settings(),
+                                              "footprint_bytes", 64 << 20);
+  if (footprint_bytes < 4096) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "footprint_bytes (", footprint_bytes, ") must be at least 4096."));
+  }
+  auto numa_node =
+      GetNamedSettingInt64(ac.activity_settings(), "numa_node", -1);
+  if (numa_node < -1) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "numa_node (", numa_node, ") must be -1 or a valid node."));
+  }
+  return absl::OkStatus();
+}
+
+absl::Status ValidatePositiveSetting(ActivityConfig& ac, absl::string_view name,
+                                     int64_t default_value) {
+  auto value =
+      GetNamedSettingInt64(ac.activity_settings(), name, default_value);
+  if (value < 1) {
+    return absl::InvalidArgumentError(
+        absl::StrCat(name, " (", value, ") must be a positive integer."));
+  }
+  return absl::OkStatus();
+}
+
+std::string DefaultScratchDir() {
+  const char* test_tmpdir = getenv("TEST_TMPDIR");
+  return test_tmpdir ? test_tmpdir : "/tmp";
+}
+
+// O_DIRECT requires buffers, offsets and sizes aligned to the logical block
+// size of the device, which is at most a page:
+constexpr int64_t kDirectIoAlignment = 4096;
+
+// Returns a buffer of at least size bytes, suitable for O_DIRECT, that the
+// calling thread can read into and write from:
+char* ThreadIoBuffer(int64_t size) {
+  thread_local std::unique_ptr<char, decltype(&free)> buffer(nullptr, &free);
+  thread_local int64_t buffer_size = 0;
+  if (buffer_size < size) {
+    void* new_buffer = nullptr;
+    CHECK_EQ(posix_memalign(&new_buffer, kDirectIoAlignment, size), 0);
+    std::memset(new_buffer, 0xa5, size);
+    buffer.reset(static_cast<char*>(new_buffer));
+    buffer_size = size;
+  }
+  return buffer.get();
+}
+
+}  // anonymous namespace
+
+void Activity::RunIteration() {
+  auto start = std::chrono::steady_clock::now();
+  int64_t start_cpu_ns = ThreadCpuTimeNs();
+  DoActivity();
+  iteration_cpu_time_.Record(ThreadCpuTimeNs() - start_cpu_ns);
+  iteration_wall_time_.Record(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now() - start)
+          .count());
+}
+
+void Activity::RecordIterationWallTime(int64_t wall_time_ns) {
+  iteration_wall_time_.Record(wall_time_ns);
+}
+
+void Activity::AddIterationTimesTo(ActivityLog* alog) const {
+  LatencyHistogram wall_time;
+  iteration_wall_time_.AddTo(&wall_time);
+  if (LatencyHistogramCount(wall_time)) {
+    *alog->mutable_iteration_wall_time() = std::move(wall_time);
+  }
+  LatencyHistogram cpu_time;
+  iteration_cpu_time_.AddTo(&cpu_time);
+  if (LatencyHistogramCount(cpu_time)) {
+    *alog->mutable_iteration_cpu_time() = std::move(cpu_time);
+  }
+}
+
 absl::StatusOr<ParsedActivityConfig> ParseActivityConfig(ActivityConfig& ac) {
   ParsedActivityConfig s;
   s.activity_func =
@@ -32,6 +147,78 @@ absl::StatusOr<ParsedActivityConfig> ParseActivityConfig(ActivityConfig& ac) {
     if (!status.ok()) return status;
     s.array_size =
         GetNamedSettingInt64(ac.activity_settings(), "array_size", 1000);
+  } else if (s.activity_func == "BurnCpu") {
+    auto status = BurnCpu::ValidateConfig(ac);
+    if (!status.ok()) return status;
+    s.cpu_kernel = ParseCpuKernel(GetNamedSettingString(ac.activity_settings(),
+                                                        "kernel", "int_hash"))
+                       .value();
+    s.burn_cpu_duration_ns =
+        GetNamedSettingInt64(ac.activity_settings(), "duration_ns", 0);
+  } else if (s.activity_func == "MemoryBandwidth" ||
+             s.activity_func == "PointerChase" ||
+             s.activity_func == "StridedAccess") {
+    absl::Status status;
+    if (s.activity_func == "MemoryBandwidth") {
+      status = MemoryBandwidth::ValidateConfig(ac);
+    } else if (s.activity_func == "PointerChase") {
+      status = PointerChase::ValidateConfig(ac);
+    } else {
+      status = StridedAccess::ValidateConfig(ac);
+    }
+    if (!status.ok()) return status;
+    s.footprint_bytes = GetNamedSettingInt64(ac.activity_settings(),
+                                             "footprint_bytes", 64 << 20);
+    s.numa_node = GetNamedSettingInt64(ac.activity_settings(), "numa_node", -1);
+    s.memory_pattern =
+        GetNamedSettingString(ac.activity_settings(), "memory_pattern", "read");
+    s.passes_per_iteration =
+        GetNamedSettingInt64(ac.activity_settings(), "passes_per_iteration", 1);
+    s.accesses_per_iteration = GetNamedSettingInt64(
+        ac.activity_settings(), "accesses_per_iteration", 100'000);
+    s.stride_bytes =
+        GetNamedSettingInt64(ac.activity_settings(), "stride_bytes", 64);
+    s.shared_memory = std::make_shared<SharedActivityMemory>();
+  } else if (s.activity_func == "AllocatorPressure") {
+    auto status = AllocatorPressure::ValidateConfig(ac);
+    if (!status.ok()) return status;
+    s.allocations_per_iteration = GetNamedSettingInt64(
+        ac.activity_settings(), "allocations_per_iteration", 1000);
+    s.min_allocation_bytes =
+        GetNamedSettingInt64(ac.activity_settings(), "min_allocation_bytes", 8);
+    s.max_allocation_bytes = GetNamedSettingInt64(
+        ac.activity_settings(), "max_allocation_bytes", 4096);
+    s.retained_percent =
+        GetNamedSettingInt64(ac.activity_settings(), "retained_percent", 10);
+    s.cross_thread_free_percent = GetNamedSettingInt64(
+        ac.activity_settings(), "cross_thread_free_percent", 10);
+    s.shared_allocations = std::make_shared<SharedAllocations>(
+        GetNamedSettingInt64(ac.activity_settings(), "retained_allocations",
+                             10'000));
+  } else if (s.activity_func == "FileIo") {
+    auto status = FileIo::ValidateConfig(ac);
+    if (!status.ok()) return status;
+    s.scratch_dir = GetNamedSettingString(ac.activity_settings(),
+                                          "scratch_dir", DefaultScratchDir());
+    s.file_size_bytes = GetNamedSettingInt64(ac.activity_settings(),
+                                             "file_size_bytes", 64 << 20);
+    s.read_size_bytes =
+        GetNamedSettingInt64(ac.activity_settings(), "read_size_bytes", 4096);
+    s.write_size_bytes =
+        GetNamedSettingInt64(ac.activity_settings(), "write_size_bytes", 4096);
+    s.read_percent =
+        GetNamedSettingInt64(ac.activity_settings(), "read_percent", 70);
+    s.access_pattern = GetNamedSettingString(ac.activity_settings(),
+                                             "access_pattern", "random");
+    s.direct_io =
+        GetNamedSettingInt64(ac.activity_settings(), "direct_io", 0) != 0;
+    s.fsync_every_n_writes = GetNamedSettingInt64(ac.activity_settings(),
+                                                  "fsync_every_n_writes", 0);
+    s.ops_per_iteration =
+        GetNamedSettingInt64(ac.activity_settings(), "ops_per_iteration", 1);
+    s.queue_depth =
+        GetNamedSettingInt64(ac.activity_settings(), "queue_depth", 1);
+    s.shared_file = std::make_shared<SharedFile>();
   } else if (s.activity_func == "PolluteDataCache") {
     auto status = PolluteDataCache::ValidateConfig(ac);
     if (!status.ok()) return status;
@@ -49,6 +236,11 @@ absl::StatusOr<ParsedActivityConfig> ParseActivityConfig(ActivityConfig& ac) {
     if (!status.ok()) return status;
     s.sleepfor_duration = absl::Microseconds(
         GetNamedSettingInt64(ac.activity_settings(), "duration_us", 0));
+  } else if (s.activity_func == "Delay") {
+    auto status = Delay::ValidateConfig(ac);
+    if (!status.ok()) return status;
+    s.delay_duration = absl::Microseconds(
+        GetNamedSettingInt64(ac.activity_settings(), "duration_us", 0));
   } else {
     return absl::FailedPreconditionError(absl::StrCat(
         "Activity config '", s.activity_config_name,
@@ -58,6 +250,19 @@ absl::StatusOr<ParsedActivityConfig> ParseActivityConfig(ActivityConfig& ac) {
   return s;
 }
 
+absl::Status PrepareActivityConfig(ParsedActivityConfig* config) {
+  if (config->activity_func == "MemoryBandwidth") {
+    MemoryBandwidth::AllocateSharedMemory(config);
+  } else if (config->activity_func == "PointerChase") {
+    PointerChase::AllocateSharedMemory(config);
+  } else if (config->activity_func == "StridedAccess") {
+    StridedAccess::AllocateSharedMemory(config);
+  } else if (config->activity_func == "FileIo") {
+    return FileIo::OpenSharedFile(config);
+  }
+  return absl::OkStatus();
+}
+
 std::unique_ptr<Activity> AllocateActivity(ParsedActivityConfig* config,
                                            SimpleClock* clock) {
   std::unique_ptr<Activity> activity;
@@ -65,12 +270,26 @@ std::unique_ptr<Activity> AllocateActivity(ParsedActivityConfig* config,
 
   if (activity_func == "ConsumeCpu") {
     activity = std::make_unique<ConsumeCpu>();
+  } else if (activity_func == "BurnCpu") {
+    activity = std::make_unique<BurnCpu>();
+  } else if (activity_func == "MemoryBandwidth") {
+    activity = std::make_unique<MemoryBandwidth>();
+  } else if (activity_func == "PointerChase") {
+    activity = std::make_unique<PointerChase>();
+  } else if (activity_func == "StridedAccess") {
+    activity = std::make_unique<StridedAccess>();
+  } else if (activity_func == "AllocatorPressure") {
+    activity = std::make_unique<AllocatorPressure>();
+  } else if (activity_func == "FileIo") {
+    activity = std::make_unique<FileIo>();
   } else if (activity_func == "PolluteDataCache") {
     activity = std::make_unique<PolluteDataCache>();
   } else if (activity_func == "PolluteInstructionCache") {
     activity = std::make_unique<PolluteInstructionCache>();
   } else if (activity_func == "SleepFor") {
     activity = std::make_unique<SleepFor>();
+  } else if (activity_func == "Delay") {
+    activity = std::make_unique<Delay>();
   }
 
   activity->Initialize(config, clock);
@@ -96,14 +315,39 @@ absl::Status SleepFor::ValidateConfig(ActivityConfig& ac) {
   return absl::OkStatus();
 }
 
+void Delay::DoActivity() {
+  iteration_count_.fetch_add(1, std::memory_order_relaxed);
+}
+
+ActivityLog Delay::GetActivityLog() {
+  ActivityLog alog;
+  if (iteration_count_) {
+    auto* am = alog.add_activity_metrics();
+    am->set_name("iteration_count");
+    am->set_value_int(iteration_count_);
+  }
+  return alog;
+}
+
+void Delay::Initialize(ParsedActivityConfig* config, SimpleClock* clock) {}
+
+absl::Status Delay::ValidateConfig(ActivityConfig& ac) {
+  return SleepFor::ValidateConfig(ac);
+}
+
 void ConsumeCpu::DoActivity() {
   iteration_count_++;
+  // Each thread sorts its own array:
+  thread_local std::vector<int> rand_array;
+  rand_array.resize(array_size_);
   unsigned int sum = 0;
-  std::srand(time(0));
-  std::generate(rand_array.begin(), rand_array.end(), std::rand);
+  // std::rand takes a lock shared by all the threads:
+  std::mt19937& prng = ThreadMersenneTwister();
+  std::generate(rand_array.begin(), rand_array.end(),
+                [&prng]() { return static_cast<int>(prng() >> 1); });
   std::sort(rand_array.begin(), rand_array.end());
   for (auto num : rand_array) sum += num;
-  optimization_preventing_num_ = sum;
+  benchmark::DoNotOptimize(sum);
 }
 
 ActivityLog ConsumeCpu::GetActivityLog() {
@@ -117,7 +361,7 @@ ActivityLog ConsumeCpu::GetActivityLog() {
 }
 
 void ConsumeCpu::Initialize(ParsedActivityConfig* config, SimpleClock* clock) {
-  rand_array.resize(config->array_size);
+  array_size_ = config->array_size;
   iteration_count_ = 0;
 }
 
@@ -131,6 +375,637 @@ absl::Status ConsumeCpu::ValidateConfig(ActivityConfig& ac) {
   return absl::OkStatus();
 }
 
+void BurnCpu::DoActivity() {
+  iteration_count_.fetch_add(1, std::memory_order_relaxed);
+  RunCpuKernel(kernel_, units_per_iteration_);
+}
+
+ActivityLog BurnCpu::GetActivityLog() {
+  ActivityLog alog;
+  if (iteration_count_) {
+    auto* am = alog.add_activity_metrics();
+    am->set_name("iteration_count");
+    am->set_value_int(iteration_count_);
+    am = alog.add_activity_metrics();
+    am->set_name("kernel_units");
+    am->set_value_int(iteration_count_ * units_per_iteration_);
+  }
+  return alog;
+}
+
+void BurnCpu::Initialize(ParsedActivityConfig* config, SimpleClock* clock) {
+  kernel_ = config->cpu_kernel;
+  units_per_iteration_ =
+      CpuKernelUnitsForDuration(kernel_, config->burn_cpu_duration_ns);
+  iteration_count_ = 0;
+}
+
+absl::Status BurnCpu::ValidateConfig(ActivityConfig& ac) {
+  auto kernel = ParseCpuKernel(
+      GetNamedSettingString(ac.activity_settings(), "kernel", "int_hash"));
+  if (!kernel.ok()) return kernel.status();
+  auto duration_ns =
+      GetNamedSettingInt64(ac.activity_settings(), "duration_ns", -1);
+  if (duration_ns < 1) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "duration_ns (", duration_ns, ") must be a positive integer."));
+  }
+  return absl::OkStatus();
+}
+
+ActivityLog MemoryActivity::GetActivityLog() {
+  ActivityLog alog;
+  if (iteration_count_) {
+    auto* am = alog.add_activity_metrics();
+    am->set_name("iteration_count");
+    am->set_value_int(iteration_count_);
+    am = alog.add_activity_metrics();
+    am->set_name(amount_metric_name_);
+    am->set_value_int(amount_);
+    am = alog.add_activity_metrics();
+    am->set_name("access_time_ns");
+    am->set_value_int(access_time_ns_);
+  }
+  return alog;
+}
+
+void MemoryActivity::AllocateMemory(
+    ParsedActivityConfig* config, int num_arrays,
+    const std::function<void(SharedActivityMemory* memory)>& fill) {
+  SharedActivityMemory* memory = config->shared_memory.get();
+  absl::call_once(memory->allocated, [&]() {
+    memory->words_per_array =
+        config->footprint_bytes / num_arrays / sizeof(uint64_t);
+    for (int i = 0; i < num_arrays; ++i) {
+      // Left uninitialized, so that no page gets allocated before binding:
+      memory->arrays.emplace_back(new uint64_t[memory->words_per_array]);
+      if (config->numa_node >= 0) {
+        auto status = BindMemoryToNumaNode(
+            memory->arrays.back().get(),
+            memory->words_per_array * sizeof(uint64_t), config->numa_node);
+        if (!status.ok()) {
+          LOG(WARNING) << "Activity config '" << config->activity_config_name
+                       << "': " << status;
+        }
+      }
+    }
+    fill(memory);
+  });
+}
+
+void MemoryActivity::RecordAccesses(int64_t amount, int64_t access_time_ns) {
+  iteration_count_.fetch_add(1, std::memory_order_relaxed);
+  amount_.fetch_add(amount, std::memory_order_relaxed);
+  access_time_ns_.fetch_add(access_time_ns, std::memory_order_relaxed);
+}
+
+absl::Status MemoryBandwidth::ValidateConfig(ActivityConfig& ac) {
+  auto status = ValidateMemoryConfig(ac);
+  if (!status.ok()) return status;
+  auto memory_pattern =
+      GetNamedSettingString(ac.activity_settings(), "memory_pattern", "read");
+  if (memory_pattern != "read" && memory_pattern != "write" &&
+      memory_pattern != "copy" && memory_pattern != "triad") {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Unknown memory_pattern '", memory_pattern, "'."));
+  }
+  return ValidatePositiveSetting(ac, "passes_per_iteration", 1);
+}
+
+void MemoryBandwidth::AllocateSharedMemory(ParsedActivityConfig* config) {
+  int num_arrays = 1;
+  if (config->memory_pattern == "copy") {
+    num_arrays = 2;
+  } else if (config->memory_pattern == "triad") {
+    num_arrays = 3;
+  }
+  AllocateMemory(config, num_arrays, [](SharedActivityMemory* memory) {
+    for (auto& array : memory->arrays) {
+      for (size_t i = 0; i < memory->words_per_array; ++i) array[i] = i;
+    }
+  });
+}
+
+void MemoryBandwidth::Initialize(ParsedActivityConfig* config,
+                                 SimpleClock* clock) {
+  if (config->memory_pattern == "write") {
+    pattern_ = Pattern::kWrite;
+  } else if (config->memory_pattern == "copy") {
+    pattern_ = Pattern::kCopy;
+  } else if (config->memory_pattern == "triad") {
+    pattern_ = Pattern::kTriad;
+  }
+  passes_per_iteration_ = config->passes_per_iteration;
+  AllocateSharedMemory(config);
+  memory_ = config->shared_memory;
+}
+
+void MemoryBandwidth::DoActivity() {
+  const size_t n = memory_->words_per_array;
+  uint64_t* a = memory_->arrays[0].get();
+  // Parallel iterations write the same values into the same arrays, so
+  // their races are benign:
+  uint64_t* b = memory_->arrays.size() > 1 ? memory_->arrays[1].get() : a;
+  uint64_t* c = memory_->arrays.size() > 2 ? memory_->arrays[2].get() : a;
+  auto start = std::chrono::steady_clock::now();
+  for (int64_t pass = 0; pass < passes_per_iteration_; ++pass) {
+    switch (pattern_) {
+      case Pattern::kRead: {
+        uint64_t sum = 0;
+        for (size_t i = 0; i < n; ++i) sum += a[i];
+        benchmark::DoNotOptimize(sum);
+        break;
+      }
+      case Pattern::kWrite:
+        for (size_t i = 0; i < n; ++i) a[i] = i;
+        break;
+      case Pattern::kCopy:
+        for (size_t i = 0; i < n; ++i) b[i] = a[i];
+        break;
+      case Pattern::kTriad:
+        for (size_t i = 0; i < n; ++i) a[i] = b[i] + 3 * c[i];
+        break;
+    }
+    benchmark::ClobberMemory();
+  }
+  int64_t access_time_ns = NsSince(start);
+  RecordAccesses(passes_per_iteration_ * memory_->arrays.size() * n *
+                     sizeof(uint64_t),
+                 access_time_ns);
+}
+
+absl::Status PointerChase::ValidateConfig(ActivityConfig& ac) {
+  auto status = ValidateMemoryConfig(ac);
+  if (!status.ok()) return status;
+  return ValidatePositiveSetting(ac, "accesses_per_iteration", 100'000);
+}
+
+// Each cache line holds the index of the next one to read in its first word:
+constexpr size_t kWordsPerCacheLine = 64 / sizeof(uint64_t);
+
+void PointerChase::AllocateSharedMemory(ParsedActivityConfig* config) {
+  AllocateMemory(config, 1, [](SharedActivityMemory* memory) {
+    const size_t num_lines = memory->words_per_array / kWordsPerCacheLine;
+    std::vector<uint64_t> next(num_lines);
+    std::iota(next.begin(), next.end(), 0);
+    // Sattolo's algorithm turns next into a single cycle through all the
+    // lines, in random order, which defeats the prefetchers:
+    std::mt19937& prng = ThreadMersenneTwister();
+    for (size_t i = num_lines - 1; i > 0; --i) {
+      std::uniform_int_distribution<size_t> random_index(0, i - 1);
+      std::swap(next[i], next[random_index(prng)]);
+    }
+    uint64_t* lines = memory->arrays[0].get();
+    for (size_t i = 0; i < num_lines; ++i) {
+      lines[i * kWordsPerCacheLine] = next[i];
+      for (size_t j = 1; j < kWordsPerCacheLine; ++j) {
+        lines[i * kWordsPerCacheLine + j] = 0;
+      }
+    }
+  });
+}
+
+void PointerChase::Initialize(ParsedActivityConfig* config,
+                              SimpleClock* clock) {
+  accesses_per_iteration_ = config->accesses_per_iteration;
+  AllocateSharedMemory(config);
+  memory_ = config->shared_memory;
+}
+
+void PointerChase::DoActivity() {
+  const uint64_t* lines = memory_->arrays[0].get();
+  const size_t num_lines = memory_->words_per_array / kWordsPerCacheLine;
+  // Parallel iterations start from different lines:
+  uint64_t line = std::uniform_int_distribution<size_t>(
+      0, num_lines - 1)(ThreadMersenneTwister());
+  auto start = std::chrono::steady_clock::now();
+  for (int64_t i = 0; i < accesses_per_iteration_; ++i) {
+    line = lines[line * kWordsPerCacheLine];
+  }
+  benchmark::DoNotOptimize(line);
+  RecordAccesses(accesses_per_iteration_, NsSince(start));
+}
+
+absl::Status StridedAccess::ValidateConfig(ActivityConfig& ac) {
+  auto status = ValidateMemoryConfig(ac);
+  if (!status.ok()) return status;
+  status = ValidatePositiveSetting(ac, "accesses_per_iteration", 100'000);
+  if (!status.ok()) return status;
+  auto stride_bytes =
+      GetNamedSettingInt64(ac.activity_settings(), "stride_bytes", 64);
+  if (stride_bytes < 1 || stride_bytes % sizeof(uint64_t) != 0) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "stride_bytes (", stride_bytes, ") must be a positive multiple of 8."));
+  }
+  return absl::OkStatus();
+}
+
+void StridedAccess::AllocateSharedMemory(ParsedActivityConfig* config) {
+  AllocateMemory(config, 1, [](SharedActivityMemory* memory) {
+    uint64_t* words = memory->arrays[0].get();
+    for (size_t i = 0; i < memory->words_per_array; ++i) words[i] = i;
+  });
+}
+
+void StridedAccess::Initialize(ParsedActivityConfig* config,
+                               SimpleClock* clock) {
+  accesses_per_iteration_ = config->accesses_per_iteration;
+  AllocateSharedMemory(config);
+  memory_ = config->shared_memory;
+  stride_words_ = std::max<size_t>(
+      1, (config->stride_bytes / sizeof(uint64_t)) % memory_->words_per_array);
+}
+
+void StridedAccess::DoActivity() {
+  const uint64_t* words = memory_->arrays[0].get();
+  const size_t n = memory_->words_per_array;
+  size_t index = std::uniform_int_distribution<size_t>(0, n - 1)(
+      ThreadMersenneTwister());
+  uint64_t sum = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int64_t i = 0; i < accesses_per_iteration_; ++i) {
+    sum += words[index];
+    index += stride_words_;
+    if (index >= n) index -= n;
+  }
+  benchmark::DoNotOptimize(sum);
+  RecordAccesses(accesses_per_iteration_, NsSince(start));
+}
+
+SharedAllocations::SharedAllocations(size_t num_retained)
+    : num_retained(num_retained),
+      retained(new std::atomic<void*>[num_retained]()) {}
+
+SharedAllocations::~SharedAllocations() {
+  for (size_t i = 0; i < num_retained; ++i) {
+    ::operator delete(retained[i].load());
+  }
+  absl::MutexLock m(&handoff_mutex);
+  for (void* allocation : handoff) ::operator delete(allocation);
+}
+
+absl::Status AllocatorPressure::ValidateConfig(ActivityConfig& ac) {
+  auto status = ValidatePositiveSetting(ac, "allocations_per_iteration", 1000);
+  if (!status.ok()) return status;
+  status = ValidatePositiveSetting(ac, "min_allocation_bytes", 8);
+  if (!status.ok()) return status;
+  status = ValidatePositiveSetting(ac, "retained_allocations", 10'000);
+  if (!status.ok()) return status;
+  auto min_allocation_bytes =
+      GetNamedSettingInt64(ac.activity_settings(), "min_allocation_bytes", 8);
+  auto max_allocation_bytes = GetNamedSettingInt64(
+      ac.activity_settings(), "max_allocation_bytes", 4096);
+  if (max_allocation_bytes < min_allocation_bytes ||
+      max_allocation_bytes > (1 << 30)) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "max_allocation_bytes (", max_allocation_bytes,
+        ") must be between min_allocation_bytes and 1GiB."));
+  }
+  auto retained_percent =
+      GetNamedSettingInt64(ac.activity_settings(), "retained_percent", 10);
+  auto cross_thread_free_percent = GetNamedSettingInt64(
+      ac.activity_settings(), "cross_thread_free_percent", 10);
+  if (retained_percent < 0 || cross_thread_free_percent < 0 ||
+      retained_percent + cross_thread_free_percent > 100) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "retained_percent (", retained_percent,
+        ") and cross_thread_free_percent (", cross_thread_free_percent,
+        ") must not be negative, and must add up to at most 100."));
+  }
+  return absl::OkStatus();
+}
+
+void AllocatorPressure::Initialize(ParsedActivityConfig* config,
+                                   SimpleClock* clock) {
+  constexpr int kPlanSize = 4096;
+  allocations_per_iteration_ = config->allocations_per_iteration;
+  shared_ = config->shared_allocations;
+  std::mt19937& prng = ThreadMersenneTwister();
+  std::uniform_real_distribution<double> log_size(
+      std::log(config->min_allocation_bytes),
+      std::log(config->max_allocation_bytes + 1));
+  std::uniform_int_distribution<int> percent(0, 99);
+  plan_.resize(kPlanSize);
+  for (auto& planned : plan_) {
+    planned.size = std::clamp<int64_t>(std::exp(log_size(prng)),
+                                       config->min_allocation_bytes,
+                                       config->max_allocation_bytes);
+    int draw = percent(prng);
+    if (draw < config->retained_percent) {
+      planned.lifetime = Lifetime::kRetained;
+    } else if (draw <
+               config->retained_percent + config->cross_thread_free_percent) {
+      planned.lifetime = Lifetime::kCrossThread;
+    } else {
+      planned.lifetime = Lifetime::kIteration;
+    }
+  }
+}
+
+void AllocatorPressure::DoActivity() {
+  iteration_count_.fetch_add(1, std::memory_order_relaxed);
+  std::mt19937& prng = ThreadMersenneTwister();
+  thread_local std::vector<void*> short_lived;
+  thread_local std::vector<void*> handed_off;
+  short_lived.clear();
+  handed_off.clear();
+  size_t plan_index = prng() % plan_.size();
+  int64_t bytes_allocated = 0;
+  for (int64_t i = 0; i < allocations_per_iteration_; ++i) {
+    const PlannedAllocation& planned = plan_[plan_index];
+    if (++plan_index == plan_.size()) plan_index = 0;
+    void* allocation = ::operator new(planned.size);
+    // Handlers initialize the objects they allocate:
+    std::memset(allocation, 0xa5, planned.size);
+    bytes_allocated += planned.size;
+    switch (planned.lifetime) {
+      case Lifetime::kIteration:
+        short_lived.push_back(allocation);
+        break;
+      case Lifetime::kCrossThread:
+        handed_off.push_back(allocation);
+        break;
+      case Lifetime::kRetained:
+        ::operator delete(
+            shared_->retained[prng() % shared_->num_retained].exchange(
+                allocation, std::memory_order_acq_rel));
+        break;
+    }
+  }
+  for (void* allocation : short_lived) ::operator delete(allocation);
+  // Leaves this iteration's allocations for the next one, and frees those
+  // that the previous one left:
+  bool cross_thread;
+  {
+    absl::MutexLock m(&shared_->handoff_mutex);
+    shared_->handoff.swap(handed_off);
+    cross_thread = shared_->handoff_thread != std::this_thread::get_id();
+    shared_->handoff_thread = std::this_thread::get_id();
+  }
+  for (void* allocation : handed_off) ::operator delete(allocation);
+  if (cross_thread) {
+    cross_thread_frees_.fetch_add(handed_off.size(),
+                                  std::memory_order_relaxed);
+  }
+  bytes_allocated_.fetch_add(bytes_allocated, std::memory_order_relaxed);
+}
+
+ActivityLog AllocatorPressure::GetActivityLog() {
+  ActivityLog alog;
+  if (iteration_count_) {
+    auto* am = alog.add_activity_metrics();
+    am->set_name("iteration_count");
+    am->set_value_int(iteration_count_);
+    am = alog.add_activity_metrics();
+    am->set_name("allocations");
+    am->set_value_int(iteration_count_ * allocations_per_iteration_);
+    am = alog.add_activity_metrics();
+    am->set_name("bytes_allocated");
+    am->set_value_int(bytes_allocated_);
+    am = alog.add_activity_metrics();
+    am->set_name("cross_thread_frees");
+    am->set_value_int(cross_thread_frees_);
+  }
+  return alog;
+}
+
+SharedFile::~SharedFile() {
+  io_threadpool.reset();
+  if (fd >= 0) close(fd);
+}
+
+absl::Status FileIo::ValidateConfig(ActivityConfig& ac) {
+  for (const auto& [name, default_value] :
+       {std::pair<absl::string_view, int64_t>{"file_size_bytes", 64 << 20},
+        {"read_size_bytes", 4096},
+        {"write_size_bytes", 4096},
+        {"ops_per_iteration", 1},
+        {"queue_depth", 1}}) {
+    auto status = ValidatePositiveSetting(ac, name, default_value);
+    if (!status.ok()) return status;
+  }
+  const auto& settings = ac.activity_settings();
+  auto file_size_bytes =
+      GetNamedSettingInt64(settings, "file_size_bytes", 64 << 20);
+  auto read_size_bytes =
+      GetNamedSettingInt64(settings, "read_size_bytes", 4096);
+  auto write_size_bytes =
+      GetNamedSettingInt64(settings, "write_size_bytes", 4096);
+  if (read_size_bytes > file_size_bytes || write_size_bytes > file_size_bytes) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("read_size_bytes (", read_size_bytes,
+                     ") and write_size_bytes (", write_size_bytes,
+                     ") must not exceed file_size_bytes (", file_size_bytes,
+                     ")."));
+  }
+  if (GetNamedSettingInt64(settings, "direct_io", 0) &&
+      (file_size_bytes % kDirectIoAlignment ||
+       read_size_bytes % kDirectIoAlignment ||
+       write_size_bytes % kDirectIoAlignment)) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "With direct_io, file_size_bytes, read_size_bytes and "
+        "write_size_bytes must be multiples of ",
+        kDirectIoAlignment, "."));
+  }
+  auto read_percent = GetNamedSettingInt64(settings, "read_percent", 70);
+  if (read_percent < 0 || read_percent > 100) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "read_percent (", read_percent, ") must be between 0 and 100."));
+  }
+  auto access_pattern =
+      GetNamedSettingString(settings, "access_pattern", "random");
+  if (access_pattern != "random" && access_pattern != "sequential") {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Unknown access_pattern '", access_pattern, "'."));
+  }
+  auto fsync_every_n_writes =
+      GetNamedSettingInt64(settings, "fsync_every_n_writes", 0);
+  if (fsync_every_n_writes < 0) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("fsync_every_n_writes (", fsync_every_n_writes,
+                     ") must not be negative."));
+  }
+  auto scratch_dir =
+      GetNamedSettingString(settings, "scratch_dir", DefaultScratchDir());
+  if (access(scratch_dir.c_str(), W_OK) != 0) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "scratch_dir '", scratch_dir, "' is not a writable directory."));
+  }
+  return absl::OkStatus();
+}
+
+void FileIo::Initialize(ParsedActivityConfig* config, SimpleClock* clock) {
+  file_ = config->shared_file;
+  file_size_bytes_ = config->file_size_bytes;
+  read_size_bytes_ = config->read_size_bytes;
+  write_size_bytes_ = config->write_size_bytes;
+  read_percent_ = config->read_percent;
+  sequential_ = config->access_pattern == "sequential";
+  fsync_every_n_writes_ = config->fsync_every_n_writes;
+  ops_per_iteration_ = config->ops_per_iteration;
+  // DistBenchEngine does not start if the file cannot be opened, so this only
+  // opens it for activities allocated without the engine; their operations
+  // count as io_errors if it fails:
+  OpenSharedFile(config).IgnoreError();
+}
+
+absl::Status FileIo::OpenSharedFile(ParsedActivityConfig* config) {
+  SharedFile* file = config->shared_file.get();
+  absl::call_once(file->opened, [config, file]() {
+    file->open_status = OpenFile(config, file);
+  });
+  return file->open_status;
+}
+
+absl::Status FileIo::OpenFile(ParsedActivityConfig* config, SharedFile* file) {
+  std::string path =
+      absl::StrCat(config->scratch_dir, "/distbench_file_io_XXXXXX");
+  int fd = mkstemp(path.data());
+  if (fd < 0) {
+    return absl::InternalError(
+        absl::StrCat("Activity config '", config->activity_config_name,
+                     "': cannot create ", path, ": ", strerror(errno)));
+  }
+  unlink(path.c_str());
+  // Fills the file, so that reads find data on the device rather than holes,
+  // then drops it from the page cache:
+  constexpr int64_t kFillChunkBytes = 1 << 20;
+  const char* fill = ThreadIoBuffer(kFillChunkBytes);
+  for (int64_t offset = 0; offset < config->file_size_bytes;
+       offset += kFillChunkBytes) {
+    int64_t size = std::min(kFillChunkBytes, config->file_size_bytes - offset);
+    if (pwrite(fd, fill, size, offset) != size) {
+      auto status = absl::InternalError(
+          absl::StrCat("Activity config '", config->activity_config_name,
+                       "': cannot fill ", path, ": ", strerror(errno)));
+      close(fd);
+      return status;
+    }
+  }
+  fsync(fd);
+  posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+  if (config->direct_io &&
+      fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_DIRECT) != 0) {
+    // e.g. on tmpfs:
+    LOG(WARNING) << "Activity config '" << config->activity_config_name
+                 << "': O_DIRECT is not supported in " << config->scratch_dir
+                 << ", using buffered I/O: " << strerror(errno);
+  }
+  if (config->queue_depth > 1) {
+    auto maybe_threadpool = CreateThreadpool("simple", config->queue_depth);
+    if (!maybe_threadpool.ok()) {
+      close(fd);
+      return maybe_threadpool.status();
+    }
+    file->io_threadpool = std::move(maybe_threadpool.value());
+  }
+  file->fd = fd;
+  return absl::OkStatus();
+}
+
+int64_t FileIo::NextOffset(int64_t size) {
+  if (sequential_) {
+    int64_t offset =
+        file_->next_offset.fetch_add(size, std::memory_order_relaxed) %
+        file_size_bytes_;
+    offset -= offset % size;
+    return offset + size > file_size_bytes_ ? 0 : offset;
+  }
+  return size * std::uniform_int_distribution<int64_t>(
+                    0, file_size_bytes_ / size - 1)(ThreadMersenneTwister());
+}
+
+void FileIo::RunOperation(bool write, bool fsync) {
+  int64_t size = write ? write_size_bytes_ : read_size_bytes_;
+  char* buffer = ThreadIoBuffer(size);
+  int64_t offset = NextOffset(size);
+  auto start = std::chrono::steady_clock::now();
+  ssize_t ret = write ? pwrite(file_->fd, buffer, size, offset)
+                      : pread(file_->fd, buffer, size, offset);
+  int64_t latency_ns = NsSince(start);
+  if (ret != size) {
+    io_errors_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  if (write) {
+    write_latency_.Record(latency_ns);
+    writes_.fetch_add(1, std::memory_order_relaxed);
+    bytes_written_.fetch_add(size, std::memory_order_relaxed);
+  } else {
+    read_latency_.Record(latency_ns);
+    reads_.fetch_add(1, std::memory_order_relaxed);
+    bytes_read_.fetch_add(size, std::memory_order_relaxed);
+  }
+  if (fsync) {
+    start = std::chrono::steady_clock::now();
+    if (::fsync(file_->fd) != 0) {
+      io_errors_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    fsync_latency_.Record(NsSince(start));
+    fsyncs_.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void FileIo::DoActivity() {
+  iteration_count_.fetch_add(1, std::memory_order_relaxed);
+  std::mt19937& prng = ThreadMersenneTwister();
+  std::uniform_int_distribution<int> percent(0, 99);
+  auto start = std::chrono::steady_clock::now();
+  AbstractThreadpool* io_threadpool = file_->io_threadpool.get();
+  absl::BlockingCounter pending(io_threadpool ? ops_per_iteration_ : 0);
+  for (int64_t i = 0; i < ops_per_iteration_; ++i) {
+    bool write = percent(prng) >= read_percent_;
+    // The write that completes each batch of fsync_every_n_writes syncs:
+    bool fsync =
+        write && fsync_every_n_writes_ > 0 &&
+        (file_->writes.fetch_add(1, std::memory_order_relaxed) + 1) %
+                fsync_every_n_writes_ ==
+            0;
+    if (io_threadpool) {
+      io_threadpool->AddTask([this, write, fsync, &pending]() {
+        RunOperation(write, fsync);
+        pending.DecrementCount();
+      });
+    } else {
+      RunOperation(write, fsync);
+    }
+  }
+  pending.Wait();
+  io_time_ns_.fetch_add(NsSince(start), std::memory_order_relaxed);
+}
+
+ActivityLog FileIo::GetActivityLog() {
+  ActivityLog alog;
+  if (iteration_count_) {
+    for (const auto& [name, value] :
+         {std::pair<const char*, int64_t>{"iteration_count", iteration_count_},
+          {"reads", reads_},
+          {"writes", writes_},
+          {"fsyncs", fsyncs_},
+          {"bytes_read", bytes_read_},
+          {"bytes_written", bytes_written_},
+          {"io_errors", io_errors_},
+          {"io_time_ns", io_time_ns_}}) {
+      auto* am = alog.add_activity_metrics();
+      am->set_name(name);
+      am->set_value_int(value);
+    }
+  }
+  for (const auto& [operation, histogram] :
+       {std::pair<const char*, const AtomicLatencyHistogram*>{"read",
+                                                              &read_latency_},
+        {"write", &write_latency_},
+        {"fsync", &fsync_latency_}}) {
+    LatencyHistogram latencies;
+    histogram->AddTo(&latencies);
+    if (LatencyHistogramCount(latencies)) {
+      (*alog.mutable_operation_latencies())[operation] = std::move(latencies);
+    }
+  }
+  return alog;
+}
+
 absl::Status PolluteDataCache::ValidateConfig(ActivityConfig& ac) {
   auto array_size =
       GetNamedSettingInt64(ac.activity_settings(), "array_size", 1000);
@@ -151,32 +1026,33 @@ absl::Status PolluteDataCache::ValidateConfig(ActivityConfig& ac) {
 
 void PolluteDataCache::Initialize(ParsedActivityConfig* config,
                                   SimpleClock* clock) {
-  std::srand(time(0));
   auto array_size = config->array_size;
 
-  data_array_.resize(array_size);
+  data_array_ = std::make_unique<std::atomic<int>[]>(array_size);
   for (int i = 0; i < array_size; i++) {
-    data_array_[i] = i;
+    data_array_[i].store(i, std::memory_order_relaxed);
   }
 
   random_index_ = std::uniform_int_distribution<>(0, array_size - 1);
   array_reads_per_iteration_ = config->array_reads_per_iteration;
   iteration_count_ = 0;
-
-  std::random_device rd;
-  mersenne_twister_prng_ = std::mt19937(rd());
 }
 
 void PolluteDataCache::DoActivity() {
   iteration_count_++;
+  std::mt19937& prng = ThreadMersenneTwister();
+  // The distribution is copied, as it may keep state between calls:
+  std::uniform_int_distribution<> random_index = random_index_;
   int64_t sum = 0;
   for (int i = 0; i < array_reads_per_iteration_; i++) {
-    int index = random_index_(mersenne_twister_prng_);
+    int index = random_index(prng);
 
     // This is read and write operation.
-    sum += data_array_[index]++;
+    int value = data_array_[index].load(std::memory_order_relaxed);
+    data_array_[index].store(value + 1, std::memory_order_relaxed);
+    sum += value;
   }
-  optimization_preventing_num_ = sum;
+  benchmark::DoNotOptimize(sum);
 }
 
 ActivityLog PolluteDataCache::GetActivityLog() {
@@ -249,9 +1125,6 @@ void PolluteInstructionCache::Initialize(ParsedActivityConfig* config,
   func_ptr_array_.resize(func_array_size);
   BOOST_PP_REPEAT(POLLUTE_ICACHE_LOOP_SIZE, GET_FUNC_PTR_OUTER_LOOP, );
 
-  std::random_device rd;
-  mersenne_twister_prng_ = std::mt19937(rd());
-
   function_invocations_per_iteration_ =
       config->function_invocations_per_iteration;
 
@@ -262,10 +1135,12 @@ void PolluteInstructionCache::Initialize(ParsedActivityConfig* config,
 
 void PolluteInstructionCache::DoActivity() {
   iteration_count_++;
+  std::mt19937& prng = ThreadMersenneTwister();
+  std::uniform_int_distribution<> random_index = random_index_;
   int64_t sum = 0;
 
   for (int i = 0; i < function_invocations_per_iteration_; i++) {
-    int index = random_index_(mersenne_twister_prng_);
+    int index = random_index(prng);
     benchmark::DoNotOptimize(sum += func_ptr_array_[index](false));
   }
 }
@@ -14,14 +14,65 @@
 #ifndef DISTBENCH_ACTIVITY_H_
 #define DISTBENCH_ACTIVITY_H_
 
+#include <atomic>
+#include <functional>
+#include <memory>
 #include <random>
+#include <thread>
+#include <vector>
 
+#include "absl/base/call_once.h"
 #include "absl/status/statusor.h"
+#include "absl/synchronization/mutex.h"
 #include "distbench.pb.h"
+#include "distbench_cpu_kernels.h"
+#include "distbench_latency_histogram.h"
+#include "distbench_threadpool.h"
 #include "simple_clock.h"
 
 namespace distbench {
 
+// Memory shared by all the activities of a config. It is allocated by
+// PrepareActivityConfig when the engine starts, so that neither the action
+// lists nor the first iterations of their activities pay for it.
+struct SharedActivityMemory {
+  absl::once_flag allocated;
+  size_t words_per_array = 0;
+  std::vector<std::unique_ptr<uint64_t[]>> arrays;
+};
+
+// Allocations of AllocatorPressure activities that outlive their iteration.
+// They are shared by all the activities of a config, so that they may be
+// freed by other threads, and outlive the action lists that allocated them.
+struct SharedAllocations {
+  explicit SharedAllocations(size_t num_retained);
+  ~SharedAllocations();
+
+  // Each retained allocation replaces a random one of these, and frees it:
+  const size_t num_retained;
+  std::unique_ptr<std::atomic<void*>[]> retained;
+  // Allocations left by an iteration for another one to free:
+  absl::Mutex handoff_mutex;
+  std::vector<void*> handoff ABSL_GUARDED_BY(handoff_mutex);
+  std::thread::id handoff_thread ABSL_GUARDED_BY(handoff_mutex);
+};
+
+// The scratch file of FileIo activities, shared by all the activities of a
+// config. It is created by PrepareActivityConfig when the engine starts, and
+// deleted as soon as it is open, so that it never outlives the test.
+struct SharedFile {
+  ~SharedFile();
+
+  absl::once_flag opened;
+  absl::Status open_status;
+  int fd = -1;
+  // The next offset of the sequential access pattern:
+  std::atomic<int64_t> next_offset = 0;
+  std::atomic<int64_t> writes = 0;
+  // Issues the operations of the iterations, queue_depth at a time:
+  std::unique_ptr<AbstractThreadpool> io_threadpool;
+};
+
 struct ParsedActivityConfig {
   std::string activity_config_name;
   std::string activity_func;
@@ -29,10 +80,43 @@ struct ParsedActivityConfig {
   int array_reads_per_iteration;
   int function_invocations_per_iteration;
   absl::Duration sleepfor_duration;
+  absl::Duration delay_duration;
+  CpuKernel cpu_kernel;
+  int64_t burn_cpu_duration_ns;
+  int64_t footprint_bytes;
+  int numa_node;
+  std::string memory_pattern;
+  int64_t passes_per_iteration;
+  int64_t accesses_per_iteration;
+  int64_t stride_bytes;
+  std::shared_ptr<SharedActivityMemory> shared_memory;
+  int64_t allocations_per_iteration;
+  int64_t min_allocation_bytes;
+  int64_t max_allocation_bytes;
+  int retained_percent;
+  int cross_thread_free_percent;
+  std::shared_ptr<SharedAllocations> shared_allocations;
+  std::string scratch_dir;
+  int64_t file_size_bytes;
+  int64_t read_size_bytes;
+  int64_t write_size_bytes;
+  int read_percent;
+  std::string access_pattern;
+  bool direct_io;
+  int64_t fsync_every_n_writes;
+  int64_t ops_per_iteration;
+  int queue_depth;
+  std::shared_ptr<SharedFile> shared_file;
 };
 
 absl::StatusOr<ParsedActivityConfig> ParseActivityConfig(ActivityConfig& ac);
 
+// Sets up the state shared by all the activities of config, e.g. the buffers
+// of memory activities. DistBenchEngine calls it when it starts, for each of
+// the configs that its service may use, so that the test does not time it,
+// and fails to start if it fails, e.g. when FileIo cannot create its file.
+absl::Status PrepareActivityConfig(ParsedActivityConfig* config);
+
 // Base class for activities that run along with RPCs in distbench.
 // Activities can be used to simulate various activities occuring in real world,
 // for eg. RPC processing delays, CPU work, cache corruption, etc.
@@ -45,13 +129,28 @@ class Activity {
   virtual void Initialize(ParsedActivityConfig* config, SimpleClock* clock) = 0;
 
   // Executes the Activity present in the class. This function is called from
-  // DistBenchEngine::ActionState's iteration_function by
-  // DistBenchEngine::RunAction method. As a result this method is called
-  // multiple times in a loop until the Activity is cancelled.
+  // DistBenchEngine::ActionState's iteration_function, once per iteration of
+  // the action, until the Activity is done or cancelled. Up to
+  // max_parallel_iterations iterations run at the same time, on different
+  // threads, so this must be thread-safe.
   virtual void DoActivity() = 0;
 
   // Returns an ActivityLog containing results metrics of Activity's run.
   virtual ActivityLog GetActivityLog() = 0;
+
+  // Runs DoActivity, recording its wall-clock and thread cpu time.
+  void RunIteration();
+
+  // Records the wall-clock time of an iteration that does not run on a single
+  // thread, e.g. one of Delay, whose cpu time is negligible.
+  void RecordIterationWallTime(int64_t wall_time_ns);
+
+  // Adds the iteration times recorded so far to alog.
+  void AddIterationTimesTo(ActivityLog* alog) const;
+
+ private:
+  AtomicLatencyHistogram iteration_wall_time_;
+  AtomicLatencyHistogram iteration_cpu_time_;
 };
 
 // Returns a unique_ptr to a newly instantiated Activity as described by the
@@ -67,9 +166,24 @@ class ConsumeCpu : public Activity {
   static absl::Status ValidateConfig(ActivityConfig& ac);
 
  private:
-  std::vector<int> rand_array;
-  int iteration_count_ = 0;
-  int64_t optimization_preventing_num_ = 0;
+  int array_size_ = 0;
+  std::atomic<int64_t> iteration_count_ = 0;
+};
+
+// Keeps the cpu busy for a fixed time per iteration, running a kernel whose
+// speed is calibrated when the engine starts, so that the same config costs
+// the same time on any machine.
+class BurnCpu : public Activity {
+ public:
+  static absl::Status ValidateConfig(ActivityConfig& ac);
+  void Initialize(ParsedActivityConfig* config, SimpleClock* clock) override;
+  void DoActivity() override;
+  ActivityLog GetActivityLog() override;
+
+ private:
+  CpuKernel kernel_ = CpuKernel::kIntHash;
+  int64_t units_per_iteration_ = 1;
+  std::atomic<int64_t> iteration_count_ = 0;
 };
 
 class PolluteDataCache : public Activity {
@@ -80,12 +194,12 @@ class PolluteDataCache : public Activity {
   ActivityLog GetActivityLog() override;
 
  private:
-  int iteration_count_ = 0;
+  std::atomic<int64_t> iteration_count_ = 0;
   int array_reads_per_iteration_ = 0;
-  std::vector<int> data_array_;
-  int64_t optimization_preventing_num_ = 0;
+  // Parallel iterations update the array with relaxed loads and stores, which
+  // cost the same as plain ones; their updates may get lost:
+  std::unique_ptr<std::atomic<int>[]> data_array_;
   std::uniform_int_distribution<> random_index_;
-  std::mt19937 mersenne_twister_prng_;
 };
 
 class PolluteInstructionCache : public Activity {
@@ -96,13 +210,162 @@ class PolluteInstructionCache : public Activity {
   ActivityLog GetActivityLog() override;
 
  private:
-  int iteration_count_ = 0;
+  std::atomic<int64_t> iteration_count_ = 0;
   int function_invocations_per_iteration_ = 0;
-  std::mt19937 mersenne_twister_prng_;
   std::vector<int (*)(bool)> func_ptr_array_;
   std::uniform_int_distribution<> random_index_;
 };
 
+// Base class of the activities that put pressure on the memory hierarchy.
+// Their buffers hold footprint_bytes, bound to numa_node if it is set, and are
+// shared by all the activities of a config. Besides iteration_count, they
+// report the total time spent accessing memory, as access_time_ns, and the
+// amount of memory accessed in that time.
+class MemoryActivity : public Activity {
+ public:
+  ActivityLog GetActivityLog() override;
+
+ protected:
+  explicit MemoryActivity(const char* amount_metric_name)
+      : amount_metric_name_(amount_metric_name) {}
+
+  // Allocates the shared buffers of config, unless they already are, as
+  // num_arrays arrays, calling fill on them once they are bound to their NUMA
+  // node.
+  static void AllocateMemory(
+      ParsedActivityConfig* config, int num_arrays,
+      const std::function<void(SharedActivityMemory* memory)>& fill);
+
+  void RecordAccesses(int64_t amount, int64_t access_time_ns);
+
+  std::shared_ptr<SharedActivityMemory> memory_;
+
+ private:
+  const char* amount_metric_name_;
+  std::atomic<int64_t> iteration_count_ = 0;
+  std::atomic<int64_t> amount_ = 0;
+  std::atomic<int64_t> access_time_ns_ = 0;
+};
+
+// Streams through its buffers, like the STREAM benchmark, with one of the
+// read, write, copy and triad memory_patterns, and reports bytes_accessed.
+class MemoryBandwidth : public MemoryActivity {
+ public:
+  MemoryBandwidth() : MemoryActivity("bytes_accessed") {}
+  static absl::Status ValidateConfig(ActivityConfig& ac);
+  static void AllocateSharedMemory(ParsedActivityConfig* config);
+  void Initialize(ParsedActivityConfig* config, SimpleClock* clock) override;
+  void DoActivity() override;
+
+ private:
+  enum class Pattern { kRead, kWrite, kCopy, kTriad };
+  Pattern pattern_ = Pattern::kRead;
+  int64_t passes_per_iteration_ = 1;
+};
+
+// Follows a random cycle of pointers through its buffer, one per cache line,
+// so that each access waits for the previous one, and reports accesses.
+class PointerChase : public MemoryActivity {
+ public:
+  PointerChase() : MemoryActivity("accesses") {}
+  static absl::Status ValidateConfig(ActivityConfig& ac);
+  static void AllocateSharedMemory(ParsedActivityConfig* config);
+  void Initialize(ParsedActivityConfig* config, SimpleClock* clock) override;
+  void DoActivity() override;
+
+ private:
+  int64_t accesses_per_iteration_ = 0;
+};
+
+// Reads its buffer every stride_bytes, wrapping around, and reports accesses.
+class StridedAccess : public MemoryActivity {
+ public:
+  StridedAccess() : MemoryActivity("accesses") {}
+  static absl::Status ValidateConfig(ActivityConfig& ac);
+  static void AllocateSharedMemory(ParsedActivityConfig* config);
+  void Initialize(ParsedActivityConfig* config, SimpleClock* clock) override;
+  void DoActivity() override;
+
+ private:
+  int64_t accesses_per_iteration_ = 0;
+  size_t stride_words_ = 1;
+};
+
+// Exercises the allocator like a request handler that allocates many small
+// objects: each iteration allocates and fills allocations_per_iteration
+// objects, of log-uniformly distributed sizes between min_allocation_bytes
+// and max_allocation_bytes. Most are freed at the end of the iteration, but
+// retained_percent of them replace (and free) random ones of
+// retained_allocations long-lived objects, and cross_thread_free_percent of
+// them are left for another iteration, usually on another thread, to free.
+class AllocatorPressure : public Activity {
+ public:
+  static absl::Status ValidateConfig(ActivityConfig& ac);
+  void Initialize(ParsedActivityConfig* config, SimpleClock* clock) override;
+  void DoActivity() override;
+  ActivityLog GetActivityLog() override;
+
+ private:
+  enum class Lifetime : uint8_t { kIteration, kRetained, kCrossThread };
+  struct PlannedAllocation {
+    uint32_t size;
+    Lifetime lifetime;
+  };
+
+  // The sizes and lifetimes are drawn beforehand, so that iterations only
+  // pick a random starting point in the plan, rather than paying for a
+  // random number generator in between allocations:
+  std::vector<PlannedAllocation> plan_;
+  int64_t allocations_per_iteration_ = 0;
+  std::shared_ptr<SharedAllocations> shared_;
+  std::atomic<int64_t> iteration_count_ = 0;
+  std::atomic<int64_t> bytes_allocated_ = 0;
+  std::atomic<int64_t> cross_thread_frees_ = 0;
+};
+
+// Reads and writes a scratch file of file_size_bytes, in scratch_dir, like a
+// storage-backed service. Each iteration performs ops_per_iteration reads of
+// read_size_bytes and writes of write_size_bytes (read_percent of them being
+// reads), at random or sequential offsets, with up to queue_depth of them in
+// flight at once, and fsyncs the file every fsync_every_n_writes writes.
+// The file is accessed with O_DIRECT if direct_io is set. Reports the count
+// and volume of each operation, and their latencies.
+class FileIo : public Activity {
+ public:
+  static absl::Status ValidateConfig(ActivityConfig& ac);
+  // Creates and fills the scratch file of config, unless it already is, and
+  // returns whether that succeeded.
+  static absl::Status OpenSharedFile(ParsedActivityConfig* config);
+  void Initialize(ParsedActivityConfig* config, SimpleClock* clock) override;
+  void DoActivity() override;
+  ActivityLog GetActivityLog() override;
+
+ private:
+  static absl::Status OpenFile(ParsedActivityConfig* config, SharedFile* file);
+  void RunOperation(bool write, bool fsync);
+  int64_t NextOffset(int64_t size);
+
+  std::shared_ptr<SharedFile> file_;
+  int64_t file_size_bytes_ = 0;
+  int64_t read_size_bytes_ = 0;
+  int64_t write_size_bytes_ = 0;
+  int read_percent_ = 0;
+  bool sequential_ = false;
+  int64_t fsync_every_n_writes_ = 0;
+  int64_t ops_per_iteration_ = 0;
+  std::atomic<int64_t> iteration_count_ = 0;
+  std::atomic<int64_t> io_time_ns_ = 0;
+  std::atomic<int64_t> reads_ = 0;
+  std::atomic<int64_t> writes_ = 0;
+  std::atomic<int64_t> fsyncs_ = 0;
+  std::atomic<int64_t> bytes_read_ = 0;
+  std::atomic<int64_t> bytes_written_ = 0;
+  std::atomic<int64_t> io_errors_ = 0;
+  AtomicLatencyHistogram read_latency_;
+  AtomicLatencyHistogram write_latency_;
+  AtomicLatencyHistogram fsync_latency_;
+};
+
 class SleepFor : public Activity {
  public:
   static absl::Status ValidateConfig(ActivityConfig& ac);
@@ -115,6 +378,21 @@ class SleepFor : public Activity {
   absl::Duration duration_;
 };
 
+// Waits like SleepFor, but without holding a thread: DistBenchEngine finishes
+// each iteration from a timer, and only calls DoActivity to count it. This
+// lets many concurrent RPC handlers wait at once.
+class Delay : public Activity {
+ public:
+  static absl::Status ValidateConfig(ActivityConfig& ac);
+  void Initialize(ParsedActivityConfig* config, SimpleClock* clock) override;
+  void DoActivity() override;
+  ActivityLog GetActivityLog() override;
+
+ private:
+  // Iterations may run in parallel, on different threads:
+  std::atomic<int64_t> iteration_count_ = 0;
+};
+
 }  // namespace distbench
 
 #endif  // ACTIVITY_H_
@@ -12,7 +12,13 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+#include <map>
+#include <string_view>
+
+#include "absl/strings/match.h"
 #include "absl/strings/str_replace.h"
+#include "distbench_latency_histogram.h"
 #include "distbench_node_manager.h"
 #include "distbench_test_sequencer.h"
 #include "distbench_utils.h"
@@ -313,6 +319,662 @@ TEST(DistBenchTestSequencer, ServerActivityTest) {
   ASSERT_EQ(activity_log_it->second.activity_metrics(0).name(),
             "iteration_count");
   ASSERT_EQ(activity_log_it->second.activity_metrics(0).value_int(), 5);
+
+  // Each iteration's times are recorded, and summarized:
+  const auto& wall_time = activity_log_it->second.iteration_wall_time();
+  const auto& cpu_time = activity_log_it->second.iteration_cpu_time();
+  ASSERT_EQ(LatencyHistogramCount(wall_time), 5);
+  ASSERT_EQ(LatencyHistogramCount(cpu_time), 5);
+  EXPECT_GT(cpu_time.min_latency_ns(), 0);
+  EXPECT_LE(cpu_time.min_latency_ns(), wall_time.max_latency_ns());
+  EXPECT_NE(std::find_if(log_summary.begin(), log_summary.end(),
+                         [](const std::string& line) {
+                           return absl::StartsWith(
+                               line, "  ConsumeCpuConfig cpu time: N: 5 ");
+                         }),
+            log_summary.end());
+}
+
+TEST(DistBenchTestSequencer, ParallelActivityIterations) {
+  DistBenchTester tester;
+  ASSERT_OK(tester.Initialize(2));
+  const std::string proto = R"(
+tests {
+  services {
+    name: "client"
+    count: 1
+  }
+  services {
+    name: "server"
+    count: 1
+    activity_threadpool_type: "simple"
+    activity_threadpool_size: 4
+    threadpool_telemetry: true
+  }
+  action_lists {
+    name: "client"
+    action_names: "run_queries"
+  }
+  actions {
+    name: "run_queries"
+    rpc_name: "client_server_rpc"
+    iterations {
+      max_iteration_count: 5
+    }
+  }
+  rpc_descriptions {
+    name: "client_server_rpc"
+    client: "client"
+    server: "server"
+  }
+  action_lists {
+    name: "client_server_rpc"
+    action_names: "consume_cpu"
+  }
+  actions {
+    name: "consume_cpu"
+    activity_config_name: "consume_cpu_config"
+    iterations {
+      max_iteration_count: 20
+      max_parallel_iterations: 4
+    }
+  }
+  activity_configs {
+    name: "consume_cpu_config"
+    activity_settings {
+      name: "activity_func"
+      string_value: "ConsumeCpu"
+    }
+    activity_settings {
+      name: "array_size"
+      int64_value: 1000
+    }
+  }
+})";
+  auto test_sequence = ParseTestSequenceTextProto(proto);
+  ASSERT_TRUE(test_sequence.ok());
+
+  TestSequenceResults results;
+  auto context = CreateContextWithDeadline(/*max_time_s=*/75);
+  grpc::Status status = tester.test_sequencer_stub->RunTestSequence(
+      context.get(), *test_sequence, &results);
+  ASSERT_OK(status);
+
+  auto& test_results = results.test_results(0);
+  const auto& instance_logs = test_results.service_logs().instance_logs();
+  const auto server_log = instance_logs.find("server/0");
+  ASSERT_NE(server_log, instance_logs.end());
+  const auto activity_log =
+      server_log->second.activity_logs().find("consume_cpu_config");
+  ASSERT_NE(activity_log, server_log->second.activity_logs().end());
+  ASSERT_EQ(activity_log->second.activity_metrics(0).name(),
+            "iteration_count");
+  ASSERT_EQ(activity_log->second.activity_metrics(0).value_int(), 100);
+
+  // Every iteration ran on the dedicated activity threadpool:
+  const auto& threadpool_logs = server_log->second.threadpool_logs();
+  const auto activity_pool_log = threadpool_logs.find("activities");
+  ASSERT_NE(activity_pool_log, threadpool_logs.end());
+  ASSERT_EQ(LatencyHistogramCount(activity_pool_log->second.queueing_delay()),
+            100);
+}
+
+TEST(DistBenchTestSequencer, Delay) {
+  DistBenchTester tester;
+  ASSERT_OK(tester.Initialize(2));
+
+  TestSequence test_sequence;
+  test_sequence.mutable_tests_setting()->set_keep_instance_log(true);
+  auto* test = test_sequence.add_tests();
+
+  auto* client = test->add_services();
+  client->set_name("client");
+  client->set_count(1);
+
+  auto* server = test->add_services();
+  server->set_name("server");
+  server->set_count(1);
+
+  auto* rpc_desc = test->add_rpc_descriptions();
+  rpc_desc->set_name("client_server_rpc");
+  rpc_desc->set_client("client");
+  rpc_desc->set_server("server");
+
+  auto* client_al = test->add_action_lists();
+  client_al->set_name("client");
+  client_al->add_action_names("run_queries");
+
+  auto action = test->add_actions();
+  action->set_name("run_queries");
+  action->set_rpc_name("client_server_rpc");
+  action->mutable_iterations()->set_max_iteration_count(5);
+
+  auto* server_al = test->add_action_lists();
+  server_al->set_name("client_server_rpc");
+  server_al->add_action_names("MyDelay");
+
+  auto server_action = test->add_actions();
+  server_action->set_name("MyDelay");
+  server_action->set_activity_config_name("DelayConfig");
+  server_action->mutable_iterations()->set_max_iteration_count(2);
+
+  auto* server_ac = test->add_activity_configs();
+  server_ac->set_name("DelayConfig");
+  AddActivitySettingStringTo(server_ac, "activity_func", "Delay");
+  AddActivitySettingIntTo(server_ac, "duration_us", 20'000);
+
+  TestSequenceResults results;
+  auto context = CreateContextWithDeadline(/*max_time_s=*/75);
+  grpc::Status status = tester.test_sequencer_stub->RunTestSequence(
+      context.get(), test_sequence, &results);
+  ASSERT_OK(status);
+
+  ASSERT_EQ(results.test_results().size(), 1);
+  auto& test_results = results.test_results(0);
+  const auto& instance_logs = test_results.service_logs().instance_logs();
+  const auto client_log = instance_logs.find("client/0");
+  ASSERT_NE(client_log, instance_logs.end());
+  ASSERT_EQ(client_log->second.peer_logs_size(), 1);
+  const auto& rpc_log =
+      client_log->second.peer_logs().begin()->second.rpc_logs().at(0);
+  ASSERT_EQ(rpc_log.successful_rpc_samples_size(), 5);
+  for (const auto& sample : rpc_log.successful_rpc_samples()) {
+    // Each response waits for two consecutive delays:
+    EXPECT_GE(sample.latency_ns(), 40'000'000);
+  }
+
+  const auto server_log = instance_logs.find("server/0");
+  ASSERT_NE(server_log, instance_logs.end());
+  const auto activity_log =
+      server_log->second.activity_logs().find("DelayConfig");
+  ASSERT_NE(activity_log, server_log->second.activity_logs().end());
+  ASSERT_EQ(activity_log->second.activity_metrics(0).name(),
+            "iteration_count");
+  ASSERT_EQ(activity_log->second.activity_metrics(0).value_int(), 10);
+  // Delay iterations are timed from their timers, and use no cpu:
+  const auto& wall_time = activity_log->second.iteration_wall_time();
+  ASSERT_EQ(LatencyHistogramCount(wall_time), 10);
+  EXPECT_GE(wall_time.min_latency_ns(), 20'000'000);
+  EXPECT_FALSE(activity_log->second.has_iteration_cpu_time());
+}
+
+// Unlike SleepFor, concurrent Delay activities do not each hold a thread, so
+// the server stays under a thread limit that SleepFor would exceed (see the
+// DistBenchTestSequencer.Overload test).
+TEST(DistBenchTestSequencer, ConcurrentDelaysDoNotOverload) {
+  DistBenchTester tester;
+  ASSERT_OK(tester.Initialize(2));
+  const std::string proto = R"(
+tests {
+  overload_limits {
+    max_threads: 20
+  }
+  protocol_driver_options {
+    name: 'default_protocol_driver_options'
+    protocol_name: 'grpc'
+    server_settings {
+      name: 'server_type'
+      string_value: 'handoff'
+    }
+  }
+  services {
+    name: "client"
+    count: 1
+  }
+  services {
+    name: "server"
+    count: 1
+  }
+  action_lists {
+    name: "client"
+    action_names: "run_queries"
+  }
+  actions {
+    name: "run_queries"
+    rpc_name: "delayed_query"
+    iterations {
+      max_iteration_count: 100
+      max_parallel_iterations: 100
+    }
+  }
+  rpc_descriptions {
+    name: "delayed_query"
+    client: "client"
+    server: "server"
+  }
+  action_lists {
+    name: "delayed_query"
+    action_names: "delay"
+  }
+  actions {
+    name: "delay"
+    activity_config_name: "delay_activity"
+  }
+  activity_configs {
+    name: "delay_activity"
+    activity_settings {
+      name: "activity_func"
+      string_value: "Delay"
+    }
+    activity_settings {
+      name: "duration_us"
+      int64_value: 500000
+    }
+  }
+})";
+  auto test_sequence = ParseTestSequenceTextProto(proto);
+  ASSERT_TRUE(test_sequence.ok());
+
+  TestSequenceResults results;
+  auto context = CreateContextWithDeadline(/*max_time_s=*/75);
+  grpc::Status status = tester.test_sequencer_stub->RunTestSequence(
+      context.get(), *test_sequence, &results);
+  ASSERT_OK(status);
+
+  auto& test_results = results.test_results(0);
+  const auto& instance_logs = test_results.service_logs().instance_logs();
+  const auto client_log = instance_logs.find("client/0");
+  ASSERT_NE(client_log, instance_logs.end());
+  EXPECT_EQ(client_log->second.engine_error_message(), "");
+  ASSERT_EQ(client_log->second.peer_logs_size(), 1);
+  const auto& rpc_log =
+      client_log->second.peer_logs().begin()->second.rpc_logs().at(0);
+  EXPECT_EQ(rpc_log.successful_rpc_samples_size(), 100);
+  EXPECT_EQ(rpc_log.failed_rpc_samples_size(), 0);
+}
+
+TEST(DistBenchTestSequencer, BurnCpu) {
+  DistBenchTester tester;
+  ASSERT_OK(tester.Initialize(2));
+  const std::string proto = R"(
+tests {
+  services {
+    name: "client"
+    count: 1
+  }
+  services {
+    name: "server"
+    count: 1
+  }
+  action_lists {
+    name: "client"
+    action_names: "run_queries"
+  }
+  actions {
+    name: "run_queries"
+    rpc_name: "client_server_rpc"
+    iterations {
+      max_iteration_count: 5
+    }
+  }
+  rpc_descriptions {
+    name: "client_server_rpc"
+    client: "client"
+    server: "server"
+  }
+  action_lists {
+    name: "client_server_rpc"
+    action_names: "burn_cpu"
+  }
+  actions {
+    name: "burn_cpu"
+    activity_config_name: "burn_cpu_config"
+    iterations {
+      max_iteration_count: 2
+      max_parallel_iterations: 2
+    }
+  }
+  activity_configs {
+    name: "burn_cpu_config"
+    activity_settings {
+      name: "activity_func"
+      string_value: "BurnCpu"
+    }
+    activity_settings {
+      name: "kernel"
+      string_value: "fp_simd"
+    }
+    activity_settings {
+      name: "duration_ns"
+      int64_value: 2000000
+    }
+  }
+})";
+  auto test_sequence = ParseTestSequenceTextProto(proto);
+  ASSERT_TRUE(test_sequence.ok());
+
+  TestSequenceResults results;
+  auto context = CreateContextWithDeadline(/*max_time_s=*/75);
+  grpc::Status status = tester.test_sequencer_stub->RunTestSequence(
+      context.get(), *test_sequence, &results);
+  ASSERT_OK(status);
+
+  auto& test_results = results.test_results(0);
+  const auto& instance_logs = test_results.service_logs().instance_logs();
+  const auto server_log = instance_logs.find("server/0");
+  ASSERT_NE(server_log, instance_logs.end());
+  const auto activity_log =
+      server_log->second.activity_logs().find("burn_cpu_config");
+  ASSERT_NE(activity_log, server_log->second.activity_logs().end());
+  ASSERT_EQ(activity_log->second.activity_metrics(0).name(),
+            "iteration_count");
+  ASSERT_EQ(activity_log->second.activity_metrics(0).value_int(), 10);
+  // Each iteration burns about 2ms of cpu, with loose bounds as other tests
+  // may share the machine:
+  const auto& cpu_time = activity_log->second.iteration_cpu_time();
+  ASSERT_EQ(LatencyHistogramCount(cpu_time), 10);
+  EXPECT_GE(cpu_time.min_latency_ns(), 1'000'000);
+  EXPECT_LE(LatencyHistogramQuantile(cpu_time, 0.5), 8'000'000);
+}
+
+TEST(DistBenchTestSequencer, BurnCpuUnknownKernel) {
+  DistBenchTester tester;
+  ASSERT_OK(tester.Initialize(1));
+  const std::string proto = R"(
+tests {
+  services {
+    name: "client"
+    count: 1
+  }
+  action_lists {
+    name: "client"
+    action_names: "burn_cpu"
+  }
+  actions {
+    name: "burn_cpu"
+    activity_config_name: "burn_cpu_config"
+  }
+  activity_configs {
+    name: "burn_cpu_config"
+    activity_settings {
+      name: "activity_func"
+      string_value: "BurnCpu"
+    }
+    activity_settings {
+      name: "kernel"
+      string_value: "bogus"
+    }
+    activity_settings {
+      name: "duration_ns"
+      int64_value: 2000
+    }
+  }
+})";
+  auto test_sequence = ParseTestSequenceTextProto(proto);
+  ASSERT_TRUE(test_sequence.ok());
+
+  TestSequenceResults results;
+  auto context = CreateContextWithDeadline(/*max_time_s=*/75);
+  grpc::Status status = tester.test_sequencer_stub->RunTestSequence(
+      context.get(), *test_sequence, &results);
+  ASSERT_EQ(status.error_code(), grpc::ABORTED);
+}
+
+TEST(DistBenchTestSequencer, MemoryActivities) {
+  DistBenchTester tester;
+  ASSERT_OK(tester.Initialize(1));
+  const std::string proto = R"(
+tests {
+  services {
+    name: "client"
+    count: 1
+  }
+  action_lists {
+    name: "client"
+    action_names: "stream"
+    action_names: "chase"
+  }
+  actions {
+    name: "stream"
+    activity_config_name: "stream_config"
+    iterations {
+      max_iteration_count: 4
+      max_parallel_iterations: 2
+    }
+  }
+  actions {
+    name: "chase"
+    activity_config_name: "chase_config"
+    iterations {
+      max_iteration_count: 4
+    }
+  }
+  activity_configs {
+    name: "stream_config"
+    activity_settings {
+      name: "activity_func"
+      string_value: "MemoryBandwidth"
+    }
+    activity_settings {
+      name: "memory_pattern"
+      string_value: "copy"
+    }
+    activity_settings {
+      name: "footprint_bytes"
+      int64_value: 1048576
+    }
+  }
+  activity_configs {
+    name: "chase_config"
+    activity_settings {
+      name: "activity_func"
+      string_value: "PointerChase"
+    }
+    activity_settings {
+      name: "footprint_bytes"
+      int64_value: 1048576
+    }
+    activity_settings {
+      name: "accesses_per_iteration"
+      int64_value: 1000
+    }
+  }
+})";
+  auto test_sequence = ParseTestSequenceTextProto(proto);
+  ASSERT_TRUE(test_sequence.ok());
+
+  TestSequenceResults results;
+  auto context = CreateContextWithDeadline(/*max_time_s=*/75);
+  grpc::Status status = tester.test_sequencer_stub->RunTestSequence(
+      context.get(), *test_sequence, &results);
+  ASSERT_OK(status);
+
+  auto& test_results = results.test_results(0);
+  const auto& instance_logs = test_results.service_logs().instance_logs();
+  const auto client_log = instance_logs.find("client/0");
+  ASSERT_NE(client_log, instance_logs.end());
+  const auto& activity_logs = client_log->second.activity_logs();
+  ASSERT_EQ(activity_logs.size(), 2);
+  std::map<std::string, int64_t> stream_metrics;
+  for (const auto& metric :
+       activity_logs.at("stream_config").activity_metrics()) {
+    stream_metrics[metric.name()] = metric.value_int();
+  }
+  EXPECT_EQ(stream_metrics["iteration_count"], 4);
+  // Each copy reads and writes half of the footprint:
+  EXPECT_EQ(stream_metrics["bytes_accessed"], 4 * 1048576);
+  EXPECT_GT(stream_metrics["access_time_ns"], 0);
+  std::map<std::string, int64_t> chase_metrics;
+  for (const auto& metric :
+       activity_logs.at("chase_config").activity_metrics()) {
+    chase_metrics[metric.name()] = metric.value_int();
+  }
+  EXPECT_EQ(chase_metrics["iteration_count"], 4);
+  EXPECT_EQ(chase_metrics["accesses"], 4000);
+  EXPECT_GT(chase_metrics["access_time_ns"], 0);
+
+  const auto& log_summary = test_results.log_summary();
+  auto summary_line = [&log_summary](std::string_view prefix) {
+    return std::find_if(log_summary.begin(), log_summary.end(),
+                        [prefix](const std::string& line) {
+                          return absl::StartsWith(line, prefix);
+                        });
+  };
+  EXPECT_NE(summary_line("  stream_config: "), log_summary.end());
+  EXPECT_NE(summary_line("  chase_config: "), log_summary.end());
+}
+
+TEST(DistBenchTestSequencer, AllocatorPressure) {
+  DistBenchTester tester;
+  ASSERT_OK(tester.Initialize(1));
+  const std::string proto = R"(
+tests {
+  services {
+    name: "client"
+    count: 1
+    activity_threadpool_type: "simple"
+    activity_threadpool_size: 4
+  }
+  action_lists {
+    name: "client"
+    action_names: "allocate"
+  }
+  actions {
+    name: "allocate"
+    activity_config_name: "allocator_config"
+    iterations {
+      max_iteration_count: 100
+      max_parallel_iterations: 4
+    }
+  }
+  activity_configs {
+    name: "allocator_config"
+    activity_settings {
+      name: "activity_func"
+      string_value: "AllocatorPressure"
+    }
+    activity_settings {
+      name: "allocations_per_iteration"
+      int64_value: 100
+    }
+    activity_settings {
+      name: "min_allocation_bytes"
+      int64_value: 16
+    }
+    activity_settings {
+      name: "max_allocation_bytes"
+      int64_value: 16
+    }
+    activity_settings {
+      name: "cross_thread_free_percent"
+      int64_value: 50
+    }
+  }
+})";
+  auto test_sequence = ParseTestSequenceTextProto(proto);
+  ASSERT_TRUE(test_sequence.ok());
+
+  TestSequenceResults results;
+  auto context = CreateContextWithDeadline(/*max_time_s=*/75);
+  grpc::Status status = tester.test_sequencer_stub->RunTestSequence(
+      context.get(), *test_sequence, &results);
+  ASSERT_OK(status);
+
+  auto& test_results = results.test_results(0);
+  const auto& instance_logs = test_results.service_logs().instance_logs();
+  const auto client_log = instance_logs.find("client/0");
+  ASSERT_NE(client_log, instance_logs.end());
+  const auto& activity_log =
+      client_log->second.activity_logs().at("allocator_config");
+  std::map<std::string, int64_t> metrics;
+  for (const auto& metric : activity_log.activity_metrics()) {
+    metrics[metric.name()] = metric.value_int();
+  }
+  EXPECT_EQ(metrics["iteration_count"], 100);
+  EXPECT_EQ(metrics["allocations"], 100 * 100);
+  EXPECT_EQ(metrics["bytes_allocated"], 100 * 100 * 16);
+  EXPECT_LE(metrics["cross_thread_frees"], 100 * 100);
+  EXPECT_EQ(LatencyHistogramCount(activity_log.iteration_wall_time()), 100);
+}
+
+TEST(DistBenchTestSequencer, FileIo) {
+  DistBenchTester tester;
+  ASSERT_OK(tester.Initialize(1));
+  const std::string proto = R"(
+tests {
+  services {
+    name: "client"
+    count: 1
+  }
+  action_lists {
+    name: "client"
+    action_names: "file_io"
+  }
+  actions {
+    name: "file_io"
+    activity_config_name: "file_io_config"
+    iterations {
+      max_iteration_count: 10
+      max_parallel_iterations: 2
+    }
+  }
+  activity_configs {
+    name: "file_io_config"
+    activity_settings {
+      name: "activity_func"
+      string_value: "FileIo"
+    }
+    activity_settings {
+      name: "file_size_bytes"
+      int64_value: 1048576
+    }
+    activity_settings {
+      name: "read_percent"
+      int64_value: 50
+    }
+    activity_settings {
+      name: "ops_per_iteration"
+      int64_value: 8
+    }
+    activity_settings {
+      name: "queue_depth"
+      int64_value: 4
+    }
+    activity_settings {
+      name: "fsync_every_n_writes"
+      int64_value: 1
+    }
+  }
+})";
+  auto test_sequence = ParseTestSequenceTextProto(proto);
+  ASSERT_TRUE(test_sequence.ok());
+
+  TestSequenceResults results;
+  auto context = CreateContextWithDeadline(/*max_time_s=*/75);
+  grpc::Status status = tester.test_sequencer_stub->RunTestSequence(
+      context.get(), *test_sequence, &results);
+  ASSERT_OK(status);
+
+  auto& test_results = results.test_results(0);
+  const auto& instance_logs = test_results.service_logs().instance_logs();
+  const auto client_log = instance_logs.find("client/0");
+  ASSERT_NE(client_log, instance_logs.end());
+  const auto& activity_log =
+      client_log->second.activity_logs().at("file_io_config");
+  std::map<std::string, int64_t> metrics;
+  for (const auto& metric : activity_log.activity_metrics()) {
+    metrics[metric.name()] = metric.value_int();
+  }
+  EXPECT_EQ(metrics["iteration_count"], 10);
+  EXPECT_EQ(metrics["io_errors"], 0);
+  EXPECT_EQ(metrics["reads"] + metrics["writes"], 80);
+  EXPECT_EQ(metrics["bytes_read"], metrics["reads"] * 4096);
+  EXPECT_EQ(metrics["bytes_written"], metrics["writes"] * 4096);
+  // Every write is followed by an fsync:
+  EXPECT_EQ(metrics["fsyncs"], metrics["writes"]);
+  int64_t num_latencies = 0;
+  for (const auto& [operation, histogram] :
+       activity_log.operation_latencies()) {
+    num_latencies += LatencyHistogramCount(histogram);
+  }
+  EXPECT_EQ(num_latencies, 80 + metrics["fsyncs"]);
+
+  const auto& log_summary = test_results.log_summary();
+  EXPECT_NE(std::find_if(log_summary.begin(), log_summary.end(),
+                         [](const std::string& line) {
+                           return absl::StartsWith(line, "  file_io_config: ");
+                         }),
+            log_summary.end());
 }
 
 #if 0
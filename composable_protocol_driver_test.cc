@@ -89,6 +89,62 @@ TEST_F(ComposableProtocolDriverTest, RpcCounterTest) {
   EXPECT_EQ(client_rpc_count, kNumIterations);
 }
 
+TEST_F(ComposableProtocolDriverTest, ShardedTransportRpcCounterTest) {
+  ProtocolDriverOptions pdo;
+  pdo.set_protocol_name("sharded_transport");
+  AddServerInt64OptionTo(pdo, "num_shards", 3);
+  AddServerStringOptionTo(pdo, "next_protocol_driver",
+                          "composable_rpc_counter");
+  AddServerStringOptionTo(pdo, "driver_under_test", "grpc");
+  int port = 0;
+  auto maybe_pd = AllocateProtocolDriver(pdo, &port);
+  ASSERT_OK(maybe_pd.status());
+  auto& pd = maybe_pd.value();
+  pd->SetNumPeers(1);
+  pd->SetHandler([&](ServerRpcState* s) {
+    s->SendResponseIfSet();
+    s->FreeStateIfSet();
+    return std::function<void()>();
+  });
+  auto initiator_info = pd->Preconnect();
+  ASSERT_OK(initiator_info.status());
+  auto responder_info = pd->HandlePreConnect(initiator_info.value(), 0);
+  ASSERT_OK(responder_info.status());
+  ASSERT_OK(pd->HandleConnect(responder_info.value(), 0));
+
+  std::atomic<int> client_rpc_count = 0;
+  const int kNumIterations = 300;
+  ClientRpcState rpc_state[kNumIterations];
+  for (int i = 0; i < kNumIterations; ++i) {
+    pd->InitiateRpc(0, &rpc_state[i], [&, i]() {
+      if (rpc_state[i].success) ++client_rpc_count;
+    });
+  }
+  pd->ShutdownClient();
+
+  // Each shard reports its own counters, and each client shard talks to the
+  // server shard of the same index:
+  std::map<std::string, int> client_counts;
+  std::map<std::string, int> server_counts;
+  auto transport_stats = pd->GetTransportStats();
+  EXPECT_EQ(transport_stats.size(), 6);
+  int total_client_rpcs = 0;
+  for (const auto& stat : transport_stats) {
+    auto slash = stat.name.find('/');
+    ASSERT_NE(slash, std::string::npos);
+    std::string shard = stat.name.substr(0, slash);
+    if (stat.name.substr(slash + 1) == "client_rpc_cnt") {
+      client_counts[shard] = stat.value;
+      total_client_rpcs += stat.value;
+    } else {
+      server_counts[shard] = stat.value;
+    }
+  }
+  EXPECT_EQ(client_counts, server_counts);
+  EXPECT_EQ(total_client_rpcs, kNumIterations);
+  EXPECT_EQ(client_rpc_count, kNumIterations);
+}
+
 // clang-format on
 
 }  // namespace distbench
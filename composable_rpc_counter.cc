@@ -88,6 +88,10 @@ std::vector<TransportStat> ComposableRpcCounter::GetTransportStats() {
   return transport_stats;
 }
 
+std::vector<NamedThreadpoolLog> ComposableRpcCounter::GetThreadpoolLogs() {
+  return pd_instance_->GetThreadpoolLogs();
+}
+
 void ComposableRpcCounter::InitiateRpc(
     int peer_index, ClientRpcState* state,
     std::function<void(void)> done_callback) {
@@ -41,6 +41,7 @@ class ComposableRpcCounter : public ProtocolDriver {
   void HandleConnectFailure(std::string_view local_connection_info) override;
 
   std::vector<TransportStat> GetTransportStats() override;
+  std::vector<NamedThreadpoolLog> GetThreadpoolLogs() override;
   void InitiateRpc(int peer_index, ClientRpcState* state,
                    std::function<void(void)> done_callback) override;
   void ChurnConnection(int peer) override;
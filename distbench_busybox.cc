@@ -37,6 +37,7 @@ void Usage();
 ABSL_FLAG(int, port, 10'000, "port to listen on");
 ABSL_FLAG(std::string, test_sequencer, "", "host:port of test sequencer");
 ABSL_FLAG(bool, binary_output, false, "Save protobufs in binary mode");
+ABSL_FLAG(bool, compress_output, false, "Save protobufs gzip compressed");
 ABSL_FLAG(std::string, infile, "/dev/stdin", "Input file");
 ABSL_FLAG(std::string, outfile, "/dev/stdout", "Output file");
 ABSL_FLAG(int, local_nodes, 0,
@@ -183,11 +184,40 @@ int MainRunTests(std::vector<char*>& arguments) {
     return 1;
   }
 
+  // The results are streamed back one chunk at a time, and written out as
+  // they arrive, so that neither side has to hold them all in memory:
+  std::unique_ptr<distbench::TestSequenceResultsWriter> results_writer;
+  const std::string result_filename = absl::GetFlag(FLAGS_outfile);
+  if (!result_filename.empty()) {
+    auto maybe_writer = distbench::TestSequenceResultsWriter::Open(
+        result_filename, absl::GetFlag(FLAGS_binary_output),
+        absl::GetFlag(FLAGS_compress_output));
+    if (!maybe_writer.ok()) {
+      std::cerr << "Unable to save the results: " << maybe_writer.status()
+                << "\n";
+      return 1;
+    }
+    results_writer = std::move(maybe_writer.value());
+  }
+
   grpc::ClientContext context;
   distbench::SetGrpcClientContextDeadline(&context, *maybe_timeout_seconds);
-  distbench::TestSequenceResults test_results;
-  grpc::Status status =
-      stub->RunTestSequence(&context, *test_sequence, &test_results);
+  auto reader = stub->RunTestSequenceStream(&context, *test_sequence);
+  distbench::TestResultChunk chunk;
+  absl::Status save_status;
+  while (reader->Read(&chunk)) {
+    if (results_writer && save_status.ok()) {
+      save_status = results_writer->Write(chunk);
+    }
+    if (chunk.last_chunk_of_test()) {
+      std::cout << "Test summary:\n";
+      for (const auto& log_summary : chunk.test_result().log_summary()) {
+        std::cout << log_summary << "\n";
+      }
+      std::cout << "\n" << std::flush;
+    }
+  }
+  grpc::Status status = reader->Finish();
   if (!status.ok()) {
     std::cerr << "The RunTestSequence RPC Failed with status: " << status
               << "\n";
@@ -200,26 +230,9 @@ int MainRunTests(std::vector<char*>& arguments) {
     return 1;
   }
 
-  for (const auto& test_result : test_results.test_results()) {
-    std::cout << "Test summary:\n";
-    for (const auto& log_summary : test_result.log_summary()) {
-      std::cout << log_summary << "\n";
-    }
-    std::cout << "\n";
-  }
-
-  const std::string result_filename = absl::GetFlag(FLAGS_outfile);
-  if (!result_filename.empty()) {
-    absl::Status save_status;
-    if (absl::GetFlag(FLAGS_binary_output)) {
-      save_status = SaveResultProtoToFileBinary(result_filename, test_results);
-    } else {
-      save_status = SaveResultProtoToFile(result_filename, test_results);
-    }
-    if (!save_status.ok()) {
-      std::cerr << "Unable to save the results: " << save_status << "\n";
-      return 1;
-    }
+  if (!save_status.ok()) {
+    std::cerr << "Unable to save the results: " << save_status << "\n";
+    return 1;
   }
 
   return 0;
@@ -331,7 +344,7 @@ void Usage() {
                "--test_sequencer=host:port "
                "[--infile test_sequence.proto_text] "
                "[--outfile result.proto_text] "
-               "[--binary_output]"
+               "[--binary_output] [--compress_output]"
                "\n";
   std::cerr << "\n";
   std::cerr << "  distbench help\n";
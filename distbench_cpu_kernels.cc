@@ -0,0 +1,225 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "distbench_cpu_kernels.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
+
+#include "absl/base/call_once.h"
+#include "absl/strings/str_cat.h"
+#include "benchmark/benchmark.h"
+#include "glog/logging.h"
+
+namespace distbench {
+
+namespace {
+
+constexpr int kIntHashRoundsPerUnit = 64;
+constexpr int kFpSimdLanes = 256;
+constexpr int kBranchesPerUnit = 64;
+constexpr size_t kMemcpyBytesPerUnit = 4096;
+
+// Each calibration run lasts at least this long, so that the clock
+// resolution does not matter:
+constexpr int64_t kCalibrationRunNs = 1'000'000;
+constexpr int kCalibrationTrials = 5;
+
+struct KernelState {
+  KernelState() {
+    std::random_device rd;
+    rng = (uint64_t{rd()} << 32) | rd();
+    if (rng == 0) rng = 1;
+    for (int i = 0; i < kFpSimdLanes; ++i) {
+      fp[i] = static_cast<float>(i) / kFpSimdLanes;
+    }
+    std::memset(memcpy_src, static_cast<int>(rng), sizeof(memcpy_src));
+  }
+
+  uint64_t rng;
+  alignas(64) float fp[kFpSimdLanes];
+  alignas(64) char memcpy_src[kMemcpyBytesPerUnit];
+  alignas(64) char memcpy_dst[kMemcpyBytesPerUnit];
+};
+
+// Every thread gets its own random number generator and buffers:
+KernelState& ThreadKernelState() {
+  thread_local KernelState state;
+  return state;
+}
+
+uint64_t SplitMix64(uint64_t x) {
+  x += 0x9e3779b97f4a7c15;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111eb;
+  return x ^ (x >> 31);
+}
+
+uint64_t XorShift64(uint64_t x) {
+  x ^= x << 13;
+  x ^= x >> 7;
+  x ^= x << 17;
+  return x;
+}
+
+void RunIntHash(KernelState& state, int64_t units) {
+  uint64_t x = state.rng;
+  for (int64_t i = 0; i < units; ++i) {
+    for (int j = 0; j < kIntHashRoundsPerUnit; ++j) {
+      x = SplitMix64(x);
+    }
+    benchmark::DoNotOptimize(x);
+  }
+  state.rng = x | 1;
+}
+
+void RunFpSimd(KernelState& state, int64_t units) {
+  float* fp = state.fp;
+  for (int64_t i = 0; i < units; ++i) {
+    // The values converge to 1, so they never become denormal:
+    for (int j = 0; j < kFpSimdLanes; ++j) {
+      fp[j] = fp[j] * 0.999f + 0.001f;
+    }
+    benchmark::ClobberMemory();
+  }
+}
+
+void RunBranchy(KernelState& state, int64_t units) {
+  uint64_t x = state.rng;
+  uint64_t acc = 0;
+  for (int64_t i = 0; i < units; ++i) {
+    for (int j = 0; j < kBranchesPerUnit; ++j) {
+      x = XorShift64(x);
+      // DoNotOptimize keeps the compiler from turning the branch into a
+      // conditional move:
+      if (x & 1) {
+        acc += x >> 7;
+        benchmark::DoNotOptimize(acc);
+      } else {
+        acc ^= x << 3;
+      }
+    }
+  }
+  benchmark::DoNotOptimize(acc);
+  state.rng = x;
+}
+
+void RunMemcpy(KernelState& state, int64_t units) {
+  for (int64_t i = 0; i < units; ++i) {
+    std::memcpy(state.memcpy_dst, state.memcpy_src, kMemcpyBytesPerUnit);
+    benchmark::ClobberMemory();
+  }
+}
+
+int64_t NsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+// Returns the fastest time per unit out of several runs, i.e. the time on an
+// otherwise idle cpu:
+double MeasureNsPerUnit(CpuKernel kernel) {
+  int64_t units = 1;
+  while (true) {
+    auto start = std::chrono::steady_clock::now();
+    RunCpuKernel(kernel, units);
+    if (NsSince(start) >= kCalibrationRunNs) break;
+    units *= 2;
+  }
+  double best_ns_per_unit = std::numeric_limits<double>::infinity();
+  for (int i = 0; i < kCalibrationTrials; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    RunCpuKernel(kernel, units);
+    best_ns_per_unit = std::min(
+        best_ns_per_unit, static_cast<double>(NsSince(start)) / units);
+  }
+  return best_ns_per_unit;
+}
+
+absl::once_flag calibration_once;
+double ns_per_unit[kNumCpuKernels];
+
+}  // anonymous namespace
+
+absl::StatusOr<CpuKernel> ParseCpuKernel(std::string_view name) {
+  for (int i = 0; i < kNumCpuKernels; ++i) {
+    CpuKernel kernel = static_cast<CpuKernel>(i);
+    if (name == CpuKernelName(kernel)) return kernel;
+  }
+  return absl::InvalidArgumentError(
+      absl::StrCat("Unknown cpu kernel '", std::string(name), "'."));
+}
+
+std::string_view CpuKernelName(CpuKernel kernel) {
+  switch (kernel) {
+    case CpuKernel::kIntHash:
+      return "int_hash";
+    case CpuKernel::kFpSimd:
+      return "fp_simd";
+    case CpuKernel::kBranchy:
+      return "branchy";
+    case CpuKernel::kMemcpy:
+      return "memcpy";
+  }
+  return "unknown";
+}
+
+void RunCpuKernel(CpuKernel kernel, int64_t units) {
+  KernelState& state = ThreadKernelState();
+  switch (kernel) {
+    case CpuKernel::kIntHash:
+      RunIntHash(state, units);
+      break;
+    case CpuKernel::kFpSimd:
+      RunFpSimd(state, units);
+      break;
+    case CpuKernel::kBranchy:
+      RunBranchy(state, units);
+      break;
+    case CpuKernel::kMemcpy:
+      RunMemcpy(state, units);
+      break;
+  }
+}
+
+void CalibrateCpuKernels() {
+  absl::call_once(calibration_once, []() {
+    for (int i = 0; i < kNumCpuKernels; ++i) {
+      CpuKernel kernel = static_cast<CpuKernel>(i);
+      // The first run warms up the caches, and lets the cpu frequency ramp
+      // up:
+      MeasureNsPerUnit(kernel);
+      ns_per_unit[i] = MeasureNsPerUnit(kernel);
+      LOG(INFO) << "Cpu kernel " << CpuKernelName(kernel) << ": "
+                << ns_per_unit[i] << "ns per unit";
+    }
+  });
+}
+
+double CpuKernelNsPerUnit(CpuKernel kernel) {
+  CalibrateCpuKernels();
+  return ns_per_unit[static_cast<int>(kernel)];
+}
+
+int64_t CpuKernelUnitsForDuration(CpuKernel kernel, int64_t duration_ns) {
+  return std::max<int64_t>(
+      1, std::llround(duration_ns / CpuKernelNsPerUnit(kernel)));
+}
+
+}  // namespace distbench
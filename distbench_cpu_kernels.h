@@ -0,0 +1,63 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef DISTBENCH_DISTBENCH_CPU_KERNELS_H_
+#define DISTBENCH_DISTBENCH_CPU_KERNELS_H_
+
+#include <cstdint>
+#include <string_view>
+
+#include "absl/status/statusor.h"
+
+namespace distbench {
+
+// Kernels that keep a cpu busy for a given time, each stressing a different
+// part of the core. They only touch per-thread state, so that any number of
+// threads can run them at once without contending on anything.
+enum class CpuKernel {
+  // Chained integer hashing, bound by the latency of multiplications:
+  kIntHash,
+  // Floating point multiply-adds over a small array, which the compiler
+  // vectorizes:
+  kFpSimd,
+  // Branches on random bits, half of which get mispredicted:
+  kBranchy,
+  // Copies between two L1-resident buffers:
+  kMemcpy,
+};
+
+constexpr int kNumCpuKernels = 4;
+
+// Kernels are named int_hash, fp_simd, branchy and memcpy:
+absl::StatusOr<CpuKernel> ParseCpuKernel(std::string_view name);
+std::string_view CpuKernelName(CpuKernel kernel);
+
+// Runs the given number of units of work of kernel on the calling thread.
+void RunCpuKernel(CpuKernel kernel, int64_t units);
+
+// Measures how long a unit of work of each kernel takes on this machine.
+// Only the first call does anything; it takes a few tens of milliseconds.
+void CalibrateCpuKernels();
+
+// Returns the calibrated time of a unit of work of kernel, calibrating the
+// kernels first if needed.
+double CpuKernelNsPerUnit(CpuKernel kernel);
+
+// Returns the number of units of work (at least 1) that keep a cpu busy for
+// duration_ns with the given kernel.
+int64_t CpuKernelUnitsForDuration(CpuKernel kernel, int64_t duration_ns);
+
+}  // namespace distbench
+
+#endif  // DISTBENCH_DISTBENCH_CPU_KERNELS_H_
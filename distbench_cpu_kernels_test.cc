@@ -0,0 +1,62 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "distbench_cpu_kernels.h"
+
+#include <time.h>
+
+#include "gtest/gtest.h"
+#include "gtest_utils.h"
+
+namespace distbench {
+
+namespace {
+
+int64_t ThreadCpuTimeNs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec * 1'000'000'000LL + ts.tv_nsec;
+}
+
+}  // anonymous namespace
+
+TEST(CpuKernelNamesTest, ParseNames) {
+  for (int i = 0; i < kNumCpuKernels; ++i) {
+    CpuKernel kernel = static_cast<CpuKernel>(i);
+    auto parsed = ParseCpuKernel(CpuKernelName(kernel));
+    ASSERT_OK(parsed.status());
+    ASSERT_EQ(parsed.value(), kernel);
+  }
+  ASSERT_FALSE(ParseCpuKernel("bogus").ok());
+}
+
+class CpuKernelsTest : public testing::TestWithParam<int> {};
+
+TEST_P(CpuKernelsTest, RunsForCalibratedDuration) {
+  CpuKernel kernel = static_cast<CpuKernel>(GetParam());
+  const int64_t duration_ns = 10'000'000;
+  int64_t units = CpuKernelUnitsForDuration(kernel, duration_ns);
+  ASSERT_GT(units, 1);
+  int64_t start_ns = ThreadCpuTimeNs();
+  RunCpuKernel(kernel, units);
+  int64_t cpu_ns = ThreadCpuTimeNs() - start_ns;
+  // Loose bounds, as other tests may share the machine:
+  EXPECT_GT(cpu_ns, duration_ns / 2);
+  EXPECT_LT(cpu_ns, duration_ns * 4);
+}
+
+INSTANTIATE_TEST_SUITE_P(CpuKernelsTests, CpuKernelsTest,
+                         testing::Range(0, kNumCpuKernels));
+
+}  // namespace distbench
@@ -20,6 +20,7 @@
 #include "absl/strings/numbers.h"
 #include "absl/strings/str_split.h"
 #include "distbench_netutils.h"
+#include "distbench_rpc_sample_columns.h"
 #include "distbench_thread_support.h"
 #include "glog/logging.h"
 
@@ -29,8 +30,43 @@ namespace {
 enum kFieldNames {
   kRequestPayloadSize = 0,
   kResponsePayloadSize = 1,
-  kMaxFieldNames = 2,
+  kOpenLoopIntervalNs = 2,
+  kMaxFieldNames = 3,
 };
+
+// Fanout selection and latency sampling run on many threads at once, so
+// each thread gets its own random number generator:
+absl::InsecureBitGen& ThreadRandomGenerator() {
+  thread_local absl::InsecureBitGen generator;
+  return generator;
+}
+
+// Never 0, which means that an action list records no samples:
+uint64_t NextLatencySampleBuffersId() {
+  static std::atomic<uint64_t> next_id = 1;
+  return next_id.fetch_add(1, std::memory_order_relaxed);
+}
+
+// The ServerRpcStates for nested action lists:
+ObjectPool<ServerRpcState>* NestedServerRpcStatePool() {
+  static auto* pool = new ObjectPool<ServerRpcState>("nested_server_rpc_state");
+  return pool;
+}
+
+// The RpcSample latency_weight of a completed RPC: the time since the previous
+// RPC of the same closed loop sender started, or for the first RPC of each
+// sender (and for every open loop RPC) the interval it was scheduled for. A
+// closed loop sender cannot start its next RPC before this one completes, so
+// its first RPC stands for at least its own latency.
+int64_t LatencyWeightNs(const ClientRpcState& state) {
+  absl::Duration interval = state.end_time - state.start_time;
+  if (state.prior_start_time != absl::InfinitePast()) {
+    interval = state.start_time - state.prior_start_time;
+  } else if (state.intended_interval > absl::ZeroDuration()) {
+    interval = state.intended_interval;
+  }
+  return std::max<int64_t>(1, absl::ToInt64Nanoseconds(interval));
+}
 }  // anonymous namespace
 
 ThreadSafeDictionary::ThreadSafeDictionary() {
@@ -86,11 +122,20 @@ DistBenchEngine::~DistBenchEngine() {
   }
   if (pd_) {
     pd_->ShutdownServer();
-    while (detached_actionlist_threads_) {
+    while (running_handler_action_lists_) {
       sched_yield();
     }
     pd_->ShutdownClient();
   }
+  if (client_rpc_table_) {
+    for (int i = 0; i < traffic_config_.rpc_descriptions_size(); ++i) {
+      auto& client_rpc = client_rpc_table_[i];
+      if (!client_rpc.peer_statistics) continue;
+      for (size_t j = 0; j < client_rpc.pending_requests_per_peer.size(); ++j) {
+        delete client_rpc.peer_statistics[j].load();
+      }
+    }
+  }
 }
 
 // Initialize the payload map and perform basic validation
@@ -106,6 +151,25 @@ absl::Status DistBenchEngine::InitializePayloadsMap() {
     }
 
     payload_map_[payload_spec_name] = payload_spec;
+    if (payload_spec.has_size()) {
+      payload_pool_.Reserve(payload_spec.size());
+    }
+  }
+
+  // Sampled payload sizes are served from the same pool, so make sure that it
+  // covers the largest size that any distribution config can produce:
+  for (const auto& config : traffic_config_.distribution_config()) {
+    for (int i = 0; i < config.field_names_size(); ++i) {
+      if (config.field_names(i) != "request_payload_size" &&
+          config.field_names(i) != "response_payload_size") {
+        continue;
+      }
+      for (const auto& pmf_point : config.pmf_points()) {
+        if (i >= pmf_point.data_points_size()) continue;
+        const auto& data_point = pmf_point.data_points(i);
+        payload_pool_.Reserve(std::max(data_point.exact(), data_point.upper()));
+      }
+    }
   }
 
   return absl::OkStatus();
@@ -203,6 +267,26 @@ absl::Status DistBenchEngine::InitializeRpcFanoutFilter(
   return absl::OkStatus();
 }
 
+void DistBenchEngine::InitializeRpcFanoutPlan(RpcDefinition& rpc_def) {
+  FanoutPlan& plan = rpc_def.fanout_plan;
+  auto maybe_server_spec =
+      GetServiceSpec(rpc_def.rpc_spec.server(), traffic_config_);
+  // Unknown services are reported by InitializeTables:
+  if (!maybe_server_spec.ok()) return;
+  plan.num_servers = maybe_server_spec.value().count();
+
+  bool server_is_self = rpc_def.rpc_spec.server() == service_name_;
+  for (int i = 0; i < plan.num_servers; ++i) {
+    if (!server_is_self || i != service_instance_) {
+      plan.all_targets.push_back(i);
+    }
+  }
+
+  if (rpc_def.fanout_filter == kStochastic) {
+    InitializeStochasticFanout(rpc_def.stochastic_dist, &plan);
+  }
+}
+
 absl::Status DistBenchEngine::InitializeActivityConfigMap() {
   for (int i = 0; i < traffic_config_.activity_configs_size(); ++i) {
     ActivityConfig activity_config = traffic_config_.activity_configs(i);
@@ -223,6 +307,54 @@ absl::Status DistBenchEngine::InitializeActivityConfigMap() {
   return absl::OkStatus();
 }
 
+// Prepares the activity configs that this service may use, i.e. those of the
+// action lists reachable from its main action list, or from the handlers of
+// the rpcs that it serves. Others are left alone, since every service parses
+// all the activity configs.
+absl::Status DistBenchEngine::PrepareActivityConfigs() {
+  std::vector<int> pending_lists;
+  for (size_t i = 0; i < action_lists_.size(); ++i) {
+    if (action_lists_[i].proto.name() == service_name_) {
+      pending_lists.push_back(i);
+    }
+  }
+  for (int i = 0; i < traffic_config_.rpc_descriptions_size(); ++i) {
+    if (traffic_config_.rpc_descriptions(i).server() == service_name_ &&
+        server_rpc_table_[i].handler_action_list_index != -1) {
+      pending_lists.push_back(server_rpc_table_[i].handler_action_list_index);
+    }
+  }
+  std::vector<bool> visited_lists(action_lists_.size());
+  std::set<int> activity_config_indices;
+  while (!pending_lists.empty()) {
+    int list_index = pending_lists.back();
+    pending_lists.pop_back();
+    if (visited_lists[list_index]) continue;
+    visited_lists[list_index] = true;
+    for (const auto& action : action_lists_[list_index].list_actions) {
+      if (action.actionlist_index != -1) {
+        pending_lists.push_back(action.actionlist_index);
+      } else if (action.activity_config_index != -1) {
+        activity_config_indices.insert(action.activity_config_index);
+      }
+    }
+  }
+
+  // This runs on the threadpool, so that memory gets first touched by a
+  // thread of the service's placement:
+  absl::Status status;
+  absl::Notification done;
+  thread_pool_->AddTask([this, &activity_config_indices, &status, &done]() {
+    for (int index : activity_config_indices) {
+      status = PrepareActivityConfig(&stored_activity_config_[index]);
+      if (!status.ok()) break;
+    }
+    done.Notify();
+  });
+  done.WaitForNotification();
+  return status;
+}
+
 absl::Status DistBenchEngine::InitializeRpcDefinitionsMap() {
   for (int i = 0; i < traffic_config_.rpc_descriptions_size(); ++i) {
     const auto& rpc_spec = traffic_config_.rpc_descriptions(i);
@@ -255,6 +387,9 @@ absl::Status DistBenchEngine::InitializeRpcDefinitionsMap() {
                    << "; using a default of " << rpc_def.response_payload_size;
     }
 
+    payload_pool_.Reserve(rpc_def.request_payload_size);
+    payload_pool_.Reserve(rpc_def.response_payload_size);
+
     if (rpc_spec.has_distribution_config_name()) {
       rpc_def.sample_generator_index =
           GetSampleGeneratorIndex(rpc_spec.distribution_config_name());
@@ -262,6 +397,7 @@ absl::Status DistBenchEngine::InitializeRpcDefinitionsMap() {
 
     auto ret = InitializeRpcFanoutFilter(rpc_def);
     if (!ret.ok()) return ret;
+    InitializeRpcFanoutPlan(rpc_def);
 
     rpc_map_[rpc_name] = rpc_def;
   }
@@ -351,10 +487,24 @@ absl::Status DistBenchEngine::InitializeTables() {
                            action.proto.activity_config_name()));
         }
         action.activity_config_index = it5->second;
+        action.timer_activity =
+            stored_activity_config_[it5->second].activity_func == "Delay";
       } else {
         return absl::InvalidArgumentError(
             "only rpc actions & activities are supported for now");
       }
+      const auto& iterations = action.proto.iterations();
+      absl::Status status = ValidateOpenLoopIterations(iterations);
+      if (!status.ok()) return status;
+      if (iterations.has_open_loop_interval_distribution_config_name()) {
+        action.open_loop_sample_generator_index = GetSampleGeneratorIndex(
+            iterations.open_loop_interval_distribution_config_name());
+        if (action.open_loop_sample_generator_index == -1) {
+          return absl::InvalidArgumentError(absl::StrCat(
+              "Distribution config not found for: ",
+              iterations.open_loop_interval_distribution_config_name()));
+        }
+      }
       action.dependent_action_indices.resize(action.proto.dependencies_size());
       for (int k = 0; k < action.proto.dependencies_size(); ++k) {
         auto it = list_action_indices.find(action.proto.dependencies(k));
@@ -366,6 +516,11 @@ absl::Status DistBenchEngine::InitializeTables() {
           return absl::InvalidArgumentError(
               "dependencies must refer to prior actions");
         }
+        action_lists_[i].list_actions[it->second]
+            .successor_action_indices.push_back(j);
+      }
+      if (action.dependent_action_indices.empty()) {
+        action_lists_[i].initial_action_indices.push_back(j);
       }
     }
   }
@@ -428,6 +583,9 @@ absl::Status DistBenchEngine::InitializeTables() {
     client_rpc_table_[i].rpc_definition = rpc_map_[rpc.name()];
     client_rpc_table_[i].pending_requests_per_peer.resize(
         traffic_config_.services(it1->second).count(), 0);
+    client_rpc_table_[i].peer_statistics =
+        std::make_unique<std::atomic<PeerRpcStatistics*>[]>(
+            traffic_config_.services(it1->second).count());
   }
 
   return absl::OkStatus();
@@ -445,15 +603,80 @@ absl::Status DistBenchEngine::Initialize(
   service_spec_ = maybe_service_spec.value();
   service_instance_ = service_instance;
   engine_name_ = absl::StrCat(service_name_, "/", service_instance_);
+  auto maybe_placement = ParseThreadPlacement(
+      service_spec_.cpu_list(),
+      service_spec_.has_numa_node() ? service_spec_.numa_node() : -1);
+  if (!maybe_placement.ok()) return maybe_placement.status();
+  placement_ = maybe_placement.value();
+  // One thread per cpu that the service may run on:
+  int threadpool_size = placement_.cpus.empty()
+                            ? absl::base_internal::NumCPUs()
+                            : placement_.cpus.size();
   auto maybe_threadpool =
-      CreateThreadpool("elastic", absl::base_internal::NumCPUs());
+      CreateThreadpool(service_spec_.threadpool_type(), threadpool_size,
+                       placement_, service_spec_.threadpool_spin_ns());
   if (!maybe_threadpool.ok()) {
     return maybe_threadpool.status();
   }
   thread_pool_ = std::move(maybe_threadpool.value());
+  activity_thread_pool_ = thread_pool_.get();
+  if (service_spec_.has_activity_threadpool_type() ||
+      service_spec_.has_activity_threadpool_size()) {
+    auto maybe_activity_threadpool = CreateThreadpool(
+        service_spec_.activity_threadpool_type(),
+        service_spec_.has_activity_threadpool_size()
+            ? service_spec_.activity_threadpool_size()
+            : threadpool_size,
+        placement_, service_spec_.threadpool_spin_ns());
+    if (!maybe_activity_threadpool.ok()) {
+      return maybe_activity_threadpool.status();
+    }
+    dedicated_activity_thread_pool_ =
+        std::move(maybe_activity_threadpool.value());
+    activity_thread_pool_ = dedicated_activity_thread_pool_.get();
+  }
+  if (service_spec_.threadpool_telemetry()) {
+    thread_pool_->EnableTelemetry();
+    if (dedicated_activity_thread_pool_) {
+      dedicated_activity_thread_pool_->EnableTelemetry();
+    }
+  }
+  absl::Notification placement_observed;
+  thread_pool_->AddTask([this, &placement_observed]() {
+    thread_cpu_list_ = GetThreadCpuList();
+    thread_numa_node_ = GetThreadNumaNode();
+    placement_observed.Notify();
+  });
+  placement_observed.WaitForNotification();
 
   absl::Status ret = InitializeTables();
   if (!ret.ok()) return ret;
+  if (placement_.numa_node >= 0) {
+    ret = payload_pool_.BindToNumaNode(placement_.numa_node);
+    if (!ret.ok()) return ret;
+  }
+  ret = PrepareActivityConfigs();
+  if (!ret.ok()) return ret;
+  bool need_pacer = false;
+  for (const auto& action : traffic_config_.actions()) {
+    if (IsOpenLoop(action.iterations())) {
+      need_pacer = true;
+    }
+  }
+  for (const auto& activity_config : stored_activity_config_) {
+    if (activity_config.activity_func == "Delay") {
+      need_pacer = true;
+    }
+    if (activity_config.activity_func == "BurnCpu") {
+      // Calibrating takes a while, so it is done before the test starts,
+      // rather than when the first action list allocates the activity:
+      CalibrateCpuKernels();
+    }
+  }
+  if (need_pacer) {
+    pacer_ = std::make_unique<Pacer>(clock_, Pacer::kDefaultSpinWindow,
+                                     placement_);
+  }
 
   // Start server
   std::string server_address =
@@ -626,9 +849,10 @@ absl::Status DistBenchEngine::RunTraffic(const RunTrafficRequest* request) {
         delete fake_request;
         delete top_level_state;
       });
-      engine_main_thread_ = RunRegisteredThread(
-          "EngineMain",
-          [this, i, top_level_state]() { RunActionList(i, top_level_state); });
+      main_action_list_done_ = std::make_unique<absl::Notification>();
+      StartActionList(i, top_level_state, false, [this]() {
+        main_action_list_done_->Notify();
+      });
       break;
     }
   }
@@ -647,8 +871,9 @@ void DistBenchEngine::CancelTraffic(absl::Status status,
 }
 
 void DistBenchEngine::FinishTraffic() {
-  if (engine_main_thread_.joinable()) {
-    engine_main_thread_.join();
+  if (main_action_list_done_) {
+    main_action_list_done_->WaitForNotification();
+    main_action_list_done_.reset();
     LOG(INFO) << engine_name_ << ": Finished running Main";
   }
 }
@@ -656,11 +881,58 @@ void DistBenchEngine::FinishTraffic() {
 void DistBenchEngine::AddActivityLogs(ServicePerformanceLog* sp_log) {
   for (auto& alog : cumulative_activity_logs_) {
     auto& activity_log = (*sp_log->mutable_activity_logs())[alog.first];
-    for (auto& metric : alog.second) {
+    for (auto& metric : alog.second.metrics) {
       auto* am = activity_log.add_activity_metrics();
       am->set_name(metric.first);
       am->set_value_int(metric.second);
     }
+    if (LatencyHistogramCount(alog.second.iteration_wall_time)) {
+      *activity_log.mutable_iteration_wall_time() =
+          alog.second.iteration_wall_time;
+    }
+    if (LatencyHistogramCount(alog.second.iteration_cpu_time)) {
+      *activity_log.mutable_iteration_cpu_time() =
+          alog.second.iteration_cpu_time;
+    }
+    for (const auto& [operation, histogram] :
+         alog.second.operation_latencies) {
+      (*activity_log.mutable_operation_latencies())[operation] = histogram;
+    }
+  }
+}
+
+void DistBenchEngine::AddEngineStats(ServicePerformanceLog* sp_log) {
+  auto& engine_stats = *sp_log->mutable_engine_stats();
+  for (const auto& stat : GetObjectPoolStats()) {
+    engine_stats[absl::StrCat("object_pool/", stat.name)] = stat.value;
+  }
+  for (const auto& stat : pd_->GetTransportStats()) {
+    engine_stats[absl::StrCat("transport/", stat.name)] = stat.value;
+  }
+}
+
+void DistBenchEngine::AddThreadPlacement(ServicePerformanceLog* sp_log) {
+  sp_log->set_cpu_list(thread_cpu_list_);
+  if (thread_numa_node_ >= 0) {
+    sp_log->set_numa_node(thread_numa_node_);
+  }
+}
+
+void DistBenchEngine::AddThreadpoolLogs(ServicePerformanceLog* sp_log) {
+  auto& threadpool_logs = *sp_log->mutable_threadpool_logs();
+  threadpool_logs["engine"] = thread_pool_->GetLog();
+  if (dedicated_activity_thread_pool_) {
+    threadpool_logs["activities"] = dedicated_activity_thread_pool_->GetLog();
+  }
+  for (auto& [name, log] : pd_->GetThreadpoolLogs()) {
+    threadpool_logs[absl::StrCat("protocol_driver/", name)] = std::move(log);
+  }
+}
+
+void DistBenchEngine::AddOpenLoopSendLag(ServicePerformanceLog* sp_log) {
+  absl::MutexLock m(&open_loop_send_lag_mu_);
+  for (const auto& [action_name, histogram] : open_loop_send_lag_) {
+    (*sp_log->mutable_open_loop_send_lag())[action_name] = histogram;
   }
 }
 
@@ -677,23 +949,134 @@ ServicePerformanceLog DistBenchEngine::GetLogs() {
           int32_t rpc_index = map_pair.first;
           const RpcPerformanceLog& rpc_perf_log = map_pair.second;
           if (rpc_perf_log.successful_rpc_samples().empty() &&
-              rpc_perf_log.failed_rpc_samples().empty())
+              rpc_perf_log.failed_rpc_samples().empty() &&
+              !rpc_perf_log.has_successful_rpc_sample_columns() &&
+              !rpc_perf_log.has_failed_rpc_sample_columns())
             continue;
           auto& output_peer_log =
               (*log.mutable_peer_logs())[peers_[i][j].log_name];
           auto& output_rpc_logs = *output_peer_log.mutable_rpc_logs();
-          output_rpc_logs[rpc_index].MergeFrom(rpc_perf_log);
+          auto& output_rpc_log = output_rpc_logs[rpc_index];
+          // Delta encoded columns can not simply be concatenated:
+          if (rpc_perf_log.has_successful_rpc_sample_columns()) {
+            MergeRpcSampleColumns(
+                rpc_perf_log.successful_rpc_sample_columns(),
+                output_rpc_log.mutable_successful_rpc_sample_columns());
+          }
+          if (rpc_perf_log.has_failed_rpc_sample_columns()) {
+            MergeRpcSampleColumns(
+                rpc_perf_log.failed_rpc_sample_columns(),
+                output_rpc_log.mutable_failed_rpc_sample_columns());
+          }
+          output_rpc_log.mutable_successful_rpc_samples()->MergeFrom(
+              rpc_perf_log.successful_rpc_samples());
+          output_rpc_log.mutable_failed_rpc_samples()->MergeFrom(
+              rpc_perf_log.failed_rpc_samples());
         }
       }
     }
   }
+  AddRpcStatistics(&log);
   for (const auto& error : actionlist_error_dictionary_->GetContents()) {
     log.mutable_error_dictionary()->add_error_message(error);
   }
   AddActivityLogs(&log);
+  AddEngineStats(&log);
+  AddOpenLoopSendLag(&log);
+  AddThreadPlacement(&log);
+  AddThreadpoolLogs(&log);
   return log;
 }
 
+DistBenchEngine::PeerRpcStatistics* DistBenchEngine::GetPeerRpcStatistics(
+    int rpc_index, int instance) {
+  auto& statistics = client_rpc_table_[rpc_index].peer_statistics[instance];
+  PeerRpcStatistics* ret = statistics.load(std::memory_order_acquire);
+  if (ret == nullptr) {
+    auto* new_statistics = new PeerRpcStatistics;
+    if (statistics.compare_exchange_strong(ret, new_statistics,
+                                           std::memory_order_acq_rel)) {
+      ret = new_statistics;
+    } else {
+      delete new_statistics;
+    }
+  }
+  return ret;
+}
+
+void DistBenchEngine::AddRpcStatistics(ServicePerformanceLog* sp_log) {
+  for (int i = 0; i < traffic_config_.rpc_descriptions_size(); ++i) {
+    const auto& client_rpc = client_rpc_table_[i];
+    for (size_t j = 0; j < client_rpc.pending_requests_per_peer.size(); ++j) {
+      PeerRpcStatistics* statistics = client_rpc.peer_statistics[j].load();
+      if (statistics == nullptr) continue;
+      const auto& peer = peers_[client_rpc.service_index][j];
+      auto& rpc_log = (*(*sp_log->mutable_peer_logs())[peer.log_name]
+                            .mutable_rpc_logs())[i];
+      statistics->CopyTo(rpc_log.mutable_statistics());
+    }
+  }
+}
+
+void DistBenchEngine::PeerRpcStatistics::Record(const ClientRpcState& state) {
+  if (!state.success) {
+    failed_rpcs.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  if (state.request.warmup()) {
+    warmup_rpcs.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  successful_rpcs.fetch_add(1, std::memory_order_relaxed);
+  request_bytes.fetch_add(state.request.payload().size(),
+                          std::memory_order_relaxed);
+  response_bytes.fetch_add(state.response.payload().size(),
+                           std::memory_order_relaxed);
+  const int64_t start_timestamp_ns = absl::ToUnixNanos(state.start_time);
+  const int64_t end_timestamp_ns = absl::ToUnixNanos(state.end_time);
+  int64_t first = first_start_timestamp_ns.load(std::memory_order_relaxed);
+  while (start_timestamp_ns < first &&
+         !first_start_timestamp_ns.compare_exchange_weak(
+             first, start_timestamp_ns, std::memory_order_relaxed)) {
+  }
+  int64_t last = last_end_timestamp_ns.load(std::memory_order_relaxed);
+  while (end_timestamp_ns > last &&
+         !last_end_timestamp_ns.compare_exchange_weak(
+             last, end_timestamp_ns, std::memory_order_relaxed)) {
+  }
+  latency_histogram.Record(end_timestamp_ns - start_timestamp_ns);
+  weighted_latency_histogram.Record(end_timestamp_ns - start_timestamp_ns,
+                                    LatencyWeightNs(state));
+  const int64_t intended_start_timestamp_ns =
+      absl::ToUnixNanos(state.intended_start_time);
+  response_time_histogram.Record(end_timestamp_ns -
+                                 intended_start_timestamp_ns);
+  if (intended_start_timestamp_ns < start_timestamp_ns &&
+      !has_send_lag.load(std::memory_order_relaxed)) {
+    has_send_lag.store(true, std::memory_order_relaxed);
+  }
+}
+
+void DistBenchEngine::PeerRpcStatistics::CopyTo(
+    RpcStatistics* statistics) const {
+  statistics->set_successful_rpcs(successful_rpcs);
+  statistics->set_warmup_rpcs(warmup_rpcs);
+  statistics->set_failed_rpcs(failed_rpcs);
+  statistics->set_request_bytes(request_bytes);
+  statistics->set_response_bytes(response_bytes);
+  if (successful_rpcs) {
+    statistics->set_first_start_timestamp_ns(first_start_timestamp_ns);
+    statistics->set_last_end_timestamp_ns(last_end_timestamp_ns);
+  }
+  latency_histogram.AddTo(statistics->mutable_latency_histogram());
+  weighted_latency_histogram.AddTo(
+      statistics->mutable_weighted_latency_histogram());
+  if (has_send_lag) {
+    response_time_histogram.AddTo(
+        statistics->mutable_response_time_histogram());
+  }
+}
+
 // Process the incoming RPC;
 // if have_dedicated_thread == true; all the processing is performed inline
 // and the function returned is always empty,
@@ -717,11 +1100,11 @@ std::function<void()> DistBenchEngine::RpcHandler(ServerRpcState* state) {
   const auto& rpc_def = server_rpc.rpc_definition;
 
   if (state->request->has_response_payload_size()) {
-    state->response.set_payload(
-        std::string(state->request->response_payload_size(), 'D'));
+    payload_pool_.FillPayload(state->request->response_payload_size(),
+                              state->response.mutable_payload());
   } else {
-    state->response.set_payload(
-        std::string(rpc_def.response_payload_size, 'D'));
+    payload_pool_.FillPayload(rpc_def.response_payload_size,
+                              state->response.mutable_payload());
   }
 
   int handler_action_list_index = server_rpc.handler_action_list_index;
@@ -732,204 +1115,179 @@ std::function<void()> DistBenchEngine::RpcHandler(ServerRpcState* state) {
   }
 
   if (state->have_dedicated_thread) {
-    RunActionList(handler_action_list_index, state);
+    // The state belongs to the caller's thread, so wait for the list:
+    absl::Notification done;
+    StartActionList(handler_action_list_index, state, false,
+                    [&done]() { done.Notify(); });
+    done.WaitForNotification();
     return std::function<void()>();
   }
 
-  ++detached_actionlist_threads_;
-  return [=]() {
-    RunActionList(handler_action_list_index, state);
-    --detached_actionlist_threads_;
-  };
+  // Otherwise the action list finishes from the completion of its actions,
+  // without holding a thread while it runs:
+  ++running_handler_action_lists_;
+  StartActionList(handler_action_list_index, state, false,
+                  [this]() { --running_handler_action_lists_; });
+  return std::function<void()>();
 }
 
-void DistBenchEngine::RunActionList(int list_index,
-                                    ServerRpcState* incoming_rpc_state,
-                                    bool force_warmup) {
+void DistBenchEngine::StartActionList(int list_index,
+                                      ServerRpcState* incoming_rpc_state,
+                                      bool force_warmup,
+                                      std::function<void()> done_callback) {
   CHECK_LT(static_cast<size_t>(list_index), action_lists_.size());
   CHECK_GE(list_index, 0);
-  ActionListState s = {};
-  s.actionlist_error_dictionary_ = actionlist_error_dictionary_;
-  s.warmup_ = force_warmup || incoming_rpc_state->request->warmup();
-  s.incoming_rpc_state = incoming_rpc_state;
-  s.action_list = &action_lists_[list_index];
-  bool sent_response_early = false;
-  unsigned int seed =
-      std::chrono::system_clock::now().time_since_epoch().count();
-  std::default_random_engine rand_gen(seed);
+  // Deleted by FinishActionList:
+  auto* s = new ActionListState();
+  s->actionlist_error_dictionary_ = actionlist_error_dictionary_;
+  s->warmup_ = force_warmup || incoming_rpc_state->request->warmup();
+  s->incoming_rpc_state = incoming_rpc_state;
+  s->action_list = &action_lists_[list_index];
+  s->done_callback = std::move(done_callback);
+  s->seed = std::chrono::system_clock::now().time_since_epoch().count();
 
   // Allocate peer_logs_ for performance gathering, if needed:
-  if (s.action_list->has_rpcs) {
-    s.packed_samples_size_ = s.action_list->proto.max_rpc_samples();
-    if (s.action_list->proto.max_rpc_samples() < 0) {
-      s.packed_samples_size_ = 0;
-    }
-    s.packed_samples_.reset(new PackedLatencySample[s.packed_samples_size_]);
-    s.remaining_initial_samples_ = s.packed_samples_size_;
-    absl::MutexLock m(&s.action_mu);
-    s.peer_logs_.resize(peers_.size());
+  if (s->action_list->has_rpcs) {
+    s->max_samples_ =
+        std::max<int64_t>(0, s->action_list->proto.max_rpc_samples());
+    s->sample_buffers_id_ = NextLatencySampleBuffersId();
+    absl::MutexLock m(&s->action_mu);
+    s->peer_logs_.resize(peers_.size());
     for (size_t i = 0; i < peers_.size(); ++i) {
-      s.peer_logs_[i].resize(peers_[i].size());
+      s->peer_logs_[i].resize(peers_[i].size());
     }
   }
 
-  int size = s.action_list->proto.action_names_size();
-  s.finished_action_indices.reserve(size);
-  s.state_table = std::make_unique<ActionState[]>(size);
-  while (true) {
-    absl::Time now = clock_->Now();
+  int size = s->action_list->proto.action_names_size();
+  s->state_table = std::make_unique<ActionState[]>(size);
+  {
+    absl::MutexLock m(&s->action_mu);
+    s->remaining_dependencies = std::make_unique<int[]>(size);
     for (int i = 0; i < size; ++i) {
-      if (s.state_table[i].started) {
-        if (s.state_table[i].next_iteration_time < now) {
-          if (s.state_table[i].action->proto.has_activity_config_name()) {
-            RunActivity(&s.state_table[i]);
-          } else {
-            StartOpenLoopIteration(&s.state_table[i]);
-          }
-        }
-        continue;
-      }
-      auto deps = s.action_list->list_actions[i].dependent_action_indices;
-      bool deps_ready = true;
-      for (const auto& dep : deps) {
-        if (!s.state_table[dep].finished) {
-          deps_ready = false;
-          break;
-        }
-      }
-      if (!deps_ready) continue;
-      s.state_table[i].started = true;
-      s.state_table[i].action = &s.action_list->list_actions[i];
-      s.state_table[i].rand_gen = &rand_gen;
-      if ((!sent_response_early && incoming_rpc_state) &&
-          ((size == 1) ||
-           s.state_table[i].action->proto.send_response_when_done())) {
-        sent_response_early = true;
-        s.state_table[i].all_done_callback = [&s, i, incoming_rpc_state,
-                                              this]() {
-          incoming_rpc_state->SendResponseIfSet();
-          if (s.state_table[i].action->proto.cancel_traffic_when_done()) {
-            CancelTraffic(absl::CancelledError("cancel_traffic_when_done"),
-                          absl::Seconds(1));
-          }
-          s.FinishAction(i);
-        };
-      } else {
-        s.state_table[i].all_done_callback = [&s, i, this]() {
-          if (s.state_table[i].action->proto.cancel_traffic_when_done()) {
-            CancelTraffic(absl::CancelledError("cancel_traffic_when_done"),
-                          absl::Seconds(1));
-          }
-          s.FinishAction(i);
-        };
-      }
-      s.state_table[i].action_list_state = &s;
-      atomic_fetch_add_explicit(&s.pending_action_count_, 1,
-                                std::memory_order_relaxed);
-      InitiateAction(&s.state_table[i]);
+      s->remaining_dependencies[i] =
+          s->action_list->list_actions[i].dependent_action_indices.size();
     }
-    absl::Time next_iteration_time = absl::InfiniteFuture();
-    bool done = true;
-    for (int i = 0; i < size; ++i) {
-      absl::MutexLock m(&s.state_table[i].iteration_mutex);
-      if (!s.state_table[i].finished) {
-        if (s.state_table[i].next_iteration_time < next_iteration_time) {
-          next_iteration_time = s.state_table[i].next_iteration_time;
+  }
+  // Keep the list from finishing while the initial actions are started, in
+  // case some of them finish right away:
+  s->pending_action_count_ = 1;
+  for (int i : s->action_list->initial_action_indices) {
+    StartAction(s, i);
+  }
+  ReleaseActionList(s);
+}
+
+void DistBenchEngine::StartAction(ActionListState* s, int action_index) {
+  ActionState& state = s->state_table[action_index];
+  state.started = true;
+  state.action = &s->action_list->list_actions[action_index];
+  state.action_list_state = s;
+  state.rand_gen.seed(s->seed + action_index);
+  bool send_response = false;
+  if (s->incoming_rpc_state) {
+    absl::MutexLock m(&s->action_mu);
+    if (!s->sent_response_early &&
+        (s->action_list->proto.action_names_size() == 1 ||
+         state.action->proto.send_response_when_done())) {
+      s->sent_response_early = true;
+      send_response = true;
+    }
+  }
+  state.all_done_callback = [this, s, action_index, send_response]() {
+    if (send_response) {
+      s->incoming_rpc_state->SendResponseIfSet();
+    }
+    FinishAction(s, action_index);
+  };
+  s->pending_action_count_.fetch_add(1, std::memory_order_relaxed);
+  InitiateAction(&state);
+}
+
+void DistBenchEngine::FinishAction(ActionListState* s, int action_index) {
+  const ActionTableEntry& action = s->action_list->list_actions[action_index];
+  if (action.proto.cancel_traffic_when_done()) {
+    CancelTraffic(absl::CancelledError("cancel_traffic_when_done"),
+                  absl::Seconds(1));
+  }
+  absl::InlinedVector<int, 8> ready_actions;
+  {
+    absl::MutexLock m(&s->action_mu);
+    s->state_table[action_index].finished = true;
+    // Once canceled, the actions that have not started yet never will:
+    if (!canceled_.HasBeenNotified()) {
+      for (int successor : action.successor_action_indices) {
+        if (--s->remaining_dependencies[successor] == 0) {
+          ready_actions.push_back(successor);
         }
-        done = false;
       }
     }
-    if (done) break;
-    auto some_actions_finished = [&s]() { return s.DidSomeActionsFinish(); };
+  }
+  for (int i : ready_actions) {
+    StartAction(s, i);
+  }
+  ReleaseActionList(s);
+}
 
-    // Idle here till some actions are finished.
-    if (clock_->MutexLockWhenWithDeadline(
-            &s.action_mu, absl::Condition(&some_actions_finished),
-            next_iteration_time)) {
-      s.HandleFinishedActions();
-    }
-    s.action_mu.Unlock();
-    if (canceled_.HasBeenNotified()) {
-      LOG(INFO) << engine_name_ << ": Cancelled action list '"
-                << s.action_list->proto.name() << "'";
+void DistBenchEngine::ReleaseActionList(ActionListState* s) {
+  if (s->pending_action_count_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    FinishActionList(s);
+  }
+}
 
-      s.CancelActivities();
-      s.WaitForAllPendingActions();
-      break;
-    }
+void DistBenchEngine::FinishActionList(ActionListState* s) {
+  if (pacer_ && pacer_->IsPacerThread()) {
+    // An open loop action finished from its pacer callback, which has yet to
+    // return, so RemoveTimer must be called from elsewhere:
+    thread_pool_->AddTask([this, s]() { FinishActionList(s); });
+    return;
+  }
+  if (canceled_.HasBeenNotified()) {
+    LOG(INFO) << engine_name_ << ": Cancelled action list '"
+              << s->action_list->proto.name() << "'";
   }
+  ServerRpcState* incoming_rpc_state = s->incoming_rpc_state;
   if (incoming_rpc_state) {
+    bool sent_response_early;
+    {
+      absl::MutexLock m(&s->action_mu);
+      sent_response_early = s->sent_response_early;
+    }
     if (!sent_response_early) {
       incoming_rpc_state->SendResponseIfSet();
     }
     incoming_rpc_state->FreeStateIfSet();
   }
+  int size = s->action_list->proto.action_names_size();
+  for (int i = 0; i < size; ++i) {
+    ActionState& action_state = s->state_table[i];
+    if (action_state.pacer_timer_id < 0) continue;
+    pacer_->RemoveTimer(action_state.pacer_timer_id);
+    absl::MutexLock m(&open_loop_send_lag_mu_);
+    action_state.send_lag->AddTo(
+        &open_loop_send_lag_[action_state.action->proto.name()]);
+  }
   // Merge the per-action-list logs into the overall logs:
-  if (s.action_list->has_rpcs) {
-    s.UnpackLatencySamples();
-    absl::MutexLock m(&s.action_mu);
-    for (size_t i = 0; i < s.peer_logs_.size(); ++i) {
-      for (size_t j = 0; j < s.peer_logs_[i].size(); ++j) {
-        if (s.peer_logs_[i][j].rpc_logs().empty()) continue;
+  if (s->action_list->has_rpcs) {
+    s->UnpackLatencySamples();
+    absl::MutexLock m(&s->action_mu);
+    for (size_t i = 0; i < s->peer_logs_.size(); ++i) {
+      for (size_t j = 0; j < s->peer_logs_[i].size(); ++j) {
+        if (s->peer_logs_[i][j].rpc_logs().empty()) continue;
         absl::MutexLock m(&peers_[i][j].mutex);
-        peers_[i][j].partial_logs.emplace_back(std::move(s.peer_logs_[i][j]));
+        peers_[i][j].partial_logs.emplace_back(
+            std::move(s->peer_logs_[i][j]));
       }
     }
   }
 
-  absl::MutexLock m(&cumulative_activity_log_mu_);
-  s.UpdateActivitiesLog(&cumulative_activity_logs_);
-}
-
-void DistBenchEngine::ActionListState::FinishAction(int action_index) {
-  action_mu.Lock();
-  finished_action_indices.push_back(action_index);
-  atomic_fetch_sub_explicit(&pending_action_count_, 1,
-                            std::memory_order_relaxed);
-  action_mu.Unlock();
-}
-
-bool DistBenchEngine::ActionListState::DidSomeActionsFinish() {
-  int pending_actions =
-      atomic_load_explicit(&pending_action_count_, std::memory_order_relaxed);
-  return !pending_actions || !finished_action_indices.empty();
-};
-
-void DistBenchEngine::ActionListState::HandleFinishedActions() {
-  if (!DidSomeActionsFinish()) {
-    LOG(FATAL) << "finished_action_indices is empty";
-  }
-  for (const auto& finished_action_index : finished_action_indices) {
-    state_table[finished_action_index].finished = true;
-    state_table[finished_action_index].next_iteration_time =
-        absl::InfiniteFuture();
-  }
-  finished_action_indices.clear();
-}
-
-void DistBenchEngine::ActionListState::CancelActivities() {
-  bool finished_some_actions = false;
-  for (int i = 0; i < action_list->proto.action_names_size(); ++i) {
-    auto action_state = &state_table[i];
-    if (action_state->finished) {
-      continue;
-    }
-    if (action_state->action->proto.has_activity_config_name()) {
-      finished_some_actions = true;
-#ifdef NDEBUG
-      action_state->all_done_callback();
-#else
-      auto adcb = std::move(action_state->all_done_callback);
-      action_state->all_done_callback = []() {
-        LOG(FATAL) << "all_done_callback already called!";
-      };
-      adcb();
-#endif
-    }
+  {
+    absl::MutexLock m(&cumulative_activity_log_mu_);
+    s->UpdateActivitiesLog(&cumulative_activity_logs_);
   }
-  if (finished_some_actions) {
-    absl::MutexLock m(&action_mu);
-    HandleFinishedActions();
+  std::function<void()> done_callback = std::move(s->done_callback);
+  delete s;
+  if (done_callback) {
+    done_callback();
   }
 }
 
@@ -939,64 +1297,102 @@ void DistBenchEngine::ActionListState::CancelActivities() {
 // For example:
 // The 'iteration_count' for two activities 'A1' and 'A2' that have the same
 // activity config 'AC' and have run 20 and 30 times respectively is reported as
-// iteration_count = 50.
+// iteration_count = 50. Likewise, their iteration time histograms are merged.
 void DistBenchEngine::ActionListState::UpdateActivitiesLog(
-    std::map<std::string, std::map<std::string, int64_t>>*
-        cumulative_activity_logs) {
+    std::map<std::string, CumulativeActivityLog>* cumulative_activity_logs) {
   for (int i = 0; i < action_list->proto.action_names_size(); ++i) {
     auto action_state = &state_table[i];
-    if (action_state->action->proto.has_activity_config_name()) {
+    if (action_state->started && action_state->activity) {
       auto activity_config_name =
           action_state->action->proto.activity_config_name();
       auto new_log = action_state->activity->GetActivityLog();
+      action_state->activity->AddIterationTimesTo(&new_log);
+      auto& cumulative_log = (*cumulative_activity_logs)[activity_config_name];
 
       for (auto new_metrics_it = new_log.activity_metrics().begin();
            new_metrics_it != new_log.activity_metrics().end();
            new_metrics_it++) {
-        (*cumulative_activity_logs)[activity_config_name]
-                                   [new_metrics_it->name()] +=
+        cumulative_log.metrics[new_metrics_it->name()] +=
             new_metrics_it->value_int();
       }
+      MergeLatencyHistogram(new_log.iteration_wall_time(),
+                            &cumulative_log.iteration_wall_time);
+      MergeLatencyHistogram(new_log.iteration_cpu_time(),
+                            &cumulative_log.iteration_cpu_time);
+      for (const auto& [operation, histogram] : new_log.operation_latencies()) {
+        MergeLatencyHistogram(histogram,
+                              &cumulative_log.operation_latencies[operation]);
+      }
     }
   }
 }
 
-void DistBenchEngine::ActionListState::WaitForAllPendingActions() {
-  auto some_actions_finished = [this]() { return DidSomeActionsFinish(); };
-  bool done;
-  do {
-    action_mu.LockWhen(absl::Condition(&some_actions_finished));
-    HandleFinishedActions();
-    done = true;
-    for (int i = 0; i < action_list->proto.action_names_size(); ++i) {
-      const auto& state = state_table[i];
-      if (state.started && !state.finished) {
-        done = false;
-        break;
-      }
+DistBenchEngine::ActionListState::~ActionListState() {
+  LatencySampleBuffer* buffer = sample_buffers_.load(std::memory_order_acquire);
+  while (buffer) {
+    delete std::exchange(buffer, buffer->next);
+  }
+}
+
+DistBenchEngine::LatencySampleBuffer*
+DistBenchEngine::ActionListState::ThreadLatencySampleBuffer() {
+  // Threads usually record several samples in a row into the same list:
+  thread_local uint64_t cached_id = 0;
+  thread_local LatencySampleBuffer* cached_buffer = nullptr;
+  if (cached_id == sample_buffers_id_) return cached_buffer;
+
+  const std::thread::id self = std::this_thread::get_id();
+  LatencySampleBuffer* head = sample_buffers_.load(std::memory_order_acquire);
+  LatencySampleBuffer* buffer = head;
+  while (buffer && buffer->owner != self) buffer = buffer->next;
+  if (!buffer) {
+    buffer = new LatencySampleBuffer{self, head, {}};
+    while (!sample_buffers_.compare_exchange_weak(buffer->next, buffer,
+                                                  std::memory_order_release,
+                                                  std::memory_order_relaxed)) {
     }
-    action_mu.Unlock();
-  } while (!done);
+  }
+  cached_id = sample_buffers_id_;
+  cached_buffer = buffer;
+  return buffer;
 }
 
 void DistBenchEngine::ActionListState::UnpackLatencySamples() {
+  // All the actions are finished, so no thread still appends to the buffers:
+  std::vector<PackedLatencySample> packed_samples;
+  for (LatencySampleBuffer* buffer =
+           sample_buffers_.load(std::memory_order_acquire);
+       buffer; buffer = buffer->next) {
+    packed_samples.insert(packed_samples.end(), buffer->samples.begin(),
+                          buffer->samples.end());
+    buffer->samples = {};
+  }
+  if (max_samples_ && packed_samples.size() > max_samples_) {
+    std::nth_element(packed_samples.begin(),
+                     packed_samples.begin() + max_samples_,
+                     packed_samples.end(),
+                     PackedLatencySample::HasSmallerReservoirKey);
+    packed_samples.resize(max_samples_);
+  }
+  // Merging the buffers loses the completion order, so restore it:
+  std::sort(packed_samples.begin(), packed_samples.end());
+
+  const bool columnar = action_list->proto.columnar_rpc_samples();
+  RpcSample columnar_sample;
   absl::MutexLock m(&action_mu);
-  if (packed_sample_number_ <= packed_samples_size_) {
-    packed_samples_size_ = packed_sample_number_;
-  } else {
-    // If we did Reservoir sampling, we should sort the data:
-    std::sort(packed_samples_.get(),
-              packed_samples_.get() + packed_samples_size_);
-  }
-  for (size_t i = 0; i < packed_samples_size_; ++i) {
-    const auto& packed_sample = packed_samples_[i];
+  for (const auto& packed_sample : packed_samples) {
     CHECK_LT(packed_sample.service_type, peer_logs_.size());
     auto& service_log = peer_logs_[packed_sample.service_type];
     CHECK_LT(packed_sample.instance, service_log.size());
     auto& peer_log = service_log[packed_sample.instance];
     auto& rpc_log = (*peer_log.mutable_rpc_logs())[packed_sample.rpc_index];
-    auto* sample = packed_sample.success ? rpc_log.add_successful_rpc_samples()
-                                         : rpc_log.add_failed_rpc_samples();
+    RpcSample* sample = &columnar_sample;
+    if (columnar) {
+      columnar_sample.Clear();
+    } else {
+      sample = packed_sample.success ? rpc_log.add_successful_rpc_samples()
+                                     : rpc_log.add_failed_rpc_samples();
+    }
     sample->set_request_size(packed_sample.request_size);
     sample->set_response_size(packed_sample.response_size);
     sample->set_start_timestamp_ns(packed_sample.start_timestamp_ns);
@@ -1004,6 +1400,9 @@ void DistBenchEngine::ActionListState::UnpackLatencySamples() {
     if (packed_sample.latency_weight) {
       sample->set_latency_weight(packed_sample.latency_weight);
     }
+    if (packed_sample.send_lag_ns) {
+      sample->set_send_lag_ns(packed_sample.send_lag_ns);
+    }
     if (packed_sample.trace_context) {
       *sample->mutable_trace_context() = *packed_sample.trace_context;
     }
@@ -1013,6 +1412,27 @@ void DistBenchEngine::ActionListState::UnpackLatencySamples() {
     if (packed_sample.error_index) {
       sample->set_error_index(packed_sample.error_index);
     }
+    if (columnar) {
+      AppendRpcSample(columnar_sample,
+                      packed_sample.success
+                          ? rpc_log.mutable_successful_rpc_sample_columns()
+                          : rpc_log.mutable_failed_rpc_sample_columns());
+    }
+  }
+  if (!columnar) return;
+  for (auto& service_log : peer_logs_) {
+    for (auto& peer_log : service_log) {
+      for (auto& rpc_log : *peer_log.mutable_rpc_logs()) {
+        if (rpc_log.second.has_successful_rpc_sample_columns()) {
+          FinishRpcSampleColumns(
+              rpc_log.second.mutable_successful_rpc_sample_columns());
+        }
+        if (rpc_log.second.has_failed_rpc_sample_columns()) {
+          FinishRpcSampleColumns(
+              rpc_log.second.mutable_failed_rpc_sample_columns());
+        }
+      }
+    }
   }
 }
 
@@ -1020,134 +1440,101 @@ void DistBenchEngine::ActionListState::RecordLatency(size_t rpc_index,
                                                      size_t service_type,
                                                      size_t instance,
                                                      ClientRpcState* state) {
-  // If we are using packed samples we avoid grabbing a mutex, but are limited
-  // in how many samples total we can collect:
-  if (packed_samples_size_) {
-    const size_t sample_number = atomic_fetch_add_explicit(
-        &packed_sample_number_, 1UL, std::memory_order_relaxed);
-    size_t index = sample_number;
-    if (index < packed_samples_size_) {
-      RecordPackedLatency(sample_number, index, rpc_index, service_type,
-                          instance, state);
-      atomic_fetch_sub_explicit(&remaining_initial_samples_, 1UL,
-                                std::memory_order_release);
-      return;
-    }
-    // Simple Reservoir Sampling:
-    absl::BitGen bitgen;
-    index = absl::Uniform(absl::IntervalClosedClosed, bitgen, 0UL, index);
-    if (index >= packed_samples_size_) {
-      // Histogram per [rpc_index, service] would be ideal here:
-      // Also client rpc state could point to the destination stats instead
-      // of requiring us to look them up below.
-      // dropped_rpc_count_ += 1;
-      // dropped_rpc_total_latency_ += latency
-      // dropped_rpc_request_size_ += state->request.payload().size();
-      // dropped_rpc_response_size_ += state->response.payload().size();
-      return;
-    }
-    // Wait until all initial samples are done:
-    while (atomic_load_explicit(&remaining_initial_samples_,
-                                std::memory_order_acquire)) {
-    }
-    // Reservoir samples are serialized.
-    absl::MutexLock m(&reservoir_sample_lock_);
-    PackedLatencySample& packed_sample = packed_samples_[index];
-    if (packed_sample.sample_number < sample_number) {
-      // Without arena allocation, via sample_arena_ we would need to do:
-      // delete packed_sample.trace_context;
-      RecordPackedLatency(sample_number, index, rpc_index, service_type,
-                          instance, state);
-    }
+  auto& samples = ThreadLatencySampleBuffer()->samples;
+  if (!max_samples_) {
+    samples.emplace_back();
+    PackLatencySample(rpc_index, service_type, instance, state,
+                      &samples.back());
     return;
   }
 
-  // Without packed samples we can support any number of samples, but then we
-  // also have to grab a mutex for each sample, and may have to grow the
-  // underlying array while holding the mutex.
-  absl::MutexLock m(&action_mu);
-  CHECK_LT(service_type, peer_logs_.size());
-  auto& service_log = peer_logs_[service_type];
-  CHECK_LT(instance, service_log.size());
-  auto& peer_log = service_log[instance];
-  auto& rpc_log = (*peer_log.mutable_rpc_logs())[rpc_index];
-  auto* sample = state->success ? rpc_log.add_successful_rpc_samples()
-                                : rpc_log.add_failed_rpc_samples();
-  auto latency = state->end_time - state->start_time;
-  sample->set_start_timestamp_ns(absl::ToUnixNanos(state->start_time));
-  sample->set_latency_ns(absl::ToInt64Nanoseconds(latency));
-  if (state->prior_start_time != absl::InfinitePast()) {
-    sample->set_latency_weight(
-        absl::ToInt64Nanoseconds(state->start_time - state->prior_start_time));
-  }
-  sample->set_request_size(state->request.payload().size());
-  sample->set_response_size(state->response.payload().size());
-  if (state->request.warmup()) {
-    sample->set_warmup(true);
-  }
-  if (!state->request.trace_context().engine_ids().empty()) {
-    *sample->mutable_trace_context() =
-        std::move(state->request.trace_context());
-  }
-  if (!state->response.error_message().empty()) {
-    sample->set_error_index(actionlist_error_dictionary_->GetIndex(
-        state->response.error_message()));
+  // Reservoir sampling, by keeping the samples with the smallest random keys:
+  const uint64_t reservoir_key =
+      absl::Uniform<uint64_t>(ThreadRandomGenerator());
+  if (samples.size() < max_samples_) {
+    samples.emplace_back();
+  } else if (reservoir_key < samples.front().reservoir_key) {
+    // Without arena allocation, via sample_arena_ we would need to
+    // delete the trace_context of the evicted sample here.
+    std::pop_heap(samples.begin(), samples.end(),
+                  PackedLatencySample::HasSmallerReservoirKey);
+  } else {
+    // The dropped sample is already counted in the per-peer histograms.
+    return;
   }
+  PackLatencySample(rpc_index, service_type, instance, state, &samples.back());
+  samples.back().reservoir_key = reservoir_key;
+  std::push_heap(samples.begin(), samples.end(),
+                 PackedLatencySample::HasSmallerReservoirKey);
 }
 
-void DistBenchEngine::ActionListState::RecordPackedLatency(
-    size_t sample_number, size_t index, size_t rpc_index, size_t service_type,
-    size_t instance, ClientRpcState* state) {
-  PackedLatencySample& packed_sample = packed_samples_[index];
+void DistBenchEngine::ActionListState::PackLatencySample(
+    size_t rpc_index, size_t service_type, size_t instance,
+    ClientRpcState* state, PackedLatencySample* packed_sample) {
+  packed_sample->error_index = 0;
   if (!state->response.error_message().empty()) {
-    packed_sample.error_index =
+    packed_sample->error_index =
         actionlist_error_dictionary_->GetIndex(state->response.error_message());
   }
-  packed_sample.sample_number = sample_number;
-  packed_sample.trace_context = nullptr;
-  packed_sample.rpc_index = rpc_index;
-  packed_sample.service_type = service_type;
-  packed_sample.instance = instance;
-  packed_sample.success = state->success;
-  packed_sample.warmup = state->request.warmup();
+  packed_sample->reservoir_key = 0;
+  packed_sample->trace_context = nullptr;
+  packed_sample->rpc_index = rpc_index;
+  packed_sample->service_type = service_type;
+  packed_sample->instance = instance;
+  packed_sample->success = state->success;
+  packed_sample->warmup = state->request.warmup();
   auto latency = state->end_time - state->start_time;
-  packed_sample.start_timestamp_ns = absl::ToUnixNanos(state->start_time);
-  packed_sample.latency_ns = absl::ToInt64Nanoseconds(latency);
-  packed_sample.latency_weight = 0;
-  if (state->prior_start_time != absl::InfinitePast()) {
-    packed_sample.latency_weight =
-        absl::ToInt64Nanoseconds(state->start_time - state->prior_start_time);
-  }
-  packed_sample.request_size = state->request.payload().size();
-  packed_sample.response_size = state->response.payload().size();
+  packed_sample->start_timestamp_ns = absl::ToUnixNanos(state->start_time);
+  packed_sample->latency_ns = absl::ToInt64Nanoseconds(latency);
+  packed_sample->latency_weight = LatencyWeightNs(*state);
+  packed_sample->send_lag_ns =
+      absl::ToInt64Nanoseconds(state->start_time - state->intended_start_time);
+  packed_sample->request_size = state->request.payload().size();
+  packed_sample->response_size = state->response.payload().size();
   if (!state->request.trace_context().engine_ids().empty()) {
-    packed_sample.trace_context =
+    packed_sample->trace_context =
         ::google::protobuf::Arena::CreateMessage<TraceContext>(&sample_arena_);
-    *packed_sample.trace_context = state->request.trace_context();
+    *packed_sample->trace_context = state->request.trace_context();
   }
 }
 
 void DistBenchEngine::InitiateAction(ActionState* action_state) {
   auto& action = *action_state->action;
   if (action.actionlist_index >= 0) {
+    // The nested action list only looks at the warmup flag and the trace
+    // context of the incoming request, so leave its payload behind:
+    const GenericRequest& incoming_request =
+        *action_state->action_list_state->incoming_rpc_state->request;
+    auto request_metadata = std::make_shared<GenericRequest>();
+    if (incoming_request.has_warmup()) {
+      request_metadata->set_warmup(incoming_request.warmup());
+    }
+    if (incoming_request.has_trace_context()) {
+      *request_metadata->mutable_trace_context() =
+          incoming_request.trace_context();
+    }
     std::shared_ptr<const GenericRequest> copied_request =
-        std::make_shared<GenericRequest>(
-            *action_state->action_list_state->incoming_rpc_state->request);
+        std::move(request_metadata);
     int action_list_index = action.actionlist_index;
     action_state->iteration_function =
         [this, action_list_index, copied_request](
             std::shared_ptr<ActionIterationState> iteration_state) {
-          ServerRpcState* copied_server_rpc_state = new ServerRpcState{};
+          ServerRpcState* copied_server_rpc_state =
+              NestedServerRpcStatePool()->New();
           copied_server_rpc_state->request = copied_request.get();
           copied_server_rpc_state->have_dedicated_thread = true;
-          copied_server_rpc_state->SetFreeStateFunction(
-              [=] { delete copied_server_rpc_state; });
+          copied_server_rpc_state->SetFreeStateFunction([=] {
+            NestedServerRpcStatePool()->Delete(copied_server_rpc_state);
+          });
+          // Start the nested list from the thread pool, so that lists which
+          // finish right away do not recurse into the next iteration:
           thread_pool_->AddTask([this, action_list_index, iteration_state,
-                                 copied_request,
-                                 copied_server_rpc_state]() mutable {
-            RunActionList(action_list_index, copied_server_rpc_state,
-                          iteration_state->warmup);
-            FinishIteration(iteration_state);
+                                 copied_request, copied_server_rpc_state]() {
+            StartActionList(action_list_index, copied_server_rpc_state,
+                            iteration_state->warmup,
+                            [this, iteration_state, copied_request]() {
+                              FinishIteration(iteration_state);
+                            });
           });
         };
   } else if (action.rpc_service_index >= 0) {
@@ -1167,12 +1554,41 @@ void DistBenchEngine::InitiateAction(ActionState* action_state) {
   } else if (action.proto.has_activity_config_name()) {
     auto* config = &stored_activity_config_[action.activity_config_index];
     action_state->activity = AllocateActivity(config, clock_);
-    action_state->iteration_function =
-        [this,
-         action_state](std::shared_ptr<ActionIterationState> iteration_state) {
-          action_state->activity->DoActivity();
-          FinishIteration(iteration_state);
-        };
+    if (action.timer_activity) {
+      absl::Duration delay = config->delay_duration;
+      action_state->iteration_function =
+          [this, action_state,
+           delay](std::shared_ptr<ActionIterationState> iteration_state) {
+            action_state->activity->DoActivity();
+            absl::Time start = clock_->Now();
+            pacer_->AddTimer(
+                start + delay,
+                [this, action_state, iteration_state,
+                 start](absl::Time deadline) {
+                  action_state->activity->RecordIterationWallTime(
+                      absl::ToInt64Nanoseconds(clock_->Now() - start));
+                  // Keep the pacer thread free for the other timers:
+                  thread_pool_->AddTask([this, iteration_state]() {
+                    FinishIteration(iteration_state);
+                  });
+                  return absl::InfiniteFuture();
+                });
+          };
+    } else {
+      // Activities burn the CPU of the thread that runs them, so each
+      // iteration runs on activity_thread_pool_, which leaves the thread that
+      // started it free, and lets up to max_parallel_iterations of them use a
+      // core each:
+      action_state->iteration_function =
+          [this, action_state](
+              std::shared_ptr<ActionIterationState> iteration_state) {
+            activity_thread_pool_->AddTask([this, action_state,
+                                            iteration_state]() {
+              action_state->activity->RunIteration();
+              FinishIteration(iteration_state);
+            });
+          };
+    }
   } else {
     LOG(FATAL) << "Supporting only RPCs and Activities as of now.";
   }
@@ -1191,7 +1607,7 @@ void DistBenchEngine::InitiateAction(ActionState* action_state) {
           clock_->Now() +
           absl::Microseconds(action.proto.iterations().max_duration_us());
     }
-    open_loop = action.proto.iterations().has_open_loop_interval_ns();
+    open_loop = IsOpenLoop(action.proto.iterations());
   }
   if (max_iterations < 1) {
     LOG(WARNING) << "an action had a weird number of iterations";
@@ -1200,9 +1616,6 @@ void DistBenchEngine::InitiateAction(ActionState* action_state) {
   action_state->iteration_limit = max_iterations;
   action_state->time_limit = time_limit;
   action_state->next_iteration = 0;
-  if (action_state->action->proto.has_activity_config_name()) {
-    action_state->next_iteration_time = absl::InfinitePast();
-  }
   action_state->iteration_mutex.Unlock();
 
   if (open_loop) {
@@ -1226,7 +1639,21 @@ void DistBenchEngine::InitiateAction(ActionState* action_state) {
     } else {
       action_state->next_iteration_time = clock_->Now();
     }
-    // StartOpenLoopIteration will be called from RunActionList().
+    DistributionSampleGenerator* interval_generator = nullptr;
+    if (action.open_loop_sample_generator_index != -1) {
+      interval_generator =
+          sample_generator_array_[action.open_loop_sample_generator_index]
+              .get();
+    }
+    action_state->open_loop_schedule = std::make_unique<OpenLoopSchedule>(
+        action.proto.iterations(), interval_generator, kOpenLoopIntervalNs,
+        action_state->rand_gen());
+    action_state->send_lag = std::make_unique<AtomicLatencyHistogram>();
+    action_state->pacer_timer_id = pacer_->AddTimer(
+        action_state->next_iteration_time,
+        [this, action_state](absl::Time deadline) {
+          return StartOpenLoopIteration(action_state);
+        });
   } else {
     int64_t parallel_copies = std::min(
         action.proto.iterations().max_parallel_iterations(), max_iterations);
@@ -1234,7 +1661,7 @@ void DistBenchEngine::InitiateAction(ActionState* action_state) {
     action_state->next_iteration = parallel_copies;
     action_state->iteration_mutex.Unlock();
     for (int i = 0; i < parallel_copies; ++i) {
-      auto it_state = std::make_shared<ActionIterationState>();
+      auto it_state = NewActionIterationState();
       it_state->action_state = action_state;
       it_state->iteration_number = i;
       StartIteration(it_state);
@@ -1242,32 +1669,58 @@ void DistBenchEngine::InitiateAction(ActionState* action_state) {
   }
 }
 
-void DistBenchEngine::StartOpenLoopIteration(ActionState* action_state) {
-  absl::Duration period = absl::Nanoseconds(
-      action_state->action->proto.iterations().open_loop_interval_ns());
-  auto it_state = std::make_shared<ActionIterationState>();
+std::shared_ptr<DistBenchEngine::ActionIterationState>
+DistBenchEngine::NewActionIterationState() {
+  static auto* pool = new BlockPool("action_iteration_state",
+                                    SharedBlockSize<ActionIterationState>());
+  return AllocateShared<ActionIterationState>(pool);
+}
+
+// Called by pacer_ at each scheduled time of an open loop action. Returns the
+// next scheduled time, or absl::InfiniteFuture() if no iterations remain.
+absl::Time DistBenchEngine::StartOpenLoopIteration(ActionState* action_state) {
+  absl::Time now = clock_->Now();
+  auto it_state = NewActionIterationState();
   it_state->action_state = action_state;
   action_state->iteration_mutex.Lock();
-  action_state->next_iteration_time += period;
+  if (canceled_.HasBeenNotified()) {
+    // Iterations still in flight report the action as done when they finish,
+    // otherwise it is up to us:
+    action_state->next_iteration_time = absl::InfiniteFuture();
+    bool all_done = !action_state->all_done_called &&
+                    action_state->next_iteration ==
+                        action_state->finished_iterations;
+    action_state->all_done_called |= all_done;
+    action_state->iteration_mutex.Unlock();
+    if (all_done) {
+      action_state->all_done_callback();
+    }
+    return absl::InfiniteFuture();
+  }
+  action_state->send_lag->Record(
+      absl::ToInt64Nanoseconds(now - action_state->next_iteration_time));
+  it_state->intended_start_time = action_state->next_iteration_time;
+  it_state->intended_interval =
+      action_state->open_loop_schedule->NextInterval();
+  action_state->next_iteration_time += it_state->intended_interval;
   if (action_state->next_iteration_time > action_state->time_limit) {
     action_state->next_iteration_time = absl::InfiniteFuture();
   }
   it_state->iteration_number = action_state->next_iteration++;
+  absl::Time next_deadline =
+      action_state->next_iteration == action_state->iteration_limit
+          ? absl::InfiniteFuture()
+          : action_state->next_iteration_time;
   action_state->iteration_mutex.Unlock();
   StartIteration(it_state);
-}
-
-void DistBenchEngine::RunActivity(ActionState* action_state) {
-  auto it_state = std::make_shared<ActionIterationState>();
-  it_state->action_state = action_state;
-  StartIteration(it_state);
+  action_state->open_loop_schedule->RefillIfEmpty();
+  return next_deadline;
 }
 
 void DistBenchEngine::FinishIteration(
     std::shared_ptr<ActionIterationState> iteration_state) {
   ActionState* state = iteration_state->action_state;
-  bool open_loop =
-      state->action->proto.iterations().has_open_loop_interval_ns();
+  bool open_loop = IsOpenLoop(state->action->proto.iterations());
   bool done = canceled_.HasBeenNotified();
   state->iteration_mutex.Lock();
   ++state->finished_iterations;
@@ -1291,8 +1744,12 @@ void DistBenchEngine::FinishIteration(
     iteration_state->iteration_number = state->next_iteration++;
   }
   int pending_iterations = state->next_iteration - state->finished_iterations;
+  // A canceled open loop action may also be reported done by
+  // StartOpenLoopIteration:
+  const bool all_done = done && !pending_iterations && !state->all_done_called;
+  state->all_done_called |= all_done;
   state->iteration_mutex.Unlock();
-  if (done && !pending_iterations) {
+  if (all_done) {
 #ifdef NDEBUG
     state->all_done_callback();
 #else
@@ -1302,8 +1759,7 @@ void DistBenchEngine::FinishIteration(
     };
     adcb();
 #endif
-  } else if (!state->action->proto.has_activity_config_name() &&
-             start_another_iteration) {
+  } else if (start_another_iteration) {
     StartIteration(iteration_state);
   }
 }
@@ -1323,7 +1779,8 @@ void DistBenchEngine::RunRpcActionIteration(
     std::shared_ptr<ActionIterationState> iteration_state) {
   ActionState* action_state = iteration_state->action_state;
   // Pick the subset of the target service instances to fanout to:
-  std::vector<int> current_targets = PickRpcFanoutTargets(action_state);
+  absl::Span<const int> current_targets =
+      PickRpcFanoutTargets(iteration_state.get());
   iteration_state->rpc_states.resize(current_targets.size());
   iteration_state->remaining_rpcs = current_targets.size();
 
@@ -1350,16 +1807,16 @@ void DistBenchEngine::RunRpcActionIteration(
   common_request.set_rpc_index(rpc_index);
   common_request.set_warmup(iteration_state->warmup);
 
+  // The payload itself is filled in per target from payload_pool_, so that
+  // it is not copied once into common_request and then again for each target:
+  int64_t request_payload_size = -1;
   if (rpc_def.sample_generator_index == -1) {
-    common_request.set_payload(std::string(rpc_def.request_payload_size, 'D'));
-
+    request_payload_size = rpc_def.request_payload_size;
   } else {
     auto sample = sample_generator_array_[rpc_def.sample_generator_index]
-                      ->GetRandomSample(action_state->rand_gen);
+                      ->GetRandomSample(&action_state->rand_gen);
 
-    if (sample[kRequestPayloadSize] != -1) {
-      common_request.set_payload(std::string(sample[kRequestPayloadSize], 'D'));
-    }
+    request_payload_size = sample[kRequestPayloadSize];
 
     if (sample[kResponsePayloadSize] != -1) {
       common_request.set_response_payload_size(sample[kResponsePayloadSize]);
@@ -1375,7 +1832,14 @@ void DistBenchEngine::RunRpcActionIteration(
     {
       absl::MutexLock m(&peers_[rpc_service_index][peer_instance].mutex);
       rpc_state = &iteration_state->rpc_states[i];
+      // Assigning over the recycled request and response (instead of
+      // replacing them) keeps the capacity of their payload strings:
       rpc_state->request = common_request;
+      if (request_payload_size != -1) {
+        payload_pool_.FillPayload(request_payload_size,
+                                  rpc_state->request.mutable_payload());
+      }
+      rpc_state->response.Clear();
       if (!common_request.trace_context().engine_ids().empty()) {
         rpc_state->request.mutable_trace_context()->add_engine_ids(
             peers_[rpc_service_index][peer_instance].trace_id);
@@ -1386,6 +1850,11 @@ void DistBenchEngine::RunRpcActionIteration(
     }  // End of MutexLock m
     rpc_state->prior_start_time = rpc_state->start_time;
     rpc_state->start_time = clock_->Now();
+    rpc_state->intended_start_time =
+        iteration_state->intended_start_time == absl::InfinitePast()
+            ? rpc_state->start_time
+            : iteration_state->intended_start_time;
+    rpc_state->intended_interval = iteration_state->intended_interval;
     pd_->InitiateRpc(
         servers[peer_instance].pd_id, rpc_state,
         [this, rpc_state, iteration_state, peer_instance]() mutable {
@@ -1399,6 +1868,8 @@ void DistBenchEngine::RunRpcActionIteration(
             CancelTraffic(absl::UnknownError(absl::StrCat(
                 "Peer reported ", rpc_state->response.error_message())));
           }
+          GetPeerRpcStatistics(action_state->rpc_index, peer_instance)
+              ->Record(*rpc_state);
           action_state->action_list_state->RecordLatency(
               action_state->rpc_index, action_state->rpc_service_index,
               peer_instance, rpc_state);
@@ -1413,80 +1884,39 @@ void DistBenchEngine::RunRpcActionIteration(
   }
 }
 
-// Return a vector of service instances, which have to be translated to
-// protocol_drivers endpoint ids by the caller.
-std::vector<int> DistBenchEngine::PickRpcFanoutTargets(
-    ActionState* action_state) {
+// Return the service instances, which have to be translated to
+// protocol_drivers endpoint ids by the caller. The result stays valid for the
+// lifetime of iteration_state.
+absl::Span<const int> DistBenchEngine::PickRpcFanoutTargets(
+    ActionIterationState* iteration_state) {
+  const ActionState* action_state = iteration_state->action_state;
   const int rpc_index = action_state->rpc_index;
   const auto& rpc_def = client_rpc_table_[rpc_index].rpc_definition;
-  std::vector<int> targets;
-  int num_servers = peers_[action_state->rpc_service_index].size();
+  const FanoutPlan& plan = rpc_def.fanout_plan;
+  auto& targets = iteration_state->fanout_targets;
+  targets.clear();
 
   switch (rpc_def.fanout_filter) {
     default:
       // Default case: return the first instance of the service
-      targets.reserve(1);
       targets.push_back(0);
       break;
 
     case kRandomSingle:
-      targets.reserve(1);
-      targets.push_back(random() % num_servers);
+      targets.push_back(
+          absl::Uniform(ThreadRandomGenerator(), 0, plan.num_servers));
       break;
 
     case kRoundRobin:
-      targets.reserve(1);
       targets.push_back(client_rpc_table_[rpc_index].rpc_tracing_counter %
-                        num_servers);
+                        plan.num_servers);
       break;
 
     case kAll:
-      targets.reserve(num_servers);
-      for (int i = 0; i < num_servers; ++i) {
-        int target = i;
-        if (action_state->rpc_service_index != service_index_ ||
-            target != service_instance_) {
-          CHECK_NE(target, -1);
-          targets.push_back(target);
-        }
-      }
-      break;
+      return plan.all_targets;
 
     case kStochastic:
-      std::map<int, std::vector<int>> partial_rand_vects =
-          action_state->partially_randomized_vectors;
-
-      int nb_targets = 0;
-      float random_val = absl::Uniform(random_generator, 0, 1.0);
-      float cur_val = 0.0;
-      for (const auto& d : rpc_def.stochastic_dist) {
-        cur_val += d.probability;
-        if (random_val <= cur_val) {
-          nb_targets = d.nb_targets;
-          break;
-        }
-      }
-      if (nb_targets > num_servers) {
-        nb_targets = num_servers;
-      }
-
-      // Generate a vector to pick random targets from (only done once)
-      partial_rand_vects.try_emplace(num_servers, std::vector<int>());
-      std::vector<int>& from_vector = partial_rand_vects[num_servers];
-      if (from_vector.empty()) {
-        for (int i = 0; i < num_servers; i++) {
-          from_vector.push_back(i);
-        }
-      }
-
-      // Randomize and pick up to nb_targets
-      for (int i = 0; i < nb_targets; i++) {
-        int rnd_pos = i + (random() % (num_servers - i));
-        std::swap(from_vector[i], from_vector[rnd_pos]);
-        int target = from_vector[i];
-        CHECK_NE(target, -1);
-        targets.push_back(target);
-      }
+      PickStochasticFanoutTargets(plan, ThreadRandomGenerator(), &targets);
       break;
   }
 
@@ -1527,6 +1957,9 @@ absl::StatusOr<DistributionConfig> GetCanonicalConfig(
     else if (field_name == "response_payload_size")
       proto_to_canonical[kResponsePayloadSize] = i;
 
+    else if (field_name == "open_loop_interval_ns")
+      proto_to_canonical[kOpenLoopIntervalNs] = i;
+
     else
       return absl::InvalidArgumentError(
           absl::StrCat("Unknown Field Name: '", field_name, "'."));
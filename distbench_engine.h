@@ -20,8 +20,15 @@
 
 #include "absl/container/flat_hash_map.h"
 #include "absl/random/random.h"
+#include "absl/types/span.h"
 #include "activity.h"
 #include "distbench.grpc.pb.h"
+#include "distbench_fanout_plan.h"
+#include "distbench_latency_histogram.h"
+#include "distbench_object_pool.h"
+#include "distbench_open_loop_schedule.h"
+#include "distbench_pacer.h"
+#include "distbench_payload_pool.h"
 #include "distbench_threadpool.h"
 #include "distbench_utils.h"
 #include "joint_distribution_sample_generator.h"
@@ -66,11 +73,6 @@ class DistBenchEngine : public ConnectionSetup::Service {
                                ConnectResponse* response) override;
 
  private:
-  struct StochasticDist {
-    float probability;
-    int nb_targets;
-  };
-
   enum FanoutFilter {
     kAll = 0,
     kRandomSingle = 1,
@@ -85,6 +87,7 @@ class DistBenchEngine : public ConnectionSetup::Service {
     // Used to store decoded stochastic fanout
     FanoutFilter fanout_filter;
     std::vector<StochasticDist> stochastic_dist;
+    FanoutPlan fanout_plan;
 
     // Decoded
     int request_payload_size;
@@ -117,12 +120,35 @@ class DistBenchEngine : public ConnectionSetup::Service {
     RpcDefinition rpc_definition;
   };
 
+  // Updated on every completed RPC, so that the statistics stay exact even
+  // when the latency samples are downsampled:
+  struct PeerRpcStatistics {
+    void Record(const ClientRpcState& state);
+    void CopyTo(RpcStatistics* statistics) const;
+
+    std::atomic<int64_t> successful_rpcs = 0;
+    std::atomic<int64_t> warmup_rpcs = 0;
+    std::atomic<int64_t> failed_rpcs = 0;
+    std::atomic<int64_t> request_bytes = 0;
+    std::atomic<int64_t> response_bytes = 0;
+    std::atomic<int64_t> first_start_timestamp_ns =
+        std::numeric_limits<int64_t>::max();
+    std::atomic<int64_t> last_end_timestamp_ns =
+        std::numeric_limits<int64_t>::min();
+    AtomicLatencyHistogram latency_histogram;
+    AtomicLatencyHistogram weighted_latency_histogram;
+    AtomicLatencyHistogram response_time_histogram;
+    std::atomic<bool> has_send_lag = false;
+  };
+
   struct SimulatedClientRpc {
     int service_index;
     std::vector<GenericRequest> request_table;
     RpcDefinition rpc_definition;
     std::atomic<int64_t> rpc_tracing_counter = 0;
     std::vector<int> pending_requests_per_peer;
+    // Indexed by server instance, and allocated on first use:
+    std::unique_ptr<std::atomic<PeerRpcStatistics*>[]> peer_statistics;
   };
 
   struct ActionTableEntry {
@@ -133,12 +159,20 @@ class DistBenchEngine : public ConnectionSetup::Service {
     int rpc_index = -1;
     int actionlist_index = -1;
     int activity_config_index = -1;
+    // Set for Delay activities, which wait on pacer_ timers rather than on a
+    // thread of activity_thread_pool_:
+    bool timer_activity = false;
+    int open_loop_sample_generator_index = -1;
     std::vector<int> dependent_action_indices;
+    // The actions of the same list that depend on this one:
+    std::vector<int> successor_action_indices;
   };
 
   struct ActionListTableEntry {
     ActionList proto;
     std::vector<ActionTableEntry> list_actions;
+    // The actions without dependencies, which are started with the list:
+    std::vector<int> initial_action_indices;
     bool has_rpcs = false;
   };
 
@@ -149,8 +183,13 @@ class DistBenchEngine : public ConnectionSetup::Service {
     struct ActionState* action_state = nullptr;
     int iteration_number = 0;
     bool warmup = false;
+    // Only set for open loop iterations, to the time they were scheduled for:
+    absl::Time intended_start_time = absl::InfinitePast();
+    absl::Duration intended_interval = absl::ZeroDuration();
     std::vector<ClientRpcState> rpc_states;
     std::atomic<int> remaining_rpcs = 0;
+    // Holds the picked targets, except for kAll fanouts:
+    FanoutTargets fanout_targets;
   };
 
   struct ActionState {
@@ -161,6 +200,7 @@ class DistBenchEngine : public ConnectionSetup::Service {
     absl::Mutex iteration_mutex;
     int next_iteration ABSL_GUARDED_BY(iteration_mutex);
     int finished_iterations ABSL_GUARDED_BY(iteration_mutex);
+    bool all_done_called ABSL_GUARDED_BY(iteration_mutex) = false;
     absl::Time next_iteration_time = absl::InfiniteFuture();
 
     int64_t iteration_limit = std::numeric_limits<int64_t>::max();
@@ -174,13 +214,24 @@ class DistBenchEngine : public ConnectionSetup::Service {
         iteration_function;
     std::function<void(void)> all_done_callback;
 
-    std::map<int, std::vector<int>> partially_randomized_vectors;
-
     std::unique_ptr<Activity> activity;
 
-    // The 'rand_gen' must be used only from RunActionList's thread
-    // to avoid race conditions.
-    std::default_random_engine* rand_gen = nullptr;
+    // Open loop actions are started by pacer_, which records how late it
+    // started each iteration into send_lag:
+    int64_t pacer_timer_id = -1;
+    std::unique_ptr<AtomicLatencyHistogram> send_lag;
+    std::unique_ptr<OpenLoopSchedule> open_loop_schedule;
+
+    // Seeded when the action starts, and shared by its iterations:
+    std::default_random_engine rand_gen;
+  };
+
+  // The logs of all the activities that share an ActivityConfig:
+  struct CumulativeActivityLog {
+    std::map<std::string, int64_t> metrics;
+    LatencyHistogram iteration_wall_time;
+    LatencyHistogram iteration_cpu_time;
+    std::map<std::string, LatencyHistogram> operation_latencies;
   };
 
   struct PackedLatencySample {
@@ -189,6 +240,11 @@ class DistBenchEngine : public ConnectionSetup::Service {
              (other.start_timestamp_ns + other.latency_ns);
     }
 
+    static bool HasSmallerReservoirKey(const PackedLatencySample& a,
+                                       const PackedLatencySample& b) {
+      return a.reservoir_key < b.reservoir_key;
+    }
+
     // Not using any in-class initializers so that these are trivially
     // destructible:
     size_t rpc_index;
@@ -201,7 +257,8 @@ class DistBenchEngine : public ConnectionSetup::Service {
     int64_t start_timestamp_ns;
     int64_t latency_ns;
     int64_t latency_weight;
-    size_t sample_number;
+    int64_t send_lag_ns;
+    uint64_t reservoir_key;
     TraceContext* trace_context;
     int error_index;
   };
@@ -209,35 +266,53 @@ class DistBenchEngine : public ConnectionSetup::Service {
   static_assert(std::is_trivially_destructible<PackedLatencySample>::value);
   static_assert(std::is_trivially_constructible<PackedLatencySample>::value);
 
+  // Completing RPCs record their latency into a buffer owned by the
+  // completing thread, so that recording takes no lock, and only the first
+  // sample of each thread touches shared state, to register its buffer.
+  // When max_rpc_samples is set each buffer is a max-heap holding the samples
+  // with the smallest random reservoir_key, so merging the buffers into one
+  // uniform sample just keeps the overall smallest keys.
+  struct alignas(64) LatencySampleBuffer {
+    std::thread::id owner;
+    LatencySampleBuffer* next;
+    std::vector<PackedLatencySample> samples;
+  };
+
+  // Action lists are driven by the completion of their actions: finishing an
+  // action decrements the remaining_dependencies of its successors, and starts
+  // the ones that reach zero. No thread waits for the list to finish.
   struct ActionListState {
-    void FinishAction(int action_index);
-    void WaitForAllPendingActions();
-    void CancelActivities();
+    ~ActionListState();
     void UpdateActivitiesLog(
-        std::map<std::string, std::map<std::string, int64_t>>*
-            cumulative_activity_logs);
-    bool DidSomeActionsFinish();
-    void HandleFinishedActions();
+        std::map<std::string, CumulativeActivityLog>* cumulative_activity_logs);
     void RecordLatency(size_t rpc_index, size_t service_type, size_t instance,
                        ClientRpcState* state);
-    void RecordPackedLatency(size_t sample_number, size_t index,
-                             size_t rpc_index, size_t service_type,
-                             size_t instance, ClientRpcState* state);
+    void PackLatencySample(size_t rpc_index, size_t service_type,
+                           size_t instance, ClientRpcState* state,
+                           PackedLatencySample* packed_sample);
     void UnpackLatencySamples();
+    LatencySampleBuffer* ThreadLatencySampleBuffer();
 
     ServerRpcState* incoming_rpc_state = nullptr;
     std::unique_ptr<ActionState[]> state_table;
     const ActionListTableEntry* action_list;
     absl::Mutex action_mu;
-    std::vector<int> finished_action_indices;
+    std::unique_ptr<int[]> remaining_dependencies ABSL_GUARDED_BY(action_mu);
+    bool sent_response_early ABSL_GUARDED_BY(action_mu) = false;
+    unsigned int seed;
+    std::function<void()> done_callback;
 
     std::vector<std::vector<PeerPerformanceLog>> peer_logs_
         ABSL_GUARDED_BY(action_mu);
-    std::unique_ptr<PackedLatencySample[]> packed_samples_;
-    size_t packed_samples_size_ = 0;
-    std::atomic<size_t> packed_sample_number_ = 0;
-    std::atomic<size_t> remaining_initial_samples_;
-    absl::Mutex reservoir_sample_lock_;
+    // A lock-free stack of the buffers of the threads that recorded samples.
+    // It only grows until UnpackLatencySamples drains it, once all the
+    // actions are finished:
+    std::atomic<LatencySampleBuffer*> sample_buffers_ = nullptr;
+    // Identifies this list in the buffer caches of the threads, since a later
+    // list may reuse its address:
+    uint64_t sample_buffers_id_ = 0;
+    // The number of samples to keep, or 0 to keep all of them:
+    size_t max_samples_ = 0;
 
     // This area is used to allocate TraceContext objects for packed samples:
     ::google::protobuf::Arena sample_arena_;
@@ -245,6 +320,9 @@ class DistBenchEngine : public ConnectionSetup::Service {
     // If true this entire action list was triggered by a warmup RPC, so all
     // actions it initiates will propgate the warmup flag:
     bool warmup_;
+    // Started but unfinished actions, plus one while StartActionList is still
+    // starting the initial actions. The list is finished when this drops to
+    // zero:
     std::atomic<int> pending_action_count_ = 0;
     std::shared_ptr<ThreadSafeDictionary> actionlist_error_dictionary_;
   };
@@ -252,22 +330,38 @@ class DistBenchEngine : public ConnectionSetup::Service {
   absl::Status InitializeTables();
   absl::Status InitializePayloadsMap();
   absl::Status InitializeRpcFanoutFilter(RpcDefinition& rpc_def);
+  void InitializeRpcFanoutPlan(RpcDefinition& rpc_def);
   absl::Status InitializeRpcDefinitionsMap();
   absl::Status InitializeActivityConfigMap();
-
-  void RunActionList(int list_index, ServerRpcState* incoming_rpc_state,
-                     bool force_warmup = false);
+  absl::Status PrepareActivityConfigs();
+
+  // Starts the actions of the list that have no dependencies, and returns
+  // without waiting for them. done_callback is called once all the actions
+  // are finished, and the response to incoming_rpc_state has been sent:
+  void StartActionList(int list_index, ServerRpcState* incoming_rpc_state,
+                       bool force_warmup, std::function<void()> done_callback);
+  void StartAction(ActionListState* s, int action_index);
+  void FinishAction(ActionListState* s, int action_index);
+  void ReleaseActionList(ActionListState* s);
+  void FinishActionList(ActionListState* s);
   void InitiateAction(ActionState* action_state);
-  void StartOpenLoopIteration(ActionState* action_state);
-  void RunActivity(ActionState* action_state);
+  std::shared_ptr<ActionIterationState> NewActionIterationState();
+  absl::Time StartOpenLoopIteration(ActionState* action_state);
   void StartIteration(std::shared_ptr<ActionIterationState> iteration_state);
   void FinishIteration(std::shared_ptr<ActionIterationState> iteration_state);
 
   void RunRpcActionIteration(
       std::shared_ptr<ActionIterationState> iteration_state);
-  std::vector<int> PickRpcFanoutTargets(ActionState* action_state);
+  absl::Span<const int> PickRpcFanoutTargets(
+      ActionIterationState* iteration_state);
 
+  PeerRpcStatistics* GetPeerRpcStatistics(int rpc_index, int instance);
+  void AddRpcStatistics(ServicePerformanceLog* sp_log);
   void AddActivityLogs(ServicePerformanceLog* sp_log);
+  void AddEngineStats(ServicePerformanceLog* sp_log);
+  void AddOpenLoopSendLag(ServicePerformanceLog* sp_log);
+  void AddThreadPlacement(ServicePerformanceLog* sp_log);
+  void AddThreadpoolLogs(ServicePerformanceLog* sp_log);
 
   std::atomic<int64_t> consume_cpu_iteration_cnt_ = 0;
 
@@ -284,16 +378,22 @@ class DistBenchEngine : public ConnectionSetup::Service {
   ServiceEndpointMap service_map_;
   std::string service_name_;
   ServiceSpec service_spec_;
+  ThreadPlacement placement_;
+  // The placement observed from a thread of thread_pool_:
+  std::string thread_cpu_list_;
+  int thread_numa_node_ = -1;
   std::set<std::string> dependent_services_;
   int service_index_;
   int service_instance_;
   std::unique_ptr<grpc::Server> server_;
   std::unique_ptr<ProtocolDriver> pd_;
-  std::thread engine_main_thread_;
+  // Set while the top level action list of the service is running:
+  std::unique_ptr<absl::Notification> main_action_list_done_;
   std::string engine_name_;
 
   // Payloads definitions
   std::map<std::string, PayloadSpec> payload_map_;
+  PayloadPool payload_pool_;
   std::map<std::string, RpcDefinition> rpc_map_;
   std::map<std::string, int> activity_config_indices_map_;
   std::vector<ParsedActivityConfig> stored_activity_config_;
@@ -302,15 +402,15 @@ class DistBenchEngine : public ConnectionSetup::Service {
   std::vector<std::vector<PeerMetadata>> peers_;
   int trace_id_ = -1;
   SimpleClock* clock_ = nullptr;
-
-  // Random
-  absl::BitGen random_generator;
+  std::unique_ptr<Pacer> pacer_;
+  absl::Mutex open_loop_send_lag_mu_;
+  std::map<std::string, LatencyHistogram> open_loop_send_lag_
+      ABSL_GUARDED_BY(open_loop_send_lag_mu_);
 
   std::atomic<int64_t> pending_rpcs_ = 0;
-  std::atomic<int64_t> detached_actionlist_threads_ = 0;
+  std::atomic<int64_t> running_handler_action_lists_ = 0;
   absl::Mutex cumulative_activity_log_mu_;
-  std::map<std::string, std::map<std::string, int64_t>>
-      cumulative_activity_logs_;
+  std::map<std::string, CumulativeActivityLog> cumulative_activity_logs_;
 
   std::map<std::string, int> sample_generator_indices_map_;
   std::vector<std::unique_ptr<DistributionSampleGenerator>>
@@ -332,6 +432,11 @@ class DistBenchEngine : public ConnectionSetup::Service {
   absl::Time cancelation_time_;
 
   std::unique_ptr<AbstractThreadpool> thread_pool_;
+  // Runs the iterations of activities, other than Delay. Points either to
+  // thread_pool_ or to dedicated_activity_thread_pool_, which is declared
+  // after thread_pool_ so that it is drained first:
+  AbstractThreadpool* activity_thread_pool_ = nullptr;
+  std::unique_ptr<AbstractThreadpool> dedicated_activity_thread_pool_;
   std::shared_ptr<ThreadSafeDictionary> actionlist_error_dictionary_;
 };
 
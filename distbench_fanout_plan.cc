@@ -0,0 +1,101 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "distbench_fanout_plan.h"
+
+#include <algorithm>
+#include <numeric>
+
+#include "absl/container/flat_hash_map.h"
+
+namespace distbench {
+
+void InitializeStochasticFanout(absl::Span<const StochasticDist> entries,
+                                FanoutPlan* plan) {
+  // Entries past a cumulative probability of 1.0 are never picked, and any
+  // probability mass left below 1.0 picks 0 targets:
+  std::vector<double> probabilities;
+  double cumulative_probability = 0.0;
+  plan->nb_targets.clear();
+  for (const auto& d : entries) {
+    double next_cumulative_probability =
+        std::min(1.0, cumulative_probability + d.probability);
+    probabilities.push_back(next_cumulative_probability -
+                            cumulative_probability);
+    plan->nb_targets.push_back(std::min(d.nb_targets, plan->num_servers));
+    cumulative_probability = next_cumulative_probability;
+  }
+  if (cumulative_probability < 1.0) {
+    probabilities.push_back(1.0 - cumulative_probability);
+    plan->nb_targets.push_back(0);
+  }
+
+  // Vose's construction of the alias table:
+  const size_t n = probabilities.size();
+  plan->alias_threshold.assign(n, 1.0);
+  plan->alias_index.resize(n);
+  std::vector<size_t> small;
+  std::vector<size_t> large;
+  for (size_t i = 0; i < n; ++i) {
+    probabilities[i] *= n;
+    plan->alias_index[i] = i;
+    (probabilities[i] < 1.0 ? small : large).push_back(i);
+  }
+  while (!small.empty() && !large.empty()) {
+    size_t s = small.back();
+    small.pop_back();
+    size_t l = large.back();
+    plan->alias_threshold[s] = probabilities[s];
+    plan->alias_index[s] = l;
+    probabilities[l] -= 1.0 - probabilities[s];
+    if (probabilities[l] < 1.0) {
+      large.pop_back();
+      small.push_back(l);
+    }
+  }
+}
+
+int PickStochasticFanoutSize(const FanoutPlan& plan,
+                             absl::InsecureBitGen& generator) {
+  size_t column =
+      absl::Uniform<size_t>(generator, 0, plan.alias_threshold.size());
+  if (absl::Uniform(generator, 0.0f, 1.0f) >= plan.alias_threshold[column]) {
+    column = plan.alias_index[column];
+  }
+  return plan.nb_targets[column];
+}
+
+void PickStochasticFanoutTargets(const FanoutPlan& plan,
+                                 absl::InsecureBitGen& generator,
+                                 FanoutTargets* targets) {
+  int nb_targets = PickStochasticFanoutSize(plan, generator);
+
+  // Partial Fisher-Yates shuffle. Any permutation is a fine starting point,
+  // so the shuffled vector is kept for the next pick. Each thread keeps one
+  // per number of servers, since RPCs to services of different sizes
+  // alternate:
+  thread_local absl::flat_hash_map<int, std::vector<int>> from_vectors;
+  std::vector<int>& from_vector = from_vectors[plan.num_servers];
+  if (from_vector.empty()) {
+    from_vector.resize(plan.num_servers);
+    std::iota(from_vector.begin(), from_vector.end(), 0);
+  }
+  for (int i = 0; i < nb_targets; i++) {
+    int rnd_pos = absl::Uniform(generator, i, plan.num_servers);
+    std::swap(from_vector[i], from_vector[rnd_pos]);
+    targets->push_back(from_vector[i]);
+  }
+}
+
+}  // namespace distbench
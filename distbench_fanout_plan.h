@@ -0,0 +1,68 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef DISTBENCH_DISTBENCH_FANOUT_PLAN_H_
+#define DISTBENCH_DISTBENCH_FANOUT_PLAN_H_
+
+#include <vector>
+
+#include "absl/container/inlined_vector.h"
+#include "absl/random/random.h"
+#include "absl/types/span.h"
+
+namespace distbench {
+
+// An entry of a stochastic fanout filter, e.g. 0.7:1 in
+// "stochastic{0.7:1,0.3:4}":
+struct StochasticDist {
+  float probability;
+  int nb_targets;
+};
+
+using FanoutTargets = absl::InlinedVector<int, 16>;
+
+// Precomputed at initialization time, so that picking the targets of an
+// RPC is O(number of targets) and does not allocate:
+struct FanoutPlan {
+  int num_servers = 0;
+
+  // The targets of kAll, i.e. every server instance except this one:
+  std::vector<int> all_targets;
+
+  // Alias table (Walker's method) for sampling the stochastic_dist entries,
+  // with a trailing 0 targets entry for any probability mass left over:
+  std::vector<float> alias_threshold;
+  std::vector<int> alias_index;
+  std::vector<int> nb_targets;
+};
+
+// Builds the alias table of plan, whose num_servers must already be set,
+// from the entries of a stochastic fanout filter. Entries past a cumulative
+// probability of 1.0 are never picked, and no entry picks more targets than
+// there are servers.
+void InitializeStochasticFanout(absl::Span<const StochasticDist> entries,
+                                FanoutPlan* plan);
+
+// Returns the number of targets of an RPC, drawn from the alias table:
+int PickStochasticFanoutSize(const FanoutPlan& plan,
+                             absl::InsecureBitGen& generator);
+
+// Appends that many distinct random server instances to targets:
+void PickStochasticFanoutTargets(const FanoutPlan& plan,
+                                 absl::InsecureBitGen& generator,
+                                 FanoutTargets* targets);
+
+}  // namespace distbench
+
+#endif  // DISTBENCH_DISTBENCH_FANOUT_PLAN_H_
@@ -0,0 +1,113 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "distbench_fanout_plan.h"
+
+#include <map>
+#include <set>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "gtest_utils.h"
+
+namespace distbench {
+
+namespace {
+
+constexpr int kPicks = 100'000;
+
+FanoutPlan MakePlan(int num_servers, std::vector<StochasticDist> entries) {
+  FanoutPlan plan;
+  plan.num_servers = num_servers;
+  InitializeStochasticFanout(entries, &plan);
+  return plan;
+}
+
+// Returns the fraction of picks of each number of targets:
+std::map<int, double> PickSizes(const FanoutPlan& plan) {
+  absl::InsecureBitGen generator;
+  std::map<int, double> fractions;
+  for (int i = 0; i < kPicks; ++i) {
+    fractions[PickStochasticFanoutSize(plan, generator)] += 1.0 / kPicks;
+  }
+  return fractions;
+}
+
+}  // anonymous namespace
+
+TEST(FanoutPlanTest, MatchesWeights) {
+  auto fractions = PickSizes(MakePlan(10, {{0.7, 1}, {0.2, 4}, {0.1, 10}}));
+  ASSERT_EQ(fractions.size(), 3);
+  // The standard deviation of each fraction is at most 0.0016:
+  EXPECT_NEAR(fractions[1], 0.7, 0.01);
+  EXPECT_NEAR(fractions[4], 0.2, 0.01);
+  EXPECT_NEAR(fractions[10], 0.1, 0.01);
+}
+
+TEST(FanoutPlanTest, ZeroWeightIsNeverPicked) {
+  auto fractions = PickSizes(MakePlan(10, {{0.0, 3}, {0.5, 1}, {0.5, 2}}));
+  EXPECT_EQ(fractions.count(3), 0);
+  EXPECT_NEAR(fractions[1], 0.5, 0.01);
+  EXPECT_NEAR(fractions[2], 0.5, 0.01);
+}
+
+TEST(FanoutPlanTest, MissingWeightPicksNoTargets) {
+  auto fractions = PickSizes(MakePlan(10, {{0.25, 2}}));
+  EXPECT_NEAR(fractions[0], 0.75, 0.01);
+  EXPECT_NEAR(fractions[2], 0.25, 0.01);
+}
+
+TEST(FanoutPlanTest, ExcessWeightIsIgnored) {
+  auto fractions = PickSizes(MakePlan(10, {{0.8, 1}, {0.8, 2}, {0.5, 3}}));
+  EXPECT_EQ(fractions.count(3), 0);
+  EXPECT_NEAR(fractions[1], 0.8, 0.01);
+  EXPECT_NEAR(fractions[2], 0.2, 0.01);
+}
+
+TEST(FanoutPlanTest, SingleServer) {
+  FanoutPlan plan = MakePlan(1, {{0.5, 1}, {0.5, 4}});
+  absl::InsecureBitGen generator;
+  for (int i = 0; i < 1000; ++i) {
+    FanoutTargets targets;
+    PickStochasticFanoutTargets(plan, generator, &targets);
+    ASSERT_EQ(targets.size(), 1);
+    ASSERT_EQ(targets[0], 0);
+  }
+}
+
+TEST(FanoutPlanTest, TargetsAreDistinctAndUniform) {
+  // Alternating between services of different sizes, on the same thread:
+  FanoutPlan small_plan = MakePlan(3, {{1.0, 2}});
+  FanoutPlan large_plan = MakePlan(20, {{1.0, 5}});
+  absl::InsecureBitGen generator;
+  std::vector<int> counts(20);
+  for (int i = 0; i < kPicks / 5; ++i) {
+    for (const FanoutPlan* plan : {&small_plan, &large_plan}) {
+      FanoutTargets targets;
+      PickStochasticFanoutTargets(*plan, generator, &targets);
+      std::set<int> distinct(targets.begin(), targets.end());
+      ASSERT_EQ(distinct.size(), targets.size());
+      ASSERT_GE(*distinct.begin(), 0);
+      ASSERT_LT(*distinct.rbegin(), plan->num_servers);
+      if (plan == &large_plan) {
+        for (int target : targets) ++counts[target];
+      }
+    }
+  }
+  for (int count : counts) {
+    EXPECT_NEAR(count, kPicks / 20, kPicks / 200);
+  }
+}
+
+}  // namespace distbench
@@ -0,0 +1,149 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "distbench_latency_histogram.h"
+
+#include <algorithm>
+#include <limits>
+#include <map>
+
+#include "absl/numeric/bits.h"
+#include "distbench.pb.h"
+#include "glog/logging.h"
+
+namespace distbench {
+
+namespace {
+
+const int kNumBuckets =
+    LatencyHistogramBucketIndex(kLatencyHistogramMaxLatencyNs) + 1;
+
+}  // anonymous namespace
+
+int LatencyHistogramBucketIndex(int64_t latency_ns, int sub_bucket_bits) {
+  latency_ns =
+      std::clamp<int64_t>(latency_ns, 0, kLatencyHistogramMaxLatencyNs);
+  const int64_t linear_buckets = int64_t{1} << sub_bucket_bits;
+  if (latency_ns < linear_buckets) {
+    return latency_ns;
+  }
+  const int64_t half_buckets = linear_buckets / 2;
+  const int shift =
+      absl::bit_width(static_cast<uint64_t>(latency_ns)) - sub_bucket_bits;
+  return linear_buckets + (shift - 1) * half_buckets +
+         ((latency_ns >> shift) - half_buckets);
+}
+
+int64_t LatencyHistogramBucketMaxLatency(int index, int sub_bucket_bits) {
+  const int64_t linear_buckets = int64_t{1} << sub_bucket_bits;
+  if (index < linear_buckets) {
+    return index;
+  }
+  const int64_t half_buckets = linear_buckets / 2;
+  const int shift = (index - linear_buckets) / half_buckets + 1;
+  const int64_t sub_bucket = (index - linear_buckets) % half_buckets;
+  return ((half_buckets + sub_bucket + 1) << shift) - 1;
+}
+
+AtomicLatencyHistogram::AtomicLatencyHistogram()
+    : buckets_(new std::atomic<int64_t>[kNumBuckets]),
+      min_latency_ns_(std::numeric_limits<int64_t>::max()),
+      max_latency_ns_(std::numeric_limits<int64_t>::min()) {
+  for (int i = 0; i < kNumBuckets; ++i) {
+    buckets_[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+void AtomicLatencyHistogram::Record(int64_t latency_ns, int64_t weight) {
+  buckets_[LatencyHistogramBucketIndex(latency_ns)].fetch_add(
+      weight, std::memory_order_relaxed);
+  int64_t min = min_latency_ns_.load(std::memory_order_relaxed);
+  while (latency_ns < min &&
+         !min_latency_ns_.compare_exchange_weak(min, latency_ns,
+                                                std::memory_order_relaxed)) {
+  }
+  int64_t max = max_latency_ns_.load(std::memory_order_relaxed);
+  while (latency_ns > max &&
+         !max_latency_ns_.compare_exchange_weak(max, latency_ns,
+                                                std::memory_order_relaxed)) {
+  }
+}
+
+void AtomicLatencyHistogram::AddTo(LatencyHistogram* histogram) const {
+  LatencyHistogram recorded;
+  recorded.set_sub_bucket_bits(kLatencyHistogramSubBucketBits);
+  for (int i = 0; i < kNumBuckets; ++i) {
+    int64_t count = buckets_[i].load(std::memory_order_relaxed);
+    if (count) {
+      recorded.add_bucket_indices(i);
+      recorded.add_bucket_counts(count);
+    }
+  }
+  if (recorded.bucket_indices().empty()) return;
+  recorded.set_min_latency_ns(min_latency_ns_.load(std::memory_order_relaxed));
+  recorded.set_max_latency_ns(max_latency_ns_.load(std::memory_order_relaxed));
+  MergeLatencyHistogram(recorded, histogram);
+}
+
+void MergeLatencyHistogram(const LatencyHistogram& from, LatencyHistogram* to) {
+  if (from.bucket_indices().empty()) return;
+  if (to->bucket_indices().empty()) {
+    *to = from;
+    return;
+  }
+  CHECK_EQ(from.sub_bucket_bits(), to->sub_bucket_bits());
+  CHECK_EQ(from.bucket_indices_size(), from.bucket_counts_size());
+  std::map<int, int64_t> buckets;
+  auto add_buckets = [&buckets](const LatencyHistogram& histogram) {
+    for (int i = 0; i < histogram.bucket_indices_size(); ++i) {
+      buckets[histogram.bucket_indices(i)] += histogram.bucket_counts(i);
+    }
+  };
+  add_buckets(from);
+  add_buckets(*to);
+  to->clear_bucket_indices();
+  to->clear_bucket_counts();
+  for (const auto& [index, count] : buckets) {
+    to->add_bucket_indices(index);
+    to->add_bucket_counts(count);
+  }
+  to->set_min_latency_ns(std::min(from.min_latency_ns(), to->min_latency_ns()));
+  to->set_max_latency_ns(std::max(from.max_latency_ns(), to->max_latency_ns()));
+}
+
+int64_t LatencyHistogramCount(const LatencyHistogram& histogram) {
+  int64_t count = 0;
+  for (int64_t bucket_count : histogram.bucket_counts()) {
+    count += bucket_count;
+  }
+  return count;
+}
+
+int64_t LatencyHistogramQuantile(const LatencyHistogram& histogram,
+                                 double quantile) {
+  const int64_t rank = LatencyHistogramCount(histogram) * quantile;
+  int64_t seen = 0;
+  for (int i = 0; i < histogram.bucket_indices_size(); ++i) {
+    seen += histogram.bucket_counts(i);
+    if (seen > rank) {
+      int64_t latency = LatencyHistogramBucketMaxLatency(
+          histogram.bucket_indices(i), histogram.sub_bucket_bits());
+      return std::clamp(latency, histogram.min_latency_ns(),
+                        histogram.max_latency_ns());
+    }
+  }
+  return histogram.max_latency_ns();
+}
+
+}  // namespace distbench
@@ -0,0 +1,78 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef DISTBENCH_DISTBENCH_LATENCY_HISTOGRAM_H_
+#define DISTBENCH_DISTBENCH_LATENCY_HISTOGRAM_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+namespace distbench {
+
+class LatencyHistogram;
+
+// Latency histograms are log-linear, in the style of HdrHistogram.
+// Latencies below 2^sub_bucket_bits ns get a bucket each. Every larger power
+// of two range is split into 2^(sub_bucket_bits - 1) equal width buckets, so
+// the bucket of any latency is at most 1/2^(sub_bucket_bits - 1) wide,
+// relative to the latency.
+constexpr int kLatencyHistogramSubBucketBits = 7;
+
+// Latencies above this (about 18 minutes) share the last bucket:
+constexpr int64_t kLatencyHistogramMaxLatencyNs = (int64_t{1} << 40) - 1;
+
+int LatencyHistogramBucketIndex(
+    int64_t latency_ns, int sub_bucket_bits = kLatencyHistogramSubBucketBits);
+
+// Returns the largest latency that falls into the given bucket:
+int64_t LatencyHistogramBucketMaxLatency(
+    int index, int sub_bucket_bits = kLatencyHistogramSubBucketBits);
+
+// A fixed-memory latency histogram that many threads can record into,
+// without locks.
+class AtomicLatencyHistogram {
+ public:
+  AtomicLatencyHistogram();
+  AtomicLatencyHistogram(const AtomicLatencyHistogram&) = delete;
+  AtomicLatencyHistogram& operator=(const AtomicLatencyHistogram&) = delete;
+
+  // Counts latency_ns weight times, e.g. to weigh each RPC by the time it
+  // stands for:
+  void Record(int64_t latency_ns, int64_t weight = 1);
+
+  // Adds the recorded latencies to histogram, which must be either empty or
+  // use kLatencyHistogramSubBucketBits:
+  void AddTo(LatencyHistogram* histogram) const;
+
+ private:
+  std::unique_ptr<std::atomic<int64_t>[]> buckets_;
+  std::atomic<int64_t> min_latency_ns_;
+  std::atomic<int64_t> max_latency_ns_;
+};
+
+// Adds the contents of 'from' to 'to', which must be either empty or use the
+// same sub_bucket_bits:
+void MergeLatencyHistogram(const LatencyHistogram& from, LatencyHistogram* to);
+
+int64_t LatencyHistogramCount(const LatencyHistogram& histogram);
+
+// Returns (an upper bound of) the latency of the sample ranked N * quantile
+// among the N samples of the histogram, clamped to the recorded min and max:
+int64_t LatencyHistogramQuantile(const LatencyHistogram& histogram,
+                                 double quantile);
+
+}  // namespace distbench
+
+#endif  // DISTBENCH_DISTBENCH_LATENCY_HISTOGRAM_H_
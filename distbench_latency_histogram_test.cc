@@ -0,0 +1,104 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "distbench_latency_histogram.h"
+
+#include <thread>
+#include <vector>
+
+#include "distbench.pb.h"
+#include "gtest/gtest.h"
+#include "gtest_utils.h"
+
+namespace distbench {
+
+TEST(LatencyHistogramTest, BucketsAreContiguous) {
+  int64_t previous_max_latency = -1;
+  for (int i = 0; i <= LatencyHistogramBucketIndex(
+                           kLatencyHistogramMaxLatencyNs);
+       ++i) {
+    int64_t max_latency = LatencyHistogramBucketMaxLatency(i);
+    ASSERT_GT(max_latency, previous_max_latency);
+    ASSERT_EQ(LatencyHistogramBucketIndex(previous_max_latency + 1), i);
+    ASSERT_EQ(LatencyHistogramBucketIndex(max_latency), i);
+    previous_max_latency = max_latency;
+  }
+  EXPECT_EQ(previous_max_latency, kLatencyHistogramMaxLatencyNs);
+}
+
+TEST(LatencyHistogramTest, RelativeErrorIsBounded) {
+  for (int64_t latency = 1; latency < kLatencyHistogramMaxLatencyNs;
+       latency = latency * 3 + 1) {
+    int64_t max_latency =
+        LatencyHistogramBucketMaxLatency(LatencyHistogramBucketIndex(latency));
+    EXPECT_LE(max_latency - latency,
+              latency >> (kLatencyHistogramSubBucketBits - 1));
+  }
+}
+
+TEST(LatencyHistogramTest, Quantiles) {
+  AtomicLatencyHistogram atomic_histogram;
+  for (int64_t latency = 1000; latency < 2000; ++latency) {
+    atomic_histogram.Record(latency);
+  }
+  LatencyHistogram histogram;
+  atomic_histogram.AddTo(&histogram);
+  EXPECT_EQ(LatencyHistogramCount(histogram), 1000);
+  EXPECT_EQ(histogram.min_latency_ns(), 1000);
+  EXPECT_EQ(histogram.max_latency_ns(), 1999);
+  EXPECT_NEAR(LatencyHistogramQuantile(histogram, 0.5), 1500, 1500 / 64);
+  EXPECT_NEAR(LatencyHistogramQuantile(histogram, 0.9), 1900, 1900 / 64);
+  EXPECT_EQ(LatencyHistogramQuantile(histogram, 0.9999), 1999);
+}
+
+TEST(LatencyHistogramTest, WeightedQuantiles) {
+  AtomicLatencyHistogram atomic_histogram;
+  for (int i = 0; i < 90; ++i) {
+    atomic_histogram.Record(1000);
+  }
+  // Outweighs the 90 other latencies:
+  atomic_histogram.Record(5000, 100);
+  LatencyHistogram histogram;
+  atomic_histogram.AddTo(&histogram);
+  EXPECT_EQ(LatencyHistogramCount(histogram), 190);
+  EXPECT_NEAR(LatencyHistogramQuantile(histogram, 0.4), 1000, 1000 / 64);
+  EXPECT_EQ(LatencyHistogramQuantile(histogram, 0.5), 5000);
+}
+
+TEST(LatencyHistogramTest, ConcurrentRecordAndMerge) {
+  const int kNumThreads = 8;
+  const int kSamplesPerThread = 10000;
+  AtomicLatencyHistogram atomic_histogram;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kNumThreads; ++i) {
+    threads.emplace_back([&, i]() {
+      for (int j = 0; j < kSamplesPerThread; ++j) {
+        atomic_histogram.Record(1000 * (i + 1) + j);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  LatencyHistogram histogram;
+  atomic_histogram.AddTo(&histogram);
+  atomic_histogram.AddTo(&histogram);
+  EXPECT_EQ(LatencyHistogramCount(histogram),
+            2 * kNumThreads * kSamplesPerThread);
+  EXPECT_EQ(histogram.min_latency_ns(), 1000);
+  EXPECT_EQ(histogram.max_latency_ns(),
+            1000 * kNumThreads + kSamplesPerThread - 1);
+}
+
+}  // namespace distbench
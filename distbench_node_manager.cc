@@ -119,6 +119,37 @@ absl::StatusOr<ProtocolDriverOptions> NodeManager::GetProtocolDriverOptionsFor(
   if (!pd_opts.has_netdev_name())
     pd_opts.set_netdev_name(std::string(service_opts.netdev_name));
 
+  // The protocol driver threads are placed, and their threadpools record
+  // telemetry, like those of the service, except for the settings that its
+  // server_settings give themselves:
+  bool has_threadpool_telemetry = false;
+  bool has_cpu_list = false;
+  bool has_numa_node = false;
+  for (const auto& setting : pd_opts.server_settings()) {
+    if (setting.name() == "threadpool_telemetry") {
+      has_threadpool_telemetry = true;
+    }
+    if (setting.name() == "cpu_list") has_cpu_list = true;
+    if (setting.name() == "numa_node") has_numa_node = true;
+  }
+  for (const auto& service : traffic_config_.services()) {
+    if (service.name() != service_opts.service_type) continue;
+    if (service.threadpool_telemetry() && !has_threadpool_telemetry) {
+      auto* setting = pd_opts.add_server_settings();
+      setting->set_name("threadpool_telemetry");
+      setting->set_int64_value(1);
+    }
+    if (service.has_cpu_list() && !has_cpu_list) {
+      auto* setting = pd_opts.add_server_settings();
+      setting->set_name("cpu_list");
+      setting->set_string_value(service.cpu_list());
+    }
+    if (service.has_numa_node() && !has_numa_node) {
+      auto* setting = pd_opts.add_server_settings();
+      setting->set_name("numa_node");
+      setting->set_int64_value(service.numa_node());
+    }
+  }
   return pd_opts;
 }
 
@@ -181,25 +212,77 @@ grpc::Status NodeManager::RunTraffic(grpc::ServerContext* context,
 grpc::Status NodeManager::GetTrafficResult(
     grpc::ServerContext* context, const GetTrafficResultRequest* request,
     GetTrafficResultResponse* response) {
+  auto& instance_logs =
+      *response->mutable_service_logs()->mutable_instance_logs();
+  return CollectTrafficResult(
+      *request, [&](GetTrafficResultResponse* chunk) {
+        auto& chunk_logs =
+            *chunk->mutable_service_logs()->mutable_instance_logs();
+        for (auto& [instance_name, log] : chunk_logs) {
+          auto it = instance_logs.find(instance_name);
+          if (it == instance_logs.end()) {
+            instance_logs[instance_name] = std::move(log);
+          } else {
+            MergeServicePerformanceLogPiece(&log, &it->second);
+          }
+        }
+        response->mutable_node_usages()->insert(chunk->node_usages().begin(),
+                                                chunk->node_usages().end());
+        return true;
+      });
+}
+
+grpc::Status NodeManager::GetTrafficResultStream(
+    grpc::ServerContext* context, const GetTrafficResultRequest* request,
+    grpc::ServerWriter<GetTrafficResultResponse>* writer) {
+  return CollectTrafficResult(*request,
+                              [writer](GetTrafficResultResponse* chunk) {
+                                return writer->Write(*chunk);
+                              });
+}
+
+grpc::Status NodeManager::CollectTrafficResult(
+    const GetTrafficResultRequest& request,
+    std::function<bool(GetTrafficResultResponse* chunk)> write_chunk) {
   absl::MutexLock m(&mutex_);
 
-  auto& service_logs = *response->mutable_service_logs();
-  auto& instance_logs = *service_logs.mutable_instance_logs();
+  // Each engine's log is handed off (and released) before the next one is
+  // collected, so the node never holds more than one of them at a time:
+  grpc::Status status = grpc::Status::OK;
   for (const auto& service_engine : service_engines_) {
     auto log = service_engine.second->GetLogs();
     if (log.peer_logs().empty() && log.activity_logs().empty()) continue;
-    instance_logs[service_engine.first] = std::move(log);
+    auto pieces =
+        SplitServicePerformanceLog(std::move(log), request.max_chunk_bytes());
+    for (auto& piece : pieces) {
+      GetTrafficResultResponse chunk;
+      (*chunk.mutable_service_logs()
+            ->mutable_instance_logs())[service_engine.first] =
+          std::move(piece);
+      if (!write_chunk(&chunk)) {
+        status = grpc::Status(grpc::StatusCode::CANCELLED,
+                              "Lost the GetTrafficResult client");
+        break;
+      }
+    }
+    if (!status.ok()) break;
   }
 
-  if (request->clear_services()) {
+  if (request.clear_services()) {
     for (const auto& service_engine : service_engines_) {
       service_engine.second->CancelTraffic(absl::OkStatus());
     }
     ClearServices();
   }
-  (*response->mutable_node_usages())[NodeAlias()] =
-      GetRUsageStatsFromStructs(rusage_start_test_, DoGetRusage());
+  if (!status.ok()) return status;
 
+  GetTrafficResultResponse chunk;
+  (*chunk.mutable_node_usages())[NodeAlias()] =
+      GetRUsageStatsFromStructs(rusage_start_test_, DoGetRusage());
+  if (!write_chunk(&chunk)) {
+    return grpc::Status(grpc::StatusCode::CANCELLED,
+                        "Lost the GetTrafficResult client");
+  }
   return grpc::Status::OK;
 }
 
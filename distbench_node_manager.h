@@ -15,6 +15,8 @@
 #ifndef DISTBENCH_DISTBENCH_NODE_MANAGER_H_
 #define DISTBENCH_DISTBENCH_NODE_MANAGER_H_
 
+#include <functional>
+
 #include "absl/status/statusor.h"
 #include "distbench.grpc.pb.h"
 #include "distbench_engine.h"
@@ -56,6 +58,10 @@ class NodeManager final : public DistBenchNodeManager::Service {
                                 const GetTrafficResultRequest* request,
                                 GetTrafficResultResponse* response) override;
 
+  grpc::Status GetTrafficResultStream(
+      grpc::ServerContext* context, const GetTrafficResultRequest* request,
+      grpc::ServerWriter<GetTrafficResultResponse>* writer) override;
+
   grpc::Status CancelTraffic(grpc::ServerContext* context,
                              const CancelTrafficRequest* request,
                              CancelTrafficResult* response) override;
@@ -72,6 +78,13 @@ class NodeManager final : public DistBenchNodeManager::Service {
  private:
   void ClearServices() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+  // Hands the traffic results to write_chunk one instance log at a time,
+  // followed by a last chunk with the node_usages. Stops early if
+  // write_chunk returns false.
+  grpc::Status CollectTrafficResult(
+      const GetTrafficResultRequest& request,
+      std::function<bool(GetTrafficResultResponse* chunk)> write_chunk);
+
   struct ServiceOpts {
     std::string_view service_name;
     std::string_view service_type;
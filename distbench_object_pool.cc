@@ -0,0 +1,129 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "distbench_object_pool.h"
+
+#include <algorithm>
+#include <new>
+
+#include "absl/strings/str_cat.h"
+#include "glog/logging.h"
+
+namespace distbench {
+
+namespace {
+
+constexpr size_t kCacheLineSize = 64;
+constexpr int kMaxBlockPools = 32;
+
+// A thread spills half of its free list to the shared list once it holds this
+// many blocks, and grabs up to half as many from the shared list when empty:
+constexpr size_t kMaxThreadCachedBlocks = 64;
+constexpr size_t kBlockTransferBatch = kMaxThreadCachedBlocks / 2;
+
+std::atomic<int> num_block_pools = 0;
+std::atomic<BlockPool*> block_pools[kMaxBlockPools];
+
+struct ThreadBlockCache {
+  ~ThreadBlockCache() {
+    for (int i = 0; i < kMaxBlockPools; ++i) {
+      if (!free_blocks[i].empty()) {
+        block_pools[i].load()->ReturnToSharedList(&free_blocks[i],
+                                                  free_blocks[i].size());
+      }
+    }
+  }
+
+  std::vector<void*> free_blocks[kMaxBlockPools];
+};
+
+thread_local ThreadBlockCache thread_block_cache;
+
+}  // anonymous namespace
+
+BlockPool::BlockPool(std::string_view name, size_t block_size)
+    : name_(name),
+      block_size_((block_size + kCacheLineSize - 1) & ~(kCacheLineSize - 1)) {
+  pool_index_ = num_block_pools.fetch_add(1);
+  if (pool_index_ >= kMaxBlockPools) {
+    LOG(WARNING) << "Too many BlockPools, " << name_
+                 << " will allocate its blocks from the heap";
+    pool_index_ = -1;
+    return;
+  }
+  block_pools[pool_index_] = this;
+}
+
+void* BlockPool::Allocate() {
+  if (pool_index_ < 0) {
+    heap_allocations_.fetch_add(1, std::memory_order_relaxed);
+    return ::operator new(block_size_, std::align_val_t(kCacheLineSize));
+  }
+  auto& free_blocks = thread_block_cache.free_blocks[pool_index_];
+  if (free_blocks.empty()) {
+    absl::MutexLock m(&mutex_);
+    size_t count = std::min(kBlockTransferBatch, shared_blocks_.size());
+    free_blocks.insert(free_blocks.end(), shared_blocks_.end() - count,
+                       shared_blocks_.end());
+    shared_blocks_.resize(shared_blocks_.size() - count);
+  }
+  if (free_blocks.empty()) {
+    heap_allocations_.fetch_add(1, std::memory_order_relaxed);
+    return ::operator new(block_size_, std::align_val_t(kCacheLineSize));
+  }
+  reused_blocks_.fetch_add(1, std::memory_order_relaxed);
+  void* block = free_blocks.back();
+  free_blocks.pop_back();
+  return block;
+}
+
+void BlockPool::Free(void* block) {
+  if (pool_index_ < 0) {
+    ::operator delete(block, std::align_val_t(kCacheLineSize));
+    return;
+  }
+  auto& free_blocks = thread_block_cache.free_blocks[pool_index_];
+  free_blocks.push_back(block);
+  if (free_blocks.size() >= kMaxThreadCachedBlocks) {
+    ReturnToSharedList(&free_blocks, kBlockTransferBatch);
+  }
+}
+
+void BlockPool::ReturnToSharedList(std::vector<void*>* blocks, size_t count) {
+  absl::MutexLock m(&mutex_);
+  shared_blocks_.insert(shared_blocks_.end(), blocks->end() - count,
+                        blocks->end());
+  blocks->resize(blocks->size() - count);
+}
+
+std::vector<ObjectPoolStat> BlockPool::GetStats() const {
+  return {
+      {absl::StrCat(name_, "/heap_allocations"), heap_allocations_},
+      {absl::StrCat(name_, "/reused_blocks"), reused_blocks_},
+  };
+}
+
+std::vector<ObjectPoolStat> GetObjectPoolStats() {
+  std::vector<ObjectPoolStat> stats;
+  int pool_count = std::min(num_block_pools.load(), kMaxBlockPools);
+  for (int i = 0; i < pool_count; ++i) {
+    BlockPool* pool = block_pools[i];
+    if (pool == nullptr) continue;
+    auto pool_stats = pool->GetStats();
+    stats.insert(stats.end(), pool_stats.begin(), pool_stats.end());
+  }
+  return stats;
+}
+
+}  // namespace distbench
@@ -0,0 +1,166 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef DISTBENCH_DISTBENCH_OBJECT_POOL_H_
+#define DISTBENCH_DISTBENCH_OBJECT_POOL_H_
+
+#include <atomic>
+#include <memory>
+#include <new>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+
+namespace distbench {
+
+struct ObjectPoolStat {
+  std::string name;
+  int64_t value;
+};
+
+// Recycles fixed-size, cache line aligned blocks of memory. Each thread keeps
+// a small free list per pool, so the common case of allocating and freeing
+// does not need any synchronization. Threads that free more blocks than they
+// allocate (e.g. RPC completion threads) spill them, in batches, to a shared
+// free list that other threads refill their own lists from.
+//
+// Pools must never be destroyed (use function-local statics allocated with
+// new), since any thread may still hold blocks from them in its free list.
+// Only the first kMaxBlockPools pools of the process recycle their blocks;
+// any further pool logs a warning and passes every block to the heap.
+class BlockPool {
+ public:
+  BlockPool(std::string_view name, size_t block_size);
+  BlockPool(const BlockPool&) = delete;
+  BlockPool& operator=(const BlockPool&) = delete;
+
+  void* Allocate();
+  void Free(void* block);
+
+  size_t block_size() const { return block_size_; }
+  const std::string& name() const { return name_; }
+
+  // Blocks that were moved to the shared free list, by a thread with a full
+  // (or departing) local free list:
+  void ReturnToSharedList(std::vector<void*>* blocks, size_t count);
+
+  std::vector<ObjectPoolStat> GetStats() const;
+
+ private:
+  std::string name_;
+  size_t block_size_;
+  // -1 if the pool does not recycle its blocks:
+  int pool_index_;
+
+  absl::Mutex mutex_;
+  std::vector<void*> shared_blocks_ ABSL_GUARDED_BY(mutex_);
+
+  std::atomic<int64_t> heap_allocations_ = 0;
+  std::atomic<int64_t> reused_blocks_ = 0;
+};
+
+// Allocates and constructs objects of type T in recycled blocks.
+template <typename T>
+class ObjectPool {
+ public:
+  explicit ObjectPool(std::string_view name) : blocks_(name, sizeof(T)) {}
+
+  template <typename... Args>
+  T* New(Args&&... args) {
+    return new (blocks_.Allocate()) T(std::forward<Args>(args)...);
+  }
+
+  void Delete(T* object) {
+    object->~T();
+    blocks_.Free(object);
+  }
+
+ private:
+  BlockPool blocks_;
+};
+
+// A standard allocator that takes its memory from a BlockPool whenever the
+// requested size fits into a block, and from the heap otherwise. This is used
+// with std::allocate_shared, so that an object and its shared_ptr control
+// block are carved out of a single recycled block.
+template <typename T>
+class PoolAllocator {
+ public:
+  using value_type = T;
+
+  explicit PoolAllocator(BlockPool* pool) : pool_(pool) {}
+  template <typename U>
+  PoolAllocator(const PoolAllocator<U>& other) : pool_(other.pool()) {}
+
+  T* allocate(size_t n) {
+    if (n * sizeof(T) <= pool_->block_size()) {
+      return static_cast<T*>(pool_->Allocate());
+    }
+    return std::allocator<T>().allocate(n);
+  }
+
+  void deallocate(T* p, size_t n) {
+    if (n * sizeof(T) <= pool_->block_size()) {
+      pool_->Free(p);
+    } else {
+      std::allocator<T>().deallocate(p, n);
+    }
+  }
+
+  BlockPool* pool() const { return pool_; }
+
+  template <typename U>
+  bool operator==(const PoolAllocator<U>& other) const {
+    return pool_ == other.pool();
+  }
+  template <typename U>
+  bool operator!=(const PoolAllocator<U>& other) const {
+    return pool_ != other.pool();
+  }
+
+ private:
+  BlockPool* pool_;
+};
+
+// Upper bound on the room that std::allocate_shared needs in front of the
+// object for its control block. That holds a vtable pointer, the use and weak
+// counts and the allocator (a single pointer), i.e. 24 bytes on LP64 with
+// libstdc++ and libc++, and the object follows it at its own alignment. So a
+// cache line covers any T aligned to at most 64 bytes. Should the estimate
+// ever be short, PoolAllocator just falls back to the heap.
+constexpr size_t kSharedControlBlockBytes = 64;
+
+// Returns the size of the blocks that a pool used with AllocateShared<T>
+// needs, to also hold the shared_ptr control block.
+template <typename T>
+constexpr size_t SharedBlockSize() {
+  static_assert(alignof(T) <= kSharedControlBlockBytes);
+  return sizeof(T) + kSharedControlBlockBytes;
+}
+
+template <typename T, typename... Args>
+std::shared_ptr<T> AllocateShared(BlockPool* pool, Args&&... args) {
+  return std::allocate_shared<T>(PoolAllocator<T>(pool),
+                                 std::forward<Args>(args)...);
+}
+
+// Returns the statistics of every BlockPool in the process.
+std::vector<ObjectPoolStat> GetObjectPoolStats();
+
+}  // namespace distbench
+
+#endif  // DISTBENCH_DISTBENCH_OBJECT_POOL_H_
@@ -0,0 +1,110 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "distbench_object_pool.h"
+
+#include <thread>
+
+#include "absl/strings/str_cat.h"
+#include "gtest/gtest.h"
+#include "gtest_utils.h"
+
+namespace distbench {
+
+namespace {
+
+int64_t GetStat(std::string_view name) {
+  for (const auto& stat : GetObjectPoolStats()) {
+    if (stat.name == name) return stat.value;
+  }
+  return -1;
+}
+
+struct TestObject {
+  explicit TestObject(int v) : value(v) {}
+  int value;
+  char padding[100];
+};
+
+}  // anonymous namespace
+
+TEST(ObjectPoolTest, BlockSizeIsRoundedToCacheLine) {
+  static auto* pool = new BlockPool("rounding_test", 65);
+  EXPECT_EQ(pool->block_size(), 128);
+}
+
+TEST(ObjectPoolTest, ReusesFreedObjects) {
+  static auto* pool = new ObjectPool<TestObject>("reuse_test");
+  TestObject* object = pool->New(1);
+  EXPECT_EQ(object->value, 1);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(object) % 64, 0);
+  pool->Delete(object);
+  TestObject* second_object = pool->New(2);
+  EXPECT_EQ(second_object, object);
+  EXPECT_EQ(second_object->value, 2);
+  pool->Delete(second_object);
+  EXPECT_EQ(GetStat("reuse_test/heap_allocations"), 1);
+  EXPECT_EQ(GetStat("reuse_test/reused_blocks"), 1);
+}
+
+TEST(ObjectPoolTest, ReusesObjectsFreedByOtherThreads) {
+  static auto* pool = new ObjectPool<TestObject>("cross_thread_test");
+  const int kNumObjects = 1000;
+  std::vector<TestObject*> objects;
+  for (int i = 0; i < kNumObjects; ++i) {
+    objects.push_back(pool->New(i));
+  }
+  std::thread freeing_thread([&]() {
+    for (auto* object : objects) {
+      pool->Delete(object);
+    }
+  });
+  freeing_thread.join();
+  EXPECT_EQ(GetStat("cross_thread_test/heap_allocations"), kNumObjects);
+  for (int i = 0; i < kNumObjects; ++i) {
+    objects[i] = pool->New(i);
+  }
+  EXPECT_EQ(GetStat("cross_thread_test/heap_allocations"), kNumObjects);
+  EXPECT_EQ(GetStat("cross_thread_test/reused_blocks"), kNumObjects);
+  for (auto* object : objects) {
+    pool->Delete(object);
+  }
+}
+
+TEST(ObjectPoolTest, AllocateSharedFitsInOneBlock) {
+  static auto* pool =
+      new BlockPool("shared_test", SharedBlockSize<TestObject>());
+  std::shared_ptr<TestObject> object = AllocateShared<TestObject>(pool, 7);
+  EXPECT_EQ(object->value, 7);
+  object.reset();
+  object = AllocateShared<TestObject>(pool, 8);
+  EXPECT_EQ(object->value, 8);
+  EXPECT_EQ(GetStat("shared_test/heap_allocations"), 1);
+  EXPECT_EQ(GetStat("shared_test/reused_blocks"), 1);
+}
+
+// Uses up every pool slot, so it must remain the last test:
+TEST(ObjectPoolTest, TooManyPoolsFallBackToTheHeap) {
+  BlockPool* pool = nullptr;
+  for (int i = 0; i < 64; ++i) {
+    pool = new BlockPool(absl::StrCat("overflow_test_", i), 64);
+  }
+  void* block = pool->Allocate();
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(block) % 64, 0);
+  pool->Free(block);
+  EXPECT_EQ(GetStat("overflow_test_63/heap_allocations"), -1);
+  EXPECT_GT(GetObjectPoolStats().size(), 0);
+}
+
+}  // namespace distbench
@@ -0,0 +1,141 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "distbench_open_loop_schedule.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "absl/strings/str_cat.h"
+
+namespace distbench {
+
+bool IsOpenLoop(const Iterations& iterations) {
+  return iterations.has_open_loop_interval_ns() ||
+         iterations.has_open_loop_interval_distribution() ||
+         iterations.has_open_loop_interval_distribution_config_name();
+}
+
+absl::Status ValidateOpenLoopIterations(const Iterations& iterations) {
+  if (!IsOpenLoop(iterations)) return absl::OkStatus();
+  const std::string& distribution =
+      iterations.open_loop_interval_distribution();
+  if (distribution == "distribution_config") {
+    if (!iterations.has_open_loop_interval_distribution_config_name()) {
+      return absl::InvalidArgumentError(
+          "open_loop_interval_distribution_config_name is needed by the "
+          "distribution_config interval distribution");
+    }
+    return absl::OkStatus();
+  }
+  if (iterations.open_loop_interval_ns() <= 0) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "open_loop_interval_ns must be positive for the ", distribution,
+        " interval distribution"));
+  }
+  if (distribution == "constant" || distribution == "sync_burst" ||
+      distribution == "sync_burst_spread" || distribution == "exponential") {
+    return absl::OkStatus();
+  }
+  if (distribution == "pareto" || distribution == "on_off") {
+    if (!(iterations.open_loop_pareto_shape() > 1)) {
+      return absl::InvalidArgumentError(
+          "open_loop_pareto_shape must be greater than 1");
+    }
+    if (distribution == "on_off" && (iterations.open_loop_mean_on_ns() <= 0 ||
+                                     iterations.open_loop_mean_off_ns() <= 0)) {
+      return absl::InvalidArgumentError(
+          "open_loop_mean_on_ns and open_loop_mean_off_ns must be positive");
+    }
+    return absl::OkStatus();
+  }
+  return absl::InvalidArgumentError(
+      absl::StrCat("Unknown open_loop_interval_distribution: ", distribution));
+}
+
+OpenLoopSchedule::OpenLoopSchedule(
+    const Iterations& iterations,
+    DistributionSampleGenerator* interval_generator, int interval_dimension,
+    unsigned int seed)
+    : interval_ns_(iterations.open_loop_interval_ns()),
+      pareto_shape_(iterations.open_loop_pareto_shape()),
+      mean_on_ns_(iterations.open_loop_mean_on_ns()),
+      mean_off_ns_(iterations.open_loop_mean_off_ns()),
+      interval_generator_(interval_generator),
+      interval_dimension_(interval_dimension),
+      rand_gen_(seed),
+      intervals_ns_(kBlockSize) {
+  const std::string& distribution =
+      iterations.open_loop_interval_distribution();
+  if (distribution == "exponential") {
+    distribution_ = Distribution::kExponential;
+  } else if (distribution == "pareto") {
+    distribution_ = Distribution::kPareto;
+  } else if (distribution == "on_off") {
+    distribution_ = Distribution::kOnOff;
+    on_remaining_ns_ = std::llround(ParetoSample(mean_on_ns_));
+  } else if (distribution == "distribution_config" && interval_generator_) {
+    distribution_ = Distribution::kDistributionConfig;
+  }
+  Refill();
+}
+
+double OpenLoopSchedule::ParetoSample(double mean) {
+  double scale = mean * (pareto_shape_ - 1) / pareto_shape_;
+  // 1 - u is in (0, 1], which keeps the sample finite:
+  double u = std::uniform_real_distribution<double>(0, 1)(rand_gen_);
+  return scale / std::pow(1 - u, 1 / pareto_shape_);
+}
+
+void OpenLoopSchedule::Refill() {
+  switch (distribution_) {
+    case Distribution::kConstant:
+      std::fill(intervals_ns_.begin(), intervals_ns_.end(), interval_ns_);
+      break;
+    case Distribution::kExponential: {
+      std::exponential_distribution<double> exponential(1.0 / interval_ns_);
+      for (auto& interval_ns : intervals_ns_) {
+        interval_ns = std::llround(exponential(rand_gen_));
+      }
+      break;
+    }
+    case Distribution::kPareto:
+      for (auto& interval_ns : intervals_ns_) {
+        interval_ns = std::llround(ParetoSample(interval_ns_));
+      }
+      break;
+    case Distribution::kOnOff:
+      for (auto& interval_ns : intervals_ns_) {
+        if (on_remaining_ns_ >= interval_ns_) {
+          interval_ns = interval_ns_;
+          on_remaining_ns_ -= interval_ns_;
+        } else {
+          // The burst is over, so stay silent before starting the next one:
+          interval_ns = interval_ns_ + std::llround(ParetoSample(mean_off_ns_));
+          on_remaining_ns_ = std::llround(ParetoSample(mean_on_ns_));
+        }
+      }
+      break;
+    case Distribution::kDistributionConfig:
+      for (auto& interval_ns : intervals_ns_) {
+        interval_ns = std::max(
+            0, interval_generator_->GetRandomSample(
+                   &rand_gen_)[interval_dimension_]);
+      }
+      break;
+  }
+  next_interval_ = 0;
+}
+
+}  // namespace distbench
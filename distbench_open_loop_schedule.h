@@ -0,0 +1,90 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef DISTBENCH_DISTBENCH_OPEN_LOOP_SCHEDULE_H_
+#define DISTBENCH_DISTBENCH_OPEN_LOOP_SCHEDULE_H_
+
+#include <random>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/time/time.h"
+#include "joint_distribution_sample_generator.h"
+#include "traffic_config.pb.h"
+
+namespace distbench {
+
+// Returns true if the iterations are paced by an open loop schedule, i.e.
+// if open_loop_interval_ns or any of the fields selecting the interval
+// distribution is set:
+bool IsOpenLoop(const Iterations& iterations);
+
+// Checks the open loop fields of iterations, except for the existence of
+// the DistributionConfig named by "distribution_config":
+absl::Status ValidateOpenLoopIterations(const Iterations& iterations);
+
+// Draws the intervals between the iterations of an open loop action from
+// the distribution named by Iterations.open_loop_interval_distribution.
+// The intervals are precomputed a block at a time, so that taking the next
+// one is just an array read.
+class OpenLoopSchedule {
+ public:
+  static constexpr int kBlockSize = 256;
+
+  // interval_generator is only used by "distribution_config", which reads
+  // the interval from the given dimension of its samples. It must outlive
+  // the schedule.
+  OpenLoopSchedule(const Iterations& iterations,
+                   DistributionSampleGenerator* interval_generator,
+                   int interval_dimension, unsigned int seed);
+
+  absl::Duration NextInterval() {
+    return absl::Nanoseconds(intervals_ns_[next_interval_++]);
+  }
+
+  // Must be called after each NextInterval, preferably once the iteration
+  // has been started, since it may need to compute the next block:
+  void RefillIfEmpty() {
+    if (next_interval_ == intervals_ns_.size()) Refill();
+  }
+
+ private:
+  enum class Distribution {
+    kConstant,
+    kExponential,
+    kPareto,
+    kOnOff,
+    kDistributionConfig,
+  };
+
+  void Refill();
+  double ParetoSample(double mean);
+
+  Distribution distribution_ = Distribution::kConstant;
+  int64_t interval_ns_;
+  double pareto_shape_;
+  int64_t mean_on_ns_;
+  int64_t mean_off_ns_;
+  // Time left in the current burst of "on_off":
+  int64_t on_remaining_ns_ = 0;
+  DistributionSampleGenerator* interval_generator_;
+  int interval_dimension_;
+  std::default_random_engine rand_gen_;
+  std::vector<int64_t> intervals_ns_;
+  size_t next_interval_ = 0;
+};
+
+}  // namespace distbench
+
+#endif  // DISTBENCH_DISTBENCH_OPEN_LOOP_SCHEDULE_H_
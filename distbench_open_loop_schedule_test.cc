@@ -0,0 +1,138 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "distbench_open_loop_schedule.h"
+
+#include <string>
+
+#include "gtest/gtest.h"
+#include "gtest_utils.h"
+
+namespace distbench {
+
+namespace {
+
+Iterations OpenLoopIterations(const std::string& distribution) {
+  Iterations iterations;
+  iterations.set_open_loop_interval_ns(10'000);
+  iterations.set_open_loop_interval_distribution(distribution);
+  return iterations;
+}
+
+// Returns the mean of the first n intervals:
+double MeanInterval(OpenLoopSchedule* schedule, int n) {
+  double sum = 0;
+  for (int i = 0; i < n; ++i) {
+    sum += absl::ToDoubleNanoseconds(schedule->NextInterval());
+    schedule->RefillIfEmpty();
+  }
+  return sum / n;
+}
+
+}  // anonymous namespace
+
+TEST(OpenLoopScheduleTest, Validate) {
+  ASSERT_OK(ValidateOpenLoopIterations(Iterations()));
+  ASSERT_OK(ValidateOpenLoopIterations(OpenLoopIterations("sync_burst")));
+  ASSERT_OK(ValidateOpenLoopIterations(OpenLoopIterations("exponential")));
+  ASSERT_OK(ValidateOpenLoopIterations(OpenLoopIterations("pareto")));
+  EXPECT_FALSE(ValidateOpenLoopIterations(OpenLoopIterations("poisson")).ok());
+  EXPECT_FALSE(ValidateOpenLoopIterations(OpenLoopIterations("on_off")).ok());
+  EXPECT_FALSE(
+      ValidateOpenLoopIterations(OpenLoopIterations("distribution_config"))
+          .ok());
+
+  Iterations pareto = OpenLoopIterations("pareto");
+  pareto.set_open_loop_pareto_shape(1);
+  EXPECT_FALSE(ValidateOpenLoopIterations(pareto).ok());
+
+  // Picking a distribution is enough to make the iterations open loop, so
+  // the interval they need must then be given too:
+  Iterations exponential;
+  exponential.set_open_loop_interval_distribution("exponential");
+  EXPECT_TRUE(IsOpenLoop(exponential));
+  EXPECT_FALSE(ValidateOpenLoopIterations(exponential).ok());
+}
+
+TEST(OpenLoopScheduleTest, IsOpenLoop) {
+  EXPECT_FALSE(IsOpenLoop(Iterations()));
+  EXPECT_TRUE(IsOpenLoop(OpenLoopIterations("constant")));
+  Iterations iterations;
+  iterations.set_open_loop_interval_distribution_config_name("intervals");
+  EXPECT_TRUE(IsOpenLoop(iterations));
+  iterations.set_open_loop_interval_distribution("distribution_config");
+  ASSERT_OK(ValidateOpenLoopIterations(iterations));
+}
+
+TEST(OpenLoopScheduleTest, Constant) {
+  OpenLoopSchedule schedule(OpenLoopIterations("constant"), nullptr, 0, 1);
+  for (int i = 0; i < 1000; ++i) {
+    ASSERT_EQ(schedule.NextInterval(), absl::Microseconds(10));
+    schedule.RefillIfEmpty();
+  }
+}
+
+TEST(OpenLoopScheduleTest, Exponential) {
+  OpenLoopSchedule schedule(OpenLoopIterations("exponential"), nullptr, 0, 1);
+  EXPECT_NEAR(MeanInterval(&schedule, 100'000), 10'000, 200);
+}
+
+TEST(OpenLoopScheduleTest, Pareto) {
+  Iterations iterations = OpenLoopIterations("pareto");
+  // A lighter tail than the default keeps the sample mean stable:
+  iterations.set_open_loop_pareto_shape(3);
+  OpenLoopSchedule schedule(iterations, nullptr, 0, 1);
+  EXPECT_NEAR(MeanInterval(&schedule, 100'000), 10'000, 300);
+}
+
+TEST(OpenLoopScheduleTest, OnOff) {
+  Iterations iterations = OpenLoopIterations("on_off");
+  iterations.set_open_loop_pareto_shape(3);
+  iterations.set_open_loop_mean_on_ns(1'000'000);
+  iterations.set_open_loop_mean_off_ns(1'000'000);
+  OpenLoopSchedule schedule(iterations, nullptr, 0, 1);
+  int bursts = 0;
+  for (int i = 0; i < 100'000; ++i) {
+    absl::Duration interval = schedule.NextInterval();
+    schedule.RefillIfEmpty();
+    ASSERT_GE(interval, absl::Microseconds(10));
+    if (interval > absl::Microseconds(10)) ++bursts;
+  }
+  // Bursts hold about 100 iterations each:
+  EXPECT_NEAR(bursts, 1000, 200);
+}
+
+TEST(OpenLoopScheduleTest, DistributionConfig) {
+  DistributionConfig config;
+  config.set_name("intervals");
+  for (int interval_ns : {1000, 3000}) {
+    auto* pmf_point = config.add_pmf_points();
+    pmf_point->set_pmf(0.5);
+    pmf_point->add_data_points()->set_exact(interval_ns);
+  }
+  auto generator = AllocateSampleGenerator(config);
+  ASSERT_OK(generator.status());
+  Iterations iterations = OpenLoopIterations("distribution_config");
+  iterations.set_open_loop_interval_distribution_config_name("intervals");
+  ASSERT_OK(ValidateOpenLoopIterations(iterations));
+  OpenLoopSchedule schedule(iterations, generator.value().get(), 0, 1);
+  for (int i = 0; i < 1000; ++i) {
+    absl::Duration interval = schedule.NextInterval();
+    schedule.RefillIfEmpty();
+    ASSERT_TRUE(interval == absl::Nanoseconds(1000) ||
+                interval == absl::Nanoseconds(3000));
+  }
+}
+
+}  // namespace distbench
@@ -0,0 +1,199 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "distbench_pacer.h"
+
+#include <algorithm>
+
+#include "absl/numeric/bits.h"
+#include "distbench_spin_wait.h"
+#include "distbench_thread_support.h"
+#include "glog/logging.h"
+
+namespace distbench {
+
+namespace {
+
+int64_t TimeToTick(absl::Time time) { return absl::ToUnixNanos(time); }
+
+}  // anonymous namespace
+
+TimerWheel::TimerWheel(int64_t start_tick) : current_tick_(start_tick) {}
+
+void TimerWheel::Insert(int64_t tick, int64_t id) {
+  if (tick <= current_tick_) {
+    due_.push_back({tick, id});
+    return;
+  }
+  for (int level = 0; level < kNumLevels; ++level) {
+    int shift = level * kSlotBits;
+    if ((tick >> shift) - (current_tick_ >> shift) < kNumSlots) {
+      int slot = (tick >> shift) & (kNumSlots - 1);
+      slots_[level][slot].push_back({tick, id});
+      occupied_[level] |= uint64_t{1} << slot;
+      return;
+    }
+  }
+  // Beyond the span of the wheel, so park it in the farthest slot:
+  int shift = (kNumLevels - 1) * kSlotBits;
+  int slot = ((current_tick_ >> shift) + kNumSlots - 1) & (kNumSlots - 1);
+  slots_[kNumLevels - 1][slot].push_back({tick, id});
+  occupied_[kNumLevels - 1] |= uint64_t{1} << slot;
+}
+
+int64_t TimerWheel::NextTick() const {
+  if (!due_.empty()) return current_tick_;
+  return NextSlotTick();
+}
+
+int64_t TimerWheel::NextSlotTick() const {
+  int64_t next_tick = kNoTick;
+  for (int level = 0; level < kNumLevels; ++level) {
+    if (!occupied_[level]) continue;
+    int shift = level * kSlotBits;
+    int64_t current_slot = current_tick_ >> shift;
+    // The slot holding the current tick is always empty, so this is the
+    // distance to the next occupied slot:
+    int distance = absl::countr_zero(absl::rotr(
+        occupied_[level], static_cast<int>(current_slot & (kNumSlots - 1))));
+    next_tick = std::min(next_tick, (current_slot + distance) << shift);
+  }
+  return next_tick;
+}
+
+void TimerWheel::AdvanceTo(int64_t tick, std::vector<int64_t>* expired) {
+  while (current_tick_ < tick) {
+    int64_t next_tick = NextSlotTick();
+    if (next_tick > tick) {
+      // No slot is crossed, so the timers all stay where they are:
+      current_tick_ = tick;
+      break;
+    }
+    Step(next_tick);
+  }
+  for (const auto& entry : due_) {
+    expired->push_back(entry.id);
+  }
+  due_.clear();
+}
+
+void TimerWheel::Step(int64_t tick) {
+  int64_t previous_tick = current_tick_;
+  current_tick_ = tick;
+  std::vector<Entry> cascaded;
+  for (int level = kNumLevels - 1; level >= 0; --level) {
+    int shift = level * kSlotBits;
+    if ((tick >> shift) == (previous_tick >> shift)) continue;
+    int slot = (tick >> shift) & (kNumSlots - 1);
+    uint64_t slot_bit = uint64_t{1} << slot;
+    if (!(occupied_[level] & slot_bit)) continue;
+    occupied_[level] &= ~slot_bit;
+    cascaded.swap(slots_[level][slot]);
+    // Level 0 timers expire now, others move down to a finer level:
+    for (const auto& entry : cascaded) {
+      Insert(entry.tick, entry.id);
+    }
+    cascaded.clear();
+  }
+}
+
+Pacer::Pacer(SimpleClock* clock, absl::Duration spin_window,
+             ThreadPlacement placement)
+    : clock_(clock),
+      spin_window_(spin_window),
+      wheel_(TimeToTick(clock->Now())) {
+  thread_ = RunRegisteredThread(
+      "Pacer", [this]() { Run(); }, std::move(placement));
+}
+
+Pacer::~Pacer() {
+  mutex_.Lock();
+  if (!timers_.empty()) {
+    LOG(WARNING) << "Pacer destroyed with " << timers_.size()
+                 << " pending timers";
+  }
+  shutdown_ = true;
+  mutex_.Unlock();
+  thread_.join();
+}
+
+int64_t Pacer::AddTimer(absl::Time deadline, Callback callback) {
+  absl::MutexLock m(&mutex_);
+  int64_t timer_id = next_timer_id_++;
+  timers_[timer_id] =
+      std::make_unique<Timer>(Timer{deadline, std::move(callback)});
+  wheel_.Insert(TimeToTick(deadline), timer_id);
+  if (deadline < sleep_deadline_) {
+    wakeup_ = true;
+  }
+  return timer_id;
+}
+
+void Pacer::RemoveTimer(int64_t timer_id) {
+  absl::MutexLock m(&mutex_);
+  auto not_running = [this, timer_id]() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    return running_timer_id_ != timer_id;
+  };
+  mutex_.Await(absl::Condition(&not_running));
+  timers_.erase(timer_id);
+}
+
+void Pacer::Run() {
+  std::vector<int64_t> expired;
+  mutex_.Lock();
+  while (!shutdown_) {
+    wheel_.AdvanceTo(TimeToTick(clock_->Now()), &expired);
+    for (int64_t timer_id : expired) {
+      auto it = timers_.find(timer_id);
+      // Removed timers leave their entry in the wheel behind:
+      if (it == timers_.end()) continue;
+      Timer* timer = it->second.get();
+      running_timer_id_ = timer_id;
+      mutex_.Unlock();
+      absl::Time next_deadline = timer->callback(timer->deadline);
+      mutex_.Lock();
+      running_timer_id_ = -1;
+      if (next_deadline == absl::InfiniteFuture()) {
+        timers_.erase(timer_id);
+      } else {
+        timer->deadline = next_deadline;
+        wheel_.Insert(TimeToTick(next_deadline), timer_id);
+      }
+    }
+    expired.clear();
+
+    int64_t next_tick = wheel_.NextTick();
+    sleep_deadline_ = next_tick == TimerWheel::kNoTick
+                          ? absl::InfiniteFuture()
+                          : absl::FromUnixNanos(next_tick);
+    wakeup_ = false;
+    absl::Time deadline = sleep_deadline_;
+    mutex_.Unlock();
+    if (clock_->Now() < deadline - spin_window_) {
+      // Sleeping is cheap but imprecise, so wake up a bit early:
+      clock_->MutexLockWhenWithDeadline(
+          &mutex_, absl::Condition(this, &Pacer::ShouldWakeUp),
+          deadline - spin_window_);
+    } else {
+      // A sooner timer or a shutdown cuts the spin short:
+      while (clock_->Now() < deadline && !ShouldWakeUp()) {
+        CpuRelax();
+      }
+      mutex_.Lock();
+    }
+  }
+  mutex_.Unlock();
+}
+
+}  // namespace distbench
@@ -0,0 +1,135 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef DISTBENCH_DISTBENCH_PACER_H_
+#define DISTBENCH_DISTBENCH_PACER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "distbench_thread_support.h"
+#include "simple_clock.h"
+
+namespace distbench {
+
+// A hierarchical timing wheel, holding the ids of timers that expire at a
+// given tick. Each level has 64 slots, each 64 times wider than the slots of
+// the level below, so inserting a timer and expiring it both take constant
+// time, regardless of how many timers are pending.
+class TimerWheel {
+ public:
+  static constexpr int kSlotBits = 6;
+  static constexpr int kNumSlots = 1 << kSlotBits;
+  // With nanosecond ticks the wheel spans about 78 hours; timers beyond that
+  // are parked in the last slot and reinserted once it is reached.
+  static constexpr int kNumLevels = 8;
+  static constexpr int64_t kNoTick = std::numeric_limits<int64_t>::max();
+
+  explicit TimerWheel(int64_t start_tick);
+
+  // Timers at or before the current tick expire on the next AdvanceTo:
+  void Insert(int64_t tick, int64_t id);
+
+  // Returns a lower bound of the earliest tick at which a timer expires,
+  // or kNoTick if there are no timers:
+  int64_t NextTick() const;
+
+  // Advances the current tick to 'tick', appending the ids of the timers
+  // that expired to 'expired', in order of their ticks.
+  void AdvanceTo(int64_t tick, std::vector<int64_t>* expired);
+
+  int64_t current_tick() const { return current_tick_; }
+
+ private:
+  struct Entry {
+    int64_t tick;
+    int64_t id;
+  };
+
+  int64_t NextSlotTick() const;
+  void Step(int64_t tick);
+
+  int64_t current_tick_;
+  std::vector<Entry> slots_[kNumLevels][kNumSlots];
+  uint64_t occupied_[kNumLevels] = {};
+  std::vector<Entry> due_;
+};
+
+// Calls the callbacks of open loop timers from a dedicated thread, as close
+// to their deadlines as possible: the thread sleeps until shortly before the
+// next deadline, and spins for the remainder.
+class Pacer {
+ public:
+  // Called with the deadline it was scheduled for. Returns the next deadline,
+  // or absl::InfiniteFuture() to remove the timer.
+  using Callback = std::function<absl::Time(absl::Time deadline)>;
+
+  static constexpr absl::Duration kDefaultSpinWindow = absl::Microseconds(50);
+
+  explicit Pacer(SimpleClock* clock,
+                 absl::Duration spin_window = kDefaultSpinWindow,
+                 ThreadPlacement placement = {});
+  ~Pacer();
+
+  // Returns the id of the new timer, to be passed to RemoveTimer:
+  int64_t AddTimer(absl::Time deadline, Callback callback);
+
+  // Removes the timer, after waiting for its callback to return if it is
+  // running. Must not be called from a callback.
+  void RemoveTimer(int64_t timer_id);
+
+  // Returns true if called from a callback:
+  bool IsPacerThread() const {
+    return std::this_thread::get_id() == thread_.get_id();
+  }
+
+ private:
+  struct Timer {
+    absl::Time deadline;
+    Callback callback;
+  };
+
+  void Run();
+  bool ShouldWakeUp() const {
+    return shutdown_.load(std::memory_order_relaxed) ||
+           wakeup_.load(std::memory_order_relaxed);
+  }
+
+  SimpleClock* clock_;
+  const absl::Duration spin_window_;
+  absl::Mutex mutex_;
+  TimerWheel wheel_ ABSL_GUARDED_BY(mutex_);
+  absl::flat_hash_map<int64_t, std::unique_ptr<Timer>> timers_
+      ABSL_GUARDED_BY(mutex_);
+  int64_t next_timer_id_ ABSL_GUARDED_BY(mutex_) = 0;
+  int64_t running_timer_id_ ABSL_GUARDED_BY(mutex_) = -1;
+  absl::Time sleep_deadline_ ABSL_GUARDED_BY(mutex_) = absl::InfiniteFuture();
+  // Only written with mutex_ held, so that ShouldWakeUp can be a Condition,
+  // but atomic so that Run can also poll them while spinning:
+  std::atomic<bool> wakeup_ = false;
+  std::atomic<bool> shutdown_ = false;
+  std::thread thread_;
+};
+
+}  // namespace distbench
+
+#endif  // DISTBENCH_DISTBENCH_PACER_H_
@@ -0,0 +1,149 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "distbench_pacer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <random>
+#include <vector>
+
+#include "absl/synchronization/notification.h"
+#include "gtest/gtest.h"
+#include "gtest_utils.h"
+
+namespace distbench {
+
+namespace {
+
+class RealClock : public SimpleClock {
+ public:
+  absl::Time Now() override { return absl::Now(); }
+
+  void SleepFor(absl::Duration duration) override { absl::SleepFor(duration); }
+
+  bool MutexLockWhenWithDeadline(absl::Mutex* mu,
+                                 const absl::Condition& condition,
+                                 absl::Time deadline)
+      ABSL_EXCLUSIVE_LOCK_FUNCTION(mu) override {
+    return mu->LockWhenWithDeadline(condition, deadline);
+  }
+};
+
+}  // anonymous namespace
+
+TEST(TimerWheelTest, ExpiresTimersAtTheirTicks) {
+  const int64_t start_tick = 1'700'000'000'000'000'000;
+  TimerWheel wheel(start_tick);
+  std::mt19937_64 rand_gen(42);
+  std::multimap<int64_t, int64_t> expected;
+  for (int64_t id = 0; id < 10000; ++id) {
+    // Spread over all the levels, including beyond the span of the wheel:
+    int64_t delay = rand_gen() >> (rand_gen() % 54 + 10);
+    expected.emplace(start_tick + delay, id);
+    wheel.Insert(start_tick + delay, id);
+  }
+  std::vector<int64_t> expired;
+  while (!expected.empty()) {
+    int64_t next_tick = wheel.NextTick();
+    ASSERT_LE(next_tick, expected.begin()->first);
+    wheel.AdvanceTo(next_tick, &expired);
+    for (int64_t id : expired) {
+      auto it = expected.begin();
+      ASSERT_EQ(it->first, next_tick);
+      while (it != expected.end() && it->second != id) ++it;
+      ASSERT_NE(it, expected.end());
+      ASSERT_EQ(it->first, next_tick);
+      expected.erase(it);
+    }
+    expired.clear();
+  }
+  EXPECT_EQ(wheel.NextTick(), TimerWheel::kNoTick);
+}
+
+TEST(TimerWheelTest, PastTimersExpireImmediately) {
+  TimerWheel wheel(1000);
+  wheel.Insert(999, 1);
+  wheel.Insert(1000, 2);
+  EXPECT_EQ(wheel.NextTick(), 1000);
+  std::vector<int64_t> expired;
+  wheel.AdvanceTo(1000, &expired);
+  EXPECT_EQ(expired, std::vector<int64_t>({1, 2}));
+}
+
+TEST(PacerTest, CallsBackNearDeadlines) {
+  RealClock clock;
+  Pacer pacer(&clock);
+  const absl::Duration period = absl::Microseconds(200);
+  const int kIterations = 100;
+  int calls = 0;
+  absl::Duration max_lag;
+  absl::Notification done;
+  absl::Time start = clock.Now() + absl::Milliseconds(1);
+  pacer.AddTimer(start, [&](absl::Time deadline) {
+    max_lag = std::max(max_lag, clock.Now() - deadline);
+    EXPECT_EQ(deadline, start + calls * period);
+    if (++calls == kIterations) {
+      done.Notify();
+      return absl::InfiniteFuture();
+    }
+    return deadline + period;
+  });
+  done.WaitForNotification();
+  EXPECT_GE(max_lag, absl::ZeroDuration());
+  EXPECT_LT(max_lag, absl::Milliseconds(100));
+}
+
+TEST(PacerTest, RemoveTimer) {
+  RealClock clock;
+  Pacer pacer(&clock);
+  std::atomic<int> calls = 0;
+  int64_t timer_id =
+      pacer.AddTimer(clock.Now() + absl::Hours(1), [&](absl::Time deadline) {
+        ++calls;
+        return deadline;
+      });
+  absl::Notification ran;
+  pacer.AddTimer(clock.Now(), [&](absl::Time deadline) {
+    ran.Notify();
+    return absl::InfiniteFuture();
+  });
+  ran.WaitForNotification();
+  pacer.RemoveTimer(timer_id);
+  EXPECT_EQ(calls, 0);
+}
+
+TEST(PacerTest, SoonerTimerCutsSpinShort) {
+  RealClock clock;
+  // A spin window long enough that the pacer spins towards the first timer:
+  Pacer pacer(&clock, absl::Seconds(10));
+  absl::Notification late_ran;
+  pacer.AddTimer(clock.Now() + absl::Seconds(2), [&](absl::Time deadline) {
+    late_ran.Notify();
+    return absl::InfiniteFuture();
+  });
+  absl::SleepFor(absl::Milliseconds(10));
+  absl::Time start = clock.Now();
+  absl::Notification ran;
+  pacer.AddTimer(start, [&](absl::Time deadline) {
+    ran.Notify();
+    return absl::InfiniteFuture();
+  });
+  ran.WaitForNotification();
+  EXPECT_LT(clock.Now() - start, absl::Seconds(1));
+  late_ran.WaitForNotification();
+}
+
+}  // namespace distbench
@@ -0,0 +1,44 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "distbench_payload_pool.h"
+
+#include "distbench_thread_support.h"
+
+namespace distbench {
+
+namespace {
+const char kPayloadFiller = 'D';
+}  // anonymous namespace
+
+void PayloadPool::Reserve(int64_t size) {
+  if (size <= static_cast<int64_t>(buffer_.size())) return;
+  buffer_.assign(size, kPayloadFiller);
+}
+
+void PayloadPool::FillPayload(int64_t size, std::string* payload) const {
+  if (size <= 0) {
+    payload->clear();
+  } else if (static_cast<size_t>(size) <= buffer_.size()) {
+    payload->assign(buffer_.data(), size);
+  } else {
+    payload->assign(size, kPayloadFiller);
+  }
+}
+
+absl::Status PayloadPool::BindToNumaNode(int numa_node) {
+  return BindMemoryToNumaNode(buffer_.data(), buffer_.size(), numa_node);
+}
+
+}  // namespace distbench
@@ -0,0 +1,54 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef DISTBENCH_DISTBENCH_PAYLOAD_POOL_H_
+#define DISTBENCH_DISTBENCH_PAYLOAD_POOL_H_
+
+#include <cstdint>
+#include <string>
+
+#include "absl/status/status.h"
+
+namespace distbench {
+
+// Holds a single immutable buffer of payload bytes that is large enough for
+// every payload an engine may send. Request and response payloads are copied
+// out of this buffer, rather than being constructed from scratch for each RPC.
+// When the destination string is recycled across RPCs (e.g. the ClientRpcState
+// of a closed-loop action) its capacity is reused, so filling the payload does
+// not touch the allocator at all.
+class PayloadPool {
+ public:
+  // Grows the buffer so that payloads of up to |size| bytes are served
+  // from the pool. Must only be called during initialization, before any
+  // concurrent calls to FillPayload.
+  void Reserve(int64_t size);
+
+  // Sets |payload| to |size| bytes of payload data. Sizes that were not
+  // reserved are still handled, but fall back to building the payload in place.
+  void FillPayload(int64_t size, std::string* payload) const;
+
+  // Moves the buffer to the memory of |numa_node|, so that payloads are
+  // copied from the node the engine runs on. Must be called after Reserve.
+  absl::Status BindToNumaNode(int numa_node);
+
+  size_t capacity() const { return buffer_.size(); }
+
+ private:
+  std::string buffer_;
+};
+
+}  // namespace distbench
+
+#endif  // DISTBENCH_DISTBENCH_PAYLOAD_POOL_H_
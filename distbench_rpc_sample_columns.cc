@@ -0,0 +1,200 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "distbench_rpc_sample_columns.h"
+
+#include <algorithm>
+
+#include "glog/logging.h"
+
+namespace distbench {
+
+namespace {
+
+template <typename T>
+bool OnlyHolds(const google::protobuf::RepeatedField<T>& column,
+               T default_value) {
+  return std::all_of(column.begin(), column.end(), [default_value](T value) {
+    return value == default_value;
+  });
+}
+
+// Appends an optional column of 'from' to the one of 'to', filling in the
+// default value for whichever side left its column empty:
+template <typename T>
+void MergeOptionalColumn(const google::protobuf::RepeatedField<T>& from,
+                         int from_size, int to_size, T default_value,
+                         google::protobuf::RepeatedField<T>* to) {
+  if (from.empty() && to->empty()) return;
+  if (to->empty()) to->Resize(to_size, default_value);
+  if (from.empty()) {
+    to->Resize(to_size + from_size, default_value);
+  } else {
+    to->MergeFrom(from);
+  }
+}
+
+// Expands a column that was collapsed into a single entry because every
+// sample holds the same value:
+void ExpandColumn(int size, google::protobuf::RepeatedField<int64_t>* column) {
+  if (size > 1 && column->size() == 1) {
+    const int64_t value = column->Get(0);
+    column->Resize(size, value);
+  }
+}
+
+void CollapseColumn(google::protobuf::RepeatedField<int64_t>* column) {
+  if (column->size() > 1 && OnlyHolds(*column, column->Get(0))) {
+    column->Truncate(1);
+  }
+}
+
+void MergeSizeColumn(const google::protobuf::RepeatedField<int64_t>& from,
+                     int from_size, int to_size,
+                     google::protobuf::RepeatedField<int64_t>* to) {
+  if (to->size() == 1 && from.size() == 1 && to->Get(0) == from.Get(0)) {
+    return;
+  }
+  ExpandColumn(to_size, to);
+  if (from.size() == 1) {
+    to->Resize(to_size + from_size, from.Get(0));
+  } else {
+    to->MergeFrom(from);
+  }
+}
+
+}  // anonymous namespace
+
+int RpcSampleColumnsSize(const RpcSampleColumns& columns) {
+  return columns.latency_ns_size();
+}
+
+int64_t RpcSampleColumnValue(
+    const google::protobuf::RepeatedField<int64_t>& column, int index) {
+  return column.Get(column.size() == 1 ? 0 : index);
+}
+
+void AppendRpcSample(const RpcSample& sample, RpcSampleColumns* columns) {
+  const int index = RpcSampleColumnsSize(*columns);
+  DCHECK_EQ(columns->warmup_size(), index)
+      << "Appending to finished RpcSampleColumns";
+  columns->add_start_timestamp_ns_deltas(sample.start_timestamp_ns());
+  columns->add_latency_ns(sample.latency_ns());
+  columns->add_request_size(sample.request_size());
+  columns->add_response_size(sample.response_size());
+  columns->add_latency_weight(sample.latency_weight());
+  columns->add_warmup(sample.warmup());
+  columns->add_error_index(sample.error_index());
+  columns->add_send_lag_ns(sample.send_lag_ns());
+  if (sample.has_trace_context()) {
+    columns->add_trace_context_sample_indices(index);
+    *columns->add_trace_contexts() = sample.trace_context();
+  }
+}
+
+void FinishRpcSampleColumns(RpcSampleColumns* columns) {
+  auto& starts = *columns->mutable_start_timestamp_ns_deltas();
+  for (int i = starts.size() - 1; i > 0; --i) {
+    starts[i] -= starts[i - 1];
+  }
+  if (OnlyHolds<int64_t>(columns->latency_weight(), 1)) {
+    columns->clear_latency_weight();
+  }
+  if (OnlyHolds(columns->warmup(), false)) {
+    columns->clear_warmup();
+  }
+  if (OnlyHolds(columns->error_index(), 0)) {
+    columns->clear_error_index();
+  }
+  if (OnlyHolds<int64_t>(columns->send_lag_ns(), 0)) {
+    columns->clear_send_lag_ns();
+  }
+  CollapseColumn(columns->mutable_request_size());
+  CollapseColumn(columns->mutable_response_size());
+}
+
+void MergeRpcSampleColumns(const RpcSampleColumns& from, RpcSampleColumns* to) {
+  const int from_size = RpcSampleColumnsSize(from);
+  const int to_size = RpcSampleColumnsSize(*to);
+  if (from_size == 0) return;
+  if (to_size == 0) {
+    *to = from;
+    return;
+  }
+  int64_t last_start_timestamp_ns = 0;
+  for (int64_t delta : to->start_timestamp_ns_deltas()) {
+    last_start_timestamp_ns += delta;
+  }
+  // The first delta of 'from' is relative to zero:
+  to->add_start_timestamp_ns_deltas(from.start_timestamp_ns_deltas(0) -
+                                    last_start_timestamp_ns);
+  to->mutable_start_timestamp_ns_deltas()->Add(
+      from.start_timestamp_ns_deltas().begin() + 1,
+      from.start_timestamp_ns_deltas().end());
+  to->mutable_latency_ns()->MergeFrom(from.latency_ns());
+  MergeSizeColumn(from.request_size(), from_size, to_size,
+                  to->mutable_request_size());
+  MergeSizeColumn(from.response_size(), from_size, to_size,
+                  to->mutable_response_size());
+  MergeOptionalColumn<int64_t>(from.latency_weight(), from_size, to_size, 1,
+                               to->mutable_latency_weight());
+  MergeOptionalColumn(from.warmup(), from_size, to_size, false,
+                      to->mutable_warmup());
+  MergeOptionalColumn(from.error_index(), from_size, to_size, 0,
+                      to->mutable_error_index());
+  MergeOptionalColumn<int64_t>(from.send_lag_ns(), from_size, to_size, 0,
+                               to->mutable_send_lag_ns());
+  for (int index : from.trace_context_sample_indices()) {
+    to->add_trace_context_sample_indices(to_size + index);
+  }
+  to->mutable_trace_contexts()->MergeFrom(from.trace_contexts());
+}
+
+void AppendRpcSamplesFromColumns(
+    const RpcSampleColumns& columns,
+    google::protobuf::RepeatedPtrField<RpcSample>* samples) {
+  const int size = RpcSampleColumnsSize(columns);
+  samples->Reserve(samples->size() + size);
+  int64_t start_timestamp_ns = 0;
+  int trace_context = 0;
+  for (int i = 0; i < size; ++i) {
+    start_timestamp_ns += columns.start_timestamp_ns_deltas(i);
+    RpcSample* sample = samples->Add();
+    sample->set_request_size(
+        RpcSampleColumnValue(columns.request_size(), i));
+    sample->set_response_size(
+        RpcSampleColumnValue(columns.response_size(), i));
+    sample->set_start_timestamp_ns(start_timestamp_ns);
+    sample->set_latency_ns(columns.latency_ns(i));
+    if (!columns.latency_weight().empty() && columns.latency_weight(i) != 1) {
+      sample->set_latency_weight(columns.latency_weight(i));
+    }
+    if (!columns.warmup().empty() && columns.warmup(i)) {
+      sample->set_warmup(true);
+    }
+    if (!columns.error_index().empty() && columns.error_index(i)) {
+      sample->set_error_index(columns.error_index(i));
+    }
+    if (!columns.send_lag_ns().empty() && columns.send_lag_ns(i)) {
+      sample->set_send_lag_ns(columns.send_lag_ns(i));
+    }
+    if (trace_context < columns.trace_context_sample_indices_size() &&
+        columns.trace_context_sample_indices(trace_context) == i) {
+      *sample->mutable_trace_context() =
+          columns.trace_contexts(trace_context++);
+    }
+  }
+}
+
+}  // namespace distbench
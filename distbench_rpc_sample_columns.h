@@ -0,0 +1,48 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef DISTBENCH_DISTBENCH_RPC_SAMPLE_COLUMNS_H_
+#define DISTBENCH_DISTBENCH_RPC_SAMPLE_COLUMNS_H_
+
+#include "distbench.pb.h"
+
+namespace distbench {
+
+// Returns the number of samples held by columns:
+int RpcSampleColumnsSize(const RpcSampleColumns& columns);
+
+// Returns entry index of a size column, which may have been collapsed into a
+// single entry:
+int64_t RpcSampleColumnValue(
+    const google::protobuf::RepeatedField<int64_t>& column, int index);
+
+// Appends sample to columns, which must not be finished yet. Its start
+// timestamp is stored as is until FinishRpcSampleColumns is called.
+void AppendRpcSample(const RpcSample& sample, RpcSampleColumns* columns);
+
+// Delta encodes the start timestamps and drops the optional columns that only
+// hold default values. Must be called once, after the last AppendRpcSample.
+void FinishRpcSampleColumns(RpcSampleColumns* columns);
+
+// Appends the samples of 'from' to 'to'. Both must be finished.
+void MergeRpcSampleColumns(const RpcSampleColumns& from, RpcSampleColumns* to);
+
+// Decodes finished columns, appending one RpcSample per sample to samples:
+void AppendRpcSamplesFromColumns(
+    const RpcSampleColumns& columns,
+    google::protobuf::RepeatedPtrField<RpcSample>* samples);
+
+}  // namespace distbench
+
+#endif  // DISTBENCH_DISTBENCH_RPC_SAMPLE_COLUMNS_H_
@@ -0,0 +1,132 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "distbench_rpc_sample_columns.h"
+
+#include "google/protobuf/util/message_differencer.h"
+#include "gtest/gtest.h"
+#include "gtest_utils.h"
+
+namespace distbench {
+
+namespace {
+
+RpcSample MakeSample(int i) {
+  RpcSample sample;
+  sample.set_request_size(16);
+  sample.set_response_size(1024);
+  // Samples are stored in completion order, so the start timestamps are not
+  // always increasing:
+  sample.set_start_timestamp_ns(1'622'744'047'420'305'230 + 1000 * i -
+                                (i % 4) * 1500);
+  sample.set_latency_ns(700'000 + (i * 7919) % 50'000);
+  return sample;
+}
+
+RpcSampleColumns EncodeSamples(
+    const google::protobuf::RepeatedPtrField<RpcSample>& samples) {
+  RpcSampleColumns columns;
+  for (const auto& sample : samples) {
+    AppendRpcSample(sample, &columns);
+  }
+  FinishRpcSampleColumns(&columns);
+  return columns;
+}
+
+void ExpectSameSamples(
+    const google::protobuf::RepeatedPtrField<RpcSample>& expected,
+    const RpcSampleColumns& columns) {
+  RpcPerformanceLog expected_log;
+  *expected_log.mutable_successful_rpc_samples() = expected;
+  RpcPerformanceLog decoded_log;
+  AppendRpcSamplesFromColumns(columns,
+                              decoded_log.mutable_successful_rpc_samples());
+  EXPECT_TRUE(google::protobuf::util::MessageDifferencer::Equals(expected_log,
+                                                                 decoded_log))
+      << decoded_log.DebugString();
+}
+
+}  // anonymous namespace
+
+TEST(RpcSampleColumnsTest, RoundTrip) {
+  google::protobuf::RepeatedPtrField<RpcSample> samples;
+  for (int i = 0; i < 100; ++i) {
+    *samples.Add() = MakeSample(i);
+  }
+  samples[3].set_warmup(true);
+  samples[5].set_latency_weight(4);
+  samples[7].set_error_index(2);
+  samples[9].mutable_trace_context()->add_engine_ids(1);
+  samples[9].mutable_trace_context()->add_iterations(9);
+  samples[11].set_response_size(2048);
+  samples[13].set_send_lag_ns(25'000);
+  RpcSampleColumns columns = EncodeSamples(samples);
+  EXPECT_EQ(RpcSampleColumnsSize(columns), 100);
+  EXPECT_EQ(columns.warmup_size(), 100);
+  EXPECT_EQ(columns.latency_weight_size(), 100);
+  EXPECT_EQ(columns.error_index_size(), 100);
+  EXPECT_EQ(columns.send_lag_ns_size(), 100);
+  EXPECT_EQ(columns.trace_contexts_size(), 1);
+  ExpectSameSamples(samples, columns);
+}
+
+TEST(RpcSampleColumnsTest, DefaultColumnsAreDropped) {
+  google::protobuf::RepeatedPtrField<RpcSample> samples;
+  for (int i = 0; i < 10; ++i) {
+    *samples.Add() = MakeSample(i);
+  }
+  RpcSampleColumns columns = EncodeSamples(samples);
+  EXPECT_TRUE(columns.latency_weight().empty());
+  EXPECT_TRUE(columns.warmup().empty());
+  EXPECT_TRUE(columns.error_index().empty());
+  EXPECT_TRUE(columns.trace_contexts().empty());
+  EXPECT_EQ(columns.request_size_size(), 1);
+  EXPECT_EQ(columns.response_size_size(), 1);
+  ExpectSameSamples(samples, columns);
+}
+
+TEST(RpcSampleColumnsTest, Merge) {
+  google::protobuf::RepeatedPtrField<RpcSample> first;
+  google::protobuf::RepeatedPtrField<RpcSample> second;
+  for (int i = 0; i < 20; ++i) {
+    *first.Add() = MakeSample(i);
+    *second.Add() = MakeSample(i + 20);
+  }
+  second[1].set_warmup(true);
+  second[3].set_request_size(32);
+  second[2].mutable_trace_context()->add_engine_ids(3);
+  RpcSampleColumns merged;
+  MergeRpcSampleColumns(EncodeSamples(first), &merged);
+  MergeRpcSampleColumns(EncodeSamples(second), &merged);
+  google::protobuf::RepeatedPtrField<RpcSample> all = first;
+  all.MergeFrom(second);
+  EXPECT_EQ(merged.warmup_size(), 40);
+  EXPECT_EQ(merged.trace_context_sample_indices(0), 22);
+  EXPECT_EQ(merged.request_size_size(), 40);
+  EXPECT_EQ(merged.response_size_size(), 1);
+  ExpectSameSamples(all, merged);
+}
+
+TEST(RpcSampleColumnsTest, IsCompact) {
+  RpcPerformanceLog samples_log;
+  for (int i = 0; i < 10000; ++i) {
+    *samples_log.add_successful_rpc_samples() = MakeSample(i);
+  }
+  RpcPerformanceLog columns_log;
+  *columns_log.mutable_successful_rpc_sample_columns() =
+      EncodeSamples(samples_log.successful_rpc_samples());
+  EXPECT_LT(columns_log.ByteSizeLong() * 4, samples_log.ByteSizeLong());
+}
+
+}  // namespace distbench
@@ -0,0 +1,40 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "distbench_spin_wait.h"
+
+#include <algorithm>
+
+namespace distbench {
+
+AdaptiveSpinner::AdaptiveSpinner(int64_t max_spin_ns, SpinStats* stats)
+    : max_spin_ns_(std::max<int64_t>(max_spin_ns, 0)),
+      min_spin_ns_(std::max<int64_t>(max_spin_ns_ / 16, 1)),
+      budget_ns_(max_spin_ns_),
+      stats_(stats) {}
+
+void AdaptiveSpinner::Record(bool hit, int64_t spin_ns) {
+  if (hit) {
+    budget_ns_ = std::min(budget_ns_ * 2, max_spin_ns_);
+  } else {
+    budget_ns_ = std::max(budget_ns_ / 2, min_spin_ns_);
+  }
+  if (stats_) {
+    stats_->spin_ns.fetch_add(spin_ns, std::memory_order_relaxed);
+    (hit ? stats_->spin_hits : stats_->spin_misses)
+        .fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+}  // namespace distbench
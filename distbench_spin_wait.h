@@ -0,0 +1,93 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef DISTBENCH_DISTBENCH_SPIN_WAIT_H_
+#define DISTBENCH_DISTBENCH_SPIN_WAIT_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace distbench {
+
+// Tells the cpu that we are busy waiting, so that it can save power and give
+// its resources to a sibling hyperthread.
+inline void CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  asm volatile("yield" ::: "memory");
+#endif
+}
+
+// Shared by the spinners of a threadpool or poller, for reporting.
+struct SpinStats {
+  // Time spent spinning, i.e. the cpu time that spinning costs:
+  std::atomic<int64_t> spin_ns = 0;
+  // Spins that found work, and so avoided parking:
+  std::atomic<int64_t> spin_hits = 0;
+  // Spins that ran out of budget, after which the thread parked:
+  std::atomic<int64_t> spin_misses = 0;
+};
+
+// Lets an idle thread poll for work for a while before it parks on a mutex,
+// futex or completion queue, so that work arriving shortly afterwards does
+// not pay for a wakeup. The budget adapts, as in adaptive mutexes: it doubles
+// (up to max_spin_ns) whenever spinning finds work, and halves (down to a
+// sixteenth of max_spin_ns) whenever it does not, so that a thread that is
+// idle for long periods does not keep burning its full budget.
+// Each thread should have its own spinner.
+class AdaptiveSpinner {
+ public:
+  // Spinning is disabled if max_spin_ns is not positive.
+  AdaptiveSpinner(int64_t max_spin_ns, SpinStats* stats);
+
+  bool enabled() const { return max_spin_ns_ > 0; }
+
+  // Polls ready() until it returns true, or the budget runs out.
+  // Returns the last value returned by ready().
+  template <typename Predicate>
+  bool SpinUntil(Predicate ready) {
+    if (!enabled()) return ready();
+    auto start = std::chrono::steady_clock::now();
+    auto deadline = start + std::chrono::nanoseconds(budget_ns_);
+    bool hit = false;
+    while (true) {
+      if (ready()) {
+        hit = true;
+        break;
+      }
+      CpuRelax();
+      if (std::chrono::steady_clock::now() >= deadline) break;
+    }
+    Record(hit, std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - start)
+                    .count());
+    return hit;
+  }
+
+  int64_t budget_ns() const { return budget_ns_; }
+
+ private:
+  void Record(bool hit, int64_t spin_ns);
+
+  const int64_t max_spin_ns_;
+  const int64_t min_spin_ns_;
+  int64_t budget_ns_;
+  SpinStats* stats_;
+};
+
+}  // namespace distbench
+
+#endif  // DISTBENCH_DISTBENCH_SPIN_WAIT_H_
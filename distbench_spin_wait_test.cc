@@ -0,0 +1,70 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "distbench_spin_wait.h"
+
+#include <atomic>
+#include <thread>
+
+#include "gtest/gtest.h"
+#include "gtest_utils.h"
+
+namespace distbench {
+
+TEST(AdaptiveSpinnerTest, Disabled) {
+  SpinStats stats;
+  AdaptiveSpinner spinner(0, &stats);
+  ASSERT_FALSE(spinner.enabled());
+  int polls = 0;
+  ASSERT_FALSE(spinner.SpinUntil([&]() {
+    ++polls;
+    return false;
+  }));
+  ASSERT_EQ(polls, 1);
+  ASSERT_EQ(stats.spin_misses, 0);
+  ASSERT_EQ(stats.spin_ns, 0);
+}
+
+TEST(AdaptiveSpinnerTest, BudgetShrinksOnMissesAndGrowsOnHits) {
+  const int64_t max_spin_ns = 1'000'000;
+  SpinStats stats;
+  AdaptiveSpinner spinner(max_spin_ns, &stats);
+  ASSERT_EQ(spinner.budget_ns(), max_spin_ns);
+  for (int i = 0; i < 10; ++i) {
+    ASSERT_FALSE(spinner.SpinUntil([]() { return false; }));
+  }
+  ASSERT_EQ(spinner.budget_ns(), max_spin_ns / 16);
+  ASSERT_EQ(stats.spin_misses, 10);
+  // Each miss spins for at least its budget:
+  ASSERT_GE(stats.spin_ns, max_spin_ns * (1 + 1.0 / 2 + 1.0 / 4 + 1.0 / 8) +
+                               6 * max_spin_ns / 16);
+  for (int i = 0; i < 10; ++i) {
+    ASSERT_TRUE(spinner.SpinUntil([]() { return true; }));
+  }
+  ASSERT_EQ(spinner.budget_ns(), max_spin_ns);
+  ASSERT_EQ(stats.spin_hits, 10);
+}
+
+TEST(AdaptiveSpinnerTest, SeesWorkFromAnotherThread) {
+  SpinStats stats;
+  // Long enough not to run out before the other thread gets to run:
+  AdaptiveSpinner spinner(10'000'000'000, &stats);
+  std::atomic<bool> ready = false;
+  std::thread producer([&]() { ready = true; });
+  ASSERT_TRUE(spinner.SpinUntil([&]() { return ready.load(); }));
+  producer.join();
+  ASSERT_EQ(stats.spin_hits, 1);
+}
+
+}  // namespace distbench
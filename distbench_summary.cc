@@ -14,35 +14,182 @@
 
 #include "distbench_summary.h"
 
+#include <algorithm>
+
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/str_split.h"
+#include "distbench_latency_histogram.h"
+#include "distbench_rpc_sample_columns.h"
 #include "glog/logging.h"
 
 namespace distbench {
 
 namespace {
 
-std::string LatencySummary(std::vector<int64_t> latencies) {
+using WeightedLatency = TestResultSummarizer::WeightedLatency;
+
+// Returns the latency at which the cumulative weight of the samples first
+// exceeds quantile * total_weight. With unit weights this is the sample
+// ranked N * quantile. The samples must be sorted by latency.
+int64_t WeightedQuantile(const std::vector<WeightedLatency>& latencies,
+                         int64_t total_weight, double quantile) {
+  const double threshold = quantile * total_weight;
+  int64_t cumulative_weight = 0;
+  for (const auto& latency : latencies) {
+    cumulative_weight += latency.weight;
+    if (cumulative_weight > threshold) return latency.latency_ns;
+  }
+  return latencies.back().latency_ns;
+}
+
+std::string LatencySummary(std::vector<WeightedLatency>& latencies) {
+  std::sort(latencies.begin(), latencies.end(),
+            [](const WeightedLatency& a, const WeightedLatency& b) {
+              return a.latency_ns < b.latency_ns;
+            });
   size_t N = latencies.size();
   std::string ret;
   absl::StrAppendFormat(&ret, "N: %ld", N);
   if (N > 0) {
-    absl::StrAppendFormat(&ret, " min: %ldns", *latencies.begin());
-    absl::StrAppendFormat(&ret, " median: %ldns", latencies[N * 0.5]);
-    absl::StrAppendFormat(&ret, " 90%%: %ldns", latencies[N * 0.9]);
-    absl::StrAppendFormat(&ret, " 99%%: %ldns", latencies[N * 0.99]);
-    absl::StrAppendFormat(&ret, " 99.9%%: %ldns", latencies[N * 0.999]);
-    absl::StrAppendFormat(&ret, " max: %ldns", *latencies.rbegin());
+    int64_t total_weight = 0;
+    for (const auto& latency : latencies) {
+      total_weight += latency.weight;
+    }
+    absl::StrAppendFormat(&ret, " min: %ldns", latencies.front().latency_ns);
+    absl::StrAppendFormat(&ret, " median: %ldns",
+                          WeightedQuantile(latencies, total_weight, 0.5));
+    absl::StrAppendFormat(&ret, " 90%%: %ldns",
+                          WeightedQuantile(latencies, total_weight, 0.9));
+    absl::StrAppendFormat(&ret, " 99%%: %ldns",
+                          WeightedQuantile(latencies, total_weight, 0.99));
+    absl::StrAppendFormat(&ret, " 99.9%%: %ldns",
+                          WeightedQuantile(latencies, total_weight, 0.999));
+    absl::StrAppendFormat(&ret, " max: %ldns", latencies.back().latency_ns);
   }
   return ret;
 }
 
-struct rpc_traffic_summary {
-  int64_t nb_rpcs = 0;
-  int64_t request_size = 0;
-  int64_t response_size = 0;
-};
+// The percentiles come from weighted_histogram, if it has any latencies,
+// which must be the same as those of histogram, with other counts:
+std::string LatencySummary(
+    const LatencyHistogram& histogram,
+    const LatencyHistogram* weighted_histogram = nullptr) {
+  int64_t N = LatencyHistogramCount(histogram);
+  const LatencyHistogram& quantiles =
+      weighted_histogram && !weighted_histogram->bucket_indices().empty()
+          ? *weighted_histogram
+          : histogram;
+  std::string ret;
+  absl::StrAppendFormat(&ret, "N: %ld", N);
+  if (N > 0) {
+    absl::StrAppendFormat(&ret, " min: %ldns", histogram.min_latency_ns());
+    absl::StrAppendFormat(&ret, " median: %ldns",
+                          LatencyHistogramQuantile(quantiles, 0.5));
+    absl::StrAppendFormat(&ret, " 90%%: %ldns",
+                          LatencyHistogramQuantile(quantiles, 0.9));
+    absl::StrAppendFormat(&ret, " 99%%: %ldns",
+                          LatencyHistogramQuantile(quantiles, 0.99));
+    absl::StrAppendFormat(&ret, " 99.9%%: %ldns",
+                          LatencyHistogramQuantile(quantiles, 0.999));
+    absl::StrAppendFormat(&ret, " max: %ldns", histogram.max_latency_ns());
+  }
+  return ret;
+}
+
+// Adds a line per RPC, preferring the histograms over the samples:
+void AddLatencySummariesTo(
+    std::vector<std::string>& ret,
+    std::map<std::string, std::vector<WeightedLatency>>& latency_map,
+    const std::map<std::string, LatencyHistogram>& histogram_map,
+    const std::map<std::string, LatencyHistogram>& weighted_histogram_map) {
+  std::map<std::string, std::string> latency_summaries;
+  for (auto& latencies : latency_map) {
+    if (histogram_map.count(latencies.first)) continue;
+    latency_summaries[latencies.first] = LatencySummary(latencies.second);
+  }
+  for (const auto& histogram : histogram_map) {
+    auto weighted_histogram = weighted_histogram_map.find(histogram.first);
+    latency_summaries[histogram.first] = LatencySummary(
+        histogram.second, weighted_histogram == weighted_histogram_map.end()
+                              ? nullptr
+                              : &weighted_histogram->second);
+  }
+  for (const auto& latency_summary : latency_summaries) {
+    std::string str{};
+    absl::StrAppendFormat(&str, "  %s: %s", latency_summary.first,
+                          latency_summary.second);
+    ret.push_back(str);
+  }
+}
+
+// Adds a line per memory activity config, with the bandwidth or the latency
+// that its iterations achieved, each on its own thread:
+void AddMemoryActivitySummariesTo(
+    std::vector<std::string>& ret,
+    const std::map<std::string, std::map<std::string, int64_t>>&
+        activity_metrics_map) {
+  std::vector<std::string> summaries;
+  for (const auto& [activity_config_name, metrics] : activity_metrics_map) {
+    auto access_time_ns = metrics.find("access_time_ns");
+    if (access_time_ns == metrics.end() || access_time_ns->second <= 0) {
+      continue;
+    }
+    double time_ns = access_time_ns->second;
+    auto bytes = metrics.find("bytes_accessed");
+    if (bytes != metrics.end()) {
+      summaries.push_back(absl::StrFormat("  %s: %3.2f GB/s per thread",
+                                          activity_config_name,
+                                          bytes->second / time_ns));
+    }
+    auto accesses = metrics.find("accesses");
+    if (accesses != metrics.end() && accesses->second > 0) {
+      summaries.push_back(absl::StrFormat("  %s: %3.2f ns/access",
+                                          activity_config_name,
+                                          time_ns / accesses->second));
+    }
+  }
+  if (summaries.empty()) return;
+  ret.push_back("Memory activity summary:");
+  ret.insert(ret.end(), summaries.begin(), summaries.end());
+}
+
+// Adds the throughput of each FileIo activity config, and the latencies of
+// its operations:
+void AddFileIoSummariesTo(
+    std::vector<std::string>& ret,
+    const std::map<std::string, std::map<std::string, int64_t>>&
+        activity_metrics_map,
+    const std::map<std::pair<std::string, std::string>, LatencyHistogram>&
+        operation_latency_map) {
+  std::vector<std::string> summaries;
+  for (const auto& [activity_config_name, metrics] : activity_metrics_map) {
+    auto io_time_ns = metrics.find("io_time_ns");
+    if (io_time_ns == metrics.end() || io_time_ns->second <= 0) continue;
+    auto metric = [&metrics](const std::string& name) -> int64_t {
+      auto it = metrics.find(name);
+      return it == metrics.end() ? 0 : it->second;
+    };
+    double seconds = io_time_ns->second / 1e9;
+    constexpr double MiB = 1024 * 1024;
+    summaries.push_back(absl::StrFormat(
+        "  %s: %3.0f IOPS, %3.1f MiB/s per iteration stream, %d errors",
+        activity_config_name,
+        (metric("reads") + metric("writes")) / seconds,
+        (metric("bytes_read") + metric("bytes_written")) / MiB / seconds,
+        metric("io_errors")));
+  }
+  for (const auto& [key, histogram] : operation_latency_map) {
+    summaries.push_back(absl::StrFormat("  %s %s latency: %s", key.first,
+                                        key.second,
+                                        LatencySummary(histogram)));
+  }
+  if (summaries.empty()) return;
+  ret.push_back("Activity I/O summary:");
+  ret.insert(ret.end(), summaries.begin(), summaries.end());
+}
+
+using rpc_traffic_summary = TestResultSummarizer::RpcTrafficSummary;
 
 typedef std::pair<std::string, std::string> t_string_pair;
 
@@ -136,69 +283,198 @@ void AddInstanceSummaryTo(std::vector<std::string>& ret,
 
 }  // anonymous namespace
 
-std::vector<std::string> SummarizeTestResult(const TestResult& test_result) {
-  std::map<std::string, std::vector<int64_t>> latency_map;
-  std::map<t_string_pair, rpc_traffic_summary> perf_map;
-  int64_t test_time = 0;
-  int64_t nb_warmup_samples = 0;
-  int64_t nb_failed_samples = 0;
+TestResultSummarizer::TestResultSummarizer(
+    const DistributedSystemDescription& traffic_config)
+    : traffic_config_(traffic_config) {}
 
-  for (const auto& instance_log : test_result.service_logs().instance_logs()) {
-    const std::string& initiator_instance_name = instance_log.first;
-    for (const auto& peer_log : instance_log.second.peer_logs()) {
-      const std::string& target_instance_name = peer_log.first;
-      int64_t start_timestamp_ns = std::numeric_limits<int64_t>::max();
-      int64_t end_timestamp_ns = std::numeric_limits<int64_t>::min();
-      rpc_traffic_summary perf_record{};
-      for (const auto& rpc_log : peer_log.second.rpc_logs()) {
-        std::string rpc_name =
-            test_result.traffic_config().rpc_descriptions(rpc_log.first).name();
-        std::vector<int64_t>& latencies = latency_map[rpc_name];
-        perf_record.nb_rpcs += rpc_log.second.successful_rpc_samples().size();
-        nb_failed_samples += rpc_log.second.failed_rpc_samples().size();
-        for (const auto& sample : rpc_log.second.successful_rpc_samples()) {
-          int64_t rpc_start_timestamp_ns = sample.start_timestamp_ns();
-          int64_t rpc_latency_ns = sample.latency_ns();
-          int64_t rpc_request_size = sample.request_size();
-          int64_t rpc_response_size = sample.response_size();
-          if (sample.warmup()) {
-            ++nb_warmup_samples;
-            continue;
-          }
-
-          start_timestamp_ns =
-              std::min(rpc_start_timestamp_ns, start_timestamp_ns);
-          end_timestamp_ns = std::max(rpc_start_timestamp_ns + rpc_latency_ns,
-                                      end_timestamp_ns);
-          perf_record.request_size += rpc_request_size;
-          perf_record.response_size += rpc_response_size;
-          latencies.push_back(rpc_latency_ns);
+void TestResultSummarizer::AddInstanceLog(
+    const std::string& initiator_instance_name,
+    const ServicePerformanceLog& instance_log) {
+  for (const auto& peer_log : instance_log.peer_logs()) {
+    const std::string& target_instance_name = peer_log.first;
+    int64_t start_timestamp_ns = std::numeric_limits<int64_t>::max();
+    int64_t end_timestamp_ns = std::numeric_limits<int64_t>::min();
+    rpc_traffic_summary perf_record{};
+    for (const auto& rpc_log : peer_log.second.rpc_logs()) {
+      std::string rpc_name =
+          traffic_config_.rpc_descriptions(rpc_log.first).name();
+      if (rpc_log.second.has_statistics()) {
+        const RpcStatistics& statistics = rpc_log.second.statistics();
+        perf_record.nb_rpcs +=
+            statistics.successful_rpcs() + statistics.warmup_rpcs();
+        nb_failed_samples_ += statistics.failed_rpcs();
+        nb_warmup_samples_ += statistics.warmup_rpcs();
+        perf_record.request_size += statistics.request_bytes();
+        perf_record.response_size += statistics.response_bytes();
+        if (statistics.successful_rpcs()) {
+          start_timestamp_ns = std::min(statistics.first_start_timestamp_ns(),
+                                        start_timestamp_ns);
+          end_timestamp_ns =
+              std::max(statistics.last_end_timestamp_ns(), end_timestamp_ns);
+        }
+        MergeLatencyHistogram(statistics.latency_histogram(),
+                              &histogram_map_[rpc_name]);
+        MergeLatencyHistogram(statistics.weighted_latency_histogram(),
+                              &weighted_histogram_map_[rpc_name]);
+        // Response time histograms are unweighted: they only differ from the
+        // latencies for open loop senders, whose RPCs merely weigh their
+        // scheduled intervals:
+        if (statistics.has_response_time_histogram()) {
+          has_send_lag_ = true;
+          MergeLatencyHistogram(statistics.response_time_histogram(),
+                                &response_time_histogram_map_[rpc_name]);
+        } else {
+          MergeLatencyHistogram(statistics.latency_histogram(),
+                                &response_time_histogram_map_[rpc_name]);
         }
+        continue;
       }
-      if (start_timestamp_ns != std::numeric_limits<int64_t>::max()) {
-        test_time = std::max(test_time, end_timestamp_ns - start_timestamp_ns);
+      std::vector<WeightedLatency>& latencies = latency_map_[rpc_name];
+      std::vector<WeightedLatency>& response_times =
+          response_time_map_[rpc_name];
+      // The columns are read directly, without decoding them into RpcSamples:
+      const RpcSampleColumns& columns =
+          rpc_log.second.successful_rpc_sample_columns();
+      const int num_columnar_samples = RpcSampleColumnsSize(columns);
+      perf_record.nb_rpcs += num_columnar_samples;
+      nb_failed_samples_ +=
+          RpcSampleColumnsSize(rpc_log.second.failed_rpc_sample_columns());
+      latencies.reserve(latencies.size() + num_columnar_samples);
+      response_times.reserve(response_times.size() + num_columnar_samples);
+      int64_t rpc_start_timestamp_ns = 0;
+      for (int i = 0; i < num_columnar_samples; ++i) {
+        rpc_start_timestamp_ns += columns.start_timestamp_ns_deltas(i);
+        if (!columns.warmup().empty() && columns.warmup(i)) {
+          ++nb_warmup_samples_;
+          continue;
+        }
+        int64_t rpc_latency_ns = columns.latency_ns(i);
+        start_timestamp_ns =
+            std::min(rpc_start_timestamp_ns, start_timestamp_ns);
+        end_timestamp_ns = std::max(rpc_start_timestamp_ns + rpc_latency_ns,
+                                    end_timestamp_ns);
+        perf_record.request_size +=
+            RpcSampleColumnValue(columns.request_size(), i);
+        perf_record.response_size +=
+            RpcSampleColumnValue(columns.response_size(), i);
+        int64_t weight =
+            columns.latency_weight().empty() ? 1 : columns.latency_weight(i);
+        int64_t send_lag_ns =
+            columns.send_lag_ns().empty() ? 0 : columns.send_lag_ns(i);
+        has_send_lag_ |= send_lag_ns > 0;
+        latencies.push_back({rpc_latency_ns, weight});
+        response_times.push_back({rpc_latency_ns + send_lag_ns, weight});
+      }
+      perf_record.nb_rpcs += rpc_log.second.successful_rpc_samples().size();
+      nb_failed_samples_ += rpc_log.second.failed_rpc_samples().size();
+      for (const auto& sample : rpc_log.second.successful_rpc_samples()) {
+        int64_t rpc_start_timestamp_ns = sample.start_timestamp_ns();
+        int64_t rpc_latency_ns = sample.latency_ns();
+        int64_t rpc_request_size = sample.request_size();
+        int64_t rpc_response_size = sample.response_size();
+        if (sample.warmup()) {
+          ++nb_warmup_samples_;
+          continue;
+        }
+
+        start_timestamp_ns =
+            std::min(rpc_start_timestamp_ns, start_timestamp_ns);
+        end_timestamp_ns = std::max(rpc_start_timestamp_ns + rpc_latency_ns,
+                                    end_timestamp_ns);
+        perf_record.request_size += rpc_request_size;
+        perf_record.response_size += rpc_response_size;
+        has_send_lag_ |= sample.send_lag_ns() > 0;
+        latencies.push_back({rpc_latency_ns, sample.latency_weight()});
+        response_times.push_back({rpc_latency_ns + sample.send_lag_ns(),
+                                  sample.latency_weight()});
       }
-      t_string_pair key_traffic_sum =
-          std::make_pair(initiator_instance_name, target_instance_name);
-      perf_map[key_traffic_sum] = perf_record;
+    }
+    if (start_timestamp_ns != std::numeric_limits<int64_t>::max()) {
+      test_time_ = std::max(test_time_, end_timestamp_ns - start_timestamp_ns);
+    }
+    t_string_pair key_traffic_sum =
+        std::make_pair(initiator_instance_name, target_instance_name);
+    perf_map_[key_traffic_sum] = perf_record;
+  }
+  for (const auto& [action_name, histogram] :
+       instance_log.open_loop_send_lag()) {
+    MergeLatencyHistogram(histogram, &send_lag_map_[action_name]);
+  }
+  for (const auto& [activity_config_name, activity_log] :
+       instance_log.activity_logs()) {
+    for (const auto& metric : activity_log.activity_metrics()) {
+      activity_metrics_map_[activity_config_name][metric.name()] +=
+          metric.value_int();
+    }
+    for (const auto& [operation, histogram] :
+         activity_log.operation_latencies()) {
+      MergeLatencyHistogram(
+          histogram, &activity_operation_latency_map_[{activity_config_name,
+                                                       operation}]);
+    }
+    if (activity_log.has_iteration_wall_time()) {
+      MergeLatencyHistogram(activity_log.iteration_wall_time(),
+                            &activity_wall_time_map_[activity_config_name]);
+    }
+    if (activity_log.has_iteration_cpu_time()) {
+      MergeLatencyHistogram(activity_log.iteration_cpu_time(),
+                            &activity_cpu_time_map_[activity_config_name]);
     }
   }
+}
 
+std::vector<std::string> TestResultSummarizer::Summarize() {
   std::vector<std::string> ret;
   ret.push_back("RPC latency summary:");
-  for (auto& latencies : latency_map) {
-    std::string str{};
-    std::sort(latencies.second.begin(), latencies.second.end());
-    absl::StrAppendFormat(&str, "  %s: %s", latencies.first,
-                          LatencySummary(latencies.second));
-    ret.push_back(str);
+  AddLatencySummariesTo(ret, latency_map_, histogram_map_,
+                        weighted_histogram_map_);
+  // Comparing these with the RPC latencies tells whether a slowdown comes
+  // from the activities (and how much of that is cpu interference, rather
+  // than cpu work) or from the network:
+  if (!activity_wall_time_map_.empty()) {
+    ret.push_back("Activity iteration time summary:");
+    for (const auto& [activity_config_name, histogram] :
+         activity_wall_time_map_) {
+      ret.push_back(absl::StrFormat("  %s wall time: %s", activity_config_name,
+                                    LatencySummary(histogram)));
+      auto cpu_time = activity_cpu_time_map_.find(activity_config_name);
+      if (cpu_time != activity_cpu_time_map_.end()) {
+        ret.push_back(absl::StrFormat("  %s cpu time: %s",
+                                      activity_config_name,
+                                      LatencySummary(cpu_time->second)));
+      }
+    }
   }
 
-  double total_time_seconds = (double)test_time / 1'000'000'000;
-  AddCommunicationSummaryTo(ret, total_time_seconds, perf_map);
-  AddInstanceSummaryTo(ret, total_time_seconds, perf_map, nb_warmup_samples,
-                       nb_failed_samples);
+  AddMemoryActivitySummariesTo(ret, activity_metrics_map_);
+  AddFileIoSummariesTo(ret, activity_metrics_map_,
+                       activity_operation_latency_map_);
+
+  double total_time_seconds = (double)test_time_ / 1'000'000'000;
+  AddCommunicationSummaryTo(ret, total_time_seconds, perf_map_);
+  AddInstanceSummaryTo(ret, total_time_seconds, perf_map_, nb_warmup_samples_,
+                       nb_failed_samples_);
+  if (has_send_lag_) {
+    ret.push_back("RPC response time summary:");
+    AddLatencySummariesTo(ret, response_time_map_,
+                          response_time_histogram_map_, {});
+  }
+  if (!send_lag_map_.empty()) {
+    ret.push_back("Open loop send lag summary:");
+    for (const auto& [action_name, histogram] : send_lag_map_) {
+      ret.push_back(absl::StrFormat("  %s: %s", action_name,
+                                    LatencySummary(histogram)));
+    }
+  }
   return ret;
 }
 
+std::vector<std::string> SummarizeTestResult(const TestResult& test_result) {
+  TestResultSummarizer summarizer(test_result.traffic_config());
+  for (const auto& instance_log : test_result.service_logs().instance_logs()) {
+    summarizer.AddInstanceLog(instance_log.first, instance_log.second);
+  }
+  return summarizer.Summarize();
+}
+
 }  // namespace distbench
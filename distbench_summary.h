@@ -15,10 +15,71 @@
 #ifndef DISTBENCH_DISTBENCH_SUMMARY_H_
 #define DISTBENCH_DISTBENCH_SUMMARY_H_
 
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
 #include "distbench.pb.h"
 
 namespace distbench {
 
+// Accumulates the summary of a test one instance log at a time, so that the
+// logs can be discarded (or streamed elsewhere) as soon as they are added.
+class TestResultSummarizer {
+ public:
+  struct RpcTrafficSummary {
+    int64_t nb_rpcs = 0;
+    int64_t request_size = 0;
+    int64_t response_size = 0;
+  };
+
+  // A sampled latency, and the RpcSample latency_weight of the sample:
+  struct WeightedLatency {
+    int64_t latency_ns;
+    int64_t weight;
+  };
+
+  // traffic_config must outlive the summarizer.
+  explicit TestResultSummarizer(
+      const DistributedSystemDescription& traffic_config);
+
+  void AddInstanceLog(const std::string& initiator_instance_name,
+                      const ServicePerformanceLog& instance_log);
+
+  std::vector<std::string> Summarize();
+
+ private:
+  const DistributedSystemDescription& traffic_config_;
+  std::map<std::string, std::vector<WeightedLatency>> latency_map_;
+  // RpcStatistics cover every RPC, so they are preferred over the samples
+  // whenever they are available:
+  std::map<std::string, LatencyHistogram> histogram_map_;
+  // The same histograms, with each RPC counted latency_weight times:
+  std::map<std::string, LatencyHistogram> weighted_histogram_map_;
+  // Response times run from the intended start of each RPC, so they include
+  // the time that late open loop senders spent catching up:
+  std::map<std::string, std::vector<WeightedLatency>> response_time_map_;
+  std::map<std::string, LatencyHistogram> response_time_histogram_map_;
+  bool has_send_lag_ = false;
+  std::map<std::pair<std::string, std::string>, RpcTrafficSummary> perf_map_;
+  // How late open loop actions started their iterations, by action name:
+  std::map<std::string, LatencyHistogram> send_lag_map_;
+  // Iteration times of activities, by activity config name, merged across
+  // instances:
+  std::map<std::string, LatencyHistogram> activity_wall_time_map_;
+  std::map<std::string, LatencyHistogram> activity_cpu_time_map_;
+  // Activity metrics, by activity config name, summed across instances:
+  std::map<std::string, std::map<std::string, int64_t>> activity_metrics_map_;
+  // Latencies of the operations of activities, by activity config name and
+  // operation:
+  std::map<std::pair<std::string, std::string>, LatencyHistogram>
+      activity_operation_latency_map_;
+  int64_t test_time_ = 0;
+  int64_t nb_warmup_samples_ = 0;
+  int64_t nb_failed_samples_ = 0;
+};
+
 std::vector<std::string> SummarizeTestResult(const TestResult& test_result);
 
 }  // namespace distbench
@@ -18,6 +18,7 @@
 #include "absl/strings/str_join.h"
 #include "distbench_netutils.h"
 #include "distbench_summary.h"
+#include "distbench_thread_support.h"
 #include "glog/logging.h"
 
 namespace distbench {
@@ -92,6 +93,29 @@ grpc::Status TestSequencer::RegisterNode(grpc::ServerContext* context,
 grpc::Status TestSequencer::RunTestSequence(grpc::ServerContext* context,
                                             const TestSequence* request,
                                             TestSequenceResults* response) {
+  return RunTestSequenceWith(
+      context, request, [response](TestResultChunk* chunk) {
+        while (response->test_results_size() <= chunk->test_index()) {
+          response->add_test_results();
+        }
+        MergeTestResultChunk(
+            chunk, response->mutable_test_results(chunk->test_index()));
+        return true;
+      });
+}
+
+grpc::Status TestSequencer::RunTestSequenceStream(
+    grpc::ServerContext* context, const TestSequence* request,
+    grpc::ServerWriter<TestResultChunk>* writer) {
+  return RunTestSequenceWith(context, request,
+                             [writer](TestResultChunk* chunk) {
+                               return writer->Write(*chunk);
+                             });
+}
+
+grpc::Status TestSequencer::RunTestSequenceWith(
+    grpc::ServerContext* context, const TestSequence* request,
+    const TestResultChunkWriter& write_chunk) {
   std::shared_ptr<absl::Notification> prior_notification;
   CancelTraffic();
   mutex_.Lock();
@@ -111,7 +135,7 @@ grpc::Status TestSequencer::RunTestSequence(grpc::ServerContext* context,
   auto notification = running_test_notification_ =
       std::make_shared<absl::Notification>();
   mutex_.Unlock();
-  grpc::Status result = DoRunTestSequence(context, request, response);
+  grpc::Status result = DoRunTestSequence(context, request, write_chunk);
   LOG(INFO) << "DoRunTestSequence status: " << result;
   notification->Notify();
   mutex_.Lock();
@@ -160,10 +184,14 @@ void TestSequencer::CancelTraffic() {
   }
 }
 
-grpc::Status TestSequencer::DoRunTestSequence(grpc::ServerContext* context,
-                                              const TestSequence* request,
-                                              TestSequenceResults* response) {
-  for (const auto& test : request->tests()) {
+grpc::Status TestSequencer::DoRunTestSequence(
+    grpc::ServerContext* context, const TestSequence* request,
+    const TestResultChunkWriter& write_chunk) {
+  const bool keep_instance_log = request->tests_setting().keep_instance_log();
+  const int64_t max_chunk_bytes =
+      request->tests_setting().max_result_chunk_bytes();
+  for (int test_index = 0; test_index < request->tests_size(); ++test_index) {
+    const auto& test = request->tests(test_index);
     {
       absl::MutexLock m(&mutex_);
       if (running_test_sequence_context_->IsCancelled()) {
@@ -171,21 +199,43 @@ grpc::Status TestSequencer::DoRunTestSequence(grpc::ServerContext* context,
                             "Cancelled by new test sequence.");
       }
     }
-    auto maybe_result = DoRunTest(context, test);
+    // Instance logs are summarized and forwarded as they arrive, so that the
+    // whole TestResult never needs to be held in memory at once:
+    TestResultSummarizer summarizer(test);
+    bool delivered = true;
+    auto instance_log_sink = [&](const std::string& instance_name,
+                                 ServicePerformanceLog* log) {
+      summarizer.AddInstanceLog(instance_name, *log);
+      if (!keep_instance_log || !delivered) return;
+      for (auto& piece :
+           SplitServicePerformanceLog(std::move(*log), max_chunk_bytes)) {
+        TestResultChunk chunk;
+        chunk.set_test_index(test_index);
+        (*chunk.mutable_test_result()
+              ->mutable_service_logs()
+              ->mutable_instance_logs())[instance_name] = std::move(piece);
+        delivered = write_chunk(&chunk);
+        if (!delivered) return;
+      }
+    };
+    auto maybe_result =
+        DoRunTest(context, test, max_chunk_bytes, instance_log_sink);
     LOG(INFO) << "DoRunTest status: " << maybe_result.status();
     if (!maybe_result.ok()) {
       return grpc::Status(grpc::StatusCode::ABORTED,
                           std::string(maybe_result.status().message()));
     }
-    auto& result = maybe_result.value();
-    auto summary = SummarizeTestResult(result);
-    for (const auto& s : summary) {
-      maybe_result->add_log_summary(s);
+    TestResultChunk chunk;
+    chunk.set_test_index(test_index);
+    chunk.set_last_chunk_of_test(true);
+    *chunk.mutable_test_result() = std::move(maybe_result.value());
+    for (const auto& s : summarizer.Summarize()) {
+      chunk.mutable_test_result()->add_log_summary(s);
     }
-    if (!request->tests_setting().keep_instance_log()) {
-      result.mutable_service_logs()->clear_instance_logs();
+    if (!delivered || !write_chunk(&chunk)) {
+      return grpc::Status(grpc::StatusCode::ABORTED,
+                          "Could not deliver the test results.");
     }
-    *response->add_test_results() = std::move(result);
   }
   if (request->tests_setting().shutdown_after_tests()) {
     shutdown_requested_.TryToNotify();
@@ -293,7 +343,8 @@ TestSequencer::PlaceServices(const DistributedSystemDescription& test) {
 }
 
 absl::StatusOr<TestResult> TestSequencer::DoRunTest(
-    grpc::ServerContext* context, const DistributedSystemDescription& test) {
+    grpc::ServerContext* context, const DistributedSystemDescription& test,
+    int64_t max_chunk_bytes, const InstanceLogSink& instance_log_sink) {
   if (test.services().empty()) {
     return absl::InvalidArgumentError("No services defined.");
   }
@@ -317,14 +368,14 @@ absl::StatusOr<TestResult> TestSequencer::DoRunTest(
 
   auto maybe_timeout = GetNamedAttributeInt64(test, "test_timeout", 3600);
   if (!maybe_timeout.ok()) return maybe_timeout.status();
-  auto maybe_logs = RunTraffic(node_service_map, *maybe_timeout);
+  auto maybe_logs = RunTraffic(node_service_map, *maybe_timeout,
+                               max_chunk_bytes, instance_log_sink);
   LOG(INFO) << "RunTraffic status: " << maybe_logs.status();
   if (!maybe_logs.ok()) return maybe_logs.status();
 
   TestResult ret;
   *ret.mutable_traffic_config() = test;
   *ret.mutable_placement() = service_map;
-  *ret.mutable_service_logs() = maybe_logs.value().service_logs();
   *ret.mutable_resource_usage_logs()->mutable_node_usages() =
       maybe_logs.value().node_usages();
   RUsageStats rusage_stats =
@@ -445,7 +496,8 @@ absl::Status TestSequencer::IntroducePeers(
 
 absl::StatusOr<GetTrafficResultResponse> TestSequencer::RunTraffic(
     const std::map<std::string, std::set<std::string>>& node_service_map,
-    int64_t timeout_seconds) {
+    int64_t timeout_seconds, int64_t max_chunk_bytes,
+    const InstanceLogSink& instance_log_sink) {
   absl::ReaderMutexLock m(&mutex_);
   grpc::CompletionQueue cq;
   struct RunTrafficPendingRpc {
@@ -494,47 +546,65 @@ absl::StatusOr<GetTrafficResultResponse> TestSequencer::RunTraffic(
   }
   LOG(INFO) << "RunTraffic: all done -- collecting results";
 
-  struct GetResultPendingRpc {
-    grpc::ClientContext context;
-    std::unique_ptr<grpc::ClientAsyncResponseReader<GetTrafficResultResponse>>
-        rpc;
-    grpc::Status status;
-    GetTrafficResultRequest request;
-    GetTrafficResultResponse response;
-    RegisteredNode* node;
-    std::string node_name;
-  };
-  std::vector<GetResultPendingRpc> pending_rpcs2(node_service_map.size());
+  // Each node streams its results back on its own thread, so that a node
+  // with large logs does not hold up the others:
+  absl::Mutex results_mutex;
+  GetTrafficResultResponse ret;
+  std::vector<std::thread> result_threads;
+  result_threads.reserve(node_service_map.size());
   for (const auto& node_services : node_service_map) {
-    auto& rpc_state = pending_rpcs2[rpc_count];
-    ++rpc_count;
-    rpc_state.node_name = node_services.first;
     auto it = node_alias_id_map_.find(node_services.first);
     CHECK(it != node_alias_id_map_.end());
-    rpc_state.node = &registered_nodes_[it->second];
-    SetGrpcClientContextDeadline(&rpc_state.context, /*max_time_s=*/600);
-    rpc_state.request.set_clear_services(true);
-    rpc_state.rpc = rpc_state.node->stub->AsyncGetTrafficResult(
-        &rpc_state.context, rpc_state.request, &cq);
-    rpc_state.rpc->Finish(&rpc_state.response, &rpc_state.status, &rpc_state);
-  }
-  GetTrafficResultResponse ret;
-  while (rpc_count) {
-    bool ok;
-    void* tag;
-    cq.Next(&tag, &ok);
-    if (ok) {
-      --rpc_count;
-      GetResultPendingRpc* finished_rpc =
-          static_cast<GetResultPendingRpc*>(tag);
-      if (!finished_rpc->status.ok()) {
-        status = Annotate(finished_rpc->status,
-                          absl::StrCat("AsyncGetTrafficResult to ",
-                                       finished_rpc->node_name, " failed: "));
-      }
-      ret.MergeFrom(finished_rpc->response);
-      finished_rpc->node->idle = true;
-    }
+    RegisteredNode* node = &registered_nodes_[it->second];
+    result_threads.push_back(RunRegisteredThread(
+        "GetTrafficResult", [&, node, node_name = node_services.first]() {
+          grpc::ClientContext context;
+          SetGrpcClientContextDeadline(&context, /*max_time_s=*/600);
+          GetTrafficResultRequest request;
+          request.set_clear_services(true);
+          request.set_max_chunk_bytes(max_chunk_bytes);
+          auto reader = node->stub->GetTrafficResultStream(&context, request);
+          // The pieces of an instance log arrive in consecutive responses,
+          // and are put back together before the log is handed on:
+          std::string instance_name;
+          ServicePerformanceLog instance_log;
+          auto hand_on_instance_log = [&]() {
+            if (instance_name.empty()) return;
+            absl::MutexLock m(&results_mutex);
+            instance_log_sink(instance_name, &instance_log);
+            instance_name.clear();
+            instance_log.Clear();
+          };
+          GetTrafficResultResponse chunk;
+          while (reader->Read(&chunk)) {
+            for (auto& [name, log] :
+                 *chunk.mutable_service_logs()->mutable_instance_logs()) {
+              if (name == instance_name) {
+                MergeServicePerformanceLogPiece(&log, &instance_log);
+                continue;
+              }
+              hand_on_instance_log();
+              instance_name = name;
+              instance_log = std::move(log);
+            }
+            absl::MutexLock m(&results_mutex);
+            ret.mutable_node_usages()->insert(chunk.node_usages().begin(),
+                                              chunk.node_usages().end());
+            chunk.Clear();
+          }
+          hand_on_instance_log();
+          grpc::Status rpc_status = reader->Finish();
+          absl::MutexLock m(&results_mutex);
+          if (!rpc_status.ok()) {
+            status = Annotate(rpc_status,
+                              absl::StrCat("GetTrafficResultStream to ",
+                                           node_name, " failed: "));
+          }
+          node->idle = true;
+        }));
+  }
+  for (auto& thread : result_threads) {
+    thread.join();
   }
 
   if (!status.ok()) {
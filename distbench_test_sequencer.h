@@ -15,6 +15,7 @@
 #ifndef DISTBENCH_DISTBENCH_TEST_SEQUENCER_H_
 #define DISTBENCH_DISTBENCH_TEST_SEQUENCER_H_
 
+#include <functional>
 #include <set>
 
 #include "absl/status/statusor.h"
@@ -54,13 +55,33 @@ class TestSequencer final : public DistBenchTestSequencer::Service {
                                const TestSequence* request,
                                TestSequenceResults* response) override;
 
+  grpc::Status RunTestSequenceStream(
+      grpc::ServerContext* context, const TestSequence* request,
+      grpc::ServerWriter<TestResultChunk>* writer) override;
+
  private:
+  // Returns false if the chunk could not be delivered.
+  using TestResultChunkWriter = std::function<bool(TestResultChunk* chunk)>;
+
+  // Receives the instance logs of a test as they are collected, each one
+  // whole:
+  using InstanceLogSink = std::function<void(
+      const std::string& instance_name, ServicePerformanceLog* log)>;
+
+  grpc::Status RunTestSequenceWith(grpc::ServerContext* context,
+                                   const TestSequence* request,
+                                   const TestResultChunkWriter& write_chunk);
+
   grpc::Status DoRunTestSequence(grpc::ServerContext* context,
                                  const TestSequence* request,
-                                 TestSequenceResults* response);
+                                 const TestResultChunkWriter& write_chunk);
 
+  // The returned TestResult does not include the instance logs, which are
+  // handed to instance_log_sink instead. The node managers send them in
+  // pieces of about max_chunk_bytes.
   absl::StatusOr<TestResult> DoRunTest(
-      grpc::ServerContext* context, const DistributedSystemDescription& test);
+      grpc::ServerContext* context, const DistributedSystemDescription& test,
+      int64_t max_chunk_bytes, const InstanceLogSink& instance_log_sink);
 
   absl::StatusOr<std::map<std::string, std::set<std::string>>> PlaceServices(
       const DistributedSystemDescription& test);
@@ -73,9 +94,12 @@ class TestSequencer final : public DistBenchTestSequencer::Service {
       const std::map<std::string, std::set<std::string>>& node_service_map,
       ServiceEndpointMap service_map);
 
+  // The returned response only holds the node_usages, since the instance
+  // logs are handed to instance_log_sink as they are streamed in.
   absl::StatusOr<GetTrafficResultResponse> RunTraffic(
       const std::map<std::string, std::set<std::string>>& node_service_map,
-      int64_t timeout_seconds);
+      int64_t timeout_seconds, int64_t max_chunk_bytes,
+      const InstanceLogSink& instance_log_sink);
 
   void CancelTraffic() ABSL_LOCKS_EXCLUDED(mutex_);
 
@@ -14,11 +14,23 @@
 
 #include "distbench_test_sequencer.h"
 
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+
+#include "absl/strings/match.h"
 #include "absl/strings/str_replace.h"
+#include "distbench_latency_histogram.h"
 #include "distbench_node_manager.h"
+#include "distbench_rpc_sample_columns.h"
+#include "distbench_summary.h"
 #include "distbench_thread_support.h"
 #include "distbench_utils.h"
 #include "glog/logging.h"
+#include "google/protobuf/text_format.h"
+#include "google/protobuf/util/message_differencer.h"
 #include "gtest/gtest.h"
 #include "gtest_utils.h"
 #include "protocol_driver_allocator.h"
@@ -167,6 +179,202 @@ TEST(DistBenchTestSequencer, NonEmptyGroup) {
   ASSERT_EQ(s2_1_echo->second.successful_rpc_samples_size(), 10);
 }
 
+TEST(DistBenchTestSequencer, ActionDependencies) {
+  DistBenchTester tester;
+  ASSERT_OK(tester.Initialize(2));
+
+  TestSequence test_sequence;
+  auto* test = test_sequence.add_tests();
+  auto* s1 = test->add_services();
+  s1->set_name("client");
+  s1->set_count(1);
+  auto* s2 = test->add_services();
+  s2->set_name("server");
+  s2->set_count(1);
+
+  // A diamond: "left" and "right" wait for "first", and "last" waits for
+  // both of them.
+  const std::vector<std::string> action_names = {"first", "left", "right",
+                                                 "last"};
+  auto* l1 = test->add_action_lists();
+  l1->set_name("client");
+  for (const auto& name : action_names) {
+    l1->add_action_names(name);
+    auto* action = test->add_actions();
+    action->set_name(name);
+    action->set_rpc_name(name + "_rpc");
+    action->mutable_iterations()->set_max_iteration_count(10);
+    if (name == "left" || name == "right") {
+      action->add_dependencies("first");
+    } else if (name == "last") {
+      action->add_dependencies("left");
+      action->add_dependencies("right");
+    }
+    auto* rpc = test->add_rpc_descriptions();
+    rpc->set_name(name + "_rpc");
+    rpc->set_client("client");
+    rpc->set_server("server");
+    test->add_action_lists()->set_name(name + "_rpc");
+  }
+
+  TestSequenceResults results;
+  auto context = CreateContextWithDeadline(/*max_time_s=*/70);
+  grpc::Status status = tester.test_sequencer_stub->RunTestSequence(
+      context.get(), test_sequence, &results);
+  ASSERT_OK(status);
+
+  ASSERT_EQ(results.test_results().size(), 1);
+  const auto& instance_logs =
+      results.test_results(0).service_logs().instance_logs();
+  const auto client_log = instance_logs.find("client/0");
+  ASSERT_NE(client_log, instance_logs.end());
+  const auto server_log = client_log->second.peer_logs().find("server/0");
+  ASSERT_NE(server_log, client_log->second.peer_logs().end());
+  std::vector<int64_t> first_start(action_names.size());
+  std::vector<int64_t> last_end(action_names.size());
+  for (size_t i = 0; i < action_names.size(); ++i) {
+    const auto rpc_log = server_log->second.rpc_logs().find(i);
+    ASSERT_NE(rpc_log, server_log->second.rpc_logs().end());
+    ASSERT_TRUE(rpc_log->second.failed_rpc_samples().empty());
+    ASSERT_EQ(rpc_log->second.successful_rpc_samples_size(), 10);
+    first_start[i] = std::numeric_limits<int64_t>::max();
+    last_end[i] = std::numeric_limits<int64_t>::min();
+    for (const auto& sample : rpc_log->second.successful_rpc_samples()) {
+      first_start[i] = std::min(first_start[i], sample.start_timestamp_ns());
+      last_end[i] = std::max(last_end[i], sample.start_timestamp_ns() +
+                                              sample.latency_ns());
+    }
+  }
+  // Each action starts after the actions it depends on have finished:
+  EXPECT_GE(first_start[1], last_end[0]);
+  EXPECT_GE(first_start[2], last_end[0]);
+  EXPECT_GE(first_start[3], last_end[1]);
+  EXPECT_GE(first_start[3], last_end[2]);
+}
+
+TEST(DistBenchTestSequencer, WorkStealingThreadpool) {
+  DistBenchTester tester;
+  ASSERT_OK(tester.Initialize(2));
+
+  TestSequence test_sequence;
+  auto* test = test_sequence.add_tests();
+  auto* s1 = test->add_services();
+  s1->set_name("client");
+  s1->set_count(1);
+  s1->set_threadpool_type("work_stealing");
+  auto* s2 = test->add_services();
+  s2->set_name("server");
+  s2->set_count(1);
+  s2->set_threadpool_type("work_stealing");
+
+  auto* l1 = test->add_action_lists();
+  l1->set_name("client");
+  l1->add_action_names("run_queries");
+  auto* a1 = test->add_actions();
+  a1->set_name("run_queries");
+  a1->set_rpc_name("client_server_rpc");
+  a1->mutable_iterations()->set_max_iteration_count(100);
+  a1->mutable_iterations()->set_max_parallel_iterations(10);
+  auto* r1 = test->add_rpc_descriptions();
+  r1->set_name("client_server_rpc");
+  r1->set_client("client");
+  r1->set_server("server");
+  test->add_action_lists()->set_name("client_server_rpc");
+
+  TestSequenceResults results;
+  auto context = CreateContextWithDeadline(/*max_time_s=*/70);
+  grpc::Status status = tester.test_sequencer_stub->RunTestSequence(
+      context.get(), test_sequence, &results);
+  ASSERT_OK(status);
+
+  ASSERT_EQ(results.test_results().size(), 1);
+  const auto& instance_logs =
+      results.test_results(0).service_logs().instance_logs();
+  const auto client_log = instance_logs.find("client/0");
+  ASSERT_NE(client_log, instance_logs.end());
+  const auto server_log = client_log->second.peer_logs().find("server/0");
+  ASSERT_NE(server_log, client_log->second.peer_logs().end());
+  const auto rpc_log = server_log->second.rpc_logs().find(0);
+  ASSERT_NE(rpc_log, server_log->second.rpc_logs().end());
+  ASSERT_TRUE(rpc_log->second.failed_rpc_samples().empty());
+  ASSERT_EQ(rpc_log->second.successful_rpc_samples_size(), 100);
+}
+
+TEST(DistBenchTestSequencer, BadThreadpoolType) {
+  DistBenchTester tester;
+  ASSERT_OK(tester.Initialize(1));
+
+  TestSequence test_sequence;
+  auto* test = test_sequence.add_tests();
+  auto* s1 = test->add_services();
+  s1->set_name("client");
+  s1->set_count(1);
+  s1->set_threadpool_type("bad_type");
+
+  TestSequenceResults results;
+  auto context = CreateContextWithDeadline(/*max_time_s=*/70);
+  grpc::Status status = tester.test_sequencer_stub->RunTestSequence(
+      context.get(), test_sequence, &results);
+  ASSERT_FALSE(status.ok());
+}
+
+TEST(DistBenchTestSequencer, ThreadPlacement) {
+  DistBenchTester tester;
+  ASSERT_OK(tester.Initialize(2));
+
+  auto cpus = ParseThreadPlacement(GetThreadCpuList(), -1);
+  ASSERT_OK(cpus.status());
+  ASSERT_FALSE(cpus.value().cpus.empty());
+  const std::string cpu_list = absl::StrCat(cpus.value().cpus.front());
+
+  TestSequence test_sequence;
+  auto* test = test_sequence.add_tests();
+  auto* s1 = test->add_services();
+  s1->set_name("client");
+  s1->set_count(1);
+  s1->set_cpu_list(cpu_list);
+  s1->set_numa_node(0);
+  auto* s2 = test->add_services();
+  s2->set_name("server");
+  s2->set_count(1);
+
+  auto* l1 = test->add_action_lists();
+  l1->set_name("client");
+  l1->add_action_names("run_queries");
+  auto* a1 = test->add_actions();
+  a1->set_name("run_queries");
+  a1->set_rpc_name("client_server_rpc");
+  a1->mutable_iterations()->set_max_iteration_count(10);
+  auto* r1 = test->add_rpc_descriptions();
+  r1->set_name("client_server_rpc");
+  r1->set_client("client");
+  r1->set_server("server");
+  r1->set_request_payload_name("request_payload");
+  auto* payload = test->add_payload_descriptions();
+  payload->set_name("request_payload");
+  payload->set_size(1 << 20);
+  test->add_action_lists()->set_name("client_server_rpc");
+
+  TestSequenceResults results;
+  auto context = CreateContextWithDeadline(/*max_time_s=*/70);
+  grpc::Status status = tester.test_sequencer_stub->RunTestSequence(
+      context.get(), test_sequence, &results);
+  ASSERT_OK(status);
+
+  ASSERT_EQ(results.test_results().size(), 1);
+  const auto& instance_logs =
+      results.test_results(0).service_logs().instance_logs();
+  const auto client_log = instance_logs.find("client/0");
+  ASSERT_NE(client_log, instance_logs.end());
+  EXPECT_EQ(client_log->second.cpu_list(), cpu_list);
+  EXPECT_EQ(client_log->second.numa_node(), 0);
+  const auto server_log = client_log->second.peer_logs().find("server/0");
+  ASSERT_NE(server_log, client_log->second.peer_logs().end());
+  const auto rpc_log = server_log->second.rpc_logs().find(0);
+  ASSERT_NE(rpc_log, server_log->second.rpc_logs().end());
+  ASSERT_EQ(rpc_log->second.successful_rpc_samples_size(), 10);
+}
+
 TEST(DistBenchTestSequencer, Overload) {
   DistBenchTester tester;
   ASSERT_OK(tester.Initialize(2));
@@ -402,6 +610,241 @@ TEST(DistBenchTestSequencer, TestReservoirSampling) {
   // => Probability less than 1 in a million this fails:
   EXPECT_GT(warmup_samples, 275);
   EXPECT_LT(warmup_samples, 392);
+
+  // The statistics are not sampled:
+  const auto& statistics = it3->second.statistics();
+  EXPECT_EQ(statistics.successful_rpcs(), 2000);
+  EXPECT_EQ(statistics.warmup_rpcs(), 1000);
+  EXPECT_EQ(statistics.failed_rpcs(), 0);
+  EXPECT_EQ(LatencyHistogramCount(statistics.latency_histogram()), 2000);
+}
+
+TEST(DistBenchTestSequencer, ConcurrentLatencySamples) {
+  DistBenchTester tester;
+  ASSERT_OK(tester.Initialize(5));
+
+  TestSequence test_sequence;
+  // The first test keeps every sample, the second only max_rpc_samples:
+  for (int max_rpc_samples : {0, 500}) {
+    auto* test = test_sequence.add_tests();
+    test->set_default_protocol("grpc");
+    auto* s1 = test->add_services();
+    s1->set_name("s1");
+    s1->set_count(1);
+    s1->set_threadpool_type("elastic");
+    auto* s2 = test->add_services();
+    s2->set_name("s2");
+    s2->set_count(4);
+
+    auto* l1 = test->add_action_lists();
+    l1->set_name("s1");
+    l1->add_action_names("s1/ping");
+    if (max_rpc_samples) l1->set_max_rpc_samples(max_rpc_samples);
+
+    auto a1 = test->add_actions();
+    a1->set_name("s1/ping");
+    a1->set_rpc_name("echo");
+    auto* iterations = a1->mutable_iterations();
+    iterations->set_max_parallel_iterations(100);
+    iterations->set_max_iteration_count(1000);
+
+    auto* r1 = test->add_rpc_descriptions();
+    r1->set_name("echo");
+    r1->set_client("s1");
+    r1->set_server("s2");
+    r1->set_fanout_filter("all");
+
+    auto* l2 = test->add_action_lists();
+    l2->set_name("echo");
+  }
+
+  TestSequenceResults results;
+  auto context = CreateContextWithDeadline(/*max_time_s=*/200);
+  grpc::Status status = tester.test_sequencer_stub->RunTestSequence(
+      context.get(), test_sequence, &results);
+  LOG(INFO) << status.error_message();
+  ASSERT_OK(status);
+  ASSERT_EQ(results.test_results_size(), 2);
+  for (int i = 0; i < 2; ++i) {
+    const auto& instance_logs =
+        results.test_results(i).service_logs().instance_logs();
+    auto it = instance_logs.find("s1/0");
+    ASSERT_NE(it, instance_logs.end());
+    ASSERT_EQ(it->second.peer_logs_size(), 4);
+    int samples = 0;
+    int64_t successful_rpcs = 0;
+    for (const auto& [peer, peer_log] : it->second.peer_logs()) {
+      ASSERT_EQ(peer_log.rpc_logs_size(), 1);
+      const auto& rpc_log = peer_log.rpc_logs().begin()->second;
+      EXPECT_EQ(rpc_log.failed_rpc_samples_size(), 0);
+      samples += rpc_log.successful_rpc_samples_size();
+      successful_rpcs += rpc_log.statistics().successful_rpcs();
+    }
+    EXPECT_EQ(successful_rpcs, 4000);
+    // Samples recorded by many threads at once are neither lost, nor kept
+    // beyond max_rpc_samples:
+    EXPECT_EQ(samples, i == 0 ? 4000 : 500);
+  }
+}
+
+TEST(DistBenchTestSequencer, ColumnarRpcSamples) {
+  DistBenchTester tester;
+  ASSERT_OK(tester.Initialize(2));
+
+  TestSequence test_sequence;
+  auto* test = test_sequence.add_tests();
+  test->set_default_protocol("grpc");
+  auto* s1 = test->add_services();
+  s1->set_name("s1");
+  s1->set_count(1);
+  auto* s2 = test->add_services();
+  s2->set_name("s2");
+  s2->set_count(1);
+
+  auto* l1 = test->add_action_lists();
+  l1->set_name("s1");
+  l1->add_action_names("s1/ping");
+  l1->set_columnar_rpc_samples(true);
+
+  auto a1 = test->add_actions();
+  a1->set_name("s1/ping");
+  a1->set_rpc_name("echo");
+  auto* iterations = a1->mutable_iterations();
+  iterations->set_max_parallel_iterations(10);
+  iterations->set_max_iteration_count(1000);
+  iterations->set_warmup_iterations(100);
+
+  auto* r1 = test->add_rpc_descriptions();
+  r1->set_name("echo");
+  r1->set_client("s1");
+  r1->set_server("s2");
+
+  auto* l2 = test->add_action_lists();
+  l2->set_name("echo");
+
+  TestSequenceResults results;
+  auto context = CreateContextWithDeadline(/*max_time_s=*/200);
+  grpc::Status status = tester.test_sequencer_stub->RunTestSequence(
+      context.get(), test_sequence, &results);
+  ASSERT_OK(status);
+  ASSERT_EQ(results.test_results_size(), 1);
+  const auto& instance_logs =
+      results.test_results(0).service_logs().instance_logs();
+  ASSERT_EQ(instance_logs.size(), 1);
+  const auto& peer_logs = instance_logs.begin()->second.peer_logs();
+  ASSERT_EQ(peer_logs.size(), 1);
+  const auto& rpc_logs = peer_logs.begin()->second.rpc_logs();
+  ASSERT_EQ(rpc_logs.size(), 1);
+  const RpcPerformanceLog& rpc_log = rpc_logs.begin()->second;
+  EXPECT_TRUE(rpc_log.successful_rpc_samples().empty());
+  EXPECT_FALSE(rpc_log.has_failed_rpc_sample_columns());
+  const RpcSampleColumns& columns = rpc_log.successful_rpc_sample_columns();
+  ASSERT_EQ(RpcSampleColumnsSize(columns), 1000);
+  EXPECT_EQ(std::count(columns.warmup().begin(), columns.warmup().end(), true),
+            100);
+
+  // Without the statistics, the summary reads the columns directly, and must
+  // agree with the summary of the decoded samples:
+  auto summarize_samples = [&](bool decode) {
+    TestResult result = results.test_results(0);
+    RpcPerformanceLog& log = result.mutable_service_logs()
+                                 ->mutable_instance_logs()
+                                 ->begin()
+                                 ->second.mutable_peer_logs()
+                                 ->begin()
+                                 ->second.mutable_rpc_logs()
+                                 ->begin()
+                                 ->second;
+    log.clear_statistics();
+    if (decode) {
+      AppendRpcSamplesFromColumns(log.successful_rpc_sample_columns(),
+                                  log.mutable_successful_rpc_samples());
+      log.clear_successful_rpc_sample_columns();
+    }
+    return SummarizeTestResult(result);
+  };
+  std::vector<std::string> columnar_summary = summarize_samples(false);
+  EXPECT_EQ(columnar_summary, summarize_samples(true));
+  EXPECT_NE(columnar_summary[1].find("N: 900 "), std::string::npos);
+
+  // Compressed results decompress back to the same proto:
+  std::string filename = absl::StrCat(
+      getenv("TEST_TMPDIR") ? getenv("TEST_TMPDIR") : "/tmp",
+      "/columnar_results.", getpid(), ".gz");
+  ASSERT_OK(SaveResultProtoToFileBinary(filename, results, /*compress=*/true));
+  int fd = open(filename.c_str(), O_RDONLY);
+  ASSERT_GE(fd, 0);
+  google::protobuf::io::FileInputStream file_stream(fd);
+  file_stream.SetCloseOnDelete(true);
+  google::protobuf::io::GzipInputStream gzip_stream(&file_stream);
+  TestSequenceResults decompressed_results;
+  ASSERT_TRUE(decompressed_results.ParseFromZeroCopyStream(&gzip_stream));
+  EXPECT_TRUE(google::protobuf::util::MessageDifferencer::Equals(
+      decompressed_results, results));
+  EXPECT_LT(file_stream.ByteCount(), results.ByteSizeLong());
+  unlink(filename.c_str());
+}
+
+TEST(DistBenchTestSequencer, ResponseTimeSummary) {
+  TestResult result;
+  result.mutable_traffic_config()->add_rpc_descriptions()->set_name("query");
+  auto& rpc_log =
+      (*(*(*result.mutable_service_logs()->mutable_instance_logs())["client/0"]
+              .mutable_peer_logs())["server/0"]
+            .mutable_rpc_logs())[0];
+  for (int i = 0; i < 9; ++i) {
+    auto* sample = rpc_log.add_successful_rpc_samples();
+    sample->set_start_timestamp_ns(1'000'000 * i);
+    sample->set_latency_ns(1000);
+  }
+  // A slow RPC holds up the closed loop sender, so it weighs more:
+  auto* slow_sample = rpc_log.add_successful_rpc_samples();
+  slow_sample->set_start_timestamp_ns(9'000'000);
+  slow_sample->set_latency_ns(5000);
+  slow_sample->set_latency_weight(9);
+  slow_sample->set_send_lag_ns(20'000);
+
+  std::vector<std::string> summary = SummarizeTestResult(result);
+  ASSERT_GE(summary.size(), 2);
+  EXPECT_EQ(summary[1],
+            "  query: N: 10 min: 1000ns median: 5000ns 90%: 5000ns "
+            "99%: 5000ns 99.9%: 5000ns max: 5000ns");
+  auto response_times = std::find(summary.begin(), summary.end(),
+                                  "RPC response time summary:");
+  ASSERT_NE(response_times, summary.end());
+  ASSERT_NE(response_times + 1, summary.end());
+  EXPECT_EQ(response_times[1],
+            "  query: N: 10 min: 1000ns median: 25000ns 90%: 25000ns "
+            "99%: 25000ns 99.9%: 25000ns max: 25000ns");
+}
+
+TEST(DistBenchTestSequencer, WeightedHistogramSummary) {
+  TestResult result;
+  result.mutable_traffic_config()->add_rpc_descriptions()->set_name("query");
+  auto& rpc_log =
+      (*(*(*result.mutable_service_logs()->mutable_instance_logs())["client/0"]
+              .mutable_peer_logs())["server/0"]
+            .mutable_rpc_logs())[0];
+  AtomicLatencyHistogram latency_histogram;
+  AtomicLatencyHistogram weighted_latency_histogram;
+  for (int i = 0; i < 9; ++i) {
+    latency_histogram.Record(1000);
+    weighted_latency_histogram.Record(1000, 1'000'000);
+  }
+  // A slow RPC holds up the closed loop sender, so it weighs more:
+  latency_histogram.Record(5000);
+  weighted_latency_histogram.Record(5000, 9'000'000);
+  RpcStatistics* statistics = rpc_log.mutable_statistics();
+  statistics->set_successful_rpcs(10);
+  latency_histogram.AddTo(statistics->mutable_latency_histogram());
+  weighted_latency_histogram.AddTo(
+      statistics->mutable_weighted_latency_histogram());
+
+  std::vector<std::string> summary = SummarizeTestResult(result);
+  ASSERT_GE(summary.size(), 2);
+  EXPECT_EQ(summary[1],
+            "  query: N: 10 min: 1000ns median: 5000ns 90%: 5000ns "
+            "99%: 5000ns 99.9%: 5000ns max: 5000ns");
 }
 
 TEST(DistBenchTestSequencer, TestWarmupSampling) {
@@ -620,6 +1063,317 @@ TEST(DistBenchTestSequencer, CliqueTest) {
             test_results.service_logs().instance_logs().end());
 }
 
+TEST(DistBenchTestSequencer, OpenLoopSendLag) {
+  DistBenchTester tester;
+  ASSERT_OK(tester.Initialize(2));
+
+  TestSequence test_sequence;
+  test_sequence.mutable_tests_setting()->set_keep_instance_log(true);
+  auto* test = test_sequence.add_tests();
+  test->set_default_protocol("grpc");
+  auto* s1 = test->add_services();
+  s1->set_name("client");
+  s1->set_count(1);
+  auto* s2 = test->add_services();
+  s2->set_name("server");
+  s2->set_count(1);
+
+  auto* l1 = test->add_action_lists();
+  l1->set_name("client");
+  l1->add_action_names("client_queries");
+
+  auto a1 = test->add_actions();
+  a1->set_name("client_queries");
+  a1->mutable_iterations()->set_max_iteration_count(500);
+  a1->mutable_iterations()->set_open_loop_interval_ns(100'000);
+  a1->set_rpc_name("client_query");
+
+  auto* r1 = test->add_rpc_descriptions();
+  r1->set_name("client_query");
+  r1->set_client("client");
+  r1->set_server("server");
+
+  auto* l2 = test->add_action_lists();
+  l2->set_name("client_query");
+
+  TestSequenceResults results;
+  auto context = CreateContextWithDeadline(/*max_time_s=*/75);
+  grpc::Status status = tester.test_sequencer_stub->RunTestSequence(
+      context.get(), test_sequence, &results);
+  ASSERT_OK(status);
+  ASSERT_EQ(results.test_results().size(), 1);
+  const auto& test_results = results.test_results(0);
+
+  const auto& instance_logs = test_results.service_logs().instance_logs();
+  const auto client_log = instance_logs.find("client/0");
+  ASSERT_NE(client_log, instance_logs.end());
+  const auto send_lag =
+      client_log->second.open_loop_send_lag().find("client_queries");
+  ASSERT_NE(send_lag, client_log->second.open_loop_send_lag().end());
+  // The pacer stops at the iteration limit:
+  EXPECT_EQ(LatencyHistogramCount(send_lag->second), 500);
+  EXPECT_GE(send_lag->second.min_latency_ns(), 0);
+  EXPECT_NE(std::find(test_results.log_summary().begin(),
+                      test_results.log_summary().end(),
+                      "Open loop send lag summary:"),
+            test_results.log_summary().end());
+}
+
+TEST(DistBenchTestSequencer, OpenLoopIntervalDistributionConfig) {
+  DistBenchTester tester;
+  ASSERT_OK(tester.Initialize(2));
+
+  TestSequence test_sequence;
+  test_sequence.mutable_tests_setting()->set_keep_instance_log(true);
+  auto* test = test_sequence.add_tests();
+  test->set_default_protocol("grpc");
+  auto* s1 = test->add_services();
+  s1->set_name("client");
+  s1->set_count(1);
+  auto* s2 = test->add_services();
+  s2->set_name("server");
+  s2->set_count(1);
+
+  auto* intervals = test->add_distribution_config();
+  intervals->set_name("intervals");
+  intervals->add_field_names("open_loop_interval_ns");
+  for (int interval_ns : {20'000, 80'000}) {
+    auto* pmf_point = intervals->add_pmf_points();
+    pmf_point->set_pmf(0.5);
+    pmf_point->add_data_points()->set_exact(interval_ns);
+  }
+
+  auto* l1 = test->add_action_lists();
+  l1->set_name("client");
+  l1->add_action_names("client_queries");
+
+  auto a1 = test->add_actions();
+  a1->set_name("client_queries");
+  a1->mutable_iterations()->set_max_iteration_count(200);
+  a1->mutable_iterations()->set_open_loop_interval_ns(50'000);
+  a1->mutable_iterations()->set_open_loop_interval_distribution(
+      "distribution_config");
+  a1->mutable_iterations()->set_open_loop_interval_distribution_config_name(
+      "intervals");
+  a1->set_rpc_name("client_query");
+
+  auto* r1 = test->add_rpc_descriptions();
+  r1->set_name("client_query");
+  r1->set_client("client");
+  r1->set_server("server");
+
+  auto* l2 = test->add_action_lists();
+  l2->set_name("client_query");
+
+  TestSequenceResults results;
+  auto context = CreateContextWithDeadline(/*max_time_s=*/75);
+  grpc::Status status = tester.test_sequencer_stub->RunTestSequence(
+      context.get(), test_sequence, &results);
+  ASSERT_OK(status);
+  ASSERT_EQ(results.test_results().size(), 1);
+  const auto& instance_logs =
+      results.test_results(0).service_logs().instance_logs();
+  const auto client_log = instance_logs.find("client/0");
+  ASSERT_NE(client_log, instance_logs.end());
+  const auto send_lag =
+      client_log->second.open_loop_send_lag().find("client_queries");
+  ASSERT_NE(send_lag, client_log->second.open_loop_send_lag().end());
+  EXPECT_EQ(LatencyHistogramCount(send_lag->second), 200);
+
+  // Unknown distributions are rejected:
+  a1->mutable_iterations()->set_open_loop_interval_distribution("poisson");
+  context = CreateContextWithDeadline(/*max_time_s=*/75);
+  status = tester.test_sequencer_stub->RunTestSequence(
+      context.get(), test_sequence, &results);
+  EXPECT_FALSE(status.ok());
+}
+
+TEST(DistBenchTestSequencer, StreamedTestResults) {
+  DistBenchTester tester;
+  ASSERT_OK(tester.Initialize(3));
+
+  TestSequence test_sequence;
+  test_sequence.mutable_tests_setting()->set_keep_instance_log(true);
+  auto* test = test_sequence.add_tests();
+  test->set_default_protocol("grpc");
+  auto* s1 = test->add_services();
+  s1->set_name("clique");
+  s1->set_count(3);
+
+  auto* l1 = test->add_action_lists();
+  l1->set_name("clique");
+  l1->add_action_names("clique_queries");
+
+  auto a1 = test->add_actions();
+  a1->set_name("clique_queries");
+  a1->mutable_iterations()->set_max_iteration_count(100);
+  a1->set_rpc_name("clique_query");
+
+  auto* r1 = test->add_rpc_descriptions();
+  r1->set_name("clique_query");
+  r1->set_client("clique");
+  r1->set_server("clique");
+  r1->set_fanout_filter("all");
+
+  auto* l2 = test->add_action_lists();
+  l2->set_name("clique_query");
+  *test_sequence.add_tests() = *test;
+
+  auto context = CreateContextWithDeadline(/*max_time_s=*/75);
+  auto reader = tester.test_sequencer_stub->RunTestSequenceStream(
+      context.get(), test_sequence);
+  std::string text_filename = absl::StrCat(
+      getenv("TEST_TMPDIR") ? getenv("TEST_TMPDIR") : "/tmp",
+      "/streamed_results.", getpid(), ".txt");
+  std::string binary_filename = absl::StrCat(text_filename, ".bin");
+  auto text_writer = TestSequenceResultsWriter::Open(text_filename, false);
+  ASSERT_OK(text_writer.status());
+  auto binary_writer = TestSequenceResultsWriter::Open(binary_filename, true);
+  ASSERT_OK(binary_writer.status());
+  std::vector<TestResultChunk> chunks;
+  TestResultChunk chunk;
+  while (reader->Read(&chunk)) {
+    ASSERT_OK((*text_writer)->Write(chunk));
+    ASSERT_OK((*binary_writer)->Write(chunk));
+    chunks.push_back(chunk);
+  }
+  ASSERT_OK(reader->Finish());
+
+  // Every instance log arrives in a chunk of its own, ahead of the last chunk
+  // of its test, which carries the summary:
+  ASSERT_EQ(chunks.size(), 8);
+  TestSequenceResults results;
+  for (size_t i = 0; i < chunks.size(); ++i) {
+    EXPECT_EQ(chunks[i].test_index(), i / 4);
+    EXPECT_EQ(chunks[i].last_chunk_of_test(), i % 4 == 3);
+    if (chunks[i].last_chunk_of_test()) {
+      EXPECT_EQ(chunks[i].test_result().service_logs().instance_logs_size(),
+                0);
+      EXPECT_FALSE(chunks[i].test_result().log_summary().empty());
+    } else {
+      EXPECT_EQ(chunks[i].test_result().service_logs().instance_logs_size(),
+                1);
+    }
+    if (results.test_results_size() <= chunks[i].test_index()) {
+      results.add_test_results();
+    }
+    TestResultChunk chunk = chunks[i];
+    MergeTestResultChunk(&chunk,
+                         results.mutable_test_results(chunks[i].test_index()));
+  }
+  for (const auto& test_result : results.test_results()) {
+    EXPECT_EQ(test_result.service_logs().instance_logs_size(), 3);
+  }
+
+  // Both files hold the same TestSequenceResults as the merged chunks:
+  text_writer->reset();
+  binary_writer->reset();
+  std::ifstream text_file(text_filename);
+  std::string text((std::istreambuf_iterator<char>(text_file)),
+                   std::istreambuf_iterator<char>());
+  TestSequenceResults text_results;
+  ASSERT_TRUE(
+      google::protobuf::TextFormat::ParseFromString(text, &text_results));
+  EXPECT_TRUE(google::protobuf::util::MessageDifferencer::Equals(
+      text_results, results));
+  std::ifstream binary_file(binary_filename, std::ios::binary);
+  TestSequenceResults binary_results;
+  ASSERT_TRUE(binary_results.ParseFromIstream(&binary_file));
+  EXPECT_TRUE(google::protobuf::util::MessageDifferencer::Equals(
+      binary_results, results));
+  unlink(text_filename.c_str());
+  unlink(binary_filename.c_str());
+}
+
+TEST(DistBenchTestSequencer, SplitInstanceLogs) {
+  TestSequenceResults results;
+  TestResult* result = results.add_test_results();
+  result->mutable_traffic_config()->set_name("split");
+  auto& instance_logs =
+      *result->mutable_service_logs()->mutable_instance_logs();
+  for (int i = 0; i < 3; ++i) {
+    ServicePerformanceLog& log = instance_logs[absl::StrCat("client/", i)];
+    (*log.mutable_engine_stats())["stat"] = i;
+    for (int j = 0; j < 10; ++j) {
+      auto& rpc_log =
+          (*(*log.mutable_peer_logs())[absl::StrCat("server/", j)]
+                .mutable_rpc_logs())[0];
+      for (int k = 0; k < 100; ++k) {
+        auto* sample = rpc_log.add_successful_rpc_samples();
+        sample->set_start_timestamp_ns(k);
+        sample->set_latency_ns(1000 + k);
+      }
+    }
+  }
+
+  // Chunk the results the way RunTestSequenceStream does, with room for
+  // about two peer logs per chunk:
+  const int64_t max_bytes =
+      2 * instance_logs["client/0"].peer_logs().at("server/0").ByteSizeLong();
+  std::vector<TestResultChunk> chunks;
+  for (const auto& [instance_name, log] : instance_logs) {
+    auto pieces = SplitServicePerformanceLog(log, max_bytes);
+    // The first piece also holds the engine_stats, which leaves it room for
+    // a single peer log:
+    EXPECT_EQ(pieces.size(), 6);
+    for (auto& piece : pieces) {
+      EXPECT_LE(piece.ByteSizeLong(), max_bytes + 64);
+      TestResultChunk& chunk = chunks.emplace_back();
+      (*chunk.mutable_test_result()
+            ->mutable_service_logs()
+            ->mutable_instance_logs())[instance_name] = std::move(piece);
+    }
+  }
+  TestResultChunk& last_chunk = chunks.emplace_back();
+  last_chunk.set_last_chunk_of_test(true);
+  *last_chunk.mutable_test_result()->mutable_traffic_config() =
+      result->traffic_config();
+
+  std::string text_filename = absl::StrCat(
+      getenv("TEST_TMPDIR") ? getenv("TEST_TMPDIR") : "/tmp",
+      "/split_results.", getpid(), ".txt");
+  std::string binary_filename = absl::StrCat(text_filename, ".bin");
+  auto text_writer = TestSequenceResultsWriter::Open(text_filename, false);
+  ASSERT_OK(text_writer.status());
+  auto binary_writer = TestSequenceResultsWriter::Open(binary_filename, true);
+  ASSERT_OK(binary_writer.status());
+  TestSequenceResults merged_results;
+  TestResult* merged_result = merged_results.add_test_results();
+  for (auto& chunk : chunks) {
+    ASSERT_OK((*text_writer)->Write(chunk));
+    ASSERT_OK((*binary_writer)->Write(chunk));
+    MergeTestResultChunk(&chunk, merged_result);
+    if (&chunk == &chunks.front()) {
+      // Text output is flushed after every chunk:
+      std::ifstream partial_file(text_filename);
+      std::string partial_text((std::istreambuf_iterator<char>(partial_file)),
+                               std::istreambuf_iterator<char>());
+      EXPECT_TRUE(absl::StrContains(partial_text, "peer_logs"));
+    }
+  }
+  EXPECT_TRUE(google::protobuf::util::MessageDifferencer::Equals(
+      merged_results, results));
+
+  // Both files put the pieces of each instance log back together:
+  text_writer->reset();
+  binary_writer->reset();
+  std::ifstream text_file(text_filename);
+  std::string text((std::istreambuf_iterator<char>(text_file)),
+                   std::istreambuf_iterator<char>());
+  TestSequenceResults text_results;
+  ASSERT_TRUE(
+      google::protobuf::TextFormat::ParseFromString(text, &text_results));
+  EXPECT_TRUE(google::protobuf::util::MessageDifferencer::Equals(
+      text_results, results));
+  std::ifstream binary_file(binary_filename, std::ios::binary);
+  TestSequenceResults binary_results;
+  ASSERT_TRUE(binary_results.ParseFromIstream(&binary_file));
+  EXPECT_TRUE(google::protobuf::util::MessageDifferencer::Equals(
+      binary_results, results));
+  unlink(text_filename.c_str());
+  unlink(binary_filename.c_str());
+}
+
 TEST(DistBenchTestSequencer, VariablePayloadSizeTest) {
   int nb_cliques = 2;
 
@@ -14,11 +14,25 @@
 
 #include "distbench_thread_support.h"
 
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
 #include <memory>
 
 #include "absl/base/const_init.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/strip.h"
 #include "absl/synchronization/mutex.h"
 #include "absl/synchronization/notification.h"
+#include "glog/logging.h"
 
 namespace distbench {
 
@@ -29,8 +43,144 @@ int abort_max_threads = 0;
 int abort_current_threads = 0;
 std::function<void()> abort_callback;
 
+// The node masks passed to the NUMA syscalls below are bitmaps of
+// kMaxNumaNodes bits:
+constexpr int kMaxNumaNodes = 1024;
+constexpr int kBitsPerWord = 8 * sizeof(unsigned long);
+using NodeMask = unsigned long[kMaxNumaNodes / kBitsPerWord];
+
+absl::StatusOr<std::vector<int>> ParseCpuList(const std::string& cpu_list) {
+  std::vector<int> cpus;
+  for (absl::string_view range :
+       absl::StrSplit(cpu_list, ',', absl::SkipWhitespace())) {
+    range = absl::StripAsciiWhitespace(range);
+    std::vector<absl::string_view> bounds = absl::StrSplit(range, '-');
+    int first;
+    int last;
+    if (bounds.size() > 2 || !absl::SimpleAtoi(bounds.front(), &first) ||
+        !absl::SimpleAtoi(bounds.back(), &last) || first < 0 ||
+        last < first || last >= CPU_SETSIZE) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Invalid cpu list: \"", cpu_list, "\""));
+    }
+    for (int cpu = first; cpu <= last; ++cpu) {
+      cpus.push_back(cpu);
+    }
+  }
+  return cpus;
+}
+
+absl::Status ErrnoStatus(std::string_view what) {
+  return absl::InternalError(absl::StrCat(what, ": ", strerror(errno)));
+}
+
 }  // namespace
 
+absl::StatusOr<ThreadPlacement> ParseThreadPlacement(std::string_view cpu_list,
+                                                     int numa_node) {
+  ThreadPlacement placement;
+  if (numa_node >= kMaxNumaNodes) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Invalid NUMA node: ", numa_node));
+  }
+  placement.numa_node = numa_node < 0 ? -1 : numa_node;
+  std::string cpus(cpu_list);
+  if (cpus.empty() && placement.numa_node >= 0) {
+    std::ifstream node_cpus(absl::StrCat(
+        "/sys/devices/system/node/node", placement.numa_node, "/cpulist"));
+    if (!std::getline(node_cpus, cpus)) {
+      return absl::NotFoundError(
+          absl::StrCat("NUMA node not found: ", placement.numa_node));
+    }
+  }
+  auto maybe_cpus = ParseCpuList(cpus);
+  if (!maybe_cpus.ok()) return maybe_cpus.status();
+  placement.cpus = std::move(maybe_cpus.value());
+  return placement;
+}
+
+absl::Status ApplyThreadPlacement(const ThreadPlacement& placement) {
+  if (!placement.cpus.empty()) {
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (int cpu : placement.cpus) {
+      CPU_SET(cpu, &cpu_set);
+    }
+    int error = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set),
+                                       &cpu_set);
+    if (error) {
+      errno = error;
+      return ErrnoStatus("pthread_setaffinity_np");
+    }
+  }
+  if (placement.numa_node >= 0) {
+    NodeMask node_mask = {};
+    node_mask[placement.numa_node / kBitsPerWord] |=
+        1ul << (placement.numa_node % kBitsPerWord);
+    if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, node_mask,
+                kMaxNumaNodes) != 0) {
+      return ErrnoStatus("set_mempolicy");
+    }
+  }
+  return absl::OkStatus();
+}
+
+std::string GetThreadCpuList() {
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  if (pthread_getaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set)) {
+    return "";
+  }
+  std::string cpu_list;
+  for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+    if (!CPU_ISSET(cpu, &cpu_set)) continue;
+    int last = cpu;
+    while (last + 1 < CPU_SETSIZE && CPU_ISSET(last + 1, &cpu_set)) {
+      ++last;
+    }
+    absl::StrAppend(&cpu_list, cpu_list.empty() ? "" : ",", cpu);
+    if (last > cpu) absl::StrAppend(&cpu_list, "-", last);
+    cpu = last;
+  }
+  return cpu_list;
+}
+
+int GetThreadNumaNode() {
+  int mode;
+  NodeMask node_mask = {};
+  if (syscall(SYS_get_mempolicy, &mode, node_mask, kMaxNumaNodes, nullptr,
+              0) != 0 ||
+      mode != MPOL_PREFERRED) {
+    return -1;
+  }
+  for (int node = 0; node < kMaxNumaNodes; ++node) {
+    if (node_mask[node / kBitsPerWord] & (1ul << (node % kBitsPerWord))) {
+      return node;
+    }
+  }
+  return -1;
+}
+
+absl::Status BindMemoryToNumaNode(void* addr, size_t size, int numa_node) {
+  if (numa_node < 0 || numa_node >= kMaxNumaNodes) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Invalid NUMA node: ", numa_node));
+  }
+  const uintptr_t page_size = sysconf(_SC_PAGESIZE);
+  uintptr_t start = reinterpret_cast<uintptr_t>(addr);
+  uintptr_t end = start + size;
+  start = (start + page_size - 1) & ~(page_size - 1);
+  end &= ~(page_size - 1);
+  if (start >= end) return absl::OkStatus();
+  NodeMask node_mask = {};
+  node_mask[numa_node / kBitsPerWord] |= 1ul << (numa_node % kBitsPerWord);
+  if (syscall(SYS_mbind, start, end - start, MPOL_BIND, node_mask,
+              kMaxNumaNodes, MPOL_MF_MOVE) != 0) {
+    return ErrnoStatus("mbind");
+  }
+  return absl::OkStatus();
+}
+
 void SetOverloadAbortThreshhold(int max_threads) {
   absl::MutexLock m(&abort_mutex);
   abort_max_threads = max_threads;
@@ -45,7 +195,8 @@ void SetOverloadAbortCallback(std::function<void()> callback) {
 }
 
 std::thread RunRegisteredThread(std::string_view thread_name,
-                                std::function<void()> f) {
+                                std::function<void()> f,
+                                ThreadPlacement placement) {
   std::shared_ptr<absl::Notification> abort_callback_notification;
   absl::Notification abort_callback_started;
   {
@@ -60,6 +211,13 @@ std::thread RunRegisteredThread(std::string_view thread_name,
   }
   auto ret = std::thread([=, &abort_callback_started]() {
     RegisterThread(thread_name);
+    if (!placement.empty()) {
+      absl::Status status = ApplyThreadPlacement(placement);
+      if (!status.ok()) {
+        LOG(ERROR) << "Could not place thread " << thread_name << ": "
+                   << status;
+      }
+    }
     if (abort_callback_notification) {
       abort_callback_started.Notify();
       if (abort_callback) {
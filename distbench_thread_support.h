@@ -16,17 +16,54 @@
 #define DISTBENCH_DISTBENCH_THREAD_SUPPORT_H_
 
 #include <functional>
+#include <string>
 #include <string_view>
 #include <thread>
+#include <vector>
+
+#include "absl/status/statusor.h"
 
 namespace distbench {
 
+// Where threads run, and where the memory they allocate comes from.
+struct ThreadPlacement {
+  // The cpus the threads may run on; any cpu if empty.
+  std::vector<int> cpus;
+  // The NUMA node that memory is preferably allocated from; the default
+  // policy applies if negative.
+  int numa_node = -1;
+
+  bool empty() const { return cpus.empty() && numa_node < 0; }
+};
+
+// Parses a cpu list such as "0-3,8". If cpu_list is empty and numa_node is
+// not negative, the threads are restricted to the cpus of that node.
+absl::StatusOr<ThreadPlacement> ParseThreadPlacement(std::string_view cpu_list,
+                                                     int numa_node);
+
+// Applies placement to the calling thread. Threads created afterwards by the
+// calling thread inherit it.
+absl::Status ApplyThreadPlacement(const ThreadPlacement& placement);
+
+// Returns the cpus that the calling thread may run on, e.g. "0-3,8".
+std::string GetThreadCpuList();
+
+// Returns the NUMA node that the calling thread preferably allocates memory
+// from, or -1 if it follows the default policy.
+int GetThreadNumaNode();
+
+// Binds the pages of [addr, addr + size) to numa_node, moving the pages that
+// were already allocated elsewhere. Partial pages at either end are skipped.
+absl::Status BindMemoryToNumaNode(void* addr, size_t size, int numa_node);
+
 void SetOverloadAbortThreshhold(int max_threads);
 
 void SetOverloadAbortCallback(std::function<void()> callback);
 
+// Applies placement to the new thread before running f, unless it is empty.
 std::thread RunRegisteredThread(std::string_view thread_name,
-                                std::function<void()> f);
+                                std::function<void()> f,
+                                ThreadPlacement placement = {});
 
 void RegisterThread(std::string_view thread_name);
 
@@ -0,0 +1,95 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "distbench_thread_support.h"
+
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "glog/logging.h"
+#include "gtest/gtest.h"
+#include "gtest_utils.h"
+
+namespace distbench {
+namespace {
+
+// Returns the first cpu that the calling thread may run on:
+int FirstAllowedCpu() {
+  auto placement = ParseThreadPlacement(GetThreadCpuList(), -1);
+  CHECK(placement.ok());
+  CHECK(!placement.value().cpus.empty());
+  return placement.value().cpus.front();
+}
+
+TEST(ThreadPlacementTest, ParseCpuList) {
+  auto placement = ParseThreadPlacement("0-3, 8", -1);
+  ASSERT_OK(placement.status());
+  EXPECT_EQ(placement.value().cpus, std::vector<int>({0, 1, 2, 3, 8}));
+  EXPECT_EQ(placement.value().numa_node, -1);
+  EXPECT_FALSE(placement.value().empty());
+}
+
+TEST(ThreadPlacementTest, ParseEmpty) {
+  auto placement = ParseThreadPlacement("", -1);
+  ASSERT_OK(placement.status());
+  EXPECT_TRUE(placement.value().empty());
+}
+
+TEST(ThreadPlacementTest, ParseBadCpuList) {
+  EXPECT_FALSE(ParseThreadPlacement("3-1", -1).ok());
+  EXPECT_FALSE(ParseThreadPlacement("1-2-3", -1).ok());
+  EXPECT_FALSE(ParseThreadPlacement("-1", -1).ok());
+  EXPECT_FALSE(ParseThreadPlacement("zero", -1).ok());
+  EXPECT_FALSE(ParseThreadPlacement("100000", -1).ok());
+}
+
+TEST(ThreadPlacementTest, ParseNumaNode) {
+  auto placement = ParseThreadPlacement("", 0);
+  ASSERT_OK(placement.status());
+  EXPECT_FALSE(placement.value().cpus.empty());
+  EXPECT_EQ(placement.value().numa_node, 0);
+  EXPECT_FALSE(ParseThreadPlacement("", 1000000).ok());
+}
+
+TEST(ThreadPlacementTest, RunPlacedThread) {
+  const int cpu = FirstAllowedCpu();
+  const std::string initial_cpu_list = GetThreadCpuList();
+  ThreadPlacement placement;
+  placement.cpus = {cpu};
+  placement.numa_node = 0;
+  std::string cpu_list;
+  int numa_node = -1;
+  RunRegisteredThread(
+      "PlacedThread",
+      [&]() {
+        cpu_list = GetThreadCpuList();
+        numa_node = GetThreadNumaNode();
+      },
+      placement)
+      .join();
+  EXPECT_EQ(cpu_list, absl::StrCat(cpu));
+  EXPECT_EQ(numa_node, 0);
+  // The calling thread is left alone:
+  EXPECT_EQ(GetThreadCpuList(), initial_cpu_list);
+  EXPECT_EQ(GetThreadNumaNode(), -1);
+}
+
+TEST(ThreadPlacementTest, BindMemoryToNumaNode) {
+  std::vector<char> buffer(1 << 20, 'D');
+  ASSERT_OK(BindMemoryToNumaNode(buffer.data(), buffer.size(), 0));
+  EXPECT_FALSE(BindMemoryToNumaNode(buffer.data(), buffer.size(), -1).ok());
+}
+
+}  // namespace
+}  // namespace distbench
@@ -14,10 +14,19 @@
 
 #include "distbench_threadpool.h"
 
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <climits>
+#include <deque>
 #include <queue>
 #include <thread>
 
 #include "absl/synchronization/notification.h"
+#include "distbench.pb.h"
+#include "distbench_spin_wait.h"
 #include "distbench_thread_support.h"
 #include "glog/logging.h"
 
@@ -29,19 +38,77 @@ namespace distbench {
 
 namespace {
 
+int64_t SteadyClockNanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+}  // anonymous namespace
+
+std::function<void()> ThreadpoolTelemetry::WrapTask(
+    std::function<void()> task) {
+  if (!enabled_) return task;
+  int64_t depth = queue_depth_.fetch_add(1, std::memory_order_relaxed) + 1;
+  int64_t max_depth = max_queue_depth_.load(std::memory_order_relaxed);
+  while (depth > max_depth &&
+         !max_queue_depth_.compare_exchange_weak(max_depth, depth,
+                                                 std::memory_order_relaxed)) {
+  }
+  return [this, task = std::move(task), enqueue_ns = SteadyClockNanos()]() {
+    int64_t start_ns = SteadyClockNanos();
+    queue_depth_.fetch_sub(1, std::memory_order_relaxed);
+    queueing_delay_.Record(start_ns - enqueue_ns);
+    task();
+    run_time_.Record(SteadyClockNanos() - start_ns);
+  };
+}
+
+void ThreadpoolTelemetry::AddTo(ThreadpoolLog* log) const {
+  if (enabled_) {
+    queueing_delay_.AddTo(log->mutable_queueing_delay());
+    run_time_.AddTo(log->mutable_run_time());
+    log->set_max_queue_depth(max_queue_depth_.load(std::memory_order_relaxed));
+  }
+  log->set_blocked_add_task_calls(
+      blocked_add_task_calls_.load(std::memory_order_relaxed));
+}
+
+ThreadpoolLog AbstractThreadpool::GetLog() {
+  ThreadpoolLog log;
+  telemetry_.AddTo(&log);
+  for (const auto& stat : GetStats()) {
+    (*log.mutable_stats())[stat.name] = stat.value;
+  }
+  return log;
+}
+
+namespace {
+
+// Reports the cost and outcome of spinning, if the pool spins at all:
+void AppendSpinStats(const SpinStats& stats, bool enabled,
+                     std::vector<ThreadpoolStat>* ret) {
+  if (!enabled) return;
+  ret->push_back({"spin_ns", stats.spin_ns.load()});
+  ret->push_back({"spin_hits", stats.spin_hits.load()});
+  ret->push_back({"spin_misses", stats.spin_misses.load()});
+}
+
 class NullThreadpool : public AbstractThreadpool {
  public:
-  NullThreadpool(int nb_threads);
+  NullThreadpool(int nb_threads, ThreadPlacement placement);
   ~NullThreadpool() override;
   void AddTask(std::function<void()> task) override;
   std::vector<ThreadpoolStat> GetStats() override;
 
  private:
+  const ThreadPlacement placement_;
   mutable absl::Mutex mutex_;
   int active_threads_ = 0;
 };
 
-NullThreadpool::NullThreadpool(int nb_threads) {}
+NullThreadpool::NullThreadpool(int nb_threads, ThreadPlacement placement)
+    : placement_(std::move(placement)) {}
 
 NullThreadpool::~NullThreadpool() {
   auto all_threads_done = [this]() { return active_threads_ == 0; };
@@ -50,6 +117,7 @@ NullThreadpool::~NullThreadpool() {
 }
 
 void NullThreadpool::AddTask(std::function<void()> task) {
+  task = telemetry_.WrapTask(std::move(task));
   {
     absl::MutexLock m(&mutex_);
     ++active_threads_;
@@ -59,26 +127,34 @@ void NullThreadpool::AddTask(std::function<void()> task) {
     absl::MutexLock m(&mutex_);
     --active_threads_;
   };
-  RunRegisteredThread("NullThreadPool", function_wrapper).detach();
+  RunRegisteredThread("NullThreadPool", function_wrapper, placement_).detach();
 }
 
 std::vector<ThreadpoolStat> NullThreadpool::GetStats() { return {}; }
 
 class SimpleThreadpool : public AbstractThreadpool {
  public:
-  SimpleThreadpool(int nb_threads);
+  SimpleThreadpool(int nb_threads, ThreadPlacement placement,
+                   int64_t max_spin_ns);
   ~SimpleThreadpool() override;
   void AddTask(std::function<void()> task) override;
   std::vector<ThreadpoolStat> GetStats() override;
 
  private:
+  const ThreadPlacement placement_;
+  const int64_t max_spin_ns_;
   mutable absl::Mutex mutex_;
   absl::Notification shutdown_;
   int active_threads_ = 0;
   std::queue<std::function<void()>> task_queue_;
+  // The size of task_queue_, which spinning threads poll without locking:
+  std::atomic<int64_t> queued_tasks_ = 0;
+  SpinStats spin_stats_;
 };
 
-SimpleThreadpool::SimpleThreadpool(int nb_threads) {
+SimpleThreadpool::SimpleThreadpool(int nb_threads, ThreadPlacement placement,
+                                   int64_t max_spin_ns)
+    : placement_(std::move(placement)), max_spin_ns_(max_spin_ns) {
   active_threads_ = nb_threads;
   for (int i = 0; i < nb_threads; i++) {
     auto task_runner = [this]() {
@@ -86,8 +162,15 @@ SimpleThreadpool::SimpleThreadpool(int nb_threads) {
         return !task_queue_.empty() || shutdown_.HasBeenNotified();
       };
       auto working_conditions = absl::Condition(&task_available);
+      AdaptiveSpinner spinner(max_spin_ns_, &spin_stats_);
       do {
         std::function<void()> task;
+        if (spinner.enabled()) {
+          spinner.SpinUntil([this]() {
+            return queued_tasks_.load(std::memory_order_relaxed) > 0 ||
+                   shutdown_.HasBeenNotified();
+          });
+        }
         {
           absl::MutexLock m(&mutex_);
           mutex_.Await(working_conditions);
@@ -97,11 +180,12 @@ SimpleThreadpool::SimpleThreadpool(int nb_threads) {
           }
           task = std::move(task_queue_.front());
           task_queue_.pop();
+          queued_tasks_.fetch_sub(1, std::memory_order_relaxed);
         }
         task();
       } while (true);
     };
-    RunRegisteredThread("SimpleThreadPool", task_runner).detach();
+    RunRegisteredThread("SimpleThreadPool", task_runner, placement_).detach();
   }
 }
 
@@ -112,16 +196,23 @@ SimpleThreadpool::~SimpleThreadpool() {
   mutex_.Await(absl::Condition(&all_threads_done));
 }
 
-std::vector<ThreadpoolStat> SimpleThreadpool::GetStats() { return {}; }
+std::vector<ThreadpoolStat> SimpleThreadpool::GetStats() {
+  std::vector<ThreadpoolStat> ret;
+  AppendSpinStats(spin_stats_, max_spin_ns_ > 0, &ret);
+  return ret;
+}
 
 void SimpleThreadpool::AddTask(std::function<void()> task) {
+  task = telemetry_.WrapTask(std::move(task));
   absl::MutexLock m(&mutex_);
   task_queue_.push(std::move(task));
+  queued_tasks_.fetch_add(1, std::memory_order_relaxed);
 }
 
 class ElasticThreadpool : public AbstractThreadpool {
  public:
-  ElasticThreadpool(int nb_threads);
+  ElasticThreadpool(int nb_threads, ThreadPlacement placement,
+                    int64_t max_spin_ns);
   ~ElasticThreadpool() override;
   void AddTask(std::function<void()> task) override;
   std::vector<ThreadpoolStat> GetStats() override;
@@ -131,6 +222,8 @@ class ElasticThreadpool : public AbstractThreadpool {
   bool WaitForTask() ABSL_EXCLUSIVE_LOCKS_REQUIRED(task_mutex_);
 
   const size_t max_idle_threads_ = 0;
+  const ThreadPlacement placement_;
+  const int64_t max_spin_ns_;
   size_t task_count_ = 0;
   size_t idle_threads_ = 0;
   size_t threads_launched_ = 0;
@@ -138,10 +231,20 @@ class ElasticThreadpool : public AbstractThreadpool {
   mutable absl::Mutex task_mutex_;
   absl::Notification shutdown_;
   std::queue<std::function<void()>> task_queue_ ABSL_GUARDED_BY(task_mutex_);
+  // The size of task_queue_, which spinning threads poll without locking:
+  std::atomic<int64_t> queued_tasks_ = 0;
+  // Spinning threads count as idle, so that AddTask does not launch a new
+  // thread for a task that one of them is about to pick up:
+  std::atomic<int64_t> spinning_threads_ = 0;
+  SpinStats spin_stats_;
 };
 
-ElasticThreadpool::ElasticThreadpool(int nb_threads)
-    : max_idle_threads_(nb_threads) {}
+ElasticThreadpool::ElasticThreadpool(int nb_threads,
+                                     ThreadPlacement placement,
+                                     int64_t max_spin_ns)
+    : max_idle_threads_(nb_threads),
+      placement_(std::move(placement)),
+      max_spin_ns_(max_spin_ns) {}
 
 void ElasticThreadpool::AddTask(std::function<void()> task) {
   auto ok_to_add = [this]() ABSL_EXCLUSIVE_LOCKS_REQUIRED(task_mutex_) {
@@ -149,24 +252,30 @@ void ElasticThreadpool::AddTask(std::function<void()> task) {
   };
   auto ok_conditions = absl::Condition(&ok_to_add);
 
+  task = telemetry_.WrapTask(std::move(task));
   task_mutex_.Lock();
+  if (!ok_to_add()) telemetry_.RecordBlockedAddTask();
   task_mutex_.Await(ok_conditions);
   task_queue_.push(std::move(task));
+  queued_tasks_.fetch_add(1, std::memory_order_relaxed);
+  size_t idle_threads = idle_threads_ + spinning_threads_.load();
   bool need_to_grow_threadpool =
-      (idle_threads_ == 0) || (active_threads_ < max_idle_threads_ &&
-                               task_queue_.size() > idle_threads_);
+      (idle_threads == 0) || (active_threads_ < max_idle_threads_ &&
+                              task_queue_.size() > idle_threads);
   if (need_to_grow_threadpool) {
     ++threads_launched_;
     ++active_threads_;
     task = std::move(task_queue_.front());
     task_queue_.pop();
+    queued_tasks_.fetch_sub(1, std::memory_order_relaxed);
   }
   task_mutex_.Unlock();
   if (need_to_grow_threadpool) {
     auto elastic_runner = [this, lambda_task = std::move(task)]() {
       TaskRunner(std::move(lambda_task));
     };
-    RunRegisteredThread("ElasticThreadPool", elastic_runner).detach();
+    RunRegisteredThread("ElasticThreadPool", elastic_runner, placement_)
+        .detach();
   }
 }
 
@@ -188,12 +297,21 @@ void ElasticThreadpool::TaskRunner(std::function<void()> task) {
   bool need_to_grow_threadpool = false;
   std::function<void()> task2;
   bool did_work = false;
+  AdaptiveSpinner spinner(max_spin_ns_, &spin_stats_);
   while (1) {
     if (task) {
       task();
       task = nullptr;
       did_work = true;
     }
+    if (spinner.enabled()) {
+      spinning_threads_.fetch_add(1);
+      spinner.SpinUntil([this]() {
+        return queued_tasks_.load(std::memory_order_relaxed) > 0 ||
+               shutdown_.HasBeenNotified();
+      });
+      spinning_threads_.fetch_sub(1);
+    }
     task_mutex_.Lock();
     if (did_work) {
       ++task_count_;
@@ -210,19 +328,22 @@ void ElasticThreadpool::TaskRunner(std::function<void()> task) {
       // A task is available....
       task = std::move(task_queue_.front());
       task_queue_.pop();
+      queued_tasks_.fetch_sub(1, std::memory_order_relaxed);
       need_to_grow_threadpool = (idle_threads_ == 0 && !task_queue_.empty());
       if (need_to_grow_threadpool) {
         ++threads_launched_;
         ++active_threads_;
         task2 = std::move(task_queue_.front());
         task_queue_.pop();
+        queued_tasks_.fetch_sub(1, std::memory_order_relaxed);
       }
       task_mutex_.Unlock();
       if (need_to_grow_threadpool) {
         auto elastic_runner = [this, lambda_task2 = std::move(task2)]() {
           TaskRunner(std::move(lambda_task2));
         };
-        RunRegisteredThread("ElasticThreadPool", elastic_runner).detach();
+        RunRegisteredThread("ElasticThreadPool", elastic_runner, placement_)
+            .detach();
       }
     } else {
       // Timed out waiting for a task; maybe need to retire this thread:
@@ -246,6 +367,7 @@ std::vector<ThreadpoolStat> ElasticThreadpool::GetStats() {
   ret[0].value = threads_launched_;
   ret[1].name = "tasks_processed";
   ret[1].value = task_count_;
+  AppendSpinStats(spin_stats_, max_spin_ns_ > 0, &ret);
   return ret;
 }
 
@@ -260,6 +382,443 @@ ElasticThreadpool::~ElasticThreadpool() {
   }
 }
 
+// A fixed set of workers, each with its own deque of tasks, so that there is
+// no single lock for all producers and consumers to contend on. Tasks added
+// from a worker go to the back of its own deque, and are run LIFO while they
+// are still hot in its cache. Other tasks go to a random worker. Idle workers
+// steal the oldest task of another worker, picked at random, before going to
+// sleep.
+class WorkStealingThreadpool : public AbstractThreadpool {
+ public:
+  WorkStealingThreadpool(int nb_threads, ThreadPlacement placement,
+                         int64_t max_spin_ns);
+  ~WorkStealingThreadpool() override;
+  void AddTask(std::function<void()> task) override;
+  std::vector<ThreadpoolStat> GetStats() override;
+
+ private:
+  struct alignas(64) Worker {
+    absl::Mutex mutex;
+    std::deque<std::function<void()>> tasks ABSL_GUARDED_BY(mutex);
+    std::atomic<int64_t> tasks_processed = 0;
+    std::atomic<int64_t> tasks_stolen = 0;
+  };
+
+  void TaskRunner(int worker_index);
+  bool PopTask(int worker_index, std::function<void()>* task);
+  bool StealTask(int worker_index, uint64_t* rand_state,
+                 std::function<void()>* task);
+
+  const int nb_workers_;
+  const ThreadPlacement placement_;
+  const int64_t max_spin_ns_;
+  std::unique_ptr<Worker[]> workers_;
+  std::vector<std::thread> threads_;
+  // The number of tasks sitting in the deques, which idle workers wait on:
+  std::atomic<int64_t> queued_tasks_ = 0;
+  std::atomic<int> idle_workers_ = 0;
+  std::atomic<bool> shutdown_ = false;
+  absl::Mutex idle_mutex_;
+  SpinStats spin_stats_;
+};
+
+// The pool and worker index of the current thread, if it is a worker:
+thread_local const WorkStealingThreadpool* current_pool = nullptr;
+thread_local int current_worker_index = -1;
+
+uint64_t NextRandom(uint64_t* state) {
+  // xorshift64:
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return *state;
+}
+
+WorkStealingThreadpool::WorkStealingThreadpool(int nb_threads,
+                                               ThreadPlacement placement,
+                                               int64_t max_spin_ns)
+    : nb_workers_(nb_threads),
+      placement_(std::move(placement)),
+      max_spin_ns_(max_spin_ns),
+      workers_(std::make_unique<Worker[]>(nb_threads)) {
+  for (int i = 0; i < nb_workers_; ++i) {
+    threads_.push_back(RunRegisteredThread(
+        "WorkStealingThreadPool", [this, i]() { TaskRunner(i); }, placement_));
+  }
+}
+
+WorkStealingThreadpool::~WorkStealingThreadpool() {
+  shutdown_ = true;
+  {
+    // Wake up the idle workers:
+    absl::MutexLock m(&idle_mutex_);
+  }
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+}
+
+void WorkStealingThreadpool::AddTask(std::function<void()> task) {
+  task = telemetry_.WrapTask(std::move(task));
+  int worker_index = current_worker_index;
+  if (current_pool != this) {
+    thread_local uint64_t rand_state =
+        std::hash<std::thread::id>()(std::this_thread::get_id()) | 1;
+    worker_index = NextRandom(&rand_state) % nb_workers_;
+  }
+  {
+    absl::MutexLock m(&workers_[worker_index].mutex);
+    workers_[worker_index].tasks.push_back(std::move(task));
+  }
+  queued_tasks_.fetch_add(1);
+  if (idle_workers_.load() > 0) {
+    // Unlocking makes the idle workers re-evaluate their wait condition:
+    absl::MutexLock m(&idle_mutex_);
+  }
+}
+
+bool WorkStealingThreadpool::PopTask(int worker_index,
+                                     std::function<void()>* task) {
+  Worker& worker = workers_[worker_index];
+  absl::MutexLock m(&worker.mutex);
+  if (worker.tasks.empty()) return false;
+  *task = std::move(worker.tasks.back());
+  worker.tasks.pop_back();
+  queued_tasks_.fetch_sub(1);
+  return true;
+}
+
+bool WorkStealingThreadpool::StealTask(int worker_index, uint64_t* rand_state,
+                                       std::function<void()>* task) {
+  int start = NextRandom(rand_state) % nb_workers_;
+  for (int i = 0; i < nb_workers_; ++i) {
+    int victim_index = (start + i) % nb_workers_;
+    if (victim_index == worker_index) continue;
+    Worker& victim = workers_[victim_index];
+    absl::MutexLock m(&victim.mutex);
+    if (victim.tasks.empty()) continue;
+    *task = std::move(victim.tasks.front());
+    victim.tasks.pop_front();
+    queued_tasks_.fetch_sub(1);
+    workers_[worker_index].tasks_stolen.fetch_add(1,
+                                                  std::memory_order_relaxed);
+    return true;
+  }
+  return false;
+}
+
+void WorkStealingThreadpool::TaskRunner(int worker_index) {
+  current_pool = this;
+  current_worker_index = worker_index;
+  uint64_t rand_state = 0x9E3779B97F4A7C15ULL * (worker_index + 1);
+  auto work_available = [this]() {
+    return queued_tasks_.load() > 0 || shutdown_.load();
+  };
+  std::function<void()> task;
+  AdaptiveSpinner spinner(max_spin_ns_, &spin_stats_);
+  while (true) {
+    if (PopTask(worker_index, &task) ||
+        StealTask(worker_index, &rand_state, &task)) {
+      task();
+      task = nullptr;
+      workers_[worker_index].tasks_processed.fetch_add(
+          1, std::memory_order_relaxed);
+      continue;
+    }
+    // Remaining tasks are drained before shutting down:
+    if (shutdown_.load() && queued_tasks_.load() == 0) break;
+    // Spinning workers are not registered as idle, so AddTask does not need
+    // to touch idle_mutex_ to hand them a task:
+    if (spinner.enabled() && spinner.SpinUntil(work_available)) continue;
+    // Registering as idle before checking queued_tasks_ again means that
+    // AddTask either sees us idle and wakes us up, or we see its task:
+    idle_workers_.fetch_add(1);
+    idle_mutex_.LockWhen(absl::Condition(&work_available));
+    idle_mutex_.Unlock();
+    idle_workers_.fetch_sub(1);
+  }
+  current_pool = nullptr;
+  current_worker_index = -1;
+}
+
+std::vector<ThreadpoolStat> WorkStealingThreadpool::GetStats() {
+  int64_t tasks_processed = 0;
+  int64_t tasks_stolen = 0;
+  for (int i = 0; i < nb_workers_; ++i) {
+    tasks_processed += workers_[i].tasks_processed;
+    tasks_stolen += workers_[i].tasks_stolen;
+  }
+  std::vector<ThreadpoolStat> ret;
+  ret.resize(3);
+  ret[0].name = "threads_launched";
+  ret[0].value = nb_workers_;
+  ret[1].name = "tasks_processed";
+  ret[1].value = tasks_processed;
+  ret[2].name = "tasks_stolen";
+  ret[2].value = tasks_stolen;
+  AppendSpinStats(spin_stats_, max_spin_ns_ > 0, &ret);
+  return ret;
+}
+
+// A fixed set of workers sharing a bounded lock-free MPMC ring buffer, as
+// described by Dmitry Vyukov. Each cell carries a sequence number telling
+// producers and consumers whether it is free for the current lap, so that
+// handing off a task costs one CAS and no lock. Workers that find the queue
+// empty spin briefly (for up to max_spin_ns if it is set, or for a fixed
+// number of polls otherwise) and then park on a futex used as an event count.
+// When the ring is full, tasks go to an unbounded overflow queue behind a
+// mutex, and keep going there until workers have drained it, so that tasks
+// still start in the order they were added, and callers never block.
+class LockFreeThreadpool : public AbstractThreadpool {
+ public:
+  LockFreeThreadpool(int nb_threads, ThreadPlacement placement,
+                     int64_t max_spin_ns);
+  ~LockFreeThreadpool() override;
+  void AddTask(std::function<void()> task) override;
+  std::vector<ThreadpoolStat> GetStats() override;
+
+ private:
+  static constexpr size_t kQueueCapacity = 4096;
+  static constexpr int kSpinsBeforeParking = 100;
+  static_assert((kQueueCapacity & (kQueueCapacity - 1)) == 0,
+                "kQueueCapacity must be a power of 2");
+
+  struct alignas(64) Cell {
+    std::atomic<size_t> sequence;
+    std::function<void()> task;
+  };
+
+  struct alignas(64) WorkerStats {
+    std::atomic<int64_t> tasks_processed = 0;
+    std::atomic<int64_t> parks = 0;
+  };
+
+  bool QueueMaybeNonEmpty() const;
+  bool TryEnqueue(std::function<void()>& task);
+  bool TryDequeue(std::function<void()>* task);
+  // Takes a task from the ring, or from the overflow queue once the ring is
+  // empty:
+  bool TryDequeueAny(std::function<void()>* task);
+  void TaskRunner(int worker_index);
+  void WakeOneWorker();
+
+  const int nb_workers_;
+  const ThreadPlacement placement_;
+  const int64_t max_spin_ns_;
+  std::unique_ptr<Cell[]> buffer_;
+  std::unique_ptr<WorkerStats[]> worker_stats_;
+  std::vector<std::thread> threads_;
+  alignas(64) std::atomic<size_t> enqueue_pos_ = 0;
+  alignas(64) std::atomic<size_t> dequeue_pos_ = 0;
+  // Bumped by producers before waking workers, so that a worker about to
+  // park notices a task enqueued after it last looked:
+  alignas(64) std::atomic<uint32_t> epoch_ = 0;
+  std::atomic<int> parked_workers_ = 0;
+  std::atomic<bool> shutdown_ = false;
+  absl::Mutex overflow_mutex_;
+  std::deque<std::function<void()>> overflow_ ABSL_GUARDED_BY(overflow_mutex_);
+  // The size of overflow_, readable without the mutex:
+  std::atomic<int64_t> overflow_size_ = 0;
+  std::atomic<int64_t> overflowed_tasks_ = 0;
+  std::atomic<int64_t> wakeups_ = 0;
+  SpinStats spin_stats_;
+};
+
+void FutexWait(std::atomic<uint32_t>* word, uint32_t expected) {
+  syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAIT_PRIVATE,
+          expected, nullptr, nullptr, 0);
+}
+
+void FutexWake(std::atomic<uint32_t>* word, int count) {
+  syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAKE_PRIVATE,
+          count, nullptr, nullptr, 0);
+}
+
+LockFreeThreadpool::LockFreeThreadpool(int nb_threads,
+                                       ThreadPlacement placement,
+                                       int64_t max_spin_ns)
+    : nb_workers_(nb_threads),
+      placement_(std::move(placement)),
+      max_spin_ns_(max_spin_ns),
+      buffer_(std::make_unique<Cell[]>(kQueueCapacity)),
+      worker_stats_(std::make_unique<WorkerStats[]>(nb_threads)) {
+  for (size_t i = 0; i < kQueueCapacity; ++i) {
+    buffer_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+  for (int i = 0; i < nb_workers_; ++i) {
+    threads_.push_back(RunRegisteredThread(
+        "LockFreeThreadPool", [this, i]() { TaskRunner(i); }, placement_));
+  }
+}
+
+LockFreeThreadpool::~LockFreeThreadpool() {
+  shutdown_ = true;
+  epoch_.fetch_add(1);
+  FutexWake(&epoch_, INT_MAX);
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+}
+
+bool LockFreeThreadpool::QueueMaybeNonEmpty() const {
+  return dequeue_pos_.load(std::memory_order_relaxed) !=
+             enqueue_pos_.load(std::memory_order_relaxed) ||
+         overflow_size_.load(std::memory_order_relaxed) > 0;
+}
+
+bool LockFreeThreadpool::TryEnqueue(std::function<void()>& task) {
+  size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+  Cell* cell;
+  while (true) {
+    cell = &buffer_[pos & (kQueueCapacity - 1)];
+    size_t sequence = cell->sequence.load(std::memory_order_acquire);
+    intptr_t diff =
+        static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+    if (diff == 0) {
+      if (enqueue_pos_.compare_exchange_weak(pos, pos + 1,
+                                             std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      // The cell still holds a task from the previous lap:
+      return false;
+    } else {
+      pos = enqueue_pos_.load(std::memory_order_relaxed);
+    }
+  }
+  cell->task = std::move(task);
+  cell->sequence.store(pos + 1, std::memory_order_release);
+  return true;
+}
+
+bool LockFreeThreadpool::TryDequeue(std::function<void()>* task) {
+  size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+  Cell* cell;
+  while (true) {
+    cell = &buffer_[pos & (kQueueCapacity - 1)];
+    size_t sequence = cell->sequence.load(std::memory_order_acquire);
+    intptr_t diff =
+        static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+    if (diff == 0) {
+      if (dequeue_pos_.compare_exchange_weak(pos, pos + 1,
+                                             std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      // The cell has not been filled yet for this lap:
+      return false;
+    } else {
+      pos = dequeue_pos_.load(std::memory_order_relaxed);
+    }
+  }
+  *task = std::move(cell->task);
+  cell->task = nullptr;
+  cell->sequence.store(pos + kQueueCapacity, std::memory_order_release);
+  return true;
+}
+
+bool LockFreeThreadpool::TryDequeueAny(std::function<void()>* task) {
+  if (TryDequeue(task)) return true;
+  if (overflow_size_.load(std::memory_order_relaxed) == 0) return false;
+  absl::MutexLock m(&overflow_mutex_);
+  if (overflow_.empty()) return false;
+  *task = std::move(overflow_.front());
+  overflow_.pop_front();
+  overflow_size_.fetch_sub(1, std::memory_order_relaxed);
+  return true;
+}
+
+void LockFreeThreadpool::AddTask(std::function<void()> task) {
+  task = telemetry_.WrapTask(std::move(task));
+  // Once tasks overflow, later ones queue up behind them, until the workers
+  // have caught up:
+  if (overflow_size_.load(std::memory_order_relaxed) > 0 ||
+      !TryEnqueue(task)) {
+    absl::MutexLock m(&overflow_mutex_);
+    overflow_.push_back(std::move(task));
+    overflow_size_.fetch_add(1, std::memory_order_relaxed);
+    overflowed_tasks_.fetch_add(1, std::memory_order_relaxed);
+  }
+  // Pairs with the increment of parked_workers_ in TaskRunner: either we see
+  // the worker parking, or it sees our task when it checks the queue again.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (parked_workers_.load(std::memory_order_relaxed) > 0) {
+    WakeOneWorker();
+  }
+}
+
+void LockFreeThreadpool::WakeOneWorker() {
+  epoch_.fetch_add(1);
+  FutexWake(&epoch_, 1);
+  wakeups_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void LockFreeThreadpool::TaskRunner(int worker_index) {
+  WorkerStats& stats = worker_stats_[worker_index];
+  std::function<void()> task;
+  int spins = 0;
+  AdaptiveSpinner spinner(max_spin_ns_, &spin_stats_);
+  while (true) {
+    if (TryDequeueAny(&task)) {
+      task();
+      task = nullptr;
+      stats.tasks_processed.fetch_add(1, std::memory_order_relaxed);
+      spins = 0;
+      continue;
+    }
+    if (shutdown_.load()) break;
+    if (spinner.enabled()) {
+      if (spinner.SpinUntil([this]() {
+            return QueueMaybeNonEmpty() || shutdown_.load();
+          })) {
+        continue;
+      }
+    } else if (++spins < kSpinsBeforeParking) {
+      continue;
+    }
+    spins = 0;
+    parked_workers_.fetch_add(1);
+    uint32_t epoch = epoch_.load();
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (TryDequeueAny(&task)) {
+      parked_workers_.fetch_sub(1);
+      task();
+      task = nullptr;
+      stats.tasks_processed.fetch_add(1, std::memory_order_relaxed);
+      continue;
+    }
+    if (!shutdown_.load()) {
+      stats.parks.fetch_add(1, std::memory_order_relaxed);
+      // Returns immediately if epoch_ moved since we read it:
+      FutexWait(&epoch_, epoch);
+    }
+    parked_workers_.fetch_sub(1);
+  }
+}
+
+std::vector<ThreadpoolStat> LockFreeThreadpool::GetStats() {
+  int64_t tasks_processed = 0;
+  int64_t parks = 0;
+  for (int i = 0; i < nb_workers_; ++i) {
+    tasks_processed += worker_stats_[i].tasks_processed;
+    parks += worker_stats_[i].parks;
+  }
+  std::vector<ThreadpoolStat> ret;
+  ret.resize(5);
+  ret[0].name = "threads_launched";
+  ret[0].value = nb_workers_;
+  ret[1].name = "tasks_processed";
+  ret[1].value = tasks_processed;
+  ret[2].name = "overflowed_tasks";
+  ret[2].value = overflowed_tasks_;
+  ret[3].name = "parks";
+  ret[3].value = parks;
+  ret[4].name = "wakeups";
+  ret[4].value = wakeups_;
+  AppendSpinStats(spin_stats_, max_spin_ns_ > 0, &ret);
+  return ret;
+}
+
 #ifdef WITH_MERCURY
 class MercuryThreadpool : public AbstractThreadpool {
  public:
@@ -296,7 +855,7 @@ void MercuryThreadpool::AddTask(std::function<void()> task) {
   auto* heap_object = new HeapObject;
   heap_object->task_item.func = Trampoline;
   heap_object->task_item.args = heap_object;
-  heap_object->task = std::move(task);
+  heap_object->task = telemetry_.WrapTask(std::move(task));
   hg_thread_pool_post(thread_pool_.get(), &heap_object->task_item);
 }
 
@@ -315,16 +874,23 @@ std::vector<ThreadpoolStat> MercuryThreadpool::GetStats() { return {}; }
 }  // anonymous namespace
 
 absl::StatusOr<std::unique_ptr<AbstractThreadpool>> CreateThreadpool(
-    std::string_view threadpool_type, int size) {
+    std::string_view threadpool_type, int size,
+    const ThreadPlacement& placement, int64_t max_spin_ns) {
   if (size < 1) {
     return absl::InvalidArgumentError("Threadpool size must be positive");
   }
   if (threadpool_type == "simple") {
-    return std::make_unique<SimpleThreadpool>(size);
+    return std::make_unique<SimpleThreadpool>(size, placement, max_spin_ns);
   } else if (threadpool_type.empty() || threadpool_type == "elastic") {
-    return std::make_unique<ElasticThreadpool>(size);
+    return std::make_unique<ElasticThreadpool>(size, placement, max_spin_ns);
   } else if (threadpool_type == "null") {
-    return std::make_unique<NullThreadpool>(size);
+    return std::make_unique<NullThreadpool>(size, placement);
+  } else if (threadpool_type == "work_stealing") {
+    return std::make_unique<WorkStealingThreadpool>(size, placement,
+                                                    max_spin_ns);
+  } else if (threadpool_type == "lock_free") {
+    return std::make_unique<LockFreeThreadpool>(size, placement,
+                                                max_spin_ns);
 #ifdef WITH_MERCURY
   } else if (threadpool_type == "mercury") {
     return std::make_unique<MercuryThreadpool>(size);
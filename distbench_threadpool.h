@@ -15,29 +15,79 @@
 #ifndef DISTBENCH_DISTBENCH_THREADPOOL_H_
 #define DISTBENCH_DISTBENCH_THREADPOOL_H_
 
+#include <atomic>
 #include <functional>
 #include <memory>
 #include <string>
 #include <string_view>
 
 #include "absl/status/statusor.h"
+#include "distbench_latency_histogram.h"
+#include "distbench_thread_support.h"
 
 namespace distbench {
 
+class ThreadpoolLog;
+
 struct ThreadpoolStat {
   std::string name;
   int64_t value;
 };
 
+// Telemetry that every threadpool type records about its tasks.
+class ThreadpoolTelemetry {
+ public:
+  // Timing tasks costs an extra allocation and two clock reads per task, so
+  // until this is called only the blocked AddTask calls are recorded. It
+  // must be called before the first task is added.
+  void Enable() { enabled_ = true; }
+
+  // Returns a task that runs |task|, recording how long it stays queued,
+  // from now until it starts running, and how long it runs for. Returns
+  // |task| itself unless the telemetry is enabled.
+  std::function<void()> WrapTask(std::function<void()> task);
+
+  // Records an AddTask call that had to wait for room in the queue.
+  void RecordBlockedAddTask() {
+    blocked_add_task_calls_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void AddTo(ThreadpoolLog* log) const;
+
+ private:
+  bool enabled_ = false;
+  AtomicLatencyHistogram queueing_delay_;
+  AtomicLatencyHistogram run_time_;
+  std::atomic<int64_t> queue_depth_ = 0;
+  std::atomic<int64_t> max_queue_depth_ = 0;
+  std::atomic<int64_t> blocked_add_task_calls_ = 0;
+};
+
 class AbstractThreadpool {
  public:
   virtual ~AbstractThreadpool() = default;
   virtual void AddTask(std::function<void()> task) = 0;
   virtual std::vector<ThreadpoolStat> GetStats() = 0;
+
+  // See ThreadpoolTelemetry::Enable.
+  void EnableTelemetry() { telemetry_.Enable(); }
+
+  // Returns the telemetry of the pool, along with its stats.
+  ThreadpoolLog GetLog();
+
+ protected:
+  ThreadpoolTelemetry telemetry_;
 };
 
+// The threads of the pool are placed according to placement, except for
+// the mercury threadpool, whose threads are not under our control.
+// If max_spin_ns is positive, idle threads spin for up to that long, waiting
+// for a task, before parking (except in the null and mercury threadpools).
+// The cost of spinning is reported in the spin_ns, spin_hits and spin_misses
+// stats of the pool.
 absl::StatusOr<std::unique_ptr<AbstractThreadpool>> CreateThreadpool(
-    std::string_view threadpool_type, int size);
+    std::string_view threadpool_type, int size,
+    const ThreadPlacement& placement = {}, int64_t max_spin_ns = 0);
 
 }  // namespace distbench
 
@@ -55,10 +55,18 @@ void BM_Elastic(benchmark::State& state) { threadpool_test("elastic", state); }
 void BM_Simple(benchmark::State& state) { threadpool_test("simple", state); }
 void BM_Mercury(benchmark::State& state) { threadpool_test("mercury", state); }
 void BM_Null(benchmark::State& state) { threadpool_test("null", state); }
+void BM_WorkStealing(benchmark::State& state) {
+  threadpool_test("work_stealing", state);
+}
+void BM_LockFree(benchmark::State& state) {
+  threadpool_test("lock_free", state);
+}
 
 BENCHMARK(BM_Null)->Range(1, 16384);
 BENCHMARK(BM_Elastic)->Range(1, 16384);
 BENCHMARK(BM_Simple)->Range(1, 16384);
+BENCHMARK(BM_WorkStealing)->Range(1, 16384);
+BENCHMARK(BM_LockFree)->Range(1, 16384);
 #ifdef WITH_MERCURY
 BENCHMARK(BM_Mercury)->Range(1, 16384);
 #endif
@@ -18,6 +18,9 @@
 
 #include "absl/base/internal/sysinfo.h"
 #include "absl/synchronization/notification.h"
+#include "absl/time/clock.h"
+#include "distbench.pb.h"
+#include "distbench_latency_histogram.h"
 #include "distbench_thread_support.h"
 #include "glog/logging.h"
 #include "gtest/gtest.h"
@@ -25,6 +28,7 @@
 
 namespace {
 
+using distbench::AbstractThreadpool;
 using distbench::CreateThreadpool;
 
 class OverloadTest : public testing::TestWithParam<std::string> {};
@@ -78,6 +82,41 @@ TEST_P(ThreadpoolTest, PerformSimpleWork) {
   ASSERT_EQ(work_counter, iterations);
 };
 
+TEST_P(ThreadpoolTest, Telemetry) {
+  const int iterations = 1000;
+  auto atp = CreateThreadpool(GetParam(), 4);
+  ASSERT_TRUE(atp.ok());
+  atp.value()->EnableTelemetry();
+  absl::Notification done;
+  std::atomic<int> work_counter = 0;
+  for (int i = 0; i < iterations; i++) {
+    atp.value()->AddTask([&]() {
+      if (++work_counter == iterations) done.Notify();
+    });
+  }
+  done.WaitForNotification();
+  distbench::ThreadpoolLog log = atp.value()->GetLog();
+  // The queueing delay is recorded before each task starts running:
+  ASSERT_EQ(distbench::LatencyHistogramCount(log.queueing_delay()),
+            iterations);
+  // Each worker may still be finishing its last task:
+  ASSERT_LE(distbench::LatencyHistogramCount(log.run_time()), iterations);
+  ASSERT_GE(log.max_queue_depth(), 1);
+  ASSERT_LE(log.max_queue_depth(), iterations);
+}
+
+TEST_P(ThreadpoolTest, TelemetryIsOptIn) {
+  auto atp = CreateThreadpool(GetParam(), 4);
+  ASSERT_TRUE(atp.ok());
+  absl::Notification done;
+  atp.value()->AddTask([&]() { done.Notify(); });
+  done.WaitForNotification();
+  distbench::ThreadpoolLog log = atp.value()->GetLog();
+  ASSERT_FALSE(log.has_queueing_delay());
+  ASSERT_FALSE(log.has_run_time());
+  ASSERT_FALSE(log.has_max_queue_depth());
+}
+
 TEST_P(ThreadpoolTest, ParallelAddTest) {
   const int iterations = 1000;
   std::atomic<int> work_counter = 0;
@@ -97,8 +136,114 @@ TEST_P(ThreadpoolTest, ParallelAddTest) {
   ASSERT_EQ(work_counter, iterations);
 }
 
+TEST(ThreadpoolTest, WorkStealingNestedTasks) {
+  const int iterations = 100;
+  const int nested_iterations = 100;
+  std::atomic<int> work_counter = 0;
+  auto atp = CreateThreadpool("work_stealing", 4);
+  ASSERT_TRUE(atp.ok());
+  AbstractThreadpool* pool = atp.value().get();
+  for (int i = 0; i < iterations; i++) {
+    pool->AddTask([&]() {
+      // These go to the deque of the current worker, for others to steal:
+      for (int j = 0; j < nested_iterations; j++) {
+        pool->AddTask([&]() { ++work_counter; });
+      }
+    });
+  }
+  atp.value().reset();  // Complete the work of atp.
+  ASSERT_EQ(work_counter, iterations * nested_iterations);
+}
+
+TEST(ThreadpoolTest, WorkStealingStats) {
+  const int iterations = 1000;
+  auto atp = CreateThreadpool("work_stealing", 4);
+  ASSERT_TRUE(atp.ok());
+  absl::Notification done;
+  std::atomic<int> work_counter = 0;
+  for (int i = 0; i < iterations; i++) {
+    atp.value()->AddTask([&]() {
+      if (++work_counter == iterations) done.Notify();
+    });
+  }
+  done.WaitForNotification();
+  int64_t tasks_processed = 0;
+  for (const auto& stat : atp.value()->GetStats()) {
+    if (stat.name == "threads_launched") {
+      ASSERT_EQ(stat.value, 4);
+    }
+    if (stat.name == "tasks_processed") tasks_processed = stat.value;
+  }
+  // Each worker may still be finishing its last task:
+  ASSERT_GE(tasks_processed, iterations - 4);
+  ASSERT_LE(tasks_processed, iterations);
+}
+
+TEST(ThreadpoolTest, LockFreeQueueFull) {
+  const int iterations = 10000;
+  std::atomic<int> work_counter = 0;
+  absl::Notification unblock;
+  auto atp = CreateThreadpool("lock_free", 4);
+  ASSERT_TRUE(atp.ok());
+  for (int i = 0; i < 4; i++) {
+    atp.value()->AddTask([&]() { unblock.WaitForNotification(); });
+  }
+  // With every worker blocked the queue fills up, and the tasks that do not
+  // fit wait in the overflow queue, rather than running on this thread:
+  for (int i = 0; i < iterations; i++) {
+    atp.value()->AddTask([&]() { ++work_counter; });
+  }
+  ASSERT_EQ(work_counter, 0);
+  int64_t overflowed_tasks = 0;
+  for (const auto& stat : atp.value()->GetStats()) {
+    if (stat.name == "overflowed_tasks") overflowed_tasks = stat.value;
+  }
+  ASSERT_GT(overflowed_tasks, 0);
+  ASSERT_EQ(atp.value()->GetLog().blocked_add_task_calls(), 0);
+  unblock.Notify();
+  atp.value().reset();  // Complete the work of atp.
+  ASSERT_EQ(work_counter, iterations);
+}
+
+class SpinningThreadpoolTest : public testing::TestWithParam<std::string> {};
+
+TEST_P(SpinningThreadpoolTest, SpinThenPark) {
+  const int iterations = 100;
+  std::atomic<int> work_counter = 0;
+  auto atp = CreateThreadpool(GetParam(), 4, {}, /*max_spin_ns=*/1'000'000);
+  ASSERT_TRUE(atp.ok());
+  for (int i = 0; i < iterations; i++) {
+    absl::Notification done;
+    atp.value()->AddTask([&]() {
+      ++work_counter;
+      done.Notify();
+    });
+    done.WaitForNotification();
+    // Long enough for some of the idle threads to give up spinning:
+    if (i % 10 == 0) absl::SleepFor(absl::Milliseconds(5));
+  }
+  int64_t spins = 0;
+  bool have_spin_ns = false;
+  for (const auto& stat : atp.value()->GetStats()) {
+    if (stat.name == "spin_hits" || stat.name == "spin_misses") {
+      spins += stat.value;
+    } else if (stat.name == "spin_ns") {
+      have_spin_ns = true;
+    }
+  }
+  ASSERT_TRUE(have_spin_ns);
+  ASSERT_GT(spins, 0);
+  atp.value().reset();  // Complete the work of atp.
+  ASSERT_EQ(work_counter, iterations);
+}
+
+INSTANTIATE_TEST_SUITE_P(SpinningThreadpoolTests, SpinningThreadpoolTest,
+                         testing::Values("simple", "elastic", "work_stealing",
+                                         "lock_free"));
+
 INSTANTIATE_TEST_SUITE_P(ThreadpoolTests, ThreadpoolTest,
-                         testing::Values("", "null", "simple", "elastic"
+                         testing::Values("", "null", "simple", "elastic",
+                                         "work_stealing", "lock_free"
 #ifdef WITH_MERCURY
                                          ,
                                          "mercury"
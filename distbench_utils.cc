@@ -19,14 +19,18 @@
 
 #include <cerrno>
 #include <fstream>
+#include <limits>
 #include <streambuf>
 
+#include "absl/strings/escaping.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/str_split.h"
 #include "glog/logging.h"
+#include "google/protobuf/io/coded_stream.h"
 #include "google/protobuf/io/zero_copy_stream_impl.h"
 #include "google/protobuf/text_format.h"
+#include "google/protobuf/wire_format_lite.h"
 #include "interface_lookup.h"
 
 namespace std {
@@ -345,6 +349,13 @@ int64_t GetNamedClientSettingInt64(const distbench::ProtocolDriverOptions& opts,
   return GetNamedSettingInt64(opts.client_settings(), name, default_value);
 }
 
+absl::StatusOr<ThreadPlacement> GetThreadPlacementFromServerSettings(
+    const distbench::ProtocolDriverOptions& opts) {
+  return ParseThreadPlacement(
+      GetNamedServerSettingString(opts, "cpu_list", ""),
+      GetNamedServerSettingInt64(opts, "numa_node", -1));
+}
+
 absl::StatusOr<int64_t> GetNamedAttributeInt64(
     const distbench::DistributedSystemDescription& test, absl::string_view name,
     int64_t default_value) {
@@ -412,7 +423,29 @@ absl::Status SaveResultProtoToFile(
 }
 
 absl::Status SaveResultProtoToFileBinary(
-    const std::string& filename, const distbench::TestSequenceResults& result) {
+    const std::string& filename, const distbench::TestSequenceResults& result,
+    bool compress) {
+  if (compress) {
+    int fd_proto = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd_proto < 0) {
+      return absl::InvalidArgumentError(absl::StrCat(
+          "Error opening the output result proto file for writing: ",
+          filename));
+    }
+    ::google::protobuf::io::FileOutputStream file_stream(fd_proto);
+    bool written;
+    {
+      ::google::protobuf::io::GzipOutputStream gzip_stream(&file_stream);
+      written = result.SerializeToZeroCopyStream(&gzip_stream) &&
+                gzip_stream.Close();
+    }
+    if (!file_stream.Close() || !written) {
+      return absl::InvalidArgumentError(
+          "Error writing the compressed result proto file");
+    }
+    return absl::OkStatus();
+  }
+
   std::fstream output(filename,
                       std::ios::out | std::ios::trunc | std::ios::binary);
   if (!result.SerializeToOstream(&output)) {
@@ -423,6 +456,213 @@ absl::Status SaveResultProtoToFileBinary(
   return absl::OkStatus();
 }
 
+std::vector<ServicePerformanceLog> SplitServicePerformanceLog(
+    ServicePerformanceLog log, int64_t max_bytes) {
+  std::vector<ServicePerformanceLog> pieces;
+  if (static_cast<int64_t>(log.ByteSizeLong()) <= max_bytes) {
+    pieces.push_back(std::move(log));
+    return pieces;
+  }
+  auto peer_logs = std::move(*log.mutable_peer_logs());
+  log.clear_peer_logs();
+  pieces.push_back(std::move(log));
+  int64_t piece_bytes = pieces.back().ByteSizeLong();
+  for (auto& [peer_name, peer_log] : peer_logs) {
+    const int64_t peer_log_bytes = peer_log.ByteSizeLong();
+    if (piece_bytes > 0 && piece_bytes + peer_log_bytes > max_bytes) {
+      pieces.emplace_back();
+      piece_bytes = 0;
+    }
+    piece_bytes += peer_log_bytes;
+    (*pieces.back().mutable_peer_logs())[peer_name] = std::move(peer_log);
+  }
+  return pieces;
+}
+
+void MergeServicePerformanceLogPiece(ServicePerformanceLog* piece,
+                                     ServicePerformanceLog* log) {
+  for (auto& [peer_name, peer_log] : *piece->mutable_peer_logs()) {
+    (*log->mutable_peer_logs())[peer_name] = std::move(peer_log);
+  }
+  piece->clear_peer_logs();
+  log->MergeFrom(*piece);
+}
+
+void MergeTestResultChunk(TestResultChunk* chunk, TestResult* result) {
+  auto& instance_logs =
+      *result->mutable_service_logs()->mutable_instance_logs();
+  auto& chunk_logs = *chunk->mutable_test_result()
+                          ->mutable_service_logs()
+                          ->mutable_instance_logs();
+  for (auto& [instance_name, log] : chunk_logs) {
+    auto it = instance_logs.find(instance_name);
+    if (it == instance_logs.end()) {
+      instance_logs[instance_name] = std::move(log);
+    } else {
+      MergeServicePerformanceLogPiece(&log, &it->second);
+    }
+  }
+  chunk_logs.clear();
+  result->MergeFrom(chunk->test_result());
+}
+
+namespace {
+
+// Appends to test_bytes a serialized TestResult that holds nothing but the
+// instance log named instance_name, whose serialization is log_bytes:
+void AppendInstanceLog(const std::string& instance_name,
+                       const std::string& log_bytes, std::string* test_bytes) {
+  using ::google::protobuf::internal::WireFormatLite;
+  using ::google::protobuf::io::CodedOutputStream;
+  auto tag = [](int field_number) {
+    return WireFormatLite::MakeTag(field_number,
+                                   WireFormatLite::WIRETYPE_LENGTH_DELIMITED);
+  };
+  auto field_size = [&tag](int field_number, size_t size) {
+    return CodedOutputStream::VarintSize32(tag(field_number)) +
+           CodedOutputStream::VarintSize32(size) + size;
+  };
+  // Map entries hold their key as field 1, and their value as field 2:
+  const size_t entry_size =
+      field_size(1, instance_name.size()) + field_size(2, log_bytes.size());
+  const size_t service_logs_size =
+      field_size(ServiceLogs::kInstanceLogsFieldNumber, entry_size);
+  ::google::protobuf::io::StringOutputStream stream(test_bytes);
+  CodedOutputStream output(&stream);
+  auto write_header = [&](int field_number, size_t size) {
+    output.WriteTag(tag(field_number));
+    output.WriteVarint32(size);
+  };
+  write_header(TestResult::kServiceLogsFieldNumber, service_logs_size);
+  write_header(ServiceLogs::kInstanceLogsFieldNumber, entry_size);
+  write_header(1, instance_name.size());
+  output.WriteString(instance_name);
+  write_header(2, log_bytes.size());
+  output.WriteString(log_bytes);
+}
+
+}  // anonymous namespace
+
+absl::StatusOr<std::unique_ptr<TestSequenceResultsWriter>>
+TestSequenceResultsWriter::Open(const std::string& filename, bool binary,
+                                bool compress) {
+  int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "Error opening the output result proto file for writing: ", filename));
+  }
+  return std::unique_ptr<TestSequenceResultsWriter>(
+      new TestSequenceResultsWriter(fd, binary, compress));
+}
+
+TestSequenceResultsWriter::TestSequenceResultsWriter(int fd, bool binary,
+                                                     bool compress)
+    : file_stream_(
+          std::make_unique<::google::protobuf::io::FileOutputStream>(fd)),
+      binary_(binary) {
+  file_stream_->SetCloseOnDelete(true);
+  output_ = file_stream_.get();
+  if (compress) {
+    gzip_stream_ = std::make_unique<::google::protobuf::io::GzipOutputStream>(
+        file_stream_.get());
+    output_ = gzip_stream_.get();
+  }
+}
+
+void TestSequenceResultsWriter::CloseInstanceLog(
+    ::google::protobuf::io::CodedOutputStream* output) {
+  if (!instance_log_open_) return;
+  instance_log_open_ = false;
+  if (binary_) {
+    AppendInstanceLog(open_instance_name_, pending_instance_bytes_,
+                      &pending_test_bytes_);
+    pending_instance_bytes_.clear();
+    pending_instance_bytes_.shrink_to_fit();
+  } else {
+    output->WriteString("      }\n    }\n");
+  }
+}
+
+absl::Status TestSequenceResultsWriter::Write(const TestResultChunk& chunk) {
+  ::google::protobuf::io::CodedOutputStream output(output_);
+  ::google::protobuf::TextFormat::Printer printer;
+  std::string text;
+  if (!binary_ && !test_open_) {
+    output.WriteString("test_results {\n  service_logs {\n");
+    test_open_ = true;
+  }
+  // The pieces of an instance log are added to it for as long as they keep
+  // coming, since repeating its map entry would replace the earlier pieces:
+  for (const auto& [instance_name, log] :
+       chunk.test_result().service_logs().instance_logs()) {
+    if (!instance_log_open_ || instance_name != open_instance_name_) {
+      CloseInstanceLog(&output);
+      instance_log_open_ = true;
+      open_instance_name_ = instance_name;
+      if (!binary_) {
+        output.WriteString(absl::StrCat("    instance_logs {\n      key: \"",
+                                        absl::CEscape(instance_name),
+                                        "\"\n      value {\n"));
+      }
+    }
+    if (binary_) {
+      if (!log.AppendToString(&pending_instance_bytes_)) {
+        return absl::InvalidArgumentError("Error serializing the test result");
+      }
+    } else {
+      printer.SetInitialIndentLevel(4);
+      printer.PrintToString(log, &text);
+      output.WriteString(text);
+    }
+  }
+  if (binary_) {
+    if (!chunk.last_chunk_of_test()) return absl::OkStatus();
+    CloseInstanceLog(&output);
+    // Concatenated serializations of partial TestResults parse as their
+    // merge, so the chunks only need to be framed as one test_results entry.
+    // Like the text files, this always holds a service_logs:
+    TestResult rest = chunk.test_result();
+    rest.mutable_service_logs()->clear_instance_logs();
+    if (!rest.AppendToString(&pending_test_bytes_)) {
+      return absl::InvalidArgumentError("Error serializing the test result");
+    }
+    if (pending_test_bytes_.size() > std::numeric_limits<int>::max()) {
+      return absl::ResourceExhaustedError(
+          "Test result exceeds the protobuf size limit");
+    }
+    output.WriteTag(::google::protobuf::internal::WireFormatLite::MakeTag(
+        TestSequenceResults::kTestResultsFieldNumber,
+        ::google::protobuf::internal::WireFormatLite::
+            WIRETYPE_LENGTH_DELIMITED));
+    output.WriteVarint32(pending_test_bytes_.size());
+    output.WriteString(pending_test_bytes_);
+    pending_test_bytes_.clear();
+    pending_test_bytes_.shrink_to_fit();
+  } else if (chunk.last_chunk_of_test()) {
+    // Instance logs are printed inside a single service_logs block that is
+    // left open until the last chunk of the test:
+    CloseInstanceLog(&output);
+    output.WriteString("  }\n");
+    TestResult rest = chunk.test_result();
+    rest.clear_service_logs();
+    printer.SetInitialIndentLevel(1);
+    printer.PrintToString(rest, &text);
+    output.WriteString(text);
+    output.WriteString("}\n");
+    test_open_ = false;
+  }
+  // Text output is flushed after every chunk, so that the file keeps up with
+  // the test, and nothing is lost if run_tests dies halfway:
+  output.Trim();
+  bool flushed = !output.HadError();
+  if (gzip_stream_) flushed = flushed && gzip_stream_->Flush();
+  flushed = flushed && file_stream_->Flush();
+  if (!flushed) {
+    return absl::InvalidArgumentError("Error writing the result proto file");
+  }
+  return absl::OkStatus();
+}
+
 void AddServerInt64OptionTo(ProtocolDriverOptions& pdo, std::string option_name,
                             int64_t value) {
   auto* ns = pdo.add_server_settings();
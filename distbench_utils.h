@@ -22,6 +22,9 @@
 #include "absl/status/statusor.h"
 #include "absl/synchronization/notification.h"
 #include "distbench.pb.h"
+#include "distbench_thread_support.h"
+#include "google/protobuf/io/gzip_stream.h"
+#include "google/protobuf/io/zero_copy_stream_impl.h"
 #include "google/protobuf/stubs/status_macros.h"
 #include "grpc_wrapper.h"
 #include "traffic_config.pb.h"
@@ -122,6 +125,11 @@ int64_t GetNamedClientSettingInt64(const distbench::ProtocolDriverOptions& opts,
                                    absl::string_view name,
                                    int64_t default_value);
 
+// Returns the placement requested by the "cpu_list" and "numa_node" server
+// settings of opts, for the threads of a protocol driver.
+absl::StatusOr<ThreadPlacement> GetThreadPlacementFromServerSettings(
+    const distbench::ProtocolDriverOptions& opts);
+
 absl::StatusOr<int64_t> GetNamedAttributeInt64(
     const distbench::DistributedSystemDescription& test, absl::string_view name,
     int64_t default_value);
@@ -135,8 +143,61 @@ absl::StatusOr<TestSequence> ParseTestSequenceProtoFromFile(
 // Write TestSequenceResults protos.
 absl::Status SaveResultProtoToFile(
     const std::string& filename, const distbench::TestSequenceResults& result);
+// With compress set, the file is gzip compressed, and can be decompressed
+// by zcat or read through a google::protobuf::io::GzipInputStream.
 absl::Status SaveResultProtoToFileBinary(
-    const std::string& filename, const distbench::TestSequenceResults& result);
+    const std::string& filename, const distbench::TestSequenceResults& result,
+    bool compress = false);
+
+// Splits an instance log into pieces of about max_bytes serialized bytes each,
+// so that every piece fits in a result chunk. Only the peer logs are spread
+// across the pieces, and a single peer log is never split; the first piece
+// holds all the other fields. As map entries replace each other when merged,
+// the pieces must be put back together with MergeServicePerformanceLogPiece.
+std::vector<ServicePerformanceLog> SplitServicePerformanceLog(
+    ServicePerformanceLog log, int64_t max_bytes);
+
+// Moves the contents of a piece made by SplitServicePerformanceLog into log.
+void MergeServicePerformanceLogPiece(ServicePerformanceLog* piece,
+                                     ServicePerformanceLog* log);
+
+// Moves the contents of chunk into result, putting back together the instance
+// logs that were split across several chunks.
+void MergeTestResultChunk(TestResultChunk* chunk, TestResult* result);
+
+// Writes the TestSequenceResults streamed by RunTestSequenceStream to a file,
+// one TestResultChunk at a time, producing the same file format as the
+// SaveResultProtoToFile* functions. In text mode every chunk is written (and
+// flushed) as it arrives; in binary mode the serialized chunks of a test are
+// held until its last chunk, since the length of each TestResult precedes its
+// contents. The pieces of an instance log that was split across chunks must
+// arrive in consecutive chunks.
+class TestSequenceResultsWriter {
+ public:
+  static absl::StatusOr<std::unique_ptr<TestSequenceResultsWriter>> Open(
+      const std::string& filename, bool binary, bool compress = false);
+
+  absl::Status Write(const TestResultChunk& chunk);
+
+ private:
+  TestSequenceResultsWriter(int fd, bool binary, bool compress);
+
+  // Ends the instance log that the previous chunks were adding to, if any:
+  void CloseInstanceLog(google::protobuf::io::CodedOutputStream* output);
+
+  // Declared before gzip_stream_, which must be closed first:
+  std::unique_ptr<google::protobuf::io::FileOutputStream> file_stream_;
+  std::unique_ptr<google::protobuf::io::GzipOutputStream> gzip_stream_;
+  google::protobuf::io::ZeroCopyOutputStream* output_;
+  bool binary_;
+  bool test_open_ = false;
+  std::string pending_test_bytes_;
+  // The instance log that the previous chunks were adding to, and in binary
+  // mode its serialized contents so far:
+  bool instance_log_open_ = false;
+  std::string open_instance_name_;
+  std::string pending_instance_bytes_;
+};
 
 void AddServerInt64OptionTo(ProtocolDriverOptions& pdo, std::string option_name,
                             int64_t value);
@@ -54,6 +54,18 @@ void ServerRpcState::FreeStateIfSet() {
   }
 }
 
+namespace {
+google::protobuf::ArenaOptions InitialBlockOptions(char* block, size_t size) {
+  google::protobuf::ArenaOptions options;
+  options.initial_block = block;
+  options.initial_block_size = size;
+  return options;
+}
+}  // anonymous namespace
+
+RpcArena::RpcArena()
+    : arena_(InitialBlockOptions(initial_block_, kInitialBlockSize)) {}
+
 class RealClock : public SimpleClock {
  public:
   ~RealClock() override {}
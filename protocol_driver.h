@@ -21,6 +21,7 @@
 #include "absl/status/statusor.h"
 #include "absl/synchronization/notification.h"
 #include "distbench.pb.h"
+#include "google/protobuf/arena.h"
 #include "grpc_wrapper.h"
 #include "simple_clock.h"
 
@@ -31,6 +32,11 @@ struct ClientRpcState {
   GenericResponse response;
   absl::Time prior_start_time = absl::InfinitePast();
   absl::Time start_time = absl::InfinitePast();
+  // When the RPC should have been sent, which is before start_time if the
+  // sender fell behind its open loop schedule:
+  absl::Time intended_start_time = absl::InfinitePast();
+  // The open loop interval the RPC was scheduled for, if any:
+  absl::Duration intended_interval = absl::ZeroDuration();
   absl::Time end_time;
   bool success;
 };
@@ -52,11 +58,36 @@ struct ServerRpcState {
   std::function<void(void)> free_state_function_;
 };
 
+// A protobuf arena for the messages of a single RPC. The first block of the
+// arena is embedded in this object, so that a request, its trace context and
+// the ServerRpcState that refers to it can be created without any further
+// allocations (only payload bytes live outside of the arena), and are all
+// freed together when the RpcArena is destroyed or Reset.
+class RpcArena {
+ public:
+  RpcArena();
+  RpcArena(const RpcArena&) = delete;
+  RpcArena& operator=(const RpcArena&) = delete;
+
+  google::protobuf::Arena* arena() { return &arena_; }
+  void Reset() { arena_.Reset(); }
+
+ private:
+  static constexpr size_t kInitialBlockSize = 1024;
+  alignas(alignof(std::max_align_t)) char initial_block_[kInitialBlockSize];
+  google::protobuf::Arena arena_;
+};
+
 struct TransportStat {
   std::string name;
   int64_t value;
 };
 
+struct NamedThreadpoolLog {
+  std::string name;
+  ThreadpoolLog log;
+};
+
 using RpcId = int64_t;
 
 class ProtocolDriverClient {
@@ -113,6 +144,10 @@ class ProtocolDriverServer {
 
   // Misc interface ===========================================================
   virtual std::vector<TransportStat> GetTransportStats() = 0;
+
+  // Returns the telemetry of the threadpools that run the handlers of the
+  // server, if any:
+  virtual std::vector<NamedThreadpoolLog> GetThreadpoolLogs() { return {}; }
 };
 
 class ProtocolDriver : public ProtocolDriverClient,
@@ -18,6 +18,7 @@
 #include "glog/logging.h"
 #include "protocol_driver_double_barrel.h"
 #include "protocol_driver_grpc.h"
+#include "protocol_driver_sharded_transport.h"
 #ifdef WITH_HOMA
 #include "protocol_driver_homa.h"
 #endif
@@ -51,6 +52,8 @@ absl::StatusOr<std::unique_ptr<ProtocolDriver>> AllocateProtocolDriver(
     pd = std::make_unique<ProtocolDriverGrpc>();
   } else if (opts.protocol_name() == "double_barrel") {
     pd = std::make_unique<ProtocolDriverDoubleBarrel>(tree_depth);
+  } else if (opts.protocol_name() == "sharded_transport") {
+    pd = std::make_unique<ProtocolDriverShardedTransport>(tree_depth);
   } else if (opts.protocol_name() == "composable_rpc_counter") {
     pd = std::make_unique<ComposableRpcCounter>(tree_depth);
 #ifdef WITH_HOMA
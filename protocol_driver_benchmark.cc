@@ -12,12 +12,30 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
 #include "benchmark/benchmark.h"
 #include "distbench_utils.h"
 #include "glog/logging.h"
 #include "google/protobuf/text_format.h"
 #include "protocol_driver_allocator.h"
 
+namespace {
+// Counts heap allocations, so that each benchmark can report how many
+// allocations (client and server side combined) an RPC costs. The default
+// operator delete releases memory with free(), so it needs no replacement:
+std::atomic<int64_t> heap_allocation_count = 0;
+}  // anonymous namespace
+
+void* operator new(size_t size) {
+  heap_allocation_count.fetch_add(1, std::memory_order_relaxed);
+  void* ptr = malloc(size);
+  if (ptr == nullptr) throw std::bad_alloc();
+  return ptr;
+}
+
 namespace distbench {
 
 ProtocolDriverOptions PdoFromString(const std::string& s) {
@@ -68,13 +86,19 @@ void Echo(benchmark::State& state, std::string opts_string) {
   if (!pd1->HandleConnect(addr2, 0).ok()) LOG(FATAL) << "HandleConnect failed";
   if (!pd2->HandleConnect(addr1, 0).ok()) LOG(FATAL) << "HandleConnect failed";
 
+  const int kRpcsPerIteration = 64;
   std::atomic<int> client_rpc_count = 0;
-  ClientRpcState rpc_state;
-  rpc_state.request.set_payload("ping!");
+  // Each concurrent RPC needs its own state, since the protocol drivers write
+  // the response into it:
+  ClientRpcState rpc_state[kRpcsPerIteration];
+  for (int i = 0; i < kRpcsPerIteration; ++i) {
+    rpc_state[i].request.set_payload("ping!");
+  }
+  const int64_t initial_allocation_count = heap_allocation_count;
   for (auto s : state) {
-    client_rpc_count = 64;
-    for (int i = 0; i < 64; ++i) {
-      pd1->InitiateRpc(0, &rpc_state, [&]() {
+    client_rpc_count = kRpcsPerIteration;
+    for (int i = 0; i < kRpcsPerIteration; ++i) {
+      pd1->InitiateRpc(0, &rpc_state[i], [&]() {
         // EXPECT_EQ(rpc_state.request.payload(), rpc_state.response.payload());
         // EXPECT_EQ(rpc_state.response.payload(), "ping!");
         client_rpc_count--;
@@ -83,6 +107,9 @@ void Echo(benchmark::State& state, std::string opts_string) {
     while (client_rpc_count)
       ;
   }
+  state.counters["allocations_per_rpc"] =
+      static_cast<double>(heap_allocation_count - initial_allocation_count) /
+      (state.iterations() * kRpcsPerIteration);
   pd1->ShutdownClient();
 }
 
@@ -108,6 +108,19 @@ std::vector<TransportStat> ProtocolDriverDoubleBarrel::GetTransportStats() {
   return transport_stats;
 }
 
+std::vector<NamedThreadpoolLog>
+ProtocolDriverDoubleBarrel::GetThreadpoolLogs() {
+  std::vector<NamedThreadpoolLog> logs = instance_1_->GetThreadpoolLogs();
+  for (auto& log : logs) {
+    log.name.insert(0, "instance_1/");
+  }
+  for (auto& log : instance_2_->GetThreadpoolLogs()) {
+    log.name.insert(0, "instance_2/");
+    logs.push_back(std::move(log));
+  }
+  return logs;
+}
+
 void ProtocolDriverDoubleBarrel::InitiateRpc(
     int peer_index, ClientRpcState* state,
     std::function<void(void)> done_callback) {
@@ -17,6 +17,8 @@
 #include <memory>
 
 #include "absl/base/internal/sysinfo.h"
+#include "absl/synchronization/mutex.h"
+#include "distbench_object_pool.h"
 #include "distbench_thread_support.h"
 #include "glog/logging.h"
 
@@ -31,6 +33,31 @@ namespace {
 
 const char* kDefaultTransport = "tcp";
 
+// Like cq->Next, but first polls cq without blocking, within the budget of
+// spinner, so that completions arriving shortly do not wait for the poller
+// to wake up.
+bool SpinThenNext(grpc::CompletionQueue* cq, AdaptiveSpinner* spinner,
+                  void** tag, bool* ok) {
+  if (spinner->enabled()) {
+    grpc::CompletionQueue::NextStatus status = grpc::CompletionQueue::TIMEOUT;
+    spinner->SpinUntil([&]() {
+      status = cq->AsyncNext(tag, ok, gpr_time_0(GPR_CLOCK_MONOTONIC));
+      return status != grpc::CompletionQueue::TIMEOUT;
+    });
+    if (status == grpc::CompletionQueue::GOT_EVENT) return true;
+    if (status == grpc::CompletionQueue::SHUTDOWN) return false;
+  }
+  return cq->Next(tag, ok);
+}
+
+std::vector<TransportStat> PollerSpinStats(int64_t poller_spin_ns,
+                                           const SpinStats& stats) {
+  if (poller_spin_ns <= 0) return {};
+  return {{"poller_spin_ns", stats.spin_ns.load()},
+          {"poller_spin_hits", stats.spin_hits.load()},
+          {"poller_spin_misses", stats.spin_misses.load()}};
+}
+
 absl::StatusOr<std::shared_ptr<grpc::Channel>> CreateClientChannel(
     const std::string& socket_address, std::string_view transport) {
   if (transport == "homa") {
@@ -79,7 +106,18 @@ GrpcPollingClientDriver::~GrpcPollingClientDriver() { ShutdownClient(); }
 
 absl::Status GrpcPollingClientDriver::Initialize(
     const ProtocolDriverOptions& pd_opts) {
-  cq_poller_ = std::thread(&GrpcPollingClientDriver::RpcCompletionThread, this);
+  auto maybe_placement = GetThreadPlacementFromServerSettings(pd_opts);
+  if (!maybe_placement.ok()) return maybe_placement.status();
+  poller_spin_ns_ = GetNamedClientSettingInt64(pd_opts, "poller_spin_ns", 0);
+  // Not a registered thread, so that it does not count towards the overload
+  // threshold:
+  cq_poller_ = std::thread([this, placement = maybe_placement.value()]() {
+    if (!placement.empty()) {
+      absl::Status status = ApplyThreadPlacement(placement);
+      if (!status.ok()) LOG(ERROR) << "Could not place cq_poller: " << status;
+    }
+    RpcCompletionThread();
+  });
   transport_ =
       GetNamedServerSettingString(pd_opts, "transport", kDefaultTransport);
   return absl::OkStatus();
@@ -104,19 +142,25 @@ absl::Status GrpcPollingClientDriver::HandleConnect(
 }
 
 std::vector<TransportStat> GrpcPollingClientDriver::GetTransportStats() {
-  return {};
+  return PollerSpinStats(poller_spin_ns_, poller_spin_stats_);
 }
 
 namespace {
+// The request and response are read from / written to the ClientRpcState
+// directly, which outlives the RPC, so that their payloads are not moved or
+// copied on the way in and out of the driver.
 struct PendingRpc {
   grpc::ClientContext context;
   std::unique_ptr<grpc::ClientAsyncResponseReader<GenericResponse>> rpc;
   grpc::Status status;
-  GenericRequest request;
-  GenericResponse response;
   std::function<void(void)> done_callback;
   ClientRpcState* state;
 };
+
+ObjectPool<PendingRpc>* PendingRpcPool() {
+  static auto* pool = new ObjectPool<PendingRpc>("grpc_pending_rpc");
+  return pool;
+}
 }  // anonymous namespace
 
 void GrpcPollingClientDriver::InitiateRpc(
@@ -126,29 +170,26 @@ void GrpcPollingClientDriver::InitiateRpc(
   CHECK_LT(static_cast<size_t>(peer_index), grpc_client_stubs_.size());
 
   ++pending_rpcs_;
-  PendingRpc* new_rpc = new PendingRpc;
+  PendingRpc* new_rpc = PendingRpcPool()->New();
   new_rpc->done_callback = done_callback;
   new_rpc->state = state;
-  new_rpc->request = std::move(state->request);
   new_rpc->rpc = grpc_client_stubs_[peer_index]->AsyncGenericRpc(
-      &new_rpc->context, new_rpc->request, &cq_);
-  new_rpc->rpc->Finish(&new_rpc->response, &new_rpc->status, new_rpc);
+      &new_rpc->context, state->request, &cq_);
+  new_rpc->rpc->Finish(&state->response, &new_rpc->status, new_rpc);
 }
 
 void GrpcPollingClientDriver::RpcCompletionThread() {
+  AdaptiveSpinner spinner(poller_spin_ns_, &poller_spin_stats_);
   while (!shutdown_.HasBeenNotified()) {
     bool ok;
     void* tag;
     tag = nullptr;
     ok = false;
-    cq_.Next(&tag, &ok);
+    SpinThenNext(&cq_, &spinner, &tag, &ok);
     if (ok) {
       PendingRpc* finished_rpc = static_cast<PendingRpc*>(tag);
       finished_rpc->state->success = finished_rpc->status.ok();
-      if (finished_rpc->state->success) {
-        finished_rpc->state->request = std::move(finished_rpc->request);
-        finished_rpc->state->response = std::move(finished_rpc->response);
-      } else {
+      if (!finished_rpc->state->success) {
         finished_rpc->state->response.set_error_message(
             finished_rpc->status.error_message());
         LOG_EVERY_N(ERROR, 1000)
@@ -157,7 +198,7 @@ void GrpcPollingClientDriver::RpcCompletionThread() {
       finished_rpc->done_callback();
 
       // Free before allowing the shutdown of the client
-      delete finished_rpc;
+      PendingRpcPool()->Delete(finished_rpc);
       --pending_rpcs_;
     }
   }
@@ -316,10 +357,18 @@ absl::Status ProtocolDriverGrpc::Initialize(
         pd_opts, "threadpool_size", absl::base_internal::NumCPUs());
     auto threadpool_type =
         GetNamedServerSettingString(pd_opts, "threadpool_type", "");
-    auto tp = CreateThreadpool(threadpool_type, threadpool_size);
+    auto threadpool_spin_ns =
+        GetNamedServerSettingInt64(pd_opts, "threadpool_spin_ns", 0);
+    auto maybe_placement = GetThreadPlacementFromServerSettings(pd_opts);
+    if (!maybe_placement.ok()) return maybe_placement.status();
+    auto tp = CreateThreadpool(threadpool_type, threadpool_size,
+                               maybe_placement.value(), threadpool_spin_ns);
     if (!tp.ok()) {
       return tp.status();
     }
+    if (GetNamedServerSettingInt64(pd_opts, "threadpool_telemetry", 0)) {
+      tp.value()->EnableTelemetry();
+    }
     server_ = std::unique_ptr<ProtocolDriverServer>(
         new GrpcPollingServerDriver(std::move(tp.value())));
   } else {
@@ -365,6 +414,10 @@ std::vector<TransportStat> ProtocolDriverGrpc::GetTransportStats() {
   return stats;
 }
 
+std::vector<NamedThreadpoolLog> ProtocolDriverGrpc::GetThreadpoolLogs() {
+  return server_->GetThreadpoolLogs();
+}
+
 void ProtocolDriverGrpc::InitiateRpc(int peer_index, ClientRpcState* state,
                                      std::function<void(void)> done_callback) {
   client_->InitiateRpc(peer_index, state, done_callback);
@@ -427,19 +480,15 @@ void GrpcCallbackClientDriver::InitiateRpc(
   CHECK_LT(static_cast<size_t>(peer_index), grpc_client_stubs_.size());
 
   ++pending_rpcs_;
-  PendingRpc* new_rpc = new PendingRpc;
+  PendingRpc* new_rpc = PendingRpcPool()->New();
   new_rpc->done_callback = done_callback;
   new_rpc->state = state;
-  new_rpc->request = std::move(state->request);
 
   auto callback_fct = [this, new_rpc,
                        done_callback](const grpc::Status& status) {
     new_rpc->status = status;
     new_rpc->state->success = status.ok();
-    if (new_rpc->state->success) {
-      new_rpc->state->request = std::move(new_rpc->request);
-      new_rpc->state->response = std::move(new_rpc->response);
-    } else {
+    if (!new_rpc->state->success) {
       new_rpc->state->response.set_error_message(
           new_rpc->status.error_message());
       LOG_EVERY_N(ERROR, 1000) << "RPC failed with status: " << status;
@@ -447,12 +496,12 @@ void GrpcCallbackClientDriver::InitiateRpc(
     new_rpc->done_callback();
 
     // Free before allowing the shutdown of the client
-    delete new_rpc;
+    PendingRpcPool()->Delete(new_rpc);
     --pending_rpcs_;
   };
 
   grpc_client_stubs_[peer_index]->experimental_async()->GenericRpc(
-      &new_rpc->context, &new_rpc->request, &new_rpc->response, callback_fct);
+      &new_rpc->context, &state->request, &state->response, callback_fct);
 }
 
 void GrpcCallbackClientDriver::ChurnConnection(int peer) {}
@@ -465,11 +514,92 @@ void GrpcCallbackClientDriver::ShutdownClient() {
 
 // Server =====================================================================
 namespace {
+// Provides the request/response pairs for the callback server. Each request
+// is allocated from the RpcArena of a holder, and holders are recycled after
+// gRPC releases them, so that in the steady state only the payload bytes of
+// an incoming request need to be allocated.
+class ArenaMessageAllocator
+    : public grpc::MessageAllocator<GenericRequest, GenericResponse> {
+ public:
+  ~ArenaMessageAllocator() override {
+    for (auto* holder : free_holders_) {
+      delete holder;
+    }
+  }
+
+  grpc::MessageHolder<GenericRequest, GenericResponse>* AllocateMessages()
+      override {
+    ArenaMessageHolder* holder = nullptr;
+    {
+      absl::MutexLock m(&mutex_);
+      if (!free_holders_.empty()) {
+        holder = free_holders_.back();
+        free_holders_.pop_back();
+      }
+    }
+    if (holder == nullptr) {
+      holder = new ArenaMessageHolder(this);
+    }
+    holder->Initialize();
+    return holder;
+  }
+
+ private:
+  class ArenaMessageHolder
+      : public grpc::MessageHolder<GenericRequest, GenericResponse> {
+   public:
+    explicit ArenaMessageHolder(ArenaMessageAllocator* allocator)
+        : allocator_(allocator) {}
+
+    void Initialize() {
+      set_request(google::protobuf::Arena::CreateMessage<GenericRequest>(
+          rpc_arena_.arena()));
+      // The response stays off the arena, so that moving the engine's
+      // response into it is a cheap swap rather than a deep copy:
+      set_response(&response_);
+    }
+
+    void Release() override {
+      response_.Clear();
+      rpc_arena_.Reset();
+      allocator_->Recycle(this);
+    }
+
+   private:
+    ArenaMessageAllocator* allocator_;
+    RpcArena rpc_arena_;
+    GenericResponse response_;
+  };
+
+  void Recycle(ArenaMessageHolder* holder) {
+    {
+      absl::MutexLock m(&mutex_);
+      if (free_holders_.size() < kMaxFreeHolders) {
+        free_holders_.push_back(holder);
+        return;
+      }
+    }
+    delete holder;
+  }
+
+  static constexpr size_t kMaxFreeHolders = 1024;
+  absl::Mutex mutex_;
+  std::vector<ArenaMessageHolder*> free_holders_ ABSL_GUARDED_BY(mutex_);
+};
+
+ObjectPool<ServerRpcState>* ServerRpcStatePool() {
+  static auto* pool =
+      new ObjectPool<ServerRpcState>("grpc_handoff_server_rpc_state");
+  return pool;
+}
+
 class TrafficServiceAsyncCallback
     : public Traffic::ExperimentalCallbackService {
  public:
   TrafficServiceAsyncCallback(std::unique_ptr<AbstractThreadpool> tp)
-      : thread_pool_(std::move(tp)) {}
+      : thread_pool_(std::move(tp)) {
+    SetMessageAllocatorFor_GenericRpc(&message_allocator_);
+  }
   ~TrafficServiceAsyncCallback() override { handler_set_.TryToNotify(); }
 
   void SetHandler(
@@ -482,13 +612,14 @@ class TrafficServiceAsyncCallback
                                        const GenericRequest* request,
                                        GenericResponse* response) override {
     auto* reactor = context->DefaultReactor();
-    ServerRpcState* rpc_state = new ServerRpcState;
+    ServerRpcState* rpc_state = ServerRpcStatePool()->New();
     rpc_state->request = request;
     rpc_state->SetSendResponseFunction([=]() {
       *response = std::move(rpc_state->response);
       reactor->Finish(grpc::Status::OK);
     });
-    rpc_state->SetFreeStateFunction([=]() { delete rpc_state; });
+    rpc_state->SetFreeStateFunction(
+        [=]() { ServerRpcStatePool()->Delete(rpc_state); });
     handler_set_.WaitForNotification();
     if (handler_) {
       auto remaining_work = handler_(rpc_state);
@@ -499,7 +630,11 @@ class TrafficServiceAsyncCallback
     return reactor;
   }
 
+  AbstractThreadpool* thread_pool() { return thread_pool_.get(); }
+
  private:
+  // Declared first so that it outlives any RPCs still being torn down:
+  ArenaMessageAllocator message_allocator_;
   SafeNotification handler_set_;
   std::function<std::function<void()>(ServerRpcState* state)> handler_;
   std::unique_ptr<AbstractThreadpool> thread_pool_;
@@ -522,11 +657,19 @@ absl::Status GrpcHandoffServerDriver::Initialize(
       pd_opts, "threadpool_size", absl::base_internal::NumCPUs());
   auto threadpool_type =
       GetNamedServerSettingString(pd_opts, "threadpool_type", "");
+  auto threadpool_spin_ns =
+      GetNamedServerSettingInt64(pd_opts, "threadpool_spin_ns", 0);
+  auto maybe_placement = GetThreadPlacementFromServerSettings(pd_opts);
+  if (!maybe_placement.ok()) return maybe_placement.status();
 
-  auto tp = CreateThreadpool(threadpool_type, threadpool_size);
+  auto tp = CreateThreadpool(threadpool_type, threadpool_size,
+                             maybe_placement.value(), threadpool_spin_ns);
   if (!tp.ok()) {
     return tp.status();
   }
+  if (GetNamedServerSettingInt64(pd_opts, "threadpool_telemetry", 0)) {
+    tp.value()->EnableTelemetry();
+  }
   traffic_service_ =
       std::make_unique<TrafficServiceAsyncCallback>(std::move(tp.value()));
   grpc::ServerBuilder builder;
@@ -582,7 +725,17 @@ std::vector<TransportStat> GrpcHandoffServerDriver::GetTransportStats() {
   return {};
 }
 
+std::vector<NamedThreadpoolLog> GrpcHandoffServerDriver::GetThreadpoolLogs() {
+  if (!traffic_service_) return {};
+  auto* service =
+      static_cast<TrafficServiceAsyncCallback*>(traffic_service_.get());
+  return {{"handoff_server", service->thread_pool()->GetLog()}};
+}
+
 namespace {
+class PollingRpcHandlerFsm;
+ObjectPool<PollingRpcHandlerFsm>* PollingRpcHandlerFsmPool();
+
 class PollingRpcHandlerFsm {
  public:
   PollingRpcHandlerFsm(
@@ -608,7 +761,7 @@ class PollingRpcHandlerFsm {
   void DecRefAndMaybeDelete() {
     if (std::atomic_fetch_sub_explicit(&refcnt_, 1,
                                        std::memory_order_acq_rel) == 1) {
-      delete this;
+      PollingRpcHandlerFsmPool()->Delete(this);
     }
   }
 
@@ -638,7 +791,7 @@ class PollingRpcHandlerFsm {
     } else if (state_ == PROCESSING_REQUEST) {
       next_state = FINISHED_SENDING_RESPONSE;
       if (post_new_handler) {
-        new PollingRpcHandlerFsm(service_, cq_, handler_, thread_pool_);
+        PollingRpcHandlerFsmPool()->New(service_, cq_, handler_, thread_pool_);
       }
       HandleRpc();
     } else if (state_ == FINISHED_SENDING_RESPONSE) {
@@ -669,6 +822,12 @@ class PollingRpcHandlerFsm {
   ServerRpcState rpc_state_;
   std::atomic<int> refcnt_ = 1;
 };
+
+ObjectPool<PollingRpcHandlerFsm>* PollingRpcHandlerFsmPool() {
+  static auto* pool =
+      new ObjectPool<PollingRpcHandlerFsm>("grpc_polling_rpc_handler_fsm");
+  return pool;
+}
 }  // anonymous namespace
 
 // Server =====================================================================
@@ -683,6 +842,9 @@ absl::Status GrpcPollingServerDriver::Initialize(
   std::string netdev_name = pd_opts.netdev_name();
   transport_ =
       GetNamedServerSettingString(pd_opts, "transport", kDefaultTransport);
+  poller_spin_ns_ = GetNamedServerSettingInt64(pd_opts, "poller_spin_ns", 0);
+  auto maybe_placement = GetThreadPlacementFromServerSettings(pd_opts);
+  if (!maybe_placement.ok()) return maybe_placement.status();
   auto maybe_ip = IpAddressForDevice(netdev_name, pd_opts.ip_version());
   if (!maybe_ip.ok()) return maybe_ip.status();
   server_ip_address_ = maybe_ip.value();
@@ -709,7 +871,8 @@ absl::Status GrpcPollingServerDriver::Initialize(
   }
 
   // Proceed to the server's main loop.
-  handle_rpcs_ = RunRegisteredThread("RpcHandler", [=]() { HandleRpcs(); });
+  handle_rpcs_ = RunRegisteredThread(
+      "RpcHandler", [=]() { HandleRpcs(); }, maybe_placement.value());
   handle_rpcs_started_.WaitForNotification();
   return absl::OkStatus();
 }
@@ -749,12 +912,17 @@ void GrpcPollingServerDriver::ShutdownServer() {
 }
 
 std::vector<TransportStat> GrpcPollingServerDriver::GetTransportStats() {
-  return {};
+  return PollerSpinStats(poller_spin_ns_, poller_spin_stats_);
+}
+
+std::vector<NamedThreadpoolLog> GrpcPollingServerDriver::GetThreadpoolLogs() {
+  return {{"polling_server", thread_pool_->GetLog()}};
 }
 
 void GrpcPollingServerDriver::HandleRpcs() {
-  new PollingRpcHandlerFsm(traffic_async_service_.get(), server_cq_.get(),
-                           &handler_, thread_pool_.get());
+  PollingRpcHandlerFsmPool()->New(traffic_async_service_.get(),
+                                  server_cq_.get(), &handler_,
+                                  thread_pool_.get());
   // Make sure the completion queue is nonempty before allowing Initialize
   // to return:
   handle_rpcs_started_.Notify();
@@ -762,7 +930,8 @@ void GrpcPollingServerDriver::HandleRpcs() {
   bool ok;
   bool post_new_handler = true;
   handler_set_.WaitForNotification();
-  while (server_cq_->Next(&tag, &ok)) {
+  AdaptiveSpinner spinner(poller_spin_ns_, &poller_spin_stats_);
+  while (SpinThenNext(server_cq_.get(), &spinner, &tag, &ok)) {
     PollingRpcHandlerFsm* rpc_fsm = static_cast<PollingRpcHandlerFsm*>(tag);
     if (!ok) {
       server_shutdown_detected_.TryToNotify();
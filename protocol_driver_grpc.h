@@ -19,6 +19,7 @@
 
 #include "distbench.grpc.pb.h"
 #include "distbench_netutils.h"
+#include "distbench_spin_wait.h"
 #include "distbench_threadpool.h"
 #include "distbench_utils.h"
 #include "protocol_driver.h"
@@ -54,6 +55,8 @@ class GrpcPollingClientDriver : public ProtocolDriverClient {
   void RpcCompletionThread();
 
   std::string transport_;
+  int64_t poller_spin_ns_ = 0;
+  SpinStats poller_spin_stats_;
   absl::Notification shutdown_;
   std::atomic<int> pending_rpcs_ = 0;
   std::vector<std::unique_ptr<Traffic::Stub>> grpc_client_stubs_;
@@ -109,6 +112,7 @@ class ProtocolDriverGrpc : public ProtocolDriver {
   void HandleConnectFailure(std::string_view local_connection_info) override;
 
   std::vector<TransportStat> GetTransportStats() override;
+  std::vector<NamedThreadpoolLog> GetThreadpoolLogs() override;
   void InitiateRpc(int peer_index, ClientRpcState* state,
                    std::function<void(void)> done_callback) override;
   void ChurnConnection(int peer) override;
@@ -167,6 +171,7 @@ class GrpcHandoffServerDriver : public ProtocolDriverServer {
   void HandleConnectFailure(std::string_view local_connection_info) override;
 
   std::vector<TransportStat> GetTransportStats() override;
+  std::vector<NamedThreadpoolLog> GetThreadpoolLogs() override;
 
  private:
   std::unique_ptr<Traffic::ExperimentalCallbackService> traffic_service_;
@@ -193,6 +198,7 @@ class GrpcPollingServerDriver : public ProtocolDriverServer {
   void HandleConnectFailure(std::string_view local_connection_info) override;
 
   std::vector<TransportStat> GetTransportStats() override;
+  std::vector<NamedThreadpoolLog> GetThreadpoolLogs() override;
   void ProcessGenericRpc(GenericRequest* request, GenericResponse* response);
   void HandleRpcs();
   std::thread handle_rpcs_;
@@ -207,6 +213,8 @@ class GrpcPollingServerDriver : public ProtocolDriverServer {
   grpc::ServerContext context;
   std::function<std::function<void()>(ServerRpcState* state)> handler_;
   std::unique_ptr<AbstractThreadpool> thread_pool_;
+  int64_t poller_spin_ns_ = 0;
+  SpinStats poller_spin_stats_;
   SafeNotification server_shutdown_detected_;
   absl::Notification handle_rpcs_started_;
   SafeNotification handler_set_;
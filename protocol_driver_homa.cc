@@ -17,12 +17,25 @@
 #include <arpa/inet.h>
 #include <sys/mman.h>
 
+#include "distbench_object_pool.h"
 #include "distbench_thread_support.h"
 #include "external/homa_module/homa.h"
 #include "glog/logging.h"
 
 namespace distbench {
 
+namespace {
+ObjectPool<PendingHomaRpc>* PendingHomaRpcPool() {
+  static auto* pool = new ObjectPool<PendingHomaRpc>("homa_pending_rpc");
+  return pool;
+}
+
+ObjectPool<RpcArena>* RpcArenaPool() {
+  static auto* pool = new ObjectPool<RpcArena>("homa_rpc_arena");
+  return pool;
+}
+}  // anonymous namespace
+
 ///////////////////////////////////
 // ProtocolDriverHoma Methods //
 ///////////////////////////////////
@@ -114,10 +127,13 @@ absl::Status ProtocolDriverHoma::Initialize(
   }
   server_port_ = *port;
 
+  auto maybe_placement = GetThreadPlacementFromServerSettings(pd_opts);
+  if (!maybe_placement.ok()) return maybe_placement.status();
   client_completion_thread_ = RunRegisteredThread(
-      "HomaClient", [=]() { this->ClientCompletionThread(); });
-  server_thread_ =
-      RunRegisteredThread("HomaServer", [=]() { this->ServerThread(); });
+      "HomaClient", [=]() { this->ClientCompletionThread(); },
+      maybe_placement.value());
+  server_thread_ = RunRegisteredThread(
+      "HomaServer", [=]() { this->ServerThread(); }, maybe_placement.value());
   return absl::OkStatus();
 }
 
@@ -269,7 +285,7 @@ void ProtocolDriverHoma::ShutdownClient() {
 
 void ProtocolDriverHoma::InitiateRpc(int peer_index, ClientRpcState* state,
                                      std::function<void(void)> done_callback) {
-  PendingHomaRpc* new_rpc = new PendingHomaRpc;
+  PendingHomaRpc* new_rpc = PendingHomaRpcPool()->New();
 
   new_rpc->done_callback = done_callback;
   new_rpc->state = state;
@@ -290,7 +306,7 @@ void ProtocolDriverHoma::InitiateRpc(int peer_index, ClientRpcState* state,
   if (res < 0) {
     LOG(INFO) << "homa_send result: " << res << " errno: " << errno
               << " kernel_rpc_number " << kernel_rpc_number;
-    delete new_rpc;
+    PendingHomaRpcPool()->Delete(new_rpc);
     state->success = false;
     done_callback();
   }
@@ -321,18 +337,21 @@ void ProtocolDriverHoma::ServerThread() {
     const sockaddr_in_union src_addr = *server_receiver_->src_addr();
     const uint64_t rpc_id = server_receiver_->id();
 
-    GenericRequest* request = new GenericRequest;
+    // The request and its ServerRpcState share a single arena:
+    RpcArena* rpc_arena = RpcArenaPool()->New();
+    GenericRequest* request =
+        google::protobuf::Arena::CreateMessage<GenericRequest>(
+            rpc_arena->arena());
     char rx_buf[1048576];
     server_receiver_->copy_out((void*)rx_buf, 0, sizeof(rx_buf));
     if (!request->ParseFromArray(rx_buf + 1, msg_length - 1)) {
       LOG(ERROR) << "rx_buf did not parse as a GenericRequest";
     }
-    ServerRpcState* rpc_state = new ServerRpcState;
+    ServerRpcState* rpc_state =
+        google::protobuf::Arena::Create<ServerRpcState>(rpc_arena->arena());
     rpc_state->request = request;
-    rpc_state->SetFreeStateFunction([=]() {
-      delete rpc_state->request;
-      delete rpc_state;
-    });
+    rpc_state->SetFreeStateFunction(
+        [=]() { RpcArenaPool()->Delete(rpc_arena); });
     rpc_state->SetSendResponseFunction([=, &pending_actionlist_threads]() {
       std::string txbuf = "!";  // Homa can't send a 0 byte message :(
       rpc_state->response.AppendToString(&txbuf);
@@ -387,7 +406,7 @@ void ProtocolDriverHoma::ClientCompletionThread() {
     }
     pending_rpc->done_callback();
     --pending_rpcs_;
-    delete pending_rpc;
+    PendingHomaRpcPool()->Delete(pending_rpc);
   }
 }
 
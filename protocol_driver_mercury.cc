@@ -23,6 +23,7 @@
 #include "absl/base/internal/sysinfo.h"
 #include "absl/strings/str_replace.h"
 #include "absl/synchronization/mutex.h"
+#include "distbench_object_pool.h"
 #include "distbench_thread_support.h"
 #include "glog/logging.h"
 
@@ -32,6 +33,13 @@ ABSL_CONST_INIT absl::Mutex mercury_init_mutex(absl::kConstInit);
 
 namespace distbench {
 
+namespace {
+ObjectPool<RpcArena>* RpcArenaPool() {
+  static auto* pool = new ObjectPool<RpcArena>("mercury_rpc_arena");
+  return pool;
+}
+}  // anonymous namespace
+
 ProtocolDriverMercury::ProtocolDriverMercury() {}
 
 absl::Status ProtocolDriverMercury::Initialize(
@@ -48,6 +56,9 @@ absl::Status ProtocolDriverMercury::Initialize(
   if (!tp.ok()) {
     return tp.status();
   }
+  if (GetNamedServerSettingInt64(pd_opts, "threadpool_telemetry", 0)) {
+    tp.value()->EnableTelemetry();
+  }
   thread_pool_ = std::move(tp.value());
   std::string netdev_name = pd_opts.netdev_name();
   auto maybe_ip = IpAddressForDevice(
@@ -115,8 +126,11 @@ absl::Status ProtocolDriverMercury::Initialize(
   PrintMercuryVersion();
   VLOG(1) << "Mercury Traffic server listening on " << server_socket_address_;
 #endif
+  auto maybe_placement = GetThreadPlacementFromServerSettings(pd_opts);
+  if (!maybe_placement.ok()) return maybe_placement.status();
   progress_thread_ = RunRegisteredThread(
-      "MercuryProgress", [=]() { this->RpcCompletionThread(); });
+      "MercuryProgress", [=]() { this->RpcCompletionThread(); },
+      maybe_placement.value());
   return absl::OkStatus();
 }
 
@@ -185,14 +199,17 @@ void ProtocolDriverMercury::PrintMercuryVersion() {
 
 namespace {
 struct PendingRpc {
-  GenericRequest request;
-  GenericResponse response;
   std::function<void(void)> done_callback;
   ClientRpcState* state;
   ProtocolDriverMercury* this_pd;
   mercury_generic_rpc_string_t encoded_request;
   hg_handle_t hg_handle;
 };
+
+ObjectPool<PendingRpc>* PendingRpcPool() {
+  static auto* pool = new ObjectPool<PendingRpc>("mercury_pending_rpc");
+  return pool;
+}
 }  // anonymous namespace
 
 void ProtocolDriverMercury::InitiateRpc(
@@ -213,14 +230,13 @@ void ProtocolDriverMercury::InitiateRpc(
     return;
   }
 
-  PendingRpc* new_rpc = new PendingRpc();
+  PendingRpc* new_rpc = PendingRpcPool()->New();
   new_rpc->done_callback = done_callback;
   new_rpc->state = state;
-  new_rpc->request = std::move(state->request);
   new_rpc->this_pd = this;
   new_rpc->hg_handle = target_handle;
 
-  new_rpc->request.SerializeToString(&new_rpc->encoded_request.string);
+  state->request.SerializeToString(&new_rpc->encoded_request.string);
 
   hg_ret = HG_Forward(target_handle, StaticClientCallback, new_rpc,
                       &new_rpc->encoded_request);
@@ -314,10 +330,15 @@ hg_return_t ProtocolDriverMercury::RpcServerCallback(hg_handle_t handle) {
     LOG(ERROR) << "HG_Get_input: failed";
   }
 
-  ServerRpcState* rpc_state = new ServerRpcState();
+  // The request and its ServerRpcState share a single arena:
+  RpcArena* rpc_arena = RpcArenaPool()->New();
+  ServerRpcState* rpc_state =
+      google::protobuf::Arena::Create<ServerRpcState>(rpc_arena->arena());
   rpc_state->have_dedicated_thread = false;
 
-  distbench::GenericRequest* request = new distbench::GenericRequest();
+  distbench::GenericRequest* request =
+      google::protobuf::Arena::CreateMessage<distbench::GenericRequest>(
+          rpc_arena->arena());
   bool success = request->ParseFromString(input.string);
   if (!success) {
     LOG(ERROR) << "Unable to decode payload !";
@@ -342,10 +363,8 @@ hg_return_t ProtocolDriverMercury::RpcServerCallback(hg_handle_t handle) {
       LOG(ERROR) << "HG_Respond: failed";
     }
   });
-  rpc_state->SetFreeStateFunction([rpc_state]() {
-    delete rpc_state->request;
-    delete rpc_state;
-  });
+  rpc_state->SetFreeStateFunction(
+      [rpc_arena]() { RpcArenaPool()->Delete(rpc_arena); });
 
   auto remaining_work = handler_(rpc_state);
   if (remaining_work) {
@@ -378,12 +397,9 @@ hg_return_t ProtocolDriverMercury::RpcClientCallback(
     return hg_ret;
   }
 
-  bool success = rpc->response.ParseFromString(result.string);
+  bool success = rpc->state->response.ParseFromString(result.string);
   if (!success) {
     LOG(ERROR) << "Unable to decode payload";
-  } else {
-    rpc->state->request = std::move(rpc->request);
-    rpc->state->response = std::move(rpc->response);
   }
   rpc->state->success = success;
   rpc->done_callback();
@@ -398,7 +414,7 @@ hg_return_t ProtocolDriverMercury::RpcClientCallback(
     LOG(ERROR) << "HG_Destroy: failed";
   }
 
-  delete rpc;
+  PendingRpcPool()->Delete(rpc);
   --pending_rpcs_;
   return HG_SUCCESS;
 }
@@ -0,0 +1,206 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "protocol_driver_sharded_transport.h"
+
+#include <sched.h>
+
+#include "distbench_utils.h"
+#include "glog/logging.h"
+#include "protocol_driver_allocator.h"
+
+namespace distbench {
+
+namespace {
+
+// Returns the connection info of the given shard, or an empty string for a
+// remote side without that many shards:
+std::string ShardConnectionInfo(const ShardedConnectionInfo& info, int shard) {
+  if (shard < info.shard_connection_info_size()) {
+    return info.shard_connection_info(shard);
+  }
+  return "";
+}
+
+}  // namespace
+
+ProtocolDriverShardedTransport::ProtocolDriverShardedTransport(int tree_depth) {
+  tree_depth_ = tree_depth;
+}
+
+ProtocolDriverShardedTransport::~ProtocolDriverShardedTransport() {}
+
+absl::Status ProtocolDriverShardedTransport::Initialize(
+    const ProtocolDriverOptions& pd_opts, int* port) {
+  int num_shards = GetNamedServerSettingInt64(pd_opts, "num_shards", 1);
+  if (num_shards < 1) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("num_shards (", num_shards, ") must be positive."));
+  }
+  auto pdo = pd_opts;
+  pdo.set_protocol_name(
+      GetNamedServerSettingString(pd_opts, "next_protocol_driver", "grpc"));
+  auto server_settings = pdo.mutable_server_settings();
+  for (auto it = server_settings->begin(); it != server_settings->end();) {
+    if (it->name() == "next_protocol_driver" || it->name() == "num_shards") {
+      it = server_settings->erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  ports_.resize(num_shards);
+  for (int i = 0; i < num_shards; ++i) {
+    auto maybe_shard = AllocateProtocolDriver(pdo, &ports_[i], tree_depth_ + 1);
+    if (!maybe_shard.ok()) return maybe_shard.status();
+    shards_.push_back(std::move(maybe_shard.value()));
+  }
+  return absl::OkStatus();
+}
+
+void ProtocolDriverShardedTransport::SetHandler(
+    std::function<std::function<void()>(ServerRpcState* state)> handler) {
+  for (auto& shard : shards_) {
+    shard->SetHandler(handler);
+  }
+}
+
+void ProtocolDriverShardedTransport::SetNumPeers(int num_peers) {
+  for (auto& shard : shards_) {
+    shard->SetNumPeers(num_peers);
+  }
+}
+
+absl::StatusOr<std::string> ProtocolDriverShardedTransport::Preconnect() {
+  ShardedConnectionInfo info;
+  for (auto& shard : shards_) {
+    auto maybe_info = shard->Preconnect();
+    if (!maybe_info.ok()) return maybe_info.status();
+    info.add_shard_connection_info(std::move(maybe_info.value()));
+  }
+  std::string ret;
+  info.AppendToString(&ret);
+  return ret;
+}
+
+absl::StatusOr<std::string> ProtocolDriverShardedTransport::HandlePreConnect(
+    std::string_view remote_connection_info, int peer) {
+  ShardedConnectionInfo remote_info;
+  if (!remote_info.ParseFromArray(remote_connection_info.data(),
+                                  remote_connection_info.size())) {
+    return absl::InvalidArgumentError(
+        "Could not parse the sharded connection info");
+  }
+  ShardedConnectionInfo info;
+  for (size_t i = 0; i < shards_.size(); ++i) {
+    auto maybe_info = shards_[i]->HandlePreConnect(
+        ShardConnectionInfo(remote_info, i), peer);
+    if (!maybe_info.ok()) return maybe_info.status();
+    info.add_shard_connection_info(std::move(maybe_info.value()));
+  }
+  std::string ret;
+  info.AppendToString(&ret);
+  return ret;
+}
+
+absl::Status ProtocolDriverShardedTransport::HandleConnect(
+    std::string remote_connection_info, int peer) {
+  ShardedConnectionInfo remote_info;
+  if (!remote_info.ParseFromString(remote_connection_info)) {
+    return absl::InvalidArgumentError(
+        "Could not parse the sharded connection info");
+  }
+  if (remote_info.shard_connection_info().empty()) {
+    return absl::InvalidArgumentError("The remote side has no shards");
+  }
+  // If the remote side has fewer shards, some of its shards serve several of
+  // ours:
+  for (size_t i = 0; i < shards_.size(); ++i) {
+    auto ret = shards_[i]->HandleConnect(
+        remote_info.shard_connection_info(
+            i % remote_info.shard_connection_info_size()),
+        peer);
+    if (!ret.ok()) return ret;
+  }
+  return absl::OkStatus();
+}
+
+void ProtocolDriverShardedTransport::HandleConnectFailure(
+    std::string_view local_connection_info) {
+  ShardedConnectionInfo local_info;
+  local_info.ParseFromArray(local_connection_info.data(),
+                            local_connection_info.size());
+  for (size_t i = 0; i < shards_.size(); ++i) {
+    shards_[i]->HandleConnectFailure(ShardConnectionInfo(local_info, i));
+  }
+}
+
+std::vector<TransportStat> ProtocolDriverShardedTransport::GetTransportStats() {
+  std::vector<TransportStat> transport_stats;
+  for (size_t i = 0; i < shards_.size(); ++i) {
+    std::string prefix = absl::StrCat("shard_", i, "/");
+    for (auto& stat : shards_[i]->GetTransportStats()) {
+      stat.name.insert(0, prefix);
+      transport_stats.push_back(std::move(stat));
+    }
+  }
+  return transport_stats;
+}
+
+std::vector<NamedThreadpoolLog>
+ProtocolDriverShardedTransport::GetThreadpoolLogs() {
+  std::vector<NamedThreadpoolLog> logs;
+  for (size_t i = 0; i < shards_.size(); ++i) {
+    std::string prefix = absl::StrCat("shard_", i, "/");
+    for (auto& log : shards_[i]->GetThreadpoolLogs()) {
+      log.name.insert(0, prefix);
+      logs.push_back(std::move(log));
+    }
+  }
+  return logs;
+}
+
+ProtocolDriver* ProtocolDriverShardedTransport::PickShard() {
+  int cpu = sched_getcpu();
+  if (cpu < 0) {
+    cpu = next_shard_.fetch_add(1, std::memory_order_relaxed);
+  }
+  return shards_[static_cast<unsigned int>(cpu) % shards_.size()].get();
+}
+
+void ProtocolDriverShardedTransport::InitiateRpc(
+    int peer_index, ClientRpcState* state,
+    std::function<void(void)> done_callback) {
+  PickShard()->InitiateRpc(peer_index, state, std::move(done_callback));
+}
+
+void ProtocolDriverShardedTransport::ChurnConnection(int peer) {
+  for (auto& shard : shards_) {
+    shard->ChurnConnection(peer);
+  }
+}
+
+void ProtocolDriverShardedTransport::ShutdownClient() {
+  for (auto& shard : shards_) {
+    shard->ShutdownClient();
+  }
+}
+
+void ProtocolDriverShardedTransport::ShutdownServer() {
+  for (auto& shard : shards_) {
+    shard->ShutdownServer();
+  }
+}
+
+}  // namespace distbench
@@ -0,0 +1,71 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef DISTBENCH_PROTOCOL_DRIVER_SHARDED_TRANSPORT_H_
+#define DISTBENCH_PROTOCOL_DRIVER_SHARDED_TRANSPORT_H_
+
+#include "protocol_driver.h"
+
+namespace distbench {
+
+// Shards the transport of a service across num_shards instances of
+// next_protocol_driver, run side by side like ProtocolDriverDoubleBarrel does
+// for two. Each shard has its own server, connections and completion threads.
+// Client shard i connects to server shard i of each peer, and RPCs are sent
+// through the shard of the CPU that initiates them, so that connection state
+// stays local to that CPU. The engine state that the handlers and clients
+// use, such as the action list state, the recorded samples and the engine
+// threadpool, is not sharded, and is still shared by all the shards.
+class ProtocolDriverShardedTransport : public ProtocolDriver {
+ public:
+  ProtocolDriverShardedTransport(int tree_depth);
+  ~ProtocolDriverShardedTransport() override;
+
+  absl::Status Initialize(const ProtocolDriverOptions& pd_opts,
+                          int* port) override;
+
+  void SetHandler(std::function<std::function<void()>(ServerRpcState* state)>
+                      handler) override;
+  void SetNumPeers(int num_peers) override;
+
+  // The connection info of all the shards is packed into a
+  // ShardedConnectionInfo:
+  absl::StatusOr<std::string> Preconnect() override;
+  absl::Status HandleConnect(std::string remote_connection_info,
+                             int peer) override;
+  absl::StatusOr<std::string> HandlePreConnect(
+      std::string_view remote_connection_info, int peer) override;
+  void HandleConnectFailure(std::string_view local_connection_info) override;
+
+  std::vector<TransportStat> GetTransportStats() override;
+  std::vector<NamedThreadpoolLog> GetThreadpoolLogs() override;
+  void InitiateRpc(int peer_index, ClientRpcState* state,
+                   std::function<void(void)> done_callback) override;
+  void ChurnConnection(int peer) override;
+  void ShutdownServer() override;
+  void ShutdownClient() override;
+
+ private:
+  ProtocolDriver* PickShard();
+
+  std::vector<std::unique_ptr<ProtocolDriver>> shards_;
+  std::vector<int> ports_;
+  int tree_depth_;
+  // Used when the current CPU is unknown:
+  std::atomic<int> next_shard_ = 0;
+};
+
+}  // namespace distbench
+
+#endif  // DISTBENCH_PROTOCOL_DRIVER_SHARDED_TRANSPORT_H_
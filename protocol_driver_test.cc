@@ -229,6 +229,14 @@ std::string DoubleBarrelGrpc() {
   return pdo.DebugString();
 }
 
+std::string ShardedTransportGrpc() {
+  ProtocolDriverOptions pdo;
+  pdo.set_protocol_name("sharded_transport");
+  AddServerInt64OptionTo(pdo, "num_shards", 3);
+  AddServerStringOptionTo(pdo, "next_protocol_driver", "grpc");
+  return pdo.DebugString();
+}
+
 std::string GrpcPollingClientHandoffServer() {
   ProtocolDriverOptions pdo;
   pdo.set_protocol_name("grpc");
@@ -313,7 +321,8 @@ INSTANTIATE_TEST_SUITE_P(ProtocolDriverTests, ProtocolDriverTest,
 #ifdef WITH_MERCURY
                            MercuryOptions(),
 #endif
-                           DoubleBarrelGrpc()
+                           DoubleBarrelGrpc(),
+                           ShardedTransportGrpc()
                            )
                          );
 // clang-format on